@@ -0,0 +1,499 @@
+// Runs every packing and codec path of the streamers on recorded or synthetic
+// frames and reports per frame type and path: MB/s in (raw payload bytes per
+// second of packing + encoding), MB/s out (payload bytes per second), ratio
+// and the p50/p99 time per frame. Every payload that has a decoder is decoded
+// again and compared with the raw payload of the frame.
+//
+// Corpus files are recorded with PythonReceiver/DataCollection/frame_recorder.py
+// (see FrameCorpus.h); without --corpus synthetic frames are used.
+//
+//   CodecBench [--corpus <dir or .hl2rec file>] [--frames n] [--passes n]
+//              [--json <file>] [--scalar]
+//
+// --json writes the results as one JSON document to compare runs with.
+
+#include "DepthCodec.h"
+#include "FrameCorpus.h"
+#include "FramePacking.h"
+#include "PayloadEncoding.h"
+#include "TemporalCodec.h"
+#include "TiledQoi.h"
+#include "WorkerPool.h"
+#include "lz4.h"
+#include "qoi.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using namespace FrameCorpus;
+	using Clock = std::chrono::steady_clock;
+
+	constexpr uint16_t kAhatInvalid = 4090;
+	constexpr uint8_t kLongThrowInvalid = 0x80;
+
+	// One packing + encoding path of a stream. encode packs the frame and
+	// writes its payload to out (sized by the caller to capacity), returning
+	// its size or 0 on failure. decode turns a payload back into the raw
+	// payload; paths without a decoder (lossy ones) leave it empty.
+	struct Path
+	{
+		std::string name;
+		size_t capacity;
+		std::function<size_t(const Frame& frame, uint8_t* out)> encode;
+		std::function<bool(const uint8_t* in, size_t size, std::vector<uint8_t>& raw)> decode;
+	};
+
+	struct Result
+	{
+		std::string type;
+		std::string source;
+		int width;
+		int height;
+		std::string path;
+		size_t frames = 0;
+		double rawBytes = 0;
+		double payloadBytes = 0;
+		double seconds = 0;
+		double p50 = 0;
+		double p99 = 0;
+		// -1 no decoder, 0 mismatch, 1 every frame round-tripped
+		int roundTrip = -1;
+	};
+
+	size_t RawSize(const Sequence& sequence)
+	{
+		const size_t count = (size_t)sequence.width * sequence.height;
+		switch (sequence.type)
+		{
+		case FrameType::PV: return count * 3;
+		case FrameType::VLC: return count;
+		default: return count * 4;
+		}
+	}
+
+	// the raw payload as the streamers send it
+	void PackRaw(const Sequence& sequence, const Frame& frame, uint8_t* out)
+	{
+		const size_t count = (size_t)sequence.width * sequence.height;
+		switch (sequence.type)
+		{
+		case FrameType::PV:
+			FramePacking::DownscaleBgraToBgr(frame.image.data(), sequence.width, sequence.height, sequence.width * 4, 1, out);
+			break;
+		case FrameType::VLC:
+			memcpy(out, frame.image.data(), count);
+			break;
+		case FrameType::Ahat:
+			FramePacking::PackAhatDepthAb(frame.depth.data(), frame.ab.data(), count, kAhatInvalid, out);
+			break;
+		case FrameType::LongThrow:
+			FramePacking::PackLongThrowDepthAb(frame.depth.data(), frame.sigma.data(), frame.ab.data(), count,
+				kLongThrowInvalid, out);
+			break;
+		}
+	}
+
+	bool DecodeLz4(const uint8_t* in, size_t size, size_t rawSize, std::vector<uint8_t>& raw)
+	{
+		raw.resize(rawSize);
+		return LZ4_decompress_safe((const char*)in, (char*)raw.data(), (int)size, (int)rawSize) == (int)rawSize;
+	}
+
+	// LZ4 on the raw payload (PayloadEncoding::Lz4), stored when it does not
+	// shrink, like the streamers do
+	Path MakeLz4Path(const Sequence& sequence)
+	{
+		const size_t rawSize = RawSize(sequence);
+		auto pRaw = std::make_shared<std::vector<uint8_t>>(rawSize);
+		return {
+			"lz4", rawSize,
+			[&sequence, pRaw, rawSize](const Frame& frame, uint8_t* out)
+			{
+				PackRaw(sequence, frame, pRaw->data());
+				const int size = LZ4_compress_default((const char*)pRaw->data(), (char*)out, (int)rawSize, (int)rawSize - 1);
+				if (size > 0)
+				{
+					return (size_t)size;
+				}
+				memcpy(out, pRaw->data(), rawSize);
+				return rawSize;
+			},
+			[rawSize](const uint8_t* in, size_t size, std::vector<uint8_t>& raw)
+			{
+				if (size == rawSize)
+				{
+					raw.assign(in, in + size);
+					return true;
+				}
+				return DecodeLz4(in, size, rawSize, raw);
+			} };
+	}
+
+	Path MakeTemporalPath(const Sequence& sequence, TemporalCodec::Method method)
+	{
+		const size_t rawSize = RawSize(sequence);
+		auto pRaw = std::make_shared<std::vector<uint8_t>>(rawSize);
+		auto pEncoder = std::make_shared<TemporalCodec::Encoder>(TemporalCodec::kDefaultKeyframeInterval, 1, method);
+		auto pDecoder = std::make_shared<TemporalCodec::Decoder>();
+		return {
+			method == TemporalCodec::Method::XorDelta ? "delta-xor" : "delta-dict",
+			TemporalCodec::MaxEncodedSize(rawSize),
+			[&sequence, pRaw, pEncoder, rawSize](const Frame& frame, uint8_t* out)
+			{
+				PackRaw(sequence, frame, pRaw->data());
+				return pEncoder->Encode(pRaw->data(), rawSize, out, TemporalCodec::MaxEncodedSize(rawSize));
+			},
+			[pDecoder, rawSize](const uint8_t* in, size_t size, std::vector<uint8_t>& raw)
+			{
+				raw.resize(rawSize);
+				return pDecoder->Decode(in, size, raw.data(), rawSize);
+			} };
+	}
+
+	std::vector<Path> MakePaths(const Sequence& sequence, WorkerPool* pool)
+	{
+		const size_t count = (size_t)sequence.width * sequence.height;
+		const size_t rawSize = RawSize(sequence);
+		const int width = sequence.width;
+		const int height = sequence.height;
+
+		std::vector<Path> paths;
+		paths.push_back({ "raw", rawSize,
+			[&sequence](const Frame& frame, uint8_t* out)
+			{
+				PackRaw(sequence, frame, out);
+				return RawSize(sequence);
+			},
+			[](const uint8_t* in, size_t size, std::vector<uint8_t>& raw)
+			{
+				raw.assign(in, in + size);
+				return true;
+			} });
+		paths.push_back(MakeLz4Path(sequence));
+
+		switch (sequence.type)
+		{
+		case FrameType::PV:
+		{
+			// "Downscale" 2 and 4, lossy
+			for (int factor : { 2, 4 })
+			{
+				paths.push_back({ "raw/" + std::to_string(factor), rawSize,
+					[width, height, factor](const Frame& frame, uint8_t* out)
+					{
+						FramePacking::DownscaleBgraToBgr(frame.image.data(), width, height, width * 4, factor, out);
+						return (size_t)(width / factor) * (height / factor) * 3;
+					},
+					nullptr });
+			}
+
+			// the single qoi_encode the PV stream started out with; its bound
+			// is 4 bytes per pixel plus a 14 byte header and 8 byte end marker
+			auto pBgr = std::make_shared<std::vector<uint8_t>>(rawSize);
+			paths.push_back({ "qoi", count * 4 + 14 + 8,
+				[pBgr, width, height](const Frame& frame, uint8_t* out)
+				{
+					FramePacking::DownscaleBgraToBgr(frame.image.data(), width, height, width * 4, 1, pBgr->data());
+					qoi_desc desc = { (unsigned int)width, (unsigned int)height, 3, QOI_SRGB };
+					int size = 0;
+					void* encoded = qoi_encode(pBgr->data(), &desc, &size);
+					if (!encoded)
+					{
+						return (size_t)0;
+					}
+					memcpy(out, encoded, size);
+					free(encoded);
+					return (size_t)size;
+				},
+				[width, height](const uint8_t* in, size_t size, std::vector<uint8_t>& raw)
+				{
+					qoi_desc desc;
+					void* pixels = qoi_decode(in, (int)size, &desc, 3);
+					if (!pixels)
+					{
+						return false;
+					}
+					const bool sameSize = desc.width == (unsigned int)width && desc.height == (unsigned int)height;
+					if (sameSize)
+					{
+						raw.assign((uint8_t*)pixels, (uint8_t*)pixels + (size_t)width * height * 3);
+					}
+					free(pixels);
+					return sameSize;
+				} });
+
+			paths.push_back({ "qoi-tiled",
+				TiledQoi::MaxEncodedSize(width, height, 3, TiledQoi::kDefaultBandCount),
+				[pBgr, width, height, pool](const Frame& frame, uint8_t* out)
+				{
+					FramePacking::DownscaleBgraToBgr(frame.image.data(), width, height, width * 4, 1, pBgr->data());
+					return TiledQoi::Encode(pBgr->data(), width, height, 3, TiledQoi::kDefaultBandCount, pool, out,
+						TiledQoi::MaxEncodedSize(width, height, 3, TiledQoi::kDefaultBandCount));
+				},
+				[pool, rawSize](const uint8_t* in, size_t size, std::vector<uint8_t>& raw)
+				{
+					raw.resize(rawSize);
+					return TiledQoi::Decode(in, size, pool, raw.data(), rawSize);
+				} });
+			break;
+		}
+
+		case FrameType::Ahat:
+		case FrameType::LongThrow:
+		{
+			const bool ahat = sequence.type == FrameType::Ahat;
+			paths.push_back({ "packed12", kPacked12HeaderSize + 2 * FramePacking::Packed12Size(count),
+				[ahat, count](const Frame& frame, uint8_t* out)
+				{
+					const bool packed = ahat ?
+						FramePacking::PackAhatDepthAb12(frame.depth.data(), frame.ab.data(), count, kAhatInvalid,
+							out + kPacked12HeaderSize) :
+						FramePacking::PackLongThrowDepthAb12(frame.depth.data(), frame.sigma.data(), frame.ab.data(),
+							count, kLongThrowInvalid, out + kPacked12HeaderSize);
+					const uint32_t flags = ahat ? kPacked12BigEndianPlanes : 0;
+					memcpy(out, &flags, sizeof(flags));
+					return packed ? kPacked12HeaderSize + 2 * FramePacking::Packed12Size(count) : (size_t)0;
+				},
+				[ahat, count](const uint8_t* in, size_t size, std::vector<uint8_t>& raw)
+				{
+					raw.resize(4 * count);
+					const uint8_t* pImages = in + kPacked12HeaderSize;
+					FramePacking::Unpack12(pImages, count, ahat, raw.data());
+					FramePacking::Unpack12(pImages + FramePacking::Packed12Size(count), count, ahat, raw.data() + 2 * count);
+					return size == kPacked12HeaderSize + 2 * FramePacking::Packed12Size(count);
+				} });
+
+			// Long Throw applies the sigma mask first, RVL only knows zero
+			// as invalid
+			auto pMasked = std::make_shared<std::vector<uint16_t>>(count);
+			paths.push_back({ "rvl", rawSize,
+				[ahat, count, rawSize, pMasked](const Frame& frame, uint8_t* out)
+				{
+					if (ahat)
+					{
+						return DepthCodec::EncodeDepthAb(frame.depth.data(), frame.ab.data(), count,
+							kAhatInvalid, kAhatInvalid, true, out, rawSize);
+					}
+					for (size_t i = 0; i < count; i++)
+					{
+						(*pMasked)[i] = (frame.sigma[i] & kLongThrowInvalid) ? 0 : frame.depth[i];
+					}
+					return DepthCodec::EncodeDepthAb(pMasked->data(), frame.ab.data(), count,
+						DepthCodec::kKeepAllValues, DepthCodec::kKeepAllValues, false, out, rawSize);
+				},
+				[count](const uint8_t* in, size_t size, std::vector<uint8_t>& raw)
+				{
+					raw.resize(4 * count);
+					return DepthCodec::DecodeDepthAb(in, size, count, raw.data());
+				} });
+			break;
+		}
+
+		case FrameType::VLC:
+			break;
+		}
+
+		paths.push_back(MakeTemporalPath(sequence, TemporalCodec::Method::XorDelta));
+		paths.push_back(MakeTemporalPath(sequence, TemporalCodec::Method::Lz4Dictionary));
+		return paths;
+	}
+
+	double Percentile(std::vector<double> values, double p)
+	{
+		if (values.empty())
+		{
+			return 0;
+		}
+		std::sort(values.begin(), values.end());
+		const size_t index = (size_t)std::ceil(p * values.size());
+		return values[(std::min)(values.size() - 1, index > 0 ? index - 1 : 0)];
+	}
+
+	Result Run(const Sequence& sequence, Path& path, int passes)
+	{
+		Result result{ FrameTypeName(sequence.type), sequence.source, sequence.width, sequence.height, path.name };
+		const size_t rawSize = RawSize(sequence);
+		std::vector<uint8_t> out(path.capacity);
+		std::vector<uint8_t> reference(rawSize);
+		std::vector<uint8_t> decoded;
+		std::vector<double> times;
+		bool ok = true;
+
+		for (int pass = 0; pass < passes; pass++)
+		{
+			for (const Frame& frame : sequence.frames)
+			{
+				const Clock::time_point start = Clock::now();
+				const size_t size = path.encode(frame, out.data());
+				const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+				times.push_back(seconds);
+				result.seconds += seconds;
+				result.rawBytes += rawSize;
+				// a failed encoding goes out raw
+				result.payloadBytes += size ? size : rawSize;
+				result.frames++;
+
+				if (path.decode && size)
+				{
+					PackRaw(sequence, frame, reference.data());
+					ok = path.decode(out.data(), size, decoded) && decoded == reference && ok;
+				}
+			}
+		}
+
+		result.p50 = Percentile(times, 0.50);
+		result.p99 = Percentile(times, 0.99);
+		if (path.decode)
+		{
+			result.roundTrip = ok ? 1 : 0;
+		}
+		return result;
+	}
+
+	std::string JsonString(const std::string& value)
+	{
+		std::string quoted = "\"";
+		for (char c : value)
+		{
+			if (c == '"' || c == '\\')
+			{
+				quoted += '\\';
+			}
+			quoted += c;
+		}
+		return quoted + "\"";
+	}
+
+	bool WriteJson(const std::string& fileName, const std::vector<Result>& results, int passes)
+	{
+		FILE* file = fopen(fileName.c_str(), "w");
+		if (!file)
+		{
+			return false;
+		}
+
+		char kernels[16];
+		snprintf(kernels, sizeof(kernels), "%ls", FramePacking::KernelPathName(FramePacking::ActiveKernelPath()));
+		fprintf(file, "{\n  \"kernels\": %s,\n  \"passes\": %d,\n  \"results\": [", JsonString(kernels).c_str(), passes);
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const Result& r = results[i];
+			fprintf(file, "%s\n    {\"type\": %s, \"source\": %s, \"width\": %d, \"height\": %d, \"path\": %s, "
+				"\"frames\": %zu, \"raw_bytes\": %.0f, \"payload_bytes\": %.0f, \"ratio\": %.4f, "
+				"\"mb_per_s_in\": %.2f, \"mb_per_s_out\": %.2f, \"p50_ms\": %.4f, \"p99_ms\": %.4f, \"round_trip\": %s}",
+				i ? "," : "", JsonString(r.type).c_str(), JsonString(r.source).c_str(), r.width, r.height,
+				JsonString(r.path).c_str(), r.frames, r.rawBytes, r.payloadBytes, r.rawBytes / r.payloadBytes,
+				r.rawBytes / r.seconds / 1e6, r.payloadBytes / r.seconds / 1e6, 1e3 * r.p50, 1e3 * r.p99,
+				r.roundTrip < 0 ? "null" : (r.roundTrip ? "true" : "false"));
+		}
+		fprintf(file, "\n  ]\n}\n");
+		return fclose(file) == 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string corpus;
+	std::string jsonFile;
+	size_t frameCount = 20;
+	int passes = 3;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--corpus" && hasValue)
+		{
+			corpus = argv[++i];
+		}
+		else if (arg == "--frames" && hasValue)
+		{
+			frameCount = (size_t)atoi(argv[++i]);
+		}
+		else if (arg == "--passes" && hasValue)
+		{
+			passes = (std::max)(1, atoi(argv[++i]));
+		}
+		else if (arg == "--json" && hasValue)
+		{
+			jsonFile = argv[++i];
+		}
+		else if (arg == "--scalar")
+		{
+			FramePacking::SetKernelPath(FramePacking::KernelPath::Scalar);
+		}
+		else
+		{
+			fprintf(stderr, "usage: CodecBench [--corpus <dir or .hl2rec file>] [--frames n] [--passes n] "
+				"[--json <file>] [--scalar]\n");
+			return 2;
+		}
+	}
+
+	std::vector<Sequence> sequences;
+	if (corpus.empty())
+	{
+		sequences = MakeSynthetic(frameCount);
+	}
+	else
+	{
+		std::string error;
+		const bool loaded = std::filesystem::is_directory(corpus) ?
+			LoadDirectory(corpus, frameCount, sequences, error) :
+			LoadFile(corpus, frameCount, sequences, error);
+		if (!loaded)
+		{
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+	}
+
+	// the plugin's pool: all cores but the one the caller runs on
+	const size_t threads = WorkerPool::DefaultThreadCount();
+	std::unique_ptr<WorkerPool> pool = threads > 0 ? std::make_unique<WorkerPool>(threads) : nullptr;
+
+	printf("%ls packing kernels, %zu frames per sequence, %d passes, %zu QOI threads\n",
+		FramePacking::KernelPathName(FramePacking::ActiveKernelPath()), frameCount, passes, threads + 1);
+
+	std::vector<Result> results;
+	bool allRoundTripped = true;
+	for (const Sequence& sequence : sequences)
+	{
+		if (sequence.frames.empty())
+		{
+			continue;
+		}
+		printf("\n%s %dx%d, %s (%zu frames)\n", FrameTypeName(sequence.type), sequence.width, sequence.height,
+			sequence.source.c_str(), sequence.frames.size());
+		printf("  %-11s %8s %10s %10s %9s %9s\n", "path", "ratio", "in MB/s", "out MB/s", "p50 ms", "p99 ms");
+
+		std::vector<Path> paths = MakePaths(sequence, pool.get());
+		for (Path& path : paths)
+		{
+			const Result r = Run(sequence, path, passes);
+			printf("  %-11s %8.2f %10.1f %10.1f %9.3f %9.3f%s\n", r.path.c_str(), r.rawBytes / r.payloadBytes,
+				r.rawBytes / r.seconds / 1e6, r.payloadBytes / r.seconds / 1e6, 1e3 * r.p50, 1e3 * r.p99,
+				r.roundTrip == 0 ? "  ROUND TRIP FAILED" : "");
+			allRoundTripped = allRoundTripped && r.roundTrip != 0;
+			results.push_back(r);
+		}
+	}
+
+	if (!jsonFile.empty() && !WriteJson(jsonFile, results, passes))
+	{
+		fprintf(stderr, "could not write %s\n", jsonFile.c_str());
+		return 1;
+	}
+	return allRoundTripped ? 0 : 1;
+}
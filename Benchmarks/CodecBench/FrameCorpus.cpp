@@ -0,0 +1,399 @@
+#include "FrameCorpus.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+namespace
+{
+	using namespace FrameCorpus;
+
+	const char kMagic[4] = { 'H', 'L', '2', 'R' };
+	constexpr uint32_t kVersion = 1;
+	constexpr size_t kFileHeaderSize = 12;
+	constexpr size_t kFrameHeaderSize = 28;
+
+	constexpr uint32_t kStreamPV = 0;
+	constexpr uint32_t kStreamDepth = 1;
+	constexpr uint32_t kStreamAhat = 7;
+	// corpora recorded before AHAT had its own stream carry it as stream 1
+	constexpr int kAhatWidth = 512;
+
+	constexpr uint16_t kAhatInvalid = 4090;
+	constexpr uint8_t kLongThrowInvalid = 0x80;
+
+	uint32_t LoadUInt32(const uint8_t* in)
+	{
+		return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+	}
+
+	uint16_t LoadUInt16(const uint8_t* in, bool bigEndian)
+	{
+		return bigEndian ? (uint16_t)((in[0] << 8) | in[1]) : (uint16_t)(in[0] | (in[1] << 8));
+	}
+
+	uint8_t ToByte(double value)
+	{
+		return (uint8_t)std::fmin(255.0, std::fmax(0.0, std::round(value)));
+	}
+
+	// payload of a recorded frame back into a sensor frame, false if the
+	// sizes do not add up
+	bool ToFrame(
+		FrameType type,
+		uint32_t width,
+		uint32_t height,
+		uint32_t rowStride,
+		const uint8_t* payload,
+		size_t size,
+		Frame& frame)
+	{
+		const size_t count = (size_t)width * height;
+		switch (type)
+		{
+		case FrameType::PV:
+			if (rowStride < width * 3 || size < (size_t)rowStride * height)
+			{
+				return false;
+			}
+			frame.image.resize(count * 4);
+			for (uint32_t y = 0; y < height; y++)
+			{
+				const uint8_t* pRow = payload + (size_t)y * rowStride;
+				uint8_t* pOut = &frame.image[(size_t)y * width * 4];
+				for (uint32_t x = 0; x < width; x++)
+				{
+					memcpy(pOut + 4 * x, pRow + 3 * x, 3);
+					pOut[4 * x + 3] = 255;
+				}
+			}
+			return true;
+
+		case FrameType::VLC:
+			if (rowStride < width || size < (size_t)rowStride * height)
+			{
+				return false;
+			}
+			frame.image.resize(count);
+			for (uint32_t y = 0; y < height; y++)
+			{
+				memcpy(&frame.image[(size_t)y * width], payload + (size_t)y * rowStride, width);
+			}
+			return true;
+
+		default:
+		{
+			// depth image, AB image directly after it
+			if (rowStride < width * 2 || size < 2 * (size_t)rowStride * height)
+			{
+				return false;
+			}
+			const bool bigEndian = type == FrameType::Ahat;
+			const size_t imageSize = (size_t)rowStride * height;
+			frame.depth.resize(count);
+			frame.ab.resize(count);
+			for (uint32_t y = 0; y < height; y++)
+			{
+				for (uint32_t x = 0; x < width; x++)
+				{
+					const size_t offset = (size_t)y * rowStride + 2 * x;
+					frame.depth[(size_t)y * width + x] = LoadUInt16(payload + offset, bigEndian);
+					frame.ab[(size_t)y * width + x] = LoadUInt16(payload + imageSize + offset, bigEndian);
+				}
+			}
+			if (type == FrameType::LongThrow)
+			{
+				frame.sigma.assign(count, 0);
+			}
+			return true;
+		}
+		}
+	}
+
+	// Sensor noise that drifts instead of being drawn anew every frame: each
+	// frame keeps kMemory of the previous noise, so a static scene only
+	// changes in some of its pixels from one frame to the next, like a
+	// camera that is held still. sigma is the spread of the noise itself.
+	class DriftingNoise
+	{
+	public:
+		static constexpr double kMemory = 0.95;
+
+		DriftingNoise(
+			size_t count,
+			double sigma,
+			uint32_t seed) :
+			m_rng(seed),
+			m_gauss(0.0, sigma),
+			m_values(count)
+		{
+			for (float& value : m_values)
+			{
+				value = (float)m_gauss(m_rng);
+			}
+		}
+
+		void Advance()
+		{
+			const double innovation = std::sqrt(1.0 - kMemory * kMemory);
+			for (float& value : m_values)
+			{
+				value = (float)(kMemory * value + innovation * m_gauss(m_rng));
+			}
+		}
+
+		double operator[](size_t i) const
+		{
+			return m_values[i];
+		}
+
+	private:
+		std::mt19937 m_rng;
+		std::normal_distribution<double> m_gauss;
+		std::vector<float> m_values;
+	};
+
+	// a textured room seen from a still camera, with a box moving through it
+	Sequence MakePV(size_t frameCount)
+	{
+		Sequence sequence{ FrameType::PV, "synthetic", 1920, 1080, {} };
+		DriftingNoise noise((size_t)sequence.width * sequence.height * 3, 1.2, 5);
+		for (size_t f = 0; f < frameCount; f++)
+		{
+			Frame frame;
+			frame.image.resize((size_t)sequence.width * sequence.height * 4);
+			const int boxX = 300 + 6 * (int)f;
+			for (int y = 0; y < sequence.height; y++)
+			{
+				for (int x = 0; x < sequence.width; x++)
+				{
+					const bool box = x >= boxX && x < boxX + 240 && y >= 500 && y < 740;
+					const double shade = box ? 200.0 - 0.2 * (y - 500) :
+						90.0 + 50.0 * std::sin(x * 0.004) * std::cos(y * 0.006) +
+						(((x / 120) + (y / 90)) % 3 == 0 ? 40.0 : 0.0);
+					const size_t i = (size_t)y * sequence.width + x;
+					uint8_t* pixel = &frame.image[i * 4];
+					for (int c = 0; c < 3; c++)
+					{
+						pixel[c] = ToByte(shade * (0.8 + 0.15 * c) + noise[i * 3 + c]);
+					}
+					pixel[3] = 255;
+				}
+			}
+			sequence.frames.push_back(std::move(frame));
+			noise.Advance();
+		}
+		return sequence;
+	}
+
+	Sequence MakeVLC(size_t frameCount)
+	{
+		Sequence sequence{ FrameType::VLC, "synthetic", 640, 480, {} };
+		DriftingNoise noise((size_t)sequence.width * sequence.height, 2.0, 7);
+		for (size_t f = 0; f < frameCount; f++)
+		{
+			Frame frame;
+			frame.image.resize((size_t)sequence.width * sequence.height);
+			const int boxX = 100 + 3 * (int)f;
+			for (int y = 0; y < sequence.height; y++)
+			{
+				for (int x = 0; x < sequence.width; x++)
+				{
+					const bool box = x >= boxX && x < boxX + 80 && y >= 200 && y < 280;
+					const double value = box ? 170.0 : 60.0 + 0.1 * y +
+						40.0 * std::sin(x * 0.05) * std::cos(y * 0.03) +
+						(((x / 40) + (y / 40)) % 2 ? 30.0 : 0.0);
+					const size_t i = (size_t)y * sequence.width + x;
+					frame.image[i] = ToByte(value + noise[i]);
+				}
+			}
+			sequence.frames.push_back(std::move(frame));
+			noise.Advance();
+		}
+		return sequence;
+	}
+
+	// a room with a moving object; the corners are outside the lens and
+	// invalid
+	Sequence MakeDepth(FrameType type, int width, int height, size_t frameCount)
+	{
+		Sequence sequence{ type, "synthetic", width, height, {} };
+		std::mt19937 rng(type == FrameType::Ahat ? 3 : 13);
+		std::normal_distribution<double> gauss(0.0, 1.5);
+		const double range = type == FrameType::Ahat ? 1.0 : 4.0;
+		for (size_t f = 0; f < frameCount; f++)
+		{
+			Frame frame;
+			const size_t count = (size_t)width * height;
+			frame.depth.resize(count);
+			frame.ab.resize(count);
+			if (type == FrameType::LongThrow)
+			{
+				frame.sigma.resize(count);
+			}
+
+			const double cx = 0.2 * std::sin(f * 0.14);
+			for (int y = 0; y < height; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					const double u = (double)x / width - 0.5;
+					const double v = (double)y / height - 0.5;
+					const size_t i = (size_t)y * width + x;
+					const bool valid = (u * u + v * v) <= 0.22;
+					const bool object = (u - cx) * (u - cx) + v * v < 0.01;
+					const double d = range * (object ? 400.0 : (v > 0.15 ? 90.0 / v : 800.0 - 300.0 * u));
+					const double n = gauss(rng);
+					const uint16_t depth = (uint16_t)std::fmax(1.0, d + range * n);
+					frame.ab[i] = (uint16_t)std::fmax(0.0, 300.0 * (1.0 - std::sqrt(u * u + v * v)) + 2.0 * n);
+					if (type == FrameType::Ahat)
+					{
+						frame.depth[i] = valid ? depth : kAhatInvalid;
+					}
+					else
+					{
+						frame.depth[i] = depth;
+						frame.sigma[i] = valid ? 0 : kLongThrowInvalid;
+					}
+				}
+			}
+			sequence.frames.push_back(std::move(frame));
+		}
+		return sequence;
+	}
+}
+
+namespace FrameCorpus
+{
+	const char* FrameTypeName(FrameType type)
+	{
+		switch (type)
+		{
+		case FrameType::PV: return "pv";
+		case FrameType::VLC: return "vlc";
+		case FrameType::Ahat: return "ahat";
+		case FrameType::LongThrow: return "longthrow";
+		}
+		return "?";
+	}
+
+	bool LoadFile(
+		const std::string& path,
+		size_t maxFrames,
+		std::vector<Sequence>& sequences,
+		std::string& error)
+	{
+		std::ifstream file(path, std::ios::binary);
+		const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (!file.is_open() || data.size() < kFileHeaderSize || memcmp(data.data(), kMagic, sizeof(kMagic)) != 0)
+		{
+			error = path + ": not a corpus file";
+			return false;
+		}
+		if (LoadUInt32(&data[4]) != kVersion)
+		{
+			error = path + ": unknown corpus version";
+			return false;
+		}
+
+		const uint32_t streamId = LoadUInt32(&data[8]);
+		const std::string source = std::filesystem::path(path).filename().string();
+		const size_t firstSequence = sequences.size();
+		size_t offset = kFileHeaderSize;
+		while (offset + kFrameHeaderSize <= data.size())
+		{
+			const uint8_t* pHeader = &data[offset];
+			const uint32_t width = LoadUInt32(pHeader + 8);
+			const uint32_t height = LoadUInt32(pHeader + 12);
+			const uint32_t rowStride = LoadUInt32(pHeader + 20);
+			const uint32_t size = LoadUInt32(pHeader + 24);
+			offset += kFrameHeaderSize;
+			if (size > data.size() - offset)
+			{
+				// cut off while recording
+				break;
+			}
+
+			FrameType type = FrameType::VLC;
+			if (streamId == kStreamPV)
+			{
+				type = FrameType::PV;
+			}
+			else if (streamId == kStreamAhat)
+			{
+				type = FrameType::Ahat;
+			}
+			else if (streamId == kStreamDepth)
+			{
+				type = width == kAhatWidth ? FrameType::Ahat : FrameType::LongThrow;
+			}
+
+			auto sequence = std::find_if(sequences.begin() + firstSequence, sequences.end(),
+				[&](const Sequence& s) { return s.type == type && s.width == (int)width && s.height == (int)height; });
+			if (sequence == sequences.end())
+			{
+				sequences.push_back({ type, source, (int)width, (int)height, {} });
+				sequence = sequences.end() - 1;
+			}
+
+			Frame frame;
+			if (width == 0 || height == 0 || !ToFrame(type, width, height, rowStride, &data[offset], size, frame))
+			{
+				error = path + ": frame size does not match its header";
+				return false;
+			}
+			if (maxFrames == 0 || sequence->frames.size() < maxFrames)
+			{
+				sequence->frames.push_back(std::move(frame));
+			}
+			offset += size;
+		}
+		return true;
+	}
+
+	bool LoadDirectory(
+		const std::string& directory,
+		size_t maxFrames,
+		std::vector<Sequence>& sequences,
+		std::string& error)
+	{
+		std::error_code ec;
+		std::vector<std::string> paths;
+		for (const auto& entry : std::filesystem::directory_iterator(directory, ec))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == ".hl2rec")
+			{
+				paths.push_back(entry.path().string());
+			}
+		}
+		if (ec)
+		{
+			error = directory + ": " + ec.message();
+			return false;
+		}
+		std::sort(paths.begin(), paths.end());
+
+		for (const std::string& path : paths)
+		{
+			if (!LoadFile(path, maxFrames, sequences, error))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::vector<Sequence> MakeSynthetic(size_t frameCount)
+	{
+		std::vector<Sequence> sequences;
+		sequences.push_back(MakePV(frameCount));
+		sequences.push_back(MakeVLC(frameCount));
+		sequences.push_back(MakeDepth(FrameType::Ahat, 512, 512, frameCount));
+		sequences.push_back(MakeDepth(FrameType::LongThrow, 320, 288, frameCount));
+		return sequences;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Sensor frames for CodecBench, in the form the streamers get them from the
+// device, either read from corpus files or generated.
+//
+// Corpus files (*.hl2rec) are written by
+// PythonReceiver/DataCollection/frame_recorder.py and hold the raw payloads of
+// one stream:
+//
+//   "HL2R"   magic
+//   uint32   version (1)
+//   uint32   stream id (0 PV, 1 Long Throw, 2 left front, 3 right front,
+//            5 left left, 6 right right, 7 AHAT, 8 front stereo)
+//   frames:
+//     int64  timestamp
+//     uint32 width, height, pixel stride, row stride
+//     uint32 payload size
+//     payload
+//
+// Everything is little-endian. The payloads are turned back into sensor
+// buffers: PV frames get an opaque alpha channel, Long Throw frames a zero
+// sigma image (the invalid pixels are already zero). Stream 1 frames 512
+// pixels wide are AHAT, recorded before it had a stream of its own. The
+// other streams are VLC; a stereo pair is one image of twice the height.
+namespace FrameCorpus
+{
+	enum class FrameType
+	{
+		PV,
+		VLC,
+		Ahat,
+		LongThrow,
+	};
+
+	const char* FrameTypeName(FrameType type);
+
+	struct Frame
+	{
+		// PV: BGRA, width * 4 bytes per row. VLC: 8-bit gray.
+		std::vector<uint8_t> image;
+		// AHAT and Long Throw
+		std::vector<uint16_t> depth;
+		std::vector<uint16_t> ab;
+		// Long Throw only
+		std::vector<uint8_t> sigma;
+	};
+
+	// frames of one type and size, in recording order
+	struct Sequence
+	{
+		FrameType type;
+		std::string source;
+		int width = 0;
+		int height = 0;
+		std::vector<Frame> frames;
+	};
+
+	// Reads one corpus file; a file whose frames change size yields one
+	// sequence per size. At most maxFrames frames per sequence (0 = all).
+	// Returns false and sets error if the file is not a corpus file.
+	bool LoadFile(
+		const std::string& path,
+		size_t maxFrames,
+		std::vector<Sequence>& sequences,
+		std::string& error);
+
+	// All *.hl2rec files of a directory, in name order.
+	bool LoadDirectory(
+		const std::string& directory,
+		size_t maxFrames,
+		std::vector<Sequence>& sequences,
+		std::string& error);
+
+	// A sequence of every frame type at the device's resolutions: textured
+	// scenes seen from a still camera with one object moving through them,
+	// and sensor noise that drifts from frame to frame. They show how the
+	// codecs compare, not the ratios to expect on the device: real noise
+	// and head motion decide those, measure them on recorded corpora.
+	std::vector<Sequence> MakeSynthetic(size_t frameCount);
+}
@@ -0,0 +1,233 @@
+// Simulates an AHAT stream whose encoding is chosen by CodecController, for
+// several link rates and CPU budgets.
+//
+// Frames arrive at 45 fps on a simulated clock and are encoded for real (raw
+// packing, LZ4, 12-bit packing, RVL, temporal delta). The measured encode
+// times are multiplied by a slowdown factor that stands in for the slower
+// cores of the device. Frames are packed one after the other and sent at a
+// fixed link rate; a frame that finds the previous one still on the wire
+// reports congestion, and a frame that would wait longer than two frame
+// intervals, for the packer or the link, is dropped.
+//
+//   CodecControllerBench [seconds] [cpu slowdown]
+
+#include "CodecController.h"
+#include "DepthCodec.h"
+#include "FramePacking.h"
+#include "PayloadEncoding.h"
+#include "TemporalCodec.h"
+#include "lz4.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace
+{
+	using Clock = CodecController::Clock;
+
+	constexpr int kSize = 512;
+	constexpr size_t kPixels = (size_t)kSize * kSize;
+	constexpr size_t kRawSize = 4 * kPixels;
+	constexpr uint16_t kAhatInvalid = 4090;
+	constexpr double kFps = 45.0;
+	constexpr int kDistinctFrames = 45;
+
+	struct DepthFrame
+	{
+		std::vector<uint16_t> depth;
+		std::vector<uint16_t> ab;
+	};
+
+	// a room with a slowly moving object and sensor noise
+	std::vector<DepthFrame> MakeFrames()
+	{
+		std::mt19937 rng(3);
+		std::normal_distribution<double> gauss(0.0, 1.5);
+		std::vector<DepthFrame> frames(kDistinctFrames);
+		for (int f = 0; f < kDistinctFrames; f++)
+		{
+			DepthFrame& frame = frames[f];
+			frame.depth.resize(kPixels);
+			frame.ab.resize(kPixels);
+			const double cx = 0.2 * std::sin(f * 0.14);
+			for (int y = 0; y < kSize; y++)
+			{
+				for (int x = 0; x < kSize; x++)
+				{
+					const double u = (double)x / kSize - 0.5;
+					const double v = (double)y / kSize - 0.5;
+					const size_t i = (size_t)y * kSize + x;
+					const bool valid = (u * u + v * v) <= 0.22;
+					const bool object = (u - cx) * (u - cx) + v * v < 0.01;
+					const double d = object ? 400.0 : (v > 0.15 ? 90.0 / v : 800.0 - 300.0 * u);
+					const double n = gauss(rng);
+					frame.depth[i] = valid ? (uint16_t)std::fmax(1.0, d + n) : kAhatInvalid;
+					frame.ab[i] = (uint16_t)std::fmax(0.0, 300.0 * (1.0 - std::sqrt(u * u + v * v)) + 2.0 * n);
+				}
+			}
+		}
+		return frames;
+	}
+
+	// encodes like ResearchModeFrameStreamer::PackAHAT, returns the payload size
+	size_t Encode(
+		PayloadEncoding encoding,
+		const DepthFrame& frame,
+		TemporalCodec::Encoder& temporal,
+		std::vector<uint8_t>& raw,
+		std::vector<uint8_t>& out)
+	{
+		switch (encoding)
+		{
+		case PayloadEncoding::Rvl:
+		{
+			const size_t size = DepthCodec::EncodeDepthAb(frame.depth.data(), frame.ab.data(), kPixels,
+				kAhatInvalid, kAhatInvalid, true, out.data(), kRawSize);
+			if (size)
+			{
+				return size;
+			}
+			break;
+		}
+		case PayloadEncoding::Packed12:
+			if (FramePacking::PackAhatDepthAb12(frame.depth.data(), frame.ab.data(), kPixels, kAhatInvalid,
+				out.data() + kPacked12HeaderSize))
+			{
+				return kPacked12HeaderSize + 2 * FramePacking::Packed12Size(kPixels);
+			}
+			break;
+		case PayloadEncoding::Lz4:
+		{
+			FramePacking::PackAhatDepthAb(frame.depth.data(), frame.ab.data(), kPixels, kAhatInvalid, raw.data());
+			const int size = LZ4_compress_default((const char*)raw.data(), (char*)out.data(), (int)kRawSize, (int)kRawSize - 1);
+			if (size > 0)
+			{
+				return (size_t)size;
+			}
+			memcpy(out.data(), raw.data(), kRawSize);
+			return kRawSize;
+		}
+		case PayloadEncoding::DeltaLz4:
+			FramePacking::PackAhatDepthAb(frame.depth.data(), frame.ab.data(), kPixels, kAhatInvalid, raw.data());
+			return temporal.Encode(raw.data(), kRawSize, out.data(), out.size());
+		default:
+			break;
+		}
+		FramePacking::PackAhatDepthAb(frame.depth.data(), frame.ab.data(), kPixels, kAhatInvalid, out.data());
+		return kRawSize;
+	}
+
+	const char* Name(PayloadEncoding encoding)
+	{
+		switch (encoding)
+		{
+		case PayloadEncoding::Raw: return "raw";
+		case PayloadEncoding::Rvl: return "rvl";
+		case PayloadEncoding::Packed12: return "12bit";
+		case PayloadEncoding::DeltaLz4: return "delta";
+		case PayloadEncoding::Lz4: return "lz4";
+		default: return "?";
+		}
+	}
+
+	void Run(
+		const std::vector<DepthFrame>& frames,
+		double seconds,
+		double slowdown,
+		double linkMBps,
+		double cpuBudget)
+	{
+		CodecController controller({ PayloadEncoding::Lz4, PayloadEncoding::Packed12, PayloadEncoding::Rvl,
+			PayloadEncoding::DeltaLz4 }, cpuBudget);
+		TemporalCodec::Encoder temporal;
+		std::vector<uint8_t> raw(kRawSize);
+		std::vector<uint8_t> out(TemporalCodec::MaxEncodedSize(kRawSize));
+
+		const Clock::time_point start{};
+		const double interval = 1.0 / kFps;
+		const int frameCount = (int)(seconds * kFps);
+		double packBusyUntil = 0.0;
+		double linkBusyUntil = 0.0;
+		double cpuSeconds = 0.0;
+		double sentBytes = 0.0;
+		int sent = 0;
+		int dropped = 0;
+		std::map<PayloadEncoding, int> mix;
+
+		for (int f = 0; f < frameCount; f++)
+		{
+			auto at = [&](double t) { return start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(t)); };
+
+			// frames are packed one after the other; the pipeline drops a
+			// frame that would wait for more than two earlier ones
+			const double arrival = f * interval;
+			if (packBusyUntil - arrival > 2 * interval)
+			{
+				controller.ReportCongestion(at(arrival));
+				temporal.RequestKeyframe();
+				dropped++;
+				continue;
+			}
+			const double packStart = std::fmax(arrival, packBusyUntil);
+
+			const PayloadEncoding encoding = controller.Choose(at(packStart));
+			const auto encodeStart = std::chrono::steady_clock::now();
+			const size_t size = Encode(encoding, frames[f % frames.size()], temporal, raw, out);
+			const double encodeSeconds = slowdown *
+				std::chrono::duration<double>(std::chrono::steady_clock::now() - encodeStart).count();
+			const double ready = packStart + encodeSeconds;
+			packBusyUntil = ready;
+			controller.Report(encoding, kRawSize, size,
+				std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(encodeSeconds)), at(ready));
+			cpuSeconds += encodeSeconds;
+
+			if (linkBusyUntil > ready)
+			{
+				controller.ReportCongestion(at(ready));
+				if (linkBusyUntil - ready > 2 * interval)
+				{
+					// a delta frame that is never sent breaks the chain
+					temporal.RequestKeyframe();
+					dropped++;
+					continue;
+				}
+			}
+			linkBusyUntil = std::fmax(linkBusyUntil, ready) + size / (linkMBps * 1e6);
+			sentBytes += size;
+			sent++;
+			mix[encoding]++;
+		}
+
+		printf("  %8.0f %6.2f %8.1f %8.1f %6.1f%%  ", linkMBps, cpuBudget, sent / seconds,
+			sentBytes / seconds / 1e6, 100.0 * cpuSeconds / seconds);
+		for (const auto& entry : mix)
+		{
+			printf(" %s %d%%", Name(entry.first), (int)std::lround(100.0 * entry.second / sent));
+		}
+		printf("%s\n", dropped ? (" (" + std::to_string(dropped) + " dropped)").c_str() : "");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const double seconds = argc > 1 ? atof(argv[1]) : 20.0;
+	const double slowdown = argc > 2 ? atof(argv[2]) : 8.0;
+	const std::vector<DepthFrame> frames = MakeFrames();
+
+	printf("AHAT 512x512 at %.0f fps, raw %.1f MB/s, encode times x%.1f\n", kFps, kRawSize * kFps / 1e6, slowdown);
+	printf("  %8s %6s %8s %8s %7s   %s\n", "link MB/s", "budget", "sent fps", "MB/s", "cpu", "encodings");
+	for (double linkMBps : { 100.0, 30.0, 12.0 })
+	{
+		for (double cpuBudget : { 0.05, 0.25, 1.0 })
+		{
+			Run(frames, seconds, slowdown, linkMBps, cpuBudget);
+		}
+	}
+	return 0;
+}
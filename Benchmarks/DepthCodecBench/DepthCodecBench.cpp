@@ -0,0 +1,358 @@
+// Compression ratio and speed of the depth + AB payload codecs.
+//
+// Compares the RVL depth codec (DepthCodec) and the 12-bit packing mode against
+// LZ4 on the raw payload and the old QOI trick of reinterpreting depth + AB as
+// a 4 channel image. Every encoded frame is decoded again and checked against
+// the raw payload.
+//
+// Without arguments a synthetic corpus is used. Recorded frames can be added
+// as raw payload dumps (the image_data the Python receiver gets for a raw
+// frame, depth then AB, 4 * width * height bytes):
+//
+//   DepthCodecBench [width height bigEndian file...]
+//
+// e.g. "DepthCodecBench 512 512 1 ahat_*.bin" for AHAT recordings.
+
+#include "DepthCodec.h"
+#include "FramePacking.h"
+#include "PayloadEncoding.h"
+#include "lz4.h"
+
+#define QOI_IMPLEMENTATION
+#include "qoi.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr uint16_t kAhatInvalid = 4090;
+	constexpr int kRepetitions = 20;
+
+	struct Frame
+	{
+		int width = 0;
+		int height = 0;
+		bool bigEndian = false;
+		// values as they come from the sensor, after invalidation
+		std::vector<uint16_t> depth;
+		std::vector<uint16_t> ab;
+		// what the raw stream puts on the wire
+		std::vector<uint8_t> payload;
+	};
+
+	struct Corpus
+	{
+		std::string name;
+		std::vector<Frame> frames;
+	};
+
+	struct Codec
+	{
+		const char* name;
+		// returns the encoded size, 0 on failure
+		std::function<size_t(const Frame&, std::vector<uint8_t>&)> encode;
+		std::function<bool(const Frame&, const std::vector<uint8_t>&, size_t, std::vector<uint8_t>&)> decode;
+	};
+
+	void PackPayload(Frame& frame)
+	{
+		const size_t count = frame.depth.size();
+		frame.payload.resize(4 * count);
+		if (frame.bigEndian)
+		{
+			FramePacking::PackAhatDepthAb(frame.depth.data(), frame.ab.data(), count, kAhatInvalid, frame.payload.data());
+		}
+		else
+		{
+			std::vector<uint8_t> sigma(count, 0);
+			FramePacking::PackLongThrowDepthAb(frame.depth.data(), sigma.data(), frame.ab.data(), count, 0x80, frame.payload.data());
+		}
+	}
+
+	// A room seen by the depth camera: floor, walls and a box, with sensor
+	// noise, the invalid ring outside the AHAT field of view and dropouts at
+	// depth edges. noise is the standard deviation in mm.
+	Frame MakeSyntheticFrame(int width, int height, bool ahat, double noise, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::normal_distribution<double> gauss(0.0, noise);
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+		Frame frame;
+		frame.width = width;
+		frame.height = height;
+		frame.bigEndian = ahat;
+		frame.depth.resize((size_t)width * height);
+		frame.ab.resize((size_t)width * height);
+
+		const double maxDepth = ahat ? 1000.0 : 4000.0;
+		const double shift = (seed % 16) * 0.01;
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const double u = (double)x / width - 0.5;
+				const double v = (double)y / height - 0.5;
+
+				double depth = maxDepth * (0.8 - 0.3 * u + shift);
+				if (v > 0.15)
+				{
+					// floor
+					depth = maxDepth * (0.15 / v) * 0.3;
+				}
+				if (std::fabs(u - 0.1) < 0.12 && std::fabs(v - 0.05) < 0.1)
+				{
+					// box
+					depth = maxDepth * 0.35;
+				}
+
+				bool valid = depth < maxDepth;
+				if (ahat && (u * u + v * v) > 0.22)
+				{
+					valid = false;
+				}
+				if (uniform(rng) < 0.01)
+				{
+					valid = false;
+				}
+
+				const size_t i = (size_t)y * width + x;
+				const double intensity = 300.0 * (1.0 - std::sqrt(u * u + v * v)) * (maxDepth / (depth + 100.0));
+				frame.depth[i] = valid ? (uint16_t)std::fmax(1.0, depth + gauss(rng)) : 0;
+				frame.ab[i] = (uint16_t)std::fmin(4000.0, std::fmax(0.0, intensity + gauss(rng) * 2.0));
+			}
+		}
+		PackPayload(frame);
+		return frame;
+	}
+
+	bool LoadRecordedFrame(const char* path, int width, int height, bool bigEndian, Frame& frame)
+	{
+		FILE* file = fopen(path, "rb");
+		if (!file)
+		{
+			return false;
+		}
+		const size_t count = (size_t)width * height;
+		frame.payload.resize(4 * count);
+		const size_t read = fread(frame.payload.data(), 1, frame.payload.size(), file);
+		fclose(file);
+		if (read != frame.payload.size())
+		{
+			return false;
+		}
+
+		frame.width = width;
+		frame.height = height;
+		frame.bigEndian = bigEndian;
+		frame.depth.resize(count);
+		frame.ab.resize(count);
+		const int hi = bigEndian ? 0 : 1;
+		for (size_t i = 0; i < 2 * count; i++)
+		{
+			const uint16_t value = (uint16_t)((frame.payload[2 * i + hi] << 8) | frame.payload[2 * i + 1 - hi]);
+			(i < count ? frame.depth[i] : frame.ab[i - count]) = value;
+		}
+		return true;
+	}
+
+	std::vector<Codec> MakeCodecs()
+	{
+		std::vector<Codec> codecs;
+
+		codecs.push_back({ "RVL",
+			[](const Frame& frame, std::vector<uint8_t>& out)
+			{
+				out.resize(DepthCodec::kDepthAbHeaderSize + 2 * DepthCodec::RvlMaxEncodedSize(frame.depth.size()));
+				// the values are already invalidated
+				return DepthCodec::EncodeDepthAb(frame.depth.data(), frame.ab.data(), frame.depth.size(),
+					DepthCodec::kKeepAllValues, DepthCodec::kKeepAllValues, frame.bigEndian, out.data(), out.size());
+			},
+			[](const Frame& frame, const std::vector<uint8_t>& in, size_t size, std::vector<uint8_t>& out)
+			{
+				return DepthCodec::DecodeDepthAb(in.data(), size, frame.depth.size(), out.data());
+			} });
+
+		codecs.push_back({ "12-bit",
+			[](const Frame& frame, std::vector<uint8_t>& out)
+			{
+				const size_t count = frame.depth.size();
+				out.resize(kPacked12HeaderSize + 2 * FramePacking::Packed12Size(count));
+				const uint32_t flags = frame.bigEndian ? kPacked12BigEndianPlanes : 0;
+				memcpy(out.data(), &flags, sizeof(flags));
+				if (frame.bigEndian)
+				{
+					return FramePacking::PackAhatDepthAb12(frame.depth.data(), frame.ab.data(), count, kAhatInvalid,
+						out.data() + kPacked12HeaderSize) ? out.size() : (size_t)0;
+				}
+
+				// no sigma mask, the values are already invalidated
+				static const std::vector<uint8_t> sigma(512 * 512, 0);
+				return FramePacking::PackLongThrowDepthAb12(frame.depth.data(), sigma.data(), frame.ab.data(), count, 0x80,
+					out.data() + kPacked12HeaderSize) ? out.size() : (size_t)0;
+			},
+			[](const Frame& frame, const std::vector<uint8_t>& in, size_t size, std::vector<uint8_t>& out)
+			{
+				const size_t count = frame.depth.size();
+				const uint8_t* pImages = in.data() + kPacked12HeaderSize;
+				FramePacking::Unpack12(pImages, count, frame.bigEndian, out.data());
+				FramePacking::Unpack12(pImages + FramePacking::Packed12Size(count), count, frame.bigEndian, out.data() + 2 * count);
+				return size == in.size();
+			} });
+
+		codecs.push_back({ "LZ4",
+			[](const Frame& frame, std::vector<uint8_t>& out)
+			{
+				out.resize(LZ4_compressBound((int)frame.payload.size()));
+				const int size = LZ4_compress_default((const char*)frame.payload.data(), (char*)out.data(),
+					(int)frame.payload.size(), (int)out.size());
+				return (size_t)(size > 0 ? size : 0);
+			},
+			[](const Frame& frame, const std::vector<uint8_t>& in, size_t size, std::vector<uint8_t>& out)
+			{
+				return LZ4_decompress_safe((const char*)in.data(), (char*)out.data(), (int)size, (int)out.size()) ==
+					(int)frame.payload.size();
+			} });
+
+		codecs.push_back({ "QOI trick",
+			[](const Frame& frame, std::vector<uint8_t>& out)
+			{
+				// depth + AB bytes as a width x height RGBA image
+				qoi_desc desc = { (unsigned int)frame.width, (unsigned int)frame.height, 4, 0 };
+				int size = 0;
+				void* encoded = qoi_encode(frame.payload.data(), &desc, &size);
+				if (!encoded)
+				{
+					return (size_t)0;
+				}
+				out.assign((uint8_t*)encoded, (uint8_t*)encoded + size);
+				free(encoded);
+				return (size_t)size;
+			},
+			[](const Frame&, const std::vector<uint8_t>& in, size_t size, std::vector<uint8_t>& out)
+			{
+				qoi_desc desc;
+				void* decoded = qoi_decode(in.data(), (int)size, &desc, 4);
+				if (!decoded)
+				{
+					return false;
+				}
+				memcpy(out.data(), decoded, out.size());
+				free(decoded);
+				return true;
+			} });
+
+		return codecs;
+	}
+
+	void Run(const Corpus& corpus, const std::vector<Codec>& codecs)
+	{
+		printf("\n%s (%zu frames)\n", corpus.name.c_str(), corpus.frames.size());
+		printf("  %-10s %8s %12s %12s\n", "codec", "ratio", "enc MB/s", "dec MB/s");
+
+		for (const Codec& codec : codecs)
+		{
+			size_t rawBytes = 0;
+			size_t encodedBytes = 0;
+			double encodeSeconds = 0;
+			double decodeSeconds = 0;
+			bool ok = true;
+
+			std::vector<uint8_t> encoded;
+			for (const Frame& frame : corpus.frames)
+			{
+				std::vector<uint8_t> decoded(frame.payload.size());
+				size_t size = 0;
+
+				auto start = Clock::now();
+				for (int r = 0; r < kRepetitions; r++)
+				{
+					size = codec.encode(frame, encoded);
+				}
+				encodeSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+				start = Clock::now();
+				for (int r = 0; r < kRepetitions && size; r++)
+				{
+					ok = codec.decode(frame, encoded, size, decoded) && ok;
+				}
+				decodeSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+				ok = ok && size != 0 && decoded == frame.payload;
+				rawBytes += frame.payload.size();
+				encodedBytes += size;
+			}
+
+			const double mb = (double)rawBytes * kRepetitions / 1e6;
+			printf("  %-10s %8.2f %12.1f %12.1f%s\n",
+				codec.name,
+				encodedBytes ? (double)rawBytes / encodedBytes : 0.0,
+				mb / encodeSeconds,
+				mb / decodeSeconds,
+				ok ? "" : "  ROUND TRIP FAILED");
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<Corpus> corpora;
+
+	Corpus ahat{ "synthetic AHAT 512x512", {} };
+	Corpus ahatNoisy{ "synthetic AHAT 512x512, noisy", {} };
+	Corpus longThrow{ "synthetic Long Throw 320x288", {} };
+	for (uint32_t seed = 1; seed <= 8; seed++)
+	{
+		ahat.frames.push_back(MakeSyntheticFrame(512, 512, true, 1.5, seed));
+		ahatNoisy.frames.push_back(MakeSyntheticFrame(512, 512, true, 8.0, seed));
+		longThrow.frames.push_back(MakeSyntheticFrame(320, 288, false, 4.0, seed));
+	}
+	corpora.push_back(ahat);
+	corpora.push_back(ahatNoisy);
+	corpora.push_back(longThrow);
+
+	if (argc > 4)
+	{
+		const int width = atoi(argv[1]);
+		const int height = atoi(argv[2]);
+		const bool bigEndian = atoi(argv[3]) != 0;
+
+		Corpus recorded{ "recorded " + std::to_string(width) + "x" + std::to_string(height), {} };
+		for (int i = 4; i < argc; i++)
+		{
+			Frame frame;
+			if (LoadRecordedFrame(argv[i], width, height, bigEndian, frame))
+			{
+				recorded.frames.push_back(std::move(frame));
+			}
+			else
+			{
+				fprintf(stderr, "skipping %s: not a %dx%d depth + AB payload\n", argv[i], width, height);
+			}
+		}
+		if (!recorded.frames.empty())
+		{
+			corpora.push_back(std::move(recorded));
+		}
+	}
+
+	printf("%s packing kernels, %d repetitions per frame\n",
+		FramePacking::ActiveKernelPath() == FramePacking::KernelPath::Scalar ? "scalar" : "SIMD", kRepetitions);
+
+	const std::vector<Codec> codecs = MakeCodecs();
+	for (const Corpus& corpus : corpora)
+	{
+		Run(corpus, codecs);
+	}
+	return 0;
+}
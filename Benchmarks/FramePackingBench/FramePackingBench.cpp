@@ -0,0 +1,370 @@
+// Checks the depth packing kernels against the loops SendAHAT and
+// SendLongThrow ran before they moved into FramePacking, and times them.
+//
+// Every kernel path this build and CPU support (scalar everywhere, SSE2 on
+// x86, NEON on ARM) packs the same random frames at the AHAT (512x512) and
+// Long Throw (320x288) sizes, and at short counts that end in every tail
+// length of the vector loops. The raw layout has to match the original loops
+// byte for byte; the 12-bit layout has to match the scalar path and unpack
+// to the raw layout. Inputs start one element off an aligned address, like a
+// sensor buffer may. Exits with 1 on any mismatch.
+//
+//   FramePackingBench [iterations]
+
+#include "FramePacking.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+	using namespace FramePacking;
+	using Clock = std::chrono::steady_clock;
+
+	// ResearchModeFrameStreamer's values
+	constexpr uint16_t kAhatInvalidValue = 4090;
+	constexpr uint8_t kLongThrowInvalidMask = 0x80;
+
+	const KernelPath kPaths[] = { KernelPath::Scalar, KernelPath::Sse2, KernelPath::Neon };
+
+	// the AHAT loops from SendAHAT
+	void ReferenceAhat(
+		const uint16_t* pDepth,
+		const uint16_t* pAbImage,
+		size_t count,
+		uint8_t* depth_combined_buf)
+	{
+		const uint16_t maxValue = kAhatInvalidValue;
+		const size_t outBufferCountDepth = count;
+
+		for (size_t i = 0; i < outBufferCountDepth; ++i)
+		{
+			const bool invalid = (pDepth[i] >= maxValue);
+			uint16_t d;
+			if (invalid)
+			{
+				d = 0;
+			}
+			else
+			{
+				d = pDepth[i];
+			}
+			depth_combined_buf[i * 2] = (uint8_t)(d >> 8);
+			depth_combined_buf[i * 2 + 1] = (uint8_t)(d);
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const bool invalid = (pAbImage[i] >= maxValue);
+			uint16_t d;
+			if (invalid)
+			{
+				d = 0;
+			}
+			else
+			{
+				d = pAbImage[i];
+			}
+			depth_combined_buf[outBufferCountDepth * 2 + i * 2] = (uint8_t)(d >> 8);
+			depth_combined_buf[outBufferCountDepth * 2 + i * 2 + 1] = (uint8_t)(d);
+		}
+	}
+
+	// the Long Throw loops from SendLongThrow
+	void ReferenceLongThrow(
+		const uint16_t* pDepth,
+		const uint8_t* pSigma,
+		const uint16_t* pAbImage,
+		size_t count,
+		uint8_t* depth_combined_buf)
+	{
+		const size_t outBufferCountDepth = count;
+
+		for (size_t i = 0; i < outBufferCountDepth; ++i)
+		{
+			const bool invalid = (pSigma[i] & kLongThrowInvalidMask) > 0;
+			uint16_t d;
+			if (invalid)
+			{
+				d = 0;
+			}
+			else
+			{
+				d = pDepth[i];
+			}
+
+			depth_combined_buf[i * 2] = (uint8_t)(d);
+			depth_combined_buf[i * 2 + 1] = (uint8_t)(d >> 8);
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint16_t d;
+			d = pAbImage[i];
+			depth_combined_buf[outBufferCountDepth * 2 + i * 2] = (uint8_t)(d);
+			depth_combined_buf[outBufferCountDepth * 2 + i * 2 + 1] = (uint8_t)(d >> 8);
+		}
+	}
+
+	struct Frame
+	{
+		// one element of padding in front, see Depth() and friends
+		std::vector<uint16_t> depth;
+		std::vector<uint16_t> ab;
+		std::vector<uint8_t> sigma;
+		size_t count = 0;
+
+		const uint16_t* Depth() const { return depth.data() + 1; }
+		const uint16_t* Ab() const { return ab.data() + 1; }
+		const uint8_t* Sigma() const { return sigma.data() + 1; }
+	};
+
+	// Values around the invalidation thresholds and the 12-bit range, with
+	// saturated pixels. twelveBit keeps every value below 4096 so the 12-bit
+	// Long Throw layout applies.
+	Frame MakeFrame(
+		size_t count,
+		bool twelveBit,
+		std::mt19937& rng)
+	{
+		Frame frame;
+		frame.count = count;
+		frame.depth.resize(count + 1);
+		frame.ab.resize(count + 1);
+		frame.sigma.resize(count + 1);
+
+		std::uniform_int_distribution<int> kind(0, 9);
+		std::uniform_int_distribution<int> low(0, 4095);
+		std::uniform_int_distribution<int> edge(4080, 4100);
+		std::uniform_int_distribution<int> high(4096, 65535);
+		std::uniform_int_distribution<int> byte(0, 255);
+		auto value = [&]()
+		{
+			switch (kind(rng))
+			{
+			case 0:
+				return twelveBit ? 4095 : 65535;
+			case 1:
+			case 2:
+				return twelveBit ? (std::min)(edge(rng), 4095) : edge(rng);
+			case 3:
+				return twelveBit ? low(rng) : high(rng);
+			default:
+				return low(rng);
+			}
+		};
+		for (size_t i = 1; i <= count; i++)
+		{
+			frame.depth[i] = (uint16_t)value();
+			frame.ab[i] = (uint16_t)value();
+			frame.sigma[i] = (uint8_t)byte(rng);
+		}
+		return frame;
+	}
+
+	bool IsSupported(KernelPath path)
+	{
+		SetKernelPath(path);
+		return ActiveKernelPath() == path;
+	}
+
+	bool Report(
+		const char* what,
+		KernelPath path,
+		size_t count,
+		const std::vector<uint8_t>& expected,
+		const std::vector<uint8_t>& actual)
+	{
+		for (size_t i = 0; i < expected.size(); i++)
+		{
+			if (expected[i] != actual[i])
+			{
+				printf("MISMATCH %s %ls count %zu: byte %zu is %u, expected %u\n",
+					what, KernelPathName(path), count, i, actual[i], expected[i]);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Checks every path on one AHAT and one Long Throw frame of count
+	// pixels. False on the first mismatch.
+	bool CheckCount(
+		size_t count,
+		std::mt19937& rng)
+	{
+		const Frame frame = MakeFrame(count, false, rng);
+		const Frame frame12 = MakeFrame(count, true, rng);
+		const size_t packed12 = 2 * Packed12Size(count);
+
+		std::vector<uint8_t> ahat(4 * count), longThrow(4 * count), longThrow12Raw(4 * count);
+		ReferenceAhat(frame.Depth(), frame.Ab(), count, ahat.data());
+		ReferenceLongThrow(frame.Depth(), frame.Sigma(), frame.Ab(), count, longThrow.data());
+		ReferenceLongThrow(frame12.Depth(), frame12.Sigma(), frame12.Ab(), count, longThrow12Raw.data());
+
+		std::vector<uint8_t> scalarAhat12, scalarLongThrow12;
+		bool ok = true;
+		for (KernelPath path : kPaths)
+		{
+			if (!IsSupported(path))
+			{
+				continue;
+			}
+
+			// the + 1 keeps the outputs off alignment as well
+			std::vector<uint8_t> out(4 * count + 1);
+			std::vector<uint8_t> out12(packed12 + 1);
+			std::vector<uint8_t> unpacked(4 * count + 1);
+
+			PackAhatDepthAb(frame.Depth(), frame.Ab(), count, kAhatInvalidValue, out.data() + 1);
+			ok &= Report("ahat", path, count, ahat, std::vector<uint8_t>(out.begin() + 1, out.end()));
+
+			PackLongThrowDepthAb(frame.Depth(), frame.Sigma(), frame.Ab(), count, kLongThrowInvalidMask, out.data() + 1);
+			ok &= Report("longthrow", path, count, longThrow, std::vector<uint8_t>(out.begin() + 1, out.end()));
+
+			// AHAT survivors are below kAhatInvalidValue, so always 12 bits
+			if (!PackAhatDepthAb12(frame.Depth(), frame.Ab(), count, kAhatInvalidValue, out12.data() + 1))
+			{
+				printf("MISMATCH ahat12 %ls count %zu: refused\n", KernelPathName(path), count);
+				ok = false;
+			}
+			const std::vector<uint8_t> ahat12(out12.begin() + 1, out12.end());
+			Unpack12(ahat12.data(), count, true, unpacked.data() + 1);
+			Unpack12(ahat12.data() + packed12 / 2, count, true, unpacked.data() + 1 + 2 * count);
+			ok &= Report("ahat12 unpacked", path, count, ahat, std::vector<uint8_t>(unpacked.begin() + 1, unpacked.end()));
+
+			if (!PackLongThrowDepthAb12(frame12.Depth(), frame12.Sigma(), frame12.Ab(), count, kLongThrowInvalidMask, out12.data() + 1))
+			{
+				printf("MISMATCH longthrow12 %ls count %zu: refused\n", KernelPathName(path), count);
+				ok = false;
+			}
+			const std::vector<uint8_t> longThrow12(out12.begin() + 1, out12.end());
+			Unpack12(longThrow12.data(), count, false, unpacked.data() + 1);
+			Unpack12(longThrow12.data() + packed12 / 2, count, false, unpacked.data() + 1 + 2 * count);
+			ok &= Report("longthrow12 unpacked", path, count, longThrow12Raw, std::vector<uint8_t>(unpacked.begin() + 1, unpacked.end()));
+
+			// a value of 4096 or more anywhere has to send the frame raw
+			Frame wide = frame12;
+			wide.ab[1 + count - 1] = 4096;
+			if (PackLongThrowDepthAb12(wide.Depth(), wide.Sigma(), wide.Ab(), count, kLongThrowInvalidMask, out12.data() + 1))
+			{
+				printf("MISMATCH longthrow12 %ls count %zu: accepted a 13-bit value\n", KernelPathName(path), count);
+				ok = false;
+			}
+
+			if (path == KernelPath::Scalar)
+			{
+				scalarAhat12 = ahat12;
+				scalarLongThrow12 = longThrow12;
+			}
+			else
+			{
+				ok &= Report("ahat12", path, count, scalarAhat12, ahat12);
+				ok &= Report("longthrow12", path, count, scalarLongThrow12, longThrow12);
+			}
+		}
+		return ok;
+	}
+
+	template <typename F>
+	double MicrosecondsPerCall(
+		int iterations,
+		F f)
+	{
+		const auto start = Clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			f();
+		}
+		return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / iterations;
+	}
+
+	void Time(
+		const char* name,
+		size_t count,
+		int iterations,
+		std::mt19937& rng)
+	{
+		const Frame frame = MakeFrame(count, true, rng);
+		std::vector<uint8_t> out(4 * count);
+		volatile uint8_t sink = 0;
+
+		printf("%-10s %7zu px  %-8s %9.1f us\n", name, count, "original",
+			MicrosecondsPerCall(iterations, [&]()
+			{
+				if (name[0] == 'A')
+					ReferenceAhat(frame.Depth(), frame.Ab(), count, out.data());
+				else
+					ReferenceLongThrow(frame.Depth(), frame.Sigma(), frame.Ab(), count, out.data());
+				sink = sink + out[count];
+			}));
+
+		for (KernelPath path : kPaths)
+		{
+			if (!IsSupported(path))
+			{
+				continue;
+			}
+			const double raw = MicrosecondsPerCall(iterations, [&]()
+			{
+				if (name[0] == 'A')
+					PackAhatDepthAb(frame.Depth(), frame.Ab(), count, kAhatInvalidValue, out.data());
+				else
+					PackLongThrowDepthAb(frame.Depth(), frame.Sigma(), frame.Ab(), count, kLongThrowInvalidMask, out.data());
+				sink = sink + out[count];
+			});
+			const double packed12 = MicrosecondsPerCall(iterations, [&]()
+			{
+				if (name[0] == 'A')
+					PackAhatDepthAb12(frame.Depth(), frame.Ab(), count, kAhatInvalidValue, out.data());
+				else
+					PackLongThrowDepthAb12(frame.Depth(), frame.Sigma(), frame.Ab(), count, kLongThrowInvalidMask, out.data());
+				sink = sink + out[count];
+			});
+			printf("%-10s %7zu px  %-8ls %9.1f us  12-bit %9.1f us\n", name, count, KernelPathName(path), raw, packed12);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int iterations = 200;
+	if (argc > 1) iterations = atoi(argv[1]);
+
+	std::mt19937 rng(5);
+	const KernelPath detected = DetectKernelPath();
+	printf("detected path: %ls\n", KernelPathName(detected));
+	for (KernelPath path : kPaths)
+	{
+		if (!IsSupported(path))
+		{
+			printf("%ls: not supported by this build, not checked\n", KernelPathName(path));
+		}
+	}
+
+	bool ok = true;
+	const size_t frameCounts[] = { 512 * 512, 320 * 288 };
+	for (size_t count : frameCounts)
+	{
+		ok &= CheckCount(count, rng);
+	}
+	// every tail length of the 8- and 16-pixel loops, and the odd 12-bit end
+	for (size_t count = 1; count <= 67; count++)
+	{
+		ok &= CheckCount(count, rng);
+	}
+	ok &= CheckCount(512 * 512 - 1, rng);
+	ok &= CheckCount(320 * 288 + 13, rng);
+	printf("byte-exact: %s\n", ok ? "yes" : "NO");
+
+	Time("AHAT", 512 * 512, iterations, rng);
+	Time("LongThrow", 320 * 288, iterations, rng);
+
+	SetKernelPath(detected);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+// Off-device throughput harness for FramePipeline.
+//
+// A synthetic AHAT sensor produces 512x512 depth + AB frames at a fixed rate.
+// Like ResearchModeFrameProcessor, a processor thread only ever picks up the
+// newest frame and hands it to the sink. The sink either packs and transmits
+// inline (what the streamers did before) or submits to a FramePipeline.
+//
+// Packing runs the real FramePacking::PackAhatDepthAb kernel plus a busy wait
+// standing in for the pose lookup; transmitting sleeps for as long as the
+// payload takes on a link of the given bandwidth.
+//
+//   FramePipelineBench [seconds] [sensor fps] [link MB/s] [pose lookup ms]
+
+#include "FramePacking.h"
+#include "FramePipeline.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr int kWidth = 512;
+	constexpr int kHeight = 512;
+	constexpr size_t kPixels = (size_t)kWidth * kHeight;
+	constexpr uint16_t kAhatInvalid = 4090;
+
+	struct Settings
+	{
+		double seconds = 5.0;
+		double sensorFps = 45.0;
+		double linkMBps = 60.0;
+		double poseLookupMs = 6.0;
+	};
+
+	struct SensorFrame
+	{
+		std::shared_ptr<std::vector<uint16_t>> depth;
+		std::shared_ptr<std::vector<uint16_t>> ab;
+		Clock::time_point captured;
+	};
+
+	struct PackedFrame
+	{
+		std::shared_ptr<std::vector<uint8_t>> payload;
+		Clock::time_point captured;
+	};
+
+	struct Results
+	{
+		uint64_t produced = 0;
+		uint64_t sent = 0;
+		uint64_t bytes = 0;
+		double latencyMsSum = 0;
+		uint64_t pipelineDropped = 0;
+	};
+
+	void SpinFor(double ms)
+	{
+		const auto end = Clock::now() + std::chrono::duration<double, std::milli>(ms);
+		while (Clock::now() < end)
+		{
+		}
+	}
+
+	SensorFrame MakeFrame(uint32_t index)
+	{
+		SensorFrame frame;
+		frame.depth = std::make_shared<std::vector<uint16_t>>(kPixels);
+		frame.ab = std::make_shared<std::vector<uint16_t>>(kPixels);
+		for (size_t i = 0; i < kPixels; i++)
+		{
+			// a slowly moving ramp with some invalid pixels sprinkled in
+			uint16_t depth = (uint16_t)((i + index * 7) % 1100);
+			(*frame.depth)[i] = (i % 97 == 0) ? kAhatInvalid : depth;
+			(*frame.ab)[i] = (uint16_t)((i * 3 + index) % 4096);
+		}
+		frame.captured = Clock::now();
+		return frame;
+	}
+
+	class Bench
+	{
+	public:
+		Bench(const Settings& settings, bool pipelined) :
+			m_settings(settings),
+			m_pipelined(pipelined)
+		{
+		}
+
+		Results Run()
+		{
+			if (m_pipelined)
+			{
+				m_pPipeline = std::make_unique<FramePipeline<SensorFrame, PackedFrame>>(
+					[this](SensorFrame& frame, PackedFrame& packed) { return Pack(frame, packed); },
+					[this](PackedFrame& packed) { Transmit(packed); });
+			}
+
+			std::thread processor(&Bench::ProcessorLoop, this);
+
+			const auto period = std::chrono::duration<double>(1.0 / m_settings.sensorFps);
+			const auto start = Clock::now();
+			const auto end = start + std::chrono::duration<double>(m_settings.seconds);
+			auto next = start;
+			uint32_t index = 0;
+			while (next < end)
+			{
+				std::this_thread::sleep_until(next);
+				Publish(MakeFrame(index++));
+				next += std::chrono::duration_cast<Clock::duration>(period);
+			}
+
+			{
+				std::lock_guard<std::mutex> guard(m_mutex);
+				m_stop = true;
+			}
+			m_wake.notify_one();
+			processor.join();
+
+			if (m_pPipeline)
+			{
+				m_pPipeline->Stop();
+				m_results.pipelineDropped = m_pPipeline->GetStats().dropped;
+			}
+			m_results.produced = index;
+			return m_results;
+		}
+
+	private:
+		// the latest frame mailbox of the frame processor
+		void Publish(SensorFrame frame)
+		{
+			{
+				std::lock_guard<std::mutex> guard(m_mutex);
+				m_latest = std::make_unique<SensorFrame>(std::move(frame));
+			}
+			m_wake.notify_one();
+		}
+
+		void ProcessorLoop()
+		{
+			for (;;)
+			{
+				std::unique_ptr<SensorFrame> frame;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_wake.wait(lock, [this] { return m_stop || m_latest; });
+					if (m_stop)
+					{
+						return;
+					}
+					frame = std::move(m_latest);
+				}
+				Send(std::move(*frame));
+			}
+		}
+
+		// IResearchModeFrameSink::Send
+		void Send(SensorFrame frame)
+		{
+			if (m_pPipeline)
+			{
+				m_pPipeline->Submit(std::move(frame));
+				return;
+			}
+
+			PackedFrame packed;
+			if (Pack(frame, packed))
+			{
+				Transmit(packed);
+			}
+		}
+
+		bool Pack(SensorFrame& frame, PackedFrame& packed)
+		{
+			SpinFor(m_settings.poseLookupMs);
+			packed.payload = std::make_shared<std::vector<uint8_t>>(kPixels * 4);
+			FramePacking::PackAhatDepthAb(
+				frame.depth->data(), frame.ab->data(), kPixels, kAhatInvalid, packed.payload->data());
+			packed.captured = frame.captured;
+			return true;
+		}
+
+		void Transmit(PackedFrame& packed)
+		{
+			const double seconds = packed.payload->size() / (m_settings.linkMBps * 1e6);
+			std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+
+			const double latencyMs =
+				std::chrono::duration<double, std::milli>(Clock::now() - packed.captured).count();
+			m_results.sent++;
+			m_results.bytes += packed.payload->size();
+			m_results.latencyMsSum += latencyMs;
+		}
+
+		Settings m_settings;
+		bool m_pipelined;
+
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::unique_ptr<SensorFrame> m_latest;
+		bool m_stop = false;
+
+		Results m_results;
+		std::unique_ptr<FramePipeline<SensorFrame, PackedFrame>> m_pPipeline;
+	};
+
+	void Report(const char* name, const Settings& settings, const Results& results)
+	{
+		printf("%-10s %6.1f fps %7.1f MB/s %7.1f ms latency %6llu of %llu frames sent, %llu dropped in pipeline\n",
+			name,
+			results.sent / settings.seconds,
+			results.bytes / settings.seconds / 1e6,
+			results.sent ? results.latencyMsSum / results.sent : 0.0,
+			(unsigned long long)results.sent,
+			(unsigned long long)results.produced,
+			(unsigned long long)results.pipelineDropped);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Settings settings;
+	if (argc > 1) settings.seconds = atof(argv[1]);
+	if (argc > 2) settings.sensorFps = atof(argv[2]);
+	if (argc > 3) settings.linkMBps = atof(argv[3]);
+	if (argc > 4) settings.poseLookupMs = atof(argv[4]);
+
+	printf("AHAT %dx%d at %.1f fps, link %.1f MB/s, pose lookup %.1f ms, %.1f s per run\n",
+		kWidth, kHeight, settings.sensorFps, settings.linkMBps, settings.poseLookupMs, settings.seconds);
+
+	Report("serial", settings, Bench(settings, false).Run());
+	Report("pipelined", settings, Bench(settings, true).Run());
+	return 0;
+}
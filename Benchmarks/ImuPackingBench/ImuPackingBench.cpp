@@ -0,0 +1,268 @@
+// Packs simulated IMU sample batches the way ImuStreamer does and checks what
+// comes back out.
+//
+// The accelerometer, gyroscope and magnetometer deliver batches at their own
+// rates, time stamped on a device clock (nanoseconds) that runs 40 ppm off
+// the host clock. The host ticks of a batch are taken after its newest
+// sample, late by a random delivery delay. Every message packs the batches
+// that arrived since the previous one. Exits with 1 if a decoded value is off
+// by more than half its block's scale, a sample time by more than the bound
+// below, or a sample goes missing.
+//
+//   ImuPackingBench [seconds] [max delivery delay ms]
+
+#include "ImuPacking.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+	using namespace ImuPacking;
+	using Clock = std::chrono::steady_clock;
+
+	constexpr double kPi = 3.14159265358979;
+	constexpr int64_t kTicksPerSecond = 10000000;
+	constexpr double kDeviceClockDrift = 40e-6;
+	// delivery delays are at least this long, the aligner can not see it
+	constexpr double kMinDelayMs = 0.5;
+	// bound on the aligned time error once the aligner's window is full,
+	// beyond the minimum delay, for delays up to kDefaultMaxDelayMs
+	constexpr double kMaxTimeErrorMs = 0.5;
+	constexpr double kDefaultMaxDelayMs = 8.0;
+	// messages go out at this rate (the receiver's credits in practice)
+	constexpr double kMessageRate = 60.0;
+
+	struct Sensor
+	{
+		const char* name;
+		SensorKind kind;
+		double rate;
+		size_t batchSize;
+		// amplitude of the simulated signal
+		double amplitude;
+		bool hasTemperature;
+	};
+
+	const Sensor kSensors[] = {
+		{ "accel", SensorKind::Accel, 1100.0, 93, 12.0, true },
+		{ "gyro", SensorKind::Gyro, 6400.0, 320, 4.0, true },
+		{ "mag", SensorKind::Mag, 50.0, 5, 0.6, false },
+	};
+
+	double Signal(
+		const Sensor& sensor,
+		int axis,
+		double seconds)
+	{
+		return sensor.amplitude * std::sin(2.0 * kPi * (0.7 + axis) * seconds + axis) +
+			0.1 * sensor.amplitude * std::sin(2.0 * kPi * 37.0 * seconds);
+	}
+
+	// a batch as the sensor hands it out
+	struct Batch
+	{
+		size_t sensor;
+		int64_t hostTicks;
+		std::vector<uint64_t> deviceNs;
+		std::vector<int64_t> trueTicks;
+		std::vector<Sample> samples;
+	};
+
+	struct SensorResult
+	{
+		uint64_t samples = 0;
+		uint64_t decoded = 0;
+		double maxValueError = 0.0;
+		double maxScale = 0.0;
+		double maxTimeErrorMs = 0.0;
+		double sumTimeErrorMs = 0.0;
+		uint64_t timedSamples = 0;
+		bool valueErrorTooLarge = false;
+	};
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = 20.0;
+	double maxDelayMs = kDefaultMaxDelayMs;
+	if (argc > 1) seconds = atof(argv[1]);
+	if (argc > 2) maxDelayMs = atof(argv[2]);
+
+	std::mt19937 rng(11);
+	std::uniform_real_distribution<double> delay(kMinDelayMs, (std::max)(kMinDelayMs, maxDelayMs));
+
+	// all batches of all sensors, ordered by when the host gets them
+	std::vector<Batch> batches;
+	for (size_t s = 0; s < 3; s++)
+	{
+		const Sensor& sensor = kSensors[s];
+		const uint64_t deviceStartNs = 123456789000ull * (s + 1);
+		size_t index = 0;
+		while (true)
+		{
+			Batch batch;
+			batch.sensor = s;
+			for (size_t i = 0; i < sensor.batchSize; i++, index++)
+			{
+				const double time = 1.0 + index / sensor.rate;
+				Sample sample;
+				sample.time = 0;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					sample.values[axis] = (float)Signal(sensor, axis, time);
+				}
+				batch.samples.push_back(sample);
+				batch.trueTicks.push_back((int64_t)std::llround(time * kTicksPerSecond));
+				batch.deviceNs.push_back(deviceStartNs + (uint64_t)std::llround(time * (1.0 + kDeviceClockDrift) * 1e9));
+			}
+			const double newest = (double)batch.trueTicks.back() / kTicksPerSecond;
+			if (newest > seconds)
+			{
+				break;
+			}
+			batch.hostTicks = (int64_t)std::llround((newest + delay(rng) / 1000.0) * kTicksPerSecond);
+			batches.push_back(std::move(batch));
+		}
+	}
+	std::sort(batches.begin(), batches.end(), [](const Batch& a, const Batch& b) { return a.hostTicks < b.hostTicks; });
+
+	ClockAligner aligners[3];
+	size_t batchCount[3] = {};
+	SensorResult results[3];
+	std::vector<uint8_t> payload;
+	std::vector<Block> decoded;
+	uint64_t messages = 0;
+	uint64_t payloadBytes = 0;
+	uint64_t rawBytes = 0;
+	double encodeSeconds = 0.0;
+
+	size_t next = 0;
+	const int64_t messageInterval = (int64_t)(kTicksPerSecond / kMessageRate);
+	for (int64_t now = kTicksPerSecond; next < batches.size(); now += messageInterval)
+	{
+		// the batches that arrived by now, per sensor
+		std::vector<Sample> pending[3];
+		std::vector<int64_t> truth[3];
+		std::vector<bool> timed[3];
+		for (; next < batches.size() && batches[next].hostTicks <= now; next++)
+		{
+			Batch& batch = batches[next];
+			const size_t s = batch.sensor;
+			ClockAligner& aligner = aligners[s];
+			aligner.Update(batch.hostTicks, batch.deviceNs.back());
+			batchCount[s]++;
+			for (size_t i = 0; i < batch.samples.size(); i++)
+			{
+				batch.samples[i].time = aligner.HostTicks(batch.deviceNs[i]);
+				pending[s].push_back(batch.samples[i]);
+				truth[s].push_back(batch.trueTicks[i]);
+				timed[s].push_back(batchCount[s] > ClockAligner::kWindow);
+			}
+			rawBytes += batch.samples.size() * 32;
+		}
+
+		int64_t baseTime = INT64_MAX;
+		size_t blockCount = 0;
+		size_t sampleCount = 0;
+		for (size_t s = 0; s < 3; s++)
+		{
+			if (!pending[s].empty())
+			{
+				baseTime = (std::min)(baseTime, pending[s].front().time);
+				blockCount++;
+				sampleCount += pending[s].size();
+			}
+		}
+		if (blockCount == 0)
+		{
+			continue;
+		}
+
+		const Clock::time_point start = Clock::now();
+		payload.resize(EncodedSize(blockCount, sampleCount));
+		uint8_t* out = payload.data();
+		for (size_t s = 0; s < 3; s++)
+		{
+			if (!pending[s].empty())
+			{
+				out += EncodeBlock(kSensors[s].kind, pending[s].data(), pending[s].size(),
+					kSensors[s].hasTemperature ? 31.5f : NAN, baseTime, out);
+			}
+		}
+		encodeSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+		messages++;
+		payloadBytes += payload.size();
+
+		decoded.clear();
+		if (out != payload.data() + payload.size() || !Decode(payload.data(), payload.size(), baseTime, decoded))
+		{
+			printf("message %llu does not decode\n", (unsigned long long)messages);
+			return 1;
+		}
+
+		for (const Block& block : decoded)
+		{
+			const size_t s = (size_t)block.kind;
+			SensorResult& result = results[s];
+			result.samples += pending[s].size();
+			result.decoded += block.samples.size();
+			result.maxScale = (std::max)(result.maxScale, (double)block.scale);
+			for (size_t i = 0; i < block.samples.size() && i < pending[s].size(); i++)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const double error = std::fabs((double)block.samples[i].values[axis] - pending[s][i].values[axis]);
+					result.maxValueError = (std::max)(result.maxValueError, error);
+					// half a step, plus the float rounding of the decoded value
+					result.valueErrorTooLarge |= error > 0.5 * block.scale + FLT_EPSILON * std::fabs(pending[s][i].values[axis]);
+				}
+				if (block.samples[i].time != pending[s][i].time)
+				{
+					printf("%s: sample time changed in packing\n", kSensors[s].name);
+					return 1;
+				}
+				if (timed[s][i])
+				{
+					const double errorMs = std::fabs((double)(block.samples[i].time - truth[s][i])) / 1e4;
+					result.maxTimeErrorMs = (std::max)(result.maxTimeErrorMs, errorMs);
+					result.sumTimeErrorMs += errorMs;
+					result.timedSamples++;
+				}
+			}
+		}
+	}
+
+	printf("%.0f s, delivery delay %.1f..%.1f ms, device clock %+.0f ppm, %.0f messages/s\n", seconds, kMinDelayMs,
+		maxDelayMs, kDeviceClockDrift * 1e6, kMessageRate);
+	printf("  %-6s %9s %9s %12s %12s %12s %12s\n", "sensor", "samples", "decoded", "max error", "max scale",
+		"max ms", "mean ms");
+	bool ok = true;
+	for (size_t s = 0; s < 3; s++)
+	{
+		const SensorResult& result = results[s];
+		const bool timeOk = maxDelayMs > kDefaultMaxDelayMs || result.maxTimeErrorMs <= kMinDelayMs + kMaxTimeErrorMs;
+		printf("  %-6s %9llu %9llu %12.6f %12.6f %12.3f %12.3f%s%s\n", kSensors[s].name,
+			(unsigned long long)result.samples, (unsigned long long)result.decoded, result.maxValueError,
+			result.maxScale, result.maxTimeErrorMs,
+			result.timedSamples ? result.sumTimeErrorMs / result.timedSamples : 0.0,
+			result.valueErrorTooLarge ? "  VALUE ERROR" : "", timeOk ? "" : "  TIME ERROR");
+		ok &= !result.valueErrorTooLarge && timeOk && result.samples == result.decoded && result.samples > 0;
+	}
+	const uint64_t samples = results[0].samples + results[1].samples + results[2].samples;
+	printf("%llu messages, %.2f bytes per sample (raw structs 32), %.1f KB/s, packing %.1f ns per sample\n",
+		(unsigned long long)messages, (double)payloadBytes / samples, payloadBytes / seconds / 1024.0,
+		encodeSeconds * 1e9 / samples);
+	printf("raw structs %.1f KB/s\n", rawBytes / seconds / 1024.0);
+	if (!ok)
+	{
+		printf("FAILED\n");
+	}
+	return ok ? 0 : 1;
+}
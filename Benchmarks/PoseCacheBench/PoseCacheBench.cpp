@@ -0,0 +1,274 @@
+// Serves the poses of simulated Research Mode frames from a PoseCache, the
+// way RigPoseService does on the device, and compares them with the true
+// head motion.
+//
+// The head turns at up to 330 degrees per second and walks at 1.5 m/s. A
+// sampler thread adds a pose every sample interval, skipping samples at
+// random (transient locate failures) and once for 300 ms (tracking lost).
+// Three threads look up the poses of AHAT (45 fps) and VLC frames (2 x 30
+// fps) a packing delay after their timestamp, as the streamers do. Exits
+// with 1 if an interpolated pose is off by more than the bounds below, if a
+// frame within a short gap misses, or if one within the long loss hits.
+//
+//   PoseCacheBench [seconds] [sample interval ms] [locate failure %]
+
+#include "PoseCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr double kPi = 3.14159265358979;
+	constexpr int64_t kTicksPerSecond = 10000000;
+
+	// bounds for the default 10 ms sample interval
+	constexpr double kMaxRotationErrorDeg = 0.05;
+	constexpr double kMaxTranslationErrorMm = 0.5;
+
+	// tracking is lost from 40% to 40% + 300 ms of the run
+	constexpr double kLossStart = 0.4;
+	constexpr double kLossSeconds = 0.3;
+	// frames are packed this long after their timestamp
+	constexpr double kPackingDelaySeconds = 0.03;
+
+	struct Settings
+	{
+		double seconds = 10.0;
+		double sampleIntervalMs = 10.0;
+		double failurePercent = 5.0;
+	};
+
+	// the true head pose at time seconds: a wobbling turn around a slowly
+	// changing axis, plus a walk
+	PoseCache::Pose TruePose(double seconds)
+	{
+		const double angle = 1.2 * std::sin(2.0 * kPi * 0.45 * seconds) + 0.3 * std::sin(2.0 * kPi * 1.3 * seconds);
+		double axis[3] = { 0.3 * std::sin(0.7 * seconds), 1.0, 0.2 * std::cos(0.5 * seconds) };
+		const double length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		const double s = std::sin(0.5 * angle) / length;
+
+		PoseCache::Pose pose;
+		pose.orientation[0] = (float)(axis[0] * s);
+		pose.orientation[1] = (float)(axis[1] * s);
+		pose.orientation[2] = (float)(axis[2] * s);
+		pose.orientation[3] = (float)std::cos(0.5 * angle);
+		pose.position[0] = (float)(1.5 * seconds);
+		pose.position[1] = (float)(1.6 + 0.03 * std::sin(2.0 * kPi * 1.8 * seconds));
+		pose.position[2] = (float)(0.5 * std::sin(0.3 * seconds));
+		return pose;
+	}
+
+	// angle of conj(a) * b, from its vector part; acos of the dot product
+	// would only show the float rounding of the quaternions
+	double RotationErrorDeg(const PoseCache::Pose& a, const PoseCache::Pose& b)
+	{
+		const double ax = a.orientation[0], ay = a.orientation[1], az = a.orientation[2], aw = a.orientation[3];
+		const double bx = b.orientation[0], by = b.orientation[1], bz = b.orientation[2], bw = b.orientation[3];
+		const double w = aw * bw + ax * bx + ay * by + az * bz;
+		const double x = aw * bx - ax * bw - ay * bz + az * by;
+		const double y = aw * by - ay * bw - az * bx + ax * bz;
+		const double z = aw * bz - az * bw - ax * by + ay * bx;
+		return 2.0 * std::atan2(std::sqrt(x * x + y * y + z * z), std::fabs(w)) * 180.0 / kPi;
+	}
+
+	double TranslationErrorMm(const PoseCache::Pose& a, const PoseCache::Pose& b)
+	{
+		double sum = 0.0;
+		for (int i = 0; i < 3; i++)
+		{
+			const double d = (double)a.position[i] - b.position[i];
+			sum += d * d;
+		}
+		return std::sqrt(sum) * 1000.0;
+	}
+
+	struct SensorResult
+	{
+		const char* name = nullptr;
+		uint64_t frames = 0;
+		uint64_t hits = 0;
+		uint64_t bridged = 0;
+		uint64_t unexpected = 0;
+		double maxRotationDeg = 0.0;
+		double sumRotationDeg = 0.0;
+		double maxTranslationMm = 0.0;
+		double lookupNs = 0.0;
+	};
+
+	// true if time falls within the long loss, widened by the sample
+	// interval either side
+	bool InLoss(double time, const Settings& settings)
+	{
+		const double start = kLossStart * settings.seconds;
+		const double margin = settings.sampleIntervalMs / 1000.0;
+		return time > start - margin && time < start + kLossSeconds + margin;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Settings settings;
+	if (argc > 1) settings.seconds = atof(argv[1]);
+	if (argc > 2) settings.sampleIntervalMs = atof(argv[2]);
+	if (argc > 3) settings.failurePercent = atof(argv[3]);
+
+	const double interval = settings.sampleIntervalMs / 1000.0;
+	const double lossStart = kLossStart * settings.seconds;
+	const double lossEnd = lossStart + kLossSeconds;
+
+	// every sample time and whether the locator delivered, decided up front
+	// so the lookups can tell which gaps were short
+	std::vector<double> slotTimes;
+	std::vector<bool> located;
+	std::vector<double> sampleTimes;
+	{
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<double> uniform(0.0, 100.0);
+		for (double time = 0.0; time < settings.seconds + 2.0 * kPackingDelaySeconds; time += interval)
+		{
+			const bool lost = time >= lossStart && time < lossEnd;
+			slotTimes.push_back(time);
+			located.push_back(!lost && uniform(rng) >= settings.failurePercent);
+			if (located.back())
+			{
+				sampleTimes.push_back(time);
+			}
+		}
+	}
+
+	PoseCache cache;
+	// The simulated clock runs as fast as the threads can go. A lookup waits
+	// for the sampler to get a packing delay past its frame, the sampler
+	// stays within two packing delays of the slowest packer so the ring is
+	// not overwritten under it.
+	std::atomic<int64_t> sampledUntil{ -1 };
+	std::atomic<int64_t> packedUntil[3] = { { 0 }, { 0 }, { 0 } };
+	const int64_t delayTicks = (int64_t)(kPackingDelaySeconds * kTicksPerSecond);
+
+	std::thread sampler([&]() {
+		for (size_t i = 0; i < slotTimes.size(); i++)
+		{
+			const int64_t ticks = (int64_t)std::llround(slotTimes[i] * kTicksPerSecond);
+			while ((std::min)({ packedUntil[0].load(), packedUntil[1].load(), packedUntil[2].load() }) + 2 * delayTicks < ticks)
+			{
+				std::this_thread::yield();
+			}
+			if (located[i])
+			{
+				cache.Add(ticks, TruePose(slotTimes[i]));
+			}
+			sampledUntil = ticks;
+		}
+		sampledUntil = INT64_MAX;
+	});
+
+	struct Sensor
+	{
+		const char* name;
+		double fps;
+		double offset;
+	};
+	const Sensor sensors[] = {
+		{ "AHAT", 45.0, 0.0013 },
+		{ "VLC LF", 30.0, 0.0041 },
+		{ "VLC RF", 30.0, 0.0042 },
+	};
+	std::vector<SensorResult> results(3);
+	std::vector<std::thread> packers;
+	for (size_t s = 0; s < 3; s++)
+	{
+		packers.emplace_back([&, s]() {
+			SensorResult& result = results[s];
+			result.name = sensors[s].name;
+			double lookupSeconds = 0.0;
+			for (double time = sensors[s].offset; time < settings.seconds; time += 1.0 / sensors[s].fps)
+			{
+				const int64_t ticks = (int64_t)std::llround(time * kTicksPerSecond);
+				packedUntil[s] = ticks;
+				const int64_t packAt = ticks + delayTicks;
+				while (sampledUntil.load() < packAt)
+				{
+					std::this_thread::yield();
+				}
+
+				PoseCache::Pose pose;
+				const Clock::time_point start = Clock::now();
+				const bool hit = cache.Lookup(ticks, pose);
+				lookupSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+				// the samples around the frame
+				const auto after = std::lower_bound(sampleTimes.begin(), sampleTimes.end(), time - 1e-9);
+				const bool covered = after != sampleTimes.begin() && after != sampleTimes.end() &&
+					*after - *(after - 1) <= (double)PoseCache::kMaxGap / kTicksPerSecond + 1e-9;
+				const bool bridged = covered && *after - *(after - 1) > interval * 1.5;
+
+				result.frames++;
+				if (hit != covered || (hit && InLoss(time, settings) && !bridged))
+				{
+					result.unexpected++;
+				}
+				if (!hit)
+				{
+					continue;
+				}
+				result.hits++;
+				result.bridged += bridged ? 1 : 0;
+				if (!bridged)
+				{
+					// bridged gaps are a guess, the bounds are for regular
+					// interpolation
+					const PoseCache::Pose truth = TruePose(time);
+					const double rotation = RotationErrorDeg(pose, truth);
+					result.maxRotationDeg = (std::max)(result.maxRotationDeg, rotation);
+					result.sumRotationDeg += rotation;
+					result.maxTranslationMm = (std::max)(result.maxTranslationMm, TranslationErrorMm(pose, truth));
+				}
+			}
+			// done, no longer holds the sampler back
+			packedUntil[s] = INT64_MAX / 2;
+			result.lookupNs = lookupSeconds * 1e9 / (std::max)(result.frames, (uint64_t)1);
+		});
+	}
+	for (std::thread& packer : packers)
+	{
+		packer.join();
+	}
+	sampler.join();
+
+	const PoseCache::Stats stats = cache.GetStats();
+	printf("%.1f s, a sample every %.1f ms, %.1f%% locate failures, tracking lost for %.0f ms\n",
+		settings.seconds, settings.sampleIntervalMs, settings.failurePercent, kLossSeconds * 1000.0);
+	printf("  %-7s %7s %7s %8s %10s %10s %10s %10s\n", "sensor", "frames", "hits", "bridged", "max deg", "mean deg",
+		"max mm", "lookup ns");
+	bool ok = true;
+	for (const SensorResult& result : results)
+	{
+		const uint64_t interpolated = result.hits - result.bridged;
+		printf("  %-7s %7llu %7llu %8llu %10.4f %10.4f %10.3f %10.0f%s\n", result.name,
+			(unsigned long long)result.frames, (unsigned long long)result.hits, (unsigned long long)result.bridged,
+			result.maxRotationDeg, interpolated ? result.sumRotationDeg / interpolated : 0.0, result.maxTranslationMm,
+			result.lookupNs, result.unexpected ? "  UNEXPECTED HIT OR MISS" : "");
+		ok &= result.unexpected == 0;
+		if (settings.sampleIntervalMs <= 10.0)
+		{
+			ok &= result.maxRotationDeg <= kMaxRotationErrorDeg && result.maxTranslationMm <= kMaxTranslationErrorMm;
+		}
+	}
+	printf("cache: %llu samples, %llu hits, %llu misses\n", (unsigned long long)stats.samples,
+		(unsigned long long)stats.hits, (unsigned long long)stats.misses);
+	if (!ok)
+	{
+		printf("FAILED\n");
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+// Round trip of the pose encodings (PoseCodec) against the float4x4 the
+// streamers send. Random rigid transforms, plus the identity and half turns
+// where the quaternion's w is 0, are encoded, decoded and compared with the
+// original matrix. Exits with 1 if an error exceeds the bounds documented in
+// PoseCodec.h.
+//
+//   PoseCodecBench [poses]
+
+#include "FrameHeader.h"
+#include "PoseCodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Matrix
+	{
+		float m[16];
+	};
+
+	// like make_float4x4_from_quaternion(q) * make_float4x4_translation(t)
+	Matrix MakeTransform(double x, double y, double z, double w, double tx, double ty, double tz)
+	{
+		Matrix matrix = {};
+		float* m = matrix.m;
+		m[0] = (float)(1.0 - 2.0 * (y * y + z * z));
+		m[1] = (float)(2.0 * (x * y + z * w));
+		m[2] = (float)(2.0 * (x * z - y * w));
+		m[4] = (float)(2.0 * (x * y - z * w));
+		m[5] = (float)(1.0 - 2.0 * (x * x + z * z));
+		m[6] = (float)(2.0 * (y * z + x * w));
+		m[8] = (float)(2.0 * (x * z + y * w));
+		m[9] = (float)(2.0 * (y * z - x * w));
+		m[10] = (float)(1.0 - 2.0 * (x * x + y * y));
+		m[12] = (float)tx;
+		m[13] = (float)ty;
+		m[14] = (float)tz;
+		m[15] = 1.0f;
+		return matrix;
+	}
+
+	std::vector<Matrix> MakePoses(size_t count)
+	{
+		std::vector<Matrix> poses;
+		poses.push_back(MakeTransform(0, 0, 0, 1, 0, 0, 0));
+		poses.push_back(MakeTransform(1, 0, 0, 0, 1.5, -0.2, 3.0));
+		poses.push_back(MakeTransform(0, 1, 0, 0, -40.0, 1.7, 12.5));
+		poses.push_back(MakeTransform(0, 0, 1, 0, 0.001, 0.002, -0.003));
+		poses.push_back(MakeTransform(0.5, 0.5, 0.5, 0.5, 100.0, -100.0, 0.25));
+
+		// uniformly random rotations, positions within a building
+		std::mt19937 rng(11);
+		std::normal_distribution<double> gauss(0.0, 1.0);
+		std::uniform_real_distribution<double> position(-50.0, 50.0);
+		while (poses.size() < count)
+		{
+			double q[4];
+			double norm = 0.0;
+			for (double& value : q)
+			{
+				value = gauss(rng);
+				norm += value * value;
+			}
+			norm = std::sqrt(norm);
+			poses.push_back(MakeTransform(q[0] / norm, q[1] / norm, q[2] / norm, q[3] / norm,
+				position(rng), position(rng), position(rng)));
+		}
+		return poses;
+	}
+
+	// angle of the rotation between the upper 3x3 of a and b. From the
+	// antisymmetric part of a^T b, which float rounding of the matrices
+	// does not swamp the way it does acos((trace - 1) / 2).
+	double RotationError(const Matrix& a, const Matrix& b)
+	{
+		double e[3][3] = {};
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					e[i][j] += (double)a.m[k * 4 + i] * b.m[k * 4 + j];
+				}
+			}
+		}
+		const double sx = e[2][1] - e[1][2];
+		const double sy = e[0][2] - e[2][0];
+		const double sz = e[1][0] - e[0][1];
+		const double sine = 0.5 * std::sqrt(sx * sx + sy * sy + sz * sz);
+		const double cosine = 0.5 * (e[0][0] + e[1][1] + e[2][2] - 1.0);
+		return std::atan2(sine, cosine);
+	}
+
+	double TranslationError(const Matrix& a, const Matrix& b)
+	{
+		double error = 0.0;
+		for (int i = 12; i < 15; i++)
+		{
+			error = (std::max)(error, std::fabs((double)a.m[i] - b.m[i]));
+		}
+		return error;
+	}
+
+	bool Run(const std::vector<Matrix>& poses, PoseCodec::Format format, const char* name,
+		double maxRotationError, double maxTranslationError)
+	{
+		const size_t size = PoseCodec::EncodedSize(format);
+		std::vector<uint8_t> encoded(poses.size() * size);
+		std::vector<Matrix> decoded(poses.size());
+
+		const Clock::time_point encodeStart = Clock::now();
+		for (size_t i = 0; i < poses.size(); i++)
+		{
+			PoseCodec::Encode(poses[i].m, format, &encoded[i * size]);
+		}
+		const Clock::time_point decodeStart = Clock::now();
+		for (size_t i = 0; i < poses.size(); i++)
+		{
+			PoseCodec::Decode(&encoded[i * size], format, decoded[i].m);
+		}
+		const Clock::time_point end = Clock::now();
+
+		double rotationError = 0.0;
+		double translationError = 0.0;
+		for (size_t i = 0; i < poses.size(); i++)
+		{
+			rotationError = (std::max)(rotationError, RotationError(poses[i], decoded[i]));
+			translationError = (std::max)(translationError, TranslationError(poses[i], decoded[i]));
+		}
+
+		const double encodeNs = std::chrono::duration<double, std::nano>(decodeStart - encodeStart).count() / poses.size();
+		const double decodeNs = std::chrono::duration<double, std::nano>(end - decodeStart).count() / poses.size();
+		const bool ok = rotationError <= maxRotationError && translationError <= maxTranslationError;
+		printf("  %-11s %6zu %7zu %14.3g %14.3g %9.1f %9.1f%s\n", name, size, sizeof(FrameHeader) + size,
+			rotationError * 180.0 / 3.14159265358979, translationError * 1000.0, encodeNs, decodeNs,
+			ok ? "" : "  EXCEEDS BOUND");
+		return ok;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t count = argc > 1 ? (size_t)atoi(argv[1]) : 100000;
+	const std::vector<Matrix> poses = MakePoses(count);
+
+	printf("%zu poses, max error against the float4x4\n", poses.size());
+	printf("  %-11s %6s %7s %14s %14s %9s %9s\n", "format", "bytes", "header", "rotation deg", "transl. mm",
+		"enc ns", "dec ns");
+	bool ok = true;
+	ok &= Run(poses, PoseCodec::Format::Matrix, "matrix", 0.0, 0.0);
+	ok &= Run(poses, PoseCodec::Format::Quaternion, "quaternion", PoseCodec::kQuaternionMaxRotationError, 0.0);
+	ok &= Run(poses, PoseCodec::Format::Quantized, "quantized", PoseCodec::kQuantizedMaxRotationError,
+		PoseCodec::kQuantizedMaxTranslationError);
+	return ok ? 0 : 1;
+}
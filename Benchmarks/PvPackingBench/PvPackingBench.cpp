@@ -0,0 +1,290 @@
+// Checks the PV packing kernels against the loop VideoCameraStreamer ran
+// before they moved into FramePacking, and times them at the PV sizes.
+//
+// At factor 1 every kernel path this build and CPU support (scalar
+// everywhere, SSE2 on x86, NEON on ARM) has to produce the bytes of the
+// original loop, for PackBgraToBgr and DownscaleBgraToBgr. The original loop
+// subsampled at factors 2 and 4 where the kernels average each block, so
+// there the kernels are checked against a plain box filter instead, at the
+// PV sizes, with padded rows, and at small sizes that end in every tail
+// length of the vector loops. Exits with 1 on any mismatch.
+//
+//   PvPackingBench [iterations]
+
+#include "FramePacking.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+	using namespace FramePacking;
+	using Clock = std::chrono::steady_clock;
+
+	const KernelPath kPaths[] = { KernelPath::Scalar, KernelPath::Sse2, KernelPath::Neon };
+	const int kFactors[] = { 1, 2, 4 };
+
+	struct Size
+	{
+		int width;
+		int height;
+	};
+
+	// Video Conferencing profiles the streamer sees
+	const Size kPvSizes[] = { { 1280, 720 }, { 1952, 1100 } };
+
+	// the loop from VideoCameraStreamer::SendFrame, rows tightly packed
+	void ReferencePack(
+		const uint8_t* pixelBufferData,
+		int imageWidth,
+		int imageHeight,
+		int scaleFactor,
+		uint8_t* m_bgr_buf)
+	{
+		const int pixelStride = 4;
+		const int rowStride = imageWidth * pixelStride;
+
+		int count = 0;
+		for (int row = 0; row < imageHeight; row += scaleFactor)
+		{
+			for (int col = 0; col < rowStride; col += scaleFactor * pixelStride)
+			{
+				for (int j = 0; j < pixelStride - 1; j++)
+				{
+					m_bgr_buf[count] = pixelBufferData[row * rowStride + col + j];
+					++count;
+				}
+			}
+		}
+	}
+
+	// rounded average of every factor x factor block
+	void ReferenceBoxFilter(
+		const uint8_t* pBgra,
+		int width,
+		int height,
+		int rowStride,
+		int factor,
+		uint8_t* out)
+	{
+		const int area = factor * factor;
+		for (int row = 0; row < height / factor; row++)
+		{
+			for (int col = 0; col < width / factor; col++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					int sum = 0;
+					for (int y = 0; y < factor; y++)
+					{
+						for (int x = 0; x < factor; x++)
+						{
+							sum += pBgra[(row * factor + y) * rowStride + (col * factor + x) * 4 + c];
+						}
+					}
+					*out++ = (uint8_t)((sum + area / 2) / area);
+				}
+			}
+		}
+	}
+
+	// A camera-like image: smooth gradients with noise, alpha is garbage
+	// the packing has to drop. rowStride may exceed width * 4.
+	std::vector<uint8_t> MakeImage(
+		int width,
+		int height,
+		int rowStride,
+		std::mt19937& rng)
+	{
+		std::vector<uint8_t> image((size_t)rowStride * height);
+		std::uniform_int_distribution<int> noise(-12, 12);
+		std::uniform_int_distribution<int> byte(0, 255);
+		for (int row = 0; row < height; row++)
+		{
+			for (int i = 0; i < rowStride; i++)
+			{
+				const int col = i / 4;
+				int v = byte(rng);
+				switch (i % 4)
+				{
+				case 0:
+					v = (col * 255 / (width + 1) + noise(rng)) & 0xFF;
+					break;
+				case 1:
+					v = (row * 255 / (height + 1) + noise(rng)) & 0xFF;
+					break;
+				case 2:
+					v = ((col + row) & 0xFF) ^ (noise(rng) & 0x3);
+					break;
+				}
+				image[(size_t)row * rowStride + i] = (uint8_t)v;
+			}
+		}
+		return image;
+	}
+
+	bool IsSupported(KernelPath path)
+	{
+		SetKernelPath(path);
+		return ActiveKernelPath() == path;
+	}
+
+	bool Compare(
+		const char* what,
+		KernelPath path,
+		int width,
+		int height,
+		int factor,
+		const std::vector<uint8_t>& expected,
+		const std::vector<uint8_t>& actual)
+	{
+		for (size_t i = 0; i < expected.size(); i++)
+		{
+			if (expected[i] != actual[i])
+			{
+				printf("MISMATCH %s %ls %dx%d factor %d: byte %zu is %u, expected %u\n",
+					what, KernelPathName(path), width, height, factor, i, actual[i], expected[i]);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Checks every path and factor on one image. The original loop only
+	// handles tightly packed rows, padded ones are checked against the box
+	// filter alone.
+	bool CheckImage(
+		int width,
+		int height,
+		int padding,
+		std::mt19937& rng)
+	{
+		const int rowStride = (width + padding) * 4;
+		const std::vector<uint8_t> image = MakeImage(width, height, rowStride, rng);
+
+		bool ok = true;
+		for (int factor : kFactors)
+		{
+			const size_t size = (size_t)(width / factor) * (height / factor) * 3;
+			std::vector<uint8_t> expected(size);
+			ReferenceBoxFilter(image.data(), width, height, rowStride, factor, expected.data());
+			if (factor == 1 && padding == 0)
+			{
+				std::vector<uint8_t> original(size);
+				ReferencePack(image.data(), width, height, factor, original.data());
+				ok &= Compare("box filter", KernelPath::Scalar, width, height, factor, original, expected);
+			}
+
+			for (KernelPath path : kPaths)
+			{
+				if (!IsSupported(path))
+				{
+					continue;
+				}
+
+				// the + 1 keeps the output off alignment
+				std::vector<uint8_t> out(size + 1);
+				DownscaleBgraToBgr(image.data(), width, height, rowStride, factor, out.data() + 1);
+				ok &= Compare("downscale", path, width, height, factor, expected,
+					std::vector<uint8_t>(out.begin() + 1, out.end()));
+
+				if (factor == 1)
+				{
+					PackBgraToBgr(image.data(), width, height, rowStride, out.data() + 1);
+					ok &= Compare("pack", path, width, height, factor, expected,
+						std::vector<uint8_t>(out.begin() + 1, out.end()));
+				}
+			}
+		}
+		return ok;
+	}
+
+	template <typename F>
+	double MillisecondsPerCall(
+		int iterations,
+		F f)
+	{
+		const auto start = Clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			f();
+		}
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+	}
+
+	void Time(
+		Size size,
+		int iterations,
+		std::mt19937& rng)
+	{
+		const std::vector<uint8_t> image = MakeImage(size.width, size.height, size.width * 4, rng);
+		std::vector<uint8_t> out((size_t)size.width * size.height * 3);
+		volatile uint8_t sink = 0;
+
+		for (int factor : kFactors)
+		{
+			printf("%4dx%-4d factor %d  %-8s %7.3f ms\n", size.width, size.height, factor, "original",
+				MillisecondsPerCall(iterations, [&]()
+				{
+					ReferencePack(image.data(), size.width, size.height, factor, out.data());
+					sink = sink + out[0];
+				}));
+
+			for (KernelPath path : kPaths)
+			{
+				if (!IsSupported(path))
+				{
+					continue;
+				}
+				printf("%4dx%-4d factor %d  %-8ls %7.3f ms\n", size.width, size.height, factor, KernelPathName(path),
+					MillisecondsPerCall(iterations, [&]()
+					{
+						DownscaleBgraToBgr(image.data(), size.width, size.height, size.width * 4, factor, out.data());
+						sink = sink + out[0];
+					}));
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int iterations = 50;
+	if (argc > 1) iterations = atoi(argv[1]);
+
+	std::mt19937 rng(3);
+	const KernelPath detected = DetectKernelPath();
+	printf("detected path: %ls\n", KernelPathName(detected));
+	for (KernelPath path : kPaths)
+	{
+		if (!IsSupported(path))
+		{
+			printf("%ls: not supported by this build, not checked\n", KernelPathName(path));
+		}
+	}
+
+	bool ok = true;
+	for (Size size : kPvSizes)
+	{
+		ok &= CheckImage(size.width, size.height, 0, rng);
+		ok &= CheckImage(size.width, size.height, 16, rng);
+	}
+	// every tail length of the vector loops, at each factor
+	for (int width = 1; width <= 70; width++)
+	{
+		ok &= CheckImage(width, 8, 0, rng);
+		ok &= CheckImage(width, 9, 3, rng);
+	}
+	printf("byte-exact: %s\n", ok ? "yes" : "NO");
+
+	for (Size size : kPvSizes)
+	{
+		Time(size, iterations, rng);
+	}
+
+	SetKernelPath(detected);
+	return ok ? 0 : 1;
+}
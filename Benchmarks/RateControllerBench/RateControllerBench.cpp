@@ -0,0 +1,344 @@
+// Streams PV, Long Throw and the two front cameras over a simulated link
+// whose rate drops to weak Wi-Fi and recovers, with and without
+// RateController.
+//
+// Every sensor delivers raw frames at its rate. As on the device, the newest
+// frame waits in a latest-frame slot until the stream has a credit (window
+// of 3) and, with the controller, until Admit lets it through. Every stream
+// writes to its own TCP connection; the connections share the link equally
+// among those with data queued, like TCP flows do. A frame's credit comes
+// back shortly after its last byte arrived. Its queueing delay is the time
+// from capture until its first byte goes out, its latency the time from
+// capture to arrival.
+//
+// Exits with 1 if, with the controller, in any phase
+// - a stream's 95th percentile queueing delay is above the latency bound,
+// - a stream gets less than RateController::kMinRate frames per second,
+// - a stream other than the heaviest gets less than kFairShare of the frame
+//   rate it gets without the controller, where the link is shared equally,
+// - or the streams together use less than kMinLinkUse of the link.
+//
+//   RateControllerBench [seconds per phase] [good MB/s] [weak MB/s] [latency bound ms]
+
+#include "RateController.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+namespace
+{
+	using Clock = RateController::Clock;
+
+	constexpr double kStep = 0.001;
+	constexpr int kWindow = 3;
+	// from the last byte to the credit back at the sender
+	constexpr double kCreditDelay = 0.003;
+	// frames taken at the start of each phase are not measured
+	constexpr double kSettleSeconds = 5.0;
+	// the controller turns frames away that would wait too long, which costs
+	// the streams a little of their rate
+	constexpr double kFairShare = 0.95;
+	constexpr double kMinLinkUse = 0.9;
+
+	struct SensorSpec
+	{
+		const char* name;
+		size_t streamId;
+		double fps;
+		double frameBytes;
+	};
+
+	// raw frames: 1280x720 BGR, depth + AB, 640x480 grayscale
+	const SensorSpec kSensors[] = {
+		{ "PV", 0, 30.0, 1280.0 * 720 * 3 },
+		{ "Long Throw", 1, 5.0, 320.0 * 288 * 4 },
+		{ "Left Front", 2, 30.0, 640.0 * 480 },
+		{ "Right Front", 3, 30.0, 640.0 * 480 },
+	};
+	constexpr size_t kSensorCount = sizeof(kSensors) / sizeof(kSensors[0]);
+	// stream ids the controller knows, like kStreamCount on the device
+	constexpr size_t kStreamSlots = 9;
+
+	struct Settings
+	{
+		double phaseSeconds = 30.0;
+		double goodRate = 40e6;
+		double weakRate = 8e6;
+		double latencyBound = RateController::kDefaultLatencyBound;
+	};
+
+	struct InFlight
+	{
+		double capture;
+		double remaining;
+		double bytes;
+		// when the first byte went out, negative before
+		double start;
+	};
+
+	struct PhaseStats
+	{
+		std::vector<double> latencies;
+		std::vector<double> queueing;
+		double bytes = 0.0;
+	};
+
+	struct PhaseResult
+	{
+		double fps = 0.0;
+		double bytesPerSecond = 0.0;
+		double queueing = 0.0;
+	};
+
+	using Results = std::vector<std::vector<PhaseResult>>;
+
+	struct Sensor
+	{
+		SensorSpec spec;
+		double nextCapture = 0.0;
+		bool pending = false;
+		double pendingCapture = 0.0;
+		int credits = kWindow;
+		std::deque<double> creditReturns;
+		std::deque<InFlight> queue;
+		PhaseStats phases[3];
+	};
+
+	double Percentile(std::vector<double> values, double share)
+	{
+		if (values.empty())
+		{
+			return 0.0;
+		}
+		std::sort(values.begin(), values.end());
+		return values[(size_t)(share * (values.size() - 1))];
+	}
+
+	Clock::time_point SimTime(double seconds)
+	{
+		return Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds)));
+	}
+
+	// results per sensor and phase
+	Results Run(const Settings& settings, bool controlled)
+	{
+		RateController controller(kStreamSlots, settings.latencyBound);
+		std::vector<Sensor> sensors;
+		for (size_t i = 0; i < kSensorCount; i++)
+		{
+			Sensor sensor;
+			sensor.spec = kSensors[i];
+			// the sensors are not in phase
+			sensor.nextCapture = 0.007 * i;
+			sensors.push_back(sensor);
+			controller.AddStream(kSensors[i].streamId);
+		}
+
+		const double end = 3 * settings.phaseSeconds;
+		std::vector<Sensor*> active;
+		for (double now = 0.0; now < end; now += kStep)
+		{
+			const int phase = (int)(now / settings.phaseSeconds);
+			const double linkRate = phase == 1 ? settings.weakRate : settings.goodRate;
+
+			for (Sensor& sensor : sensors)
+			{
+				while (!sensor.creditReturns.empty() && sensor.creditReturns.front() <= now)
+				{
+					sensor.creditReturns.pop_front();
+					sensor.credits++;
+				}
+				if (now >= sensor.nextCapture)
+				{
+					// replaces a frame still waiting for a credit
+					sensor.pending = true;
+					sensor.pendingCapture = sensor.nextCapture;
+					sensor.nextCapture += 1.0 / sensor.spec.fps;
+				}
+				if (sensor.pending && sensor.credits > 0)
+				{
+					sensor.pending = false;
+					const uint64_t ticks = (uint64_t)(sensor.pendingCapture * 1e7);
+					if (!controlled || controller.Admit(sensor.spec.streamId, ticks, SimTime(now)))
+					{
+						sensor.credits--;
+						if (controlled)
+						{
+							controller.ReportQueued(sensor.spec.streamId, (size_t)sensor.spec.frameBytes, SimTime(now));
+						}
+						sensor.queue.push_back({ sensor.pendingCapture, sensor.spec.frameBytes, sensor.spec.frameBytes, -1.0 });
+					}
+				}
+			}
+
+			// the flows with data queued share the link equally, a flow
+			// that needs less leaves the rest to the others
+			active.clear();
+			for (Sensor& sensor : sensors)
+			{
+				if (!sensor.queue.empty())
+				{
+					active.push_back(&sensor);
+				}
+			}
+			double budget = linkRate * kStep;
+			while (!active.empty() && budget > 1e-9)
+			{
+				const double share = budget / active.size();
+				for (auto it = active.begin(); it != active.end();)
+				{
+					Sensor& sensor = **it;
+					double take = share;
+					while (take > 1e-9 && !sensor.queue.empty())
+					{
+						InFlight& frame = sensor.queue.front();
+						if (frame.start < 0.0)
+						{
+							frame.start = now;
+						}
+						const double sent = (std::min)(take, frame.remaining);
+						frame.remaining -= sent;
+						take -= sent;
+						budget -= sent;
+						if (frame.remaining <= 1e-9)
+						{
+							const double arrival = now + kStep;
+							if (controlled)
+							{
+								// the write completes once the last byte left
+								controller.ReportSent(sensor.spec.streamId, (size_t)frame.bytes, SimTime(arrival));
+							}
+							// a frame counts in the phase it was taken in
+							const int framePhase = (int)(frame.capture / settings.phaseSeconds);
+							if (frame.capture - framePhase * settings.phaseSeconds >= kSettleSeconds)
+							{
+								PhaseStats& stats = sensor.phases[framePhase];
+								stats.latencies.push_back(arrival - frame.capture);
+								stats.queueing.push_back(frame.start - frame.capture);
+								stats.bytes += frame.bytes;
+							}
+							sensor.creditReturns.push_back(arrival + kCreditDelay);
+							sensor.queue.pop_front();
+						}
+					}
+					if (sensor.queue.empty())
+					{
+						it = active.erase(it);
+					}
+					else
+					{
+						++it;
+					}
+				}
+			}
+		}
+
+		const char* phaseNames[3] = { "good", "weak", "good again" };
+		const double measuredSeconds = settings.phaseSeconds - kSettleSeconds;
+		Results results(sensors.size(), std::vector<PhaseResult>(3));
+		printf("%s\n", controlled ? "with RateController" : "without rate control");
+		printf("  %-12s %-11s %8s %10s %12s %12s %14s\n", "stream", "link", "fps", "MB/s", "p50 ms", "p95 ms",
+			"queue p95 ms");
+		for (int phase = 0; phase < 3; phase++)
+		{
+			for (size_t i = 0; i < sensors.size(); i++)
+			{
+				const Sensor& sensor = sensors[i];
+				const PhaseStats& stats = sensor.phases[phase];
+				PhaseResult& result = results[i][phase];
+				result.fps = stats.latencies.size() / measuredSeconds;
+				result.bytesPerSecond = stats.bytes / measuredSeconds;
+				result.queueing = Percentile(stats.queueing, 0.95);
+				printf("  %-12s %-11s %8.1f %10.2f %12.0f %12.0f %14.0f\n", sensor.spec.name, phaseNames[phase],
+					result.fps, result.bytesPerSecond / 1e6, 1000.0 * Percentile(stats.latencies, 0.5),
+					1000.0 * Percentile(stats.latencies, 0.95), 1000.0 * result.queueing);
+			}
+		}
+		if (controlled)
+		{
+			printf("  capacity estimate at the end %.1f MB/s\n", controller.Capacity() / 1e6);
+		}
+		return results;
+	}
+
+	// prints every goal the controlled run missed
+	bool Check(
+		const Settings& settings,
+		const Results& uncontrolled,
+		const Results& controlled)
+	{
+		const char* phaseNames[3] = { "good", "weak", "good again" };
+		size_t heaviest = 0;
+		for (size_t i = 1; i < kSensorCount; i++)
+		{
+			if (kSensors[i].fps * kSensors[i].frameBytes > kSensors[heaviest].fps * kSensors[heaviest].frameBytes)
+			{
+				heaviest = i;
+			}
+		}
+
+		bool ok = true;
+		for (int phase = 0; phase < 3; phase++)
+		{
+			double used = 0.0;
+			for (size_t i = 0; i < kSensorCount; i++)
+			{
+				const PhaseResult& result = controlled[i][phase];
+				const char* name = kSensors[i].name;
+				used += result.bytesPerSecond;
+				if (result.queueing > settings.latencyBound)
+				{
+					printf("FAIL: %s on the %s link queued for %.0f ms\n", name, phaseNames[phase], 1000.0 * result.queueing);
+					ok = false;
+				}
+				if (result.fps < RateController::kMinRate)
+				{
+					printf("FAIL: %s on the %s link got %.1f fps\n", name, phaseNames[phase], result.fps);
+					ok = false;
+				}
+				if (i != heaviest && result.fps < kFairShare * uncontrolled[i][phase].fps)
+				{
+					printf("FAIL: %s on the %s link got %.1f fps, %.1f without the controller\n", name, phaseNames[phase],
+						result.fps, uncontrolled[i][phase].fps);
+					ok = false;
+				}
+			}
+			const double linkRate = phase == 1 ? settings.weakRate : settings.goodRate;
+			if (used < kMinLinkUse * linkRate)
+			{
+				printf("FAIL: the streams used %.1f of %.1f MB/s on the %s link\n", used / 1e6, linkRate / 1e6,
+					phaseNames[phase]);
+				ok = false;
+			}
+		}
+		return ok;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Settings settings;
+	if (argc > 1) settings.phaseSeconds = atof(argv[1]);
+	if (argc > 2) settings.goodRate = atof(argv[2]) * 1e6;
+	if (argc > 3) settings.weakRate = atof(argv[3]) * 1e6;
+	if (argc > 4) settings.latencyBound = atof(argv[4]) / 1000.0;
+	settings.phaseSeconds = (std::max)(settings.phaseSeconds, 2.0 * kSettleSeconds);
+
+	printf("link %.0f MB/s, %.0f MB/s, %.0f MB/s for %.0f s each, latency bound %.0f ms\n\n",
+		settings.goodRate / 1e6, settings.weakRate / 1e6, settings.goodRate / 1e6, settings.phaseSeconds,
+		1000.0 * settings.latencyBound);
+
+	const Results uncontrolled = Run(settings, false);
+	printf("\n");
+	const Results controlled = Run(settings, true);
+	printf("\n");
+	const bool ok = Check(settings, uncontrolled, controlled);
+	if (ok)
+	{
+		printf("every stream met the latency bound and its fair share, the link was used\n");
+	}
+	return ok ? 0 : 1;
+}
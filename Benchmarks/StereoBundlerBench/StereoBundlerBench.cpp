@@ -0,0 +1,214 @@
+// Pairs simulated LF and RF frames with a StereoBundler the way
+// StereoFrameProcessor does on the device, and checks the pairs.
+//
+// Both cameras expose together at 30 fps; their timestamps differ by a few
+// microseconds. Every frame reaches its camera thread after a random
+// delivery delay and is lost with the given probability. As on the device,
+// each camera thread publishes into a latest-frame slot and wakes the
+// processing thread, which offers both slots to the bundler and, for every
+// pair, is busy sending for the given time (no credits). Frames published
+// while it is busy replace the previous one.
+//
+// Exits with 1 if a pair combines different exposures or is further apart
+// than the bundler allows, or if, with no send time, an exposure both
+// cameras delivered is not paired.
+//
+//   StereoBundlerBench [seconds] [loss %] [delivery jitter ms] [send ms]
+
+#include "StereoBundler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr uint64_t kTicksPerMs = 10000;
+	// 30 fps
+	constexpr uint64_t kFrameInterval = 333333;
+	// timestamps of one exposure differ by up to this
+	constexpr uint64_t kTimestampJitter = 200;
+	constexpr uint64_t kMinDeliveryDelay = 2 * kTicksPerMs;
+
+	struct Settings
+	{
+		double seconds = 600.0;
+		double lossPercent = 0.0;
+		double jitterMs = 8.0;
+		double sendMs = 0.0;
+	};
+
+	struct Frame
+	{
+		int64_t exposure = -1;
+	};
+
+	using Bundler = StereoBundler<Frame>;
+
+	enum class EventType
+	{
+		// a camera thread publishes a frame
+		Deliver,
+		// the processing thread is done sending
+		Idle,
+	};
+
+	struct Event
+	{
+		uint64_t time;
+		EventType type;
+		Bundler::Side side;
+		Frame frame;
+		uint64_t ticks;
+
+		bool operator>(const Event& other) const
+		{
+			return time > other.time;
+		}
+	};
+
+	struct Slot
+	{
+		bool full = false;
+		Frame frame;
+		uint64_t ticks = 0;
+	};
+}
+
+int main(int argc, char** argv)
+{
+	Settings settings;
+	if (argc > 1) settings.seconds = atof(argv[1]);
+	if (argc > 2) settings.lossPercent = atof(argv[2]);
+	if (argc > 3) settings.jitterMs = atof(argv[3]);
+	if (argc > 4) settings.sendMs = atof(argv[4]);
+
+	std::mt19937_64 random(42);
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+	const int64_t exposures = (int64_t)(settings.seconds * 1e7 / kFrameInterval);
+	const uint64_t jitter = (uint64_t)(settings.jitterMs * kTicksPerMs);
+	const uint64_t sendTime = (uint64_t)(settings.sendMs * kTicksPerMs);
+
+	std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+	int64_t deliveredBoth = 0;
+	for (int64_t i = 0; i < exposures; i++)
+	{
+		const uint64_t exposureTime = (uint64_t)(i + 1) * kFrameInterval;
+		bool delivered[2] = {};
+		for (int side = 0; side < 2; side++)
+		{
+			if (unit(random) * 100.0 < settings.lossPercent)
+			{
+				continue;
+			}
+			delivered[side] = true;
+
+			Event event;
+			event.type = EventType::Deliver;
+			event.side = side == 0 ? Bundler::Side::Left : Bundler::Side::Right;
+			event.frame.exposure = i;
+			event.ticks = exposureTime + (uint64_t)(unit(random) * kTimestampJitter);
+			event.time = exposureTime + kMinDeliveryDelay + (uint64_t)(unit(random) * jitter);
+			events.push(event);
+		}
+		if (delivered[0] && delivered[1])
+		{
+			deliveredBoth++;
+		}
+	}
+
+	Bundler bundler;
+	Slot slots[2];
+	uint64_t busyUntil = 0;
+	int64_t replaced = 0;
+	int64_t mismatched = 0;
+	uint64_t maxSkew = 0;
+	int64_t wakeUps = 0;
+	Clock::duration bundlerTime = Clock::duration::zero();
+
+	while (!events.empty())
+	{
+		const Event event = events.top();
+		events.pop();
+
+		if (event.type == EventType::Deliver)
+		{
+			Slot& slot = slots[event.side == Bundler::Side::Left ? 0 : 1];
+			if (slot.full)
+			{
+				replaced++;
+			}
+			slot = { true, event.frame, event.ticks };
+		}
+		if (event.time < busyUntil)
+		{
+			continue;
+		}
+
+		// the processing thread wakes up
+		const Clock::time_point start = Clock::now();
+		Bundler::Pair pair;
+		for (int side = 0; side < 2; side++)
+		{
+			if (slots[side].full)
+			{
+				bundler.Offer(side == 0 ? Bundler::Side::Left : Bundler::Side::Right, slots[side].frame, slots[side].ticks);
+				slots[side].full = false;
+			}
+		}
+		const bool paired = bundler.TakePair(pair);
+		bundlerTime += Clock::now() - start;
+		wakeUps++;
+
+		if (!paired)
+		{
+			continue;
+		}
+
+		const uint64_t skew = pair.leftTicks > pair.rightTicks ?
+			pair.leftTicks - pair.rightTicks : pair.rightTicks - pair.leftTicks;
+		maxSkew = skew > maxSkew ? skew : maxSkew;
+		if (pair.left.exposure != pair.right.exposure || skew > Bundler::kDefaultMaxSkew)
+		{
+			mismatched++;
+		}
+
+		if (sendTime > 0)
+		{
+			busyUntil = event.time + sendTime;
+			Event idle = {};
+			idle.time = busyUntil;
+			idle.type = EventType::Idle;
+			events.push(idle);
+		}
+	}
+
+	const double pairedShare = deliveredBoth > 0 ? (double)bundler.Paired() / deliveredBoth : 1.0;
+	printf("exposures %lld, both delivered %lld, paired %llu (%.2f%%)\n",
+		(long long)exposures, (long long)deliveredBoth, (unsigned long long)bundler.Paired(), 100.0 * pairedShare);
+	printf("dropped by the bundler %llu, replaced in the slots %lld\n",
+		(unsigned long long)bundler.Dropped(), (long long)replaced);
+	printf("max skew %.1f us, mismatched pairs %lld\n", maxSkew / 10.0, (long long)mismatched);
+	printf("%.1f ns per wake-up of the processing thread\n",
+		wakeUps > 0 ? std::chrono::duration<double, std::nano>(bundlerTime).count() / wakeUps : 0.0);
+	printf("per pair: 1 frame header and 1 credit request instead of 2 each\n");
+
+	bool ok = mismatched == 0;
+	if (sendTime == 0 && (int64_t)bundler.Paired() != deliveredBoth)
+	{
+		printf("FAIL: exposures delivered by both cameras were not paired\n");
+		ok = false;
+	}
+	if (mismatched > 0)
+	{
+		printf("FAIL: pairs of different exposures or beyond the allowed skew\n");
+	}
+	return ok ? 0 : 1;
+}
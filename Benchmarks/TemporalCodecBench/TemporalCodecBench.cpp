@@ -0,0 +1,276 @@
+// Compression ratio and speed of the temporal codec (TemporalCodec) on frame
+// sequences, XOR deltas and previous-frame LZ4 dictionaries, against LZ4 on
+// every frame on its own.
+//
+// Every sequence is decoded again and checked frame by frame. A second pass
+// drops every 10th encoded frame on the way to the decoder, which has to
+// reject the following deltas and recover with the keyframe it asks for.
+//
+// Without arguments synthetic VLC and AHAT sequences are used. Recorded raw
+// payloads (in order) can be added:
+//
+//   TemporalCodecBench [payload bytes file...]
+
+#include "FramePacking.h"
+#include "TemporalCodec.h"
+#include "lz4.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr uint16_t kAhatInvalid = 4090;
+	constexpr int kFrames = 60;
+
+	struct Sequence
+	{
+		std::string name;
+		std::vector<std::vector<uint8_t>> frames;
+	};
+
+	// A textured scene seen by a VLC camera, panned by panPixels per frame,
+	// with sensor noise of the given standard deviation (in DN).
+	Sequence MakeVlcSequence(const char* name, double panPixels, double noise)
+	{
+		const int width = 640;
+		const int height = 480;
+		std::mt19937 rng(7);
+		std::normal_distribution<double> gauss(0.0, noise);
+
+		Sequence sequence{ name, {} };
+		for (int f = 0; f < kFrames; f++)
+		{
+			std::vector<uint8_t> frame((size_t)width * height);
+			const double offset = f * panPixels;
+			for (int y = 0; y < height; y++)
+			{
+				for (int x = 0; x < width; x++)
+				{
+					const double u = x + offset;
+					double value = 60.0 + 0.1 * y +
+						40.0 * std::sin(u * 0.05) * std::cos(y * 0.03) +
+						((((int)u / 40) + (y / 40)) % 2 ? 30.0 : 0.0);
+					if (noise > 0)
+					{
+						value += gauss(rng);
+					}
+					frame[(size_t)y * width + x] = (uint8_t)std::fmin(255.0, std::fmax(0.0, std::round(value)));
+				}
+			}
+			sequence.frames.push_back(std::move(frame));
+		}
+		return sequence;
+	}
+
+	// Static room seen by the AHAT camera, depth + AB payload as on the wire.
+	Sequence MakeAhatSequence(const char* name, double noise)
+	{
+		const int size = 512;
+		const size_t count = (size_t)size * size;
+		std::mt19937 rng(11);
+		std::normal_distribution<double> gauss(0.0, noise);
+
+		Sequence sequence{ name, {} };
+		std::vector<uint16_t> depth(count);
+		std::vector<uint16_t> ab(count);
+		for (int f = 0; f < kFrames; f++)
+		{
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					const double u = (double)x / size - 0.5;
+					const double v = (double)y / size - 0.5;
+					const size_t i = (size_t)y * size + x;
+					const bool valid = (u * u + v * v) <= 0.22;
+					const double d = v > 0.15 ? 90.0 / v : 800.0 - 300.0 * u;
+					const double n = noise > 0 ? gauss(rng) : 0.0;
+					depth[i] = valid ? (uint16_t)std::fmax(1.0, d + n) : kAhatInvalid;
+					ab[i] = (uint16_t)std::fmax(0.0, 300.0 * (1.0 - std::sqrt(u * u + v * v)) + 2.0 * n);
+				}
+			}
+			std::vector<uint8_t> frame(4 * count);
+			FramePacking::PackAhatDepthAb(depth.data(), ab.data(), count, kAhatInvalid, frame.data());
+			sequence.frames.push_back(std::move(frame));
+		}
+		return sequence;
+	}
+
+	bool LoadRecordedSequence(size_t payloadBytes, int fileCount, char** files, Sequence& sequence)
+	{
+		sequence.name = "recorded, " + std::to_string(fileCount) + " frames";
+		for (int i = 0; i < fileCount; i++)
+		{
+			FILE* file = fopen(files[i], "rb");
+			if (!file)
+			{
+				return false;
+			}
+			std::vector<uint8_t> frame(payloadBytes);
+			const size_t read = fread(frame.data(), 1, frame.size(), file);
+			fclose(file);
+			if (read != frame.size())
+			{
+				return false;
+			}
+			sequence.frames.push_back(std::move(frame));
+		}
+		return !sequence.frames.empty();
+	}
+
+	void RunIntraLz4(const Sequence& sequence)
+	{
+		size_t rawBytes = 0;
+		size_t encodedBytes = 0;
+		double seconds = 0;
+		std::vector<uint8_t> out;
+		for (const std::vector<uint8_t>& frame : sequence.frames)
+		{
+			out.resize(LZ4_compressBound((int)frame.size()));
+			const auto start = Clock::now();
+			const int size = LZ4_compress_default((const char*)frame.data(), (char*)out.data(), (int)frame.size(), (int)out.size());
+			seconds += std::chrono::duration<double>(Clock::now() - start).count();
+			rawBytes += frame.size();
+			encodedBytes += size > 0 ? size : frame.size();
+		}
+		printf("  %-22s %8.2f %12.1f\n", "LZ4 per frame", (double)rawBytes / encodedBytes, rawBytes / seconds / 1e6);
+	}
+
+	void RunTemporal(const Sequence& sequence, TemporalCodec::Method method, uint32_t keyframeInterval, int acceleration)
+	{
+		TemporalCodec::Encoder encoder(keyframeInterval, acceleration, method);
+		TemporalCodec::Decoder decoder;
+
+		size_t rawBytes = 0;
+		size_t encodedBytes = 0;
+		double encodeSeconds = 0;
+		double decodeSeconds = 0;
+		bool ok = true;
+
+		std::vector<uint8_t> encoded;
+		std::vector<uint8_t> decoded;
+		for (const std::vector<uint8_t>& frame : sequence.frames)
+		{
+			encoded.resize(TemporalCodec::MaxEncodedSize(frame.size()));
+			decoded.assign(frame.size(), 0);
+
+			auto start = Clock::now();
+			const size_t size = encoder.Encode(frame.data(), frame.size(), encoded.data(), encoded.size());
+			encodeSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+			start = Clock::now();
+			ok = decoder.Decode(encoded.data(), size, decoded.data(), decoded.size()) && ok;
+			decodeSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+			ok = ok && size != 0 && decoded == frame;
+			rawBytes += frame.size();
+			encodedBytes += size;
+		}
+
+		const std::string name = std::string(method == TemporalCodec::Method::XorDelta ? "xor" : "dict") +
+			", key/" + std::to_string(keyframeInterval) + ", acc " + std::to_string(acceleration);
+		printf("  %-22s %8.2f %12.1f %12.1f%s\n",
+			name.c_str(),
+			(double)rawBytes / encodedBytes,
+			rawBytes / encodeSeconds / 1e6,
+			rawBytes / decodeSeconds / 1e6,
+			ok ? "" : "  ROUND TRIP FAILED");
+	}
+
+	// Drops every 10th frame between encoder and decoder. Returns the number
+	// of frames lost while waiting for a keyframe, -1 on a wrong frame.
+	int RunWithDrops(const Sequence& sequence, TemporalCodec::Method method)
+	{
+		TemporalCodec::Encoder encoder(1000, 1, method);
+		TemporalCodec::Decoder decoder;
+
+		int lost = 0;
+		std::vector<uint8_t> encoded;
+		std::vector<uint8_t> decoded;
+		for (size_t i = 0; i < sequence.frames.size(); i++)
+		{
+			const std::vector<uint8_t>& frame = sequence.frames[i];
+			encoded.resize(TemporalCodec::MaxEncodedSize(frame.size()));
+			decoded.assign(frame.size(), 0);
+			const size_t size = encoder.Encode(frame.data(), frame.size(), encoded.data(), encoded.size());
+			if (i % 10 == 5)
+			{
+				continue;
+			}
+
+			if (!decoder.Decode(encoded.data(), size, decoded.data(), decoded.size()))
+			{
+				// what the receiver does
+				encoder.RequestKeyframe();
+				lost++;
+			}
+			else if (decoded != frame)
+			{
+				return -1;
+			}
+		}
+		return lost;
+	}
+
+	void Run(const Sequence& sequence)
+	{
+		printf("\n%s (%zu frames of %zu bytes)\n", sequence.name.c_str(), sequence.frames.size(),
+			sequence.frames.empty() ? (size_t)0 : sequence.frames[0].size());
+		printf("  %-22s %8s %12s %12s\n", "codec", "ratio", "enc MB/s", "dec MB/s");
+		RunIntraLz4(sequence);
+		for (TemporalCodec::Method method : { TemporalCodec::Method::XorDelta, TemporalCodec::Method::Lz4Dictionary })
+		{
+			RunTemporal(sequence, method, TemporalCodec::kDefaultKeyframeInterval, 1);
+			RunTemporal(sequence, method, TemporalCodec::kDefaultKeyframeInterval, 8);
+		}
+
+		for (TemporalCodec::Method method : { TemporalCodec::Method::XorDelta, TemporalCodec::Method::Lz4Dictionary })
+		{
+			const int lost = RunWithDrops(sequence, method);
+			const char* name = method == TemporalCodec::Method::XorDelta ? "xor" : "dict";
+			if (lost < 0)
+			{
+				printf("  %s with drops: WRONG FRAME DECODED\n", name);
+			}
+			else
+			{
+				printf("  %s with drops: %d undecodable frames waiting for a keyframe\n", name, lost);
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<Sequence> sequences;
+	sequences.push_back(MakeVlcSequence("VLC 640x480, static", 0.0, 0.0));
+	sequences.push_back(MakeVlcSequence("VLC 640x480, static, sensor noise", 0.0, 0.7));
+	sequences.push_back(MakeVlcSequence("VLC 640x480, panning 2 px/frame", 2.0, 0.0));
+	sequences.push_back(MakeAhatSequence("AHAT depth + AB, static", 0.0));
+	sequences.push_back(MakeAhatSequence("AHAT depth + AB, static, noise", 1.5));
+
+	if (argc > 2)
+	{
+		Sequence recorded;
+		if (!LoadRecordedSequence((size_t)atoll(argv[1]), argc - 2, argv + 2, recorded))
+		{
+			fprintf(stderr, "could not read the recorded frames\n");
+			return 1;
+		}
+		sequences.push_back(recorded);
+	}
+
+	for (const Sequence& sequence : sequences)
+	{
+		Run(sequence);
+	}
+	return 0;
+}
@@ -0,0 +1,149 @@
+// Speed of tiled QOI (TiledQoi) on PV frames against a single qoi_encode,
+// for several band and thread counts. Every encoded frame is decoded again
+// (with the same pool) and compared with the input.
+//
+// A synthetic BGRA camera image is downscaled to BGR like
+// VideoCameraStreamer does.
+//
+//   TiledQoiBench [iterations]
+
+#include "FramePacking.h"
+#include "TiledQoi.h"
+#include "WorkerPool.h"
+#include "qoi.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr int kWidth = 1920;
+	constexpr int kHeight = 1080;
+
+	// gradients, edges and some sensor noise
+	std::vector<uint8_t> MakeBgraImage()
+	{
+		std::mt19937 rng(5);
+		std::normal_distribution<double> gauss(0.0, 1.2);
+		std::vector<uint8_t> image((size_t)kWidth * kHeight * 4);
+		for (int y = 0; y < kHeight; y++)
+		{
+			for (int x = 0; x < kWidth; x++)
+			{
+				const double shade = 90.0 + 50.0 * std::sin(x * 0.004) * std::cos(y * 0.006) +
+					(((x / 120) + (y / 90)) % 3 == 0 ? 40.0 : 0.0);
+				uint8_t* pixel = &image[((size_t)y * kWidth + x) * 4];
+				for (int c = 0; c < 3; c++)
+				{
+					const double value = shade * (0.8 + 0.15 * c) + gauss(rng);
+					pixel[c] = (uint8_t)std::fmin(255.0, std::fmax(0.0, std::round(value)));
+				}
+				pixel[3] = 255;
+			}
+		}
+		return image;
+	}
+
+	void RunSingle(const std::vector<uint8_t>& image, int width, int height, int iterations)
+	{
+		qoi_desc desc = { (unsigned int)width, (unsigned int)height, 3, QOI_SRGB };
+		int size = 0;
+		double encodeSeconds = 0;
+		double decodeSeconds = 0;
+		bool ok = true;
+		for (int i = 0; i < iterations; i++)
+		{
+			auto start = Clock::now();
+			void* encoded = qoi_encode(image.data(), &desc, &size);
+			encodeSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+			qoi_desc decodedDesc;
+			start = Clock::now();
+			void* decoded = qoi_decode(encoded, size, &decodedDesc, 3);
+			decodeSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+			ok = ok && decoded && memcmp(decoded, image.data(), image.size()) == 0;
+			free(encoded);
+			free(decoded);
+		}
+
+		const double bytes = (double)image.size() * iterations;
+		printf("  %-22s %8.2f %12.1f %12.1f%s\n", "qoi_encode", (double)image.size() / size,
+			bytes / encodeSeconds / 1e6, bytes / decodeSeconds / 1e6, ok ? "" : "  ROUND TRIP FAILED");
+	}
+
+	void RunTiled(const std::vector<uint8_t>& image, int width, int height, uint32_t bandCount,
+		WorkerPool* pool, int iterations)
+	{
+		std::vector<uint8_t> encoded(TiledQoi::MaxEncodedSize(width, height, 3, bandCount));
+		std::vector<uint8_t> decoded(image.size());
+		size_t size = 0;
+		double encodeSeconds = 0;
+		double decodeSeconds = 0;
+		bool ok = true;
+		for (int i = 0; i < iterations; i++)
+		{
+			auto start = Clock::now();
+			size = TiledQoi::Encode(image.data(), width, height, 3, bandCount, pool, encoded.data(), encoded.size());
+			encodeSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+			std::fill(decoded.begin(), decoded.end(), (uint8_t)0);
+			start = Clock::now();
+			ok = TiledQoi::Decode(encoded.data(), size, pool, decoded.data(), decoded.size()) && ok;
+			decodeSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+			ok = ok && size != 0 && decoded == image;
+		}
+
+		const std::string name = std::to_string(bandCount) + " bands, " +
+			std::to_string(pool ? pool->ThreadCount() + 1 : 1) + " threads";
+		const double bytes = (double)image.size() * iterations;
+		printf("  %-22s %8.2f %12.1f %12.1f%s\n", name.c_str(), (double)image.size() / size,
+			bytes / encodeSeconds / 1e6, bytes / decodeSeconds / 1e6, ok ? "" : "  ROUND TRIP FAILED");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int iterations = argc > 1 ? atoi(argv[1]) : 10;
+	const std::vector<uint8_t> bgra = MakeBgraImage();
+
+	std::vector<std::unique_ptr<WorkerPool>> pools;
+	for (size_t threads : { (size_t)1, (size_t)3, WorkerPool::DefaultThreadCount() })
+	{
+		if (threads > 0 && (pools.empty() || pools.back()->ThreadCount() < threads))
+		{
+			pools.push_back(std::make_unique<WorkerPool>(threads));
+		}
+	}
+
+	for (int scaleFactor : { 1, 2 })
+	{
+		const int width = kWidth / scaleFactor;
+		const int height = kHeight / scaleFactor;
+		std::vector<uint8_t> bgr((size_t)width * height * 3);
+		FramePacking::DownscaleBgraToBgr(bgra.data(), kWidth, kHeight, kWidth * 4, scaleFactor, bgr.data());
+
+		printf("\nPV BGR %dx%d, %d iterations\n", width, height, iterations);
+		printf("  %-22s %8s %12s %12s\n", "codec", "ratio", "enc MB/s", "dec MB/s");
+		RunSingle(bgr, width, height, iterations);
+		RunTiled(bgr, width, height, 1, nullptr, iterations);
+		for (uint32_t bandCount : { 4u, 8u, 16u })
+		{
+			for (const std::unique_ptr<WorkerPool>& pool : pools)
+			{
+				RunTiled(bgr, width, height, bandCount, pool.get(), iterations);
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,180 @@
+#include "CodecController.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+	constexpr CodecController::Clock::rep kNever = (std::numeric_limits<CodecController::Clock::rep>::min)();
+
+	CodecController::Clock::rep Ticks(std::chrono::milliseconds duration)
+	{
+		return std::chrono::duration_cast<CodecController::Clock::duration>(duration).count();
+	}
+}
+
+CodecController::CodecController(
+	std::vector<PayloadEncoding> candidates,
+	double cpuBudget) :
+	m_cpuBudget(cpuBudget > 0.0 ? cpuBudget : kDefaultCpuBudget),
+	m_budget(m_cpuBudget * kBurstSeconds),
+	m_lastCongestion(kNever),
+	m_congestionHold(Ticks(kCongestionHold))
+{
+	m_estimates.push_back({ PayloadEncoding::Raw });
+	for (PayloadEncoding encoding : candidates)
+	{
+		if (!Find(encoding))
+		{
+			m_estimates.push_back({ encoding });
+		}
+	}
+}
+
+bool CodecController::IsCongested(Clock::time_point now) const
+{
+	const Clock::rep last = m_lastCongestion;
+	return last != kNever && now.time_since_epoch().count() - last < m_congestionHold;
+}
+
+void CodecController::ReportCongestion(Clock::time_point now)
+{
+	// concurrent reports may race, they only ever pick one of the holds
+	const Clock::rep ticks = now.time_since_epoch().count();
+	const Clock::rep last = m_lastCongestion;
+	Clock::rep hold = m_congestionHold;
+	if (last == kNever || ticks - last >= 2 * hold)
+	{
+		// the link kept up with raw frames for a while
+		hold = Ticks(kCongestionHold);
+	}
+	else if (ticks - last >= hold)
+	{
+		// raw again, and behind again right away: compress for longer
+		hold = (std::min)(2 * hold, Ticks(kMaxCongestionHold));
+	}
+	m_congestionHold = hold;
+	m_lastCongestion = ticks;
+}
+
+PayloadEncoding CodecController::Choose(Clock::time_point now)
+{
+	Refill(now);
+	m_frame++;
+
+	if (!IsCongested(now))
+	{
+		return PayloadEncoding::Raw;
+	}
+
+	// every candidate gets measured once, then the stale ones now and then
+	Estimate* pProbe = nullptr;
+	for (Estimate& estimate : m_estimates)
+	{
+		if (!estimate.measured)
+		{
+			pProbe = &estimate;
+			break;
+		}
+	}
+	if (!pProbe && m_frame % kProbeInterval == 0)
+	{
+		pProbe = &*std::min_element(m_estimates.begin(), m_estimates.end(),
+			[](const Estimate& a, const Estimate& b) { return a.lastUsed < b.lastUsed; });
+	}
+	if (pProbe && (pProbe->encoding == PayloadEncoding::Raw || ExpectedSeconds(*pProbe) <= m_budget))
+	{
+		return pProbe->encoding;
+	}
+
+	// best ratio that fits the budget; raw always does
+	const Estimate* pBest = &m_estimates.front();
+	for (const Estimate& estimate : m_estimates)
+	{
+		if (estimate.measured && estimate.ratio > pBest->ratio && Fits(estimate))
+		{
+			pBest = &estimate;
+		}
+	}
+	return pBest->encoding;
+}
+
+void CodecController::Report(
+	PayloadEncoding encoding,
+	size_t rawSize,
+	size_t payloadSize,
+	Clock::duration encodeTime,
+	Clock::time_point now)
+{
+	const double seconds = std::chrono::duration<double>(encodeTime).count();
+	m_budget -= seconds;
+	m_lastRawSize = rawSize;
+
+	if (m_frame > 1)
+	{
+		const double interval = std::chrono::duration<double>(now - m_lastReport).count();
+		if (interval > 0.0)
+		{
+			m_cpuLoad += kSmoothing * ((std::min)(1.0, seconds / interval) - m_cpuLoad);
+		}
+	}
+	m_lastReport = now;
+
+	Estimate* pEstimate = Find(encoding);
+	if (!pEstimate || rawSize == 0)
+	{
+		return;
+	}
+
+	const double secondsPerByte = seconds / rawSize;
+	const double ratio = payloadSize > 0 ? (double)rawSize / payloadSize : 1.0;
+	if (pEstimate->measured)
+	{
+		pEstimate->secondsPerByte += kSmoothing * (secondsPerByte - pEstimate->secondsPerByte);
+		pEstimate->ratio += kSmoothing * (ratio - pEstimate->ratio);
+	}
+	else
+	{
+		pEstimate->secondsPerByte = secondsPerByte;
+		pEstimate->ratio = ratio;
+		pEstimate->measured = true;
+	}
+	pEstimate->lastUsed = m_frame;
+}
+
+CodecController::Estimate* CodecController::Find(PayloadEncoding encoding)
+{
+	for (Estimate& estimate : m_estimates)
+	{
+		if (estimate.encoding == encoding)
+		{
+			return &estimate;
+		}
+	}
+	return nullptr;
+}
+
+double CodecController::ExpectedSeconds(const Estimate& estimate) const
+{
+	return estimate.secondsPerByte * m_lastRawSize;
+}
+
+bool CodecController::Fits(const Estimate& estimate) const
+{
+	// affordable now, and every frame could be encoded like this without
+	// running the budget dry
+	const double seconds = ExpectedSeconds(estimate);
+	return seconds <= m_budget && seconds <= m_cpuBudget * m_frameInterval;
+}
+
+void CodecController::Refill(Clock::time_point now)
+{
+	if (m_started && now > m_lastRefill)
+	{
+		const double elapsed = std::chrono::duration<double>(now - m_lastRefill).count();
+		m_frameInterval = m_frameInterval > 0.0 ? m_frameInterval + kSmoothing * (elapsed - m_frameInterval) : elapsed;
+		m_budget = (std::min)(m_budget + elapsed * m_cpuBudget, m_cpuBudget * kBurstSeconds);
+	}
+	m_lastRefill = now;
+	m_started = true;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "PayloadEncoding.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Picks the payload encoding of every frame of one stream at run time,
+// instead of fixing it before streaming starts.
+//
+// While the link keeps up, frames go out raw: compressing them would only
+// heat the device. Once the link falls behind (ReportCongestion) the
+// controller compresses for a hold time, which doubles whenever the link
+// falls behind again right after going back to raw. It picks the candidate
+// with the best measured ratio whose expected encode time fits the CPU
+// budget. The budget is a share of one core: every second the stream earns
+// cpuBudget seconds of encode time and every frame spends what its encoding
+// took, raw packing included. A candidate also has to be cheap enough to be
+// used for every frame at the current frame rate, so the controller settles
+// on one encoding instead of alternating between an expensive one and raw.
+// An exhausted budget falls back to raw until it refills. The budget is what
+// keeps the encoders from overheating the device; no thermal sensor is read.
+//
+// Encode time per byte and ratio are running averages per candidate, fed by
+// Report after every frame. Every kProbeInterval frames the candidate that
+// has gone unused longest is tried again so the estimates follow the scene.
+//
+// Choose and Report are called from the packing thread; ReportCongestion
+// from any thread.
+class CodecController
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// how long the link counts as congested after the last report
+	static constexpr std::chrono::milliseconds kCongestionHold{ 2000 };
+	static constexpr std::chrono::milliseconds kMaxCongestionHold{ 32000 };
+	// the budget saved up while idle, in seconds of budget
+	static constexpr double kBurstSeconds = 0.5;
+	static constexpr uint64_t kProbeInterval = 50;
+	// weight of the newest frame in the running averages
+	static constexpr double kSmoothing = 0.2;
+	static constexpr double kDefaultCpuBudget = 0.25;
+
+	// Raw is always a candidate. cpuBudget is the share of one core the
+	// stream may spend encoding (0.25 = 250 ms per second).
+	CodecController(
+		std::vector<PayloadEncoding> candidates,
+		double cpuBudget = kDefaultCpuBudget);
+
+	// Encoding of the next frame.
+	PayloadEncoding Choose(Clock::time_point now = Clock::now());
+
+	// What the encoding returned by Choose achieved. A failed encoding (sent
+	// raw in the end) is reported with payloadSize == rawSize.
+	void Report(
+		PayloadEncoding encoding,
+		size_t rawSize,
+		size_t payloadSize,
+		Clock::duration encodeTime,
+		Clock::time_point now = Clock::now());
+
+	// A frame was dropped or had to wait because the previous one was still
+	// on the wire.
+	void ReportCongestion(Clock::time_point now = Clock::now());
+
+	bool IsCongested(Clock::time_point now = Clock::now()) const;
+
+	// share of one core spent encoding, running average
+	double CpuLoad() const
+	{
+		return m_cpuLoad;
+	}
+
+private:
+	struct Estimate
+	{
+		PayloadEncoding encoding;
+		double secondsPerByte = 0.0;
+		double ratio = 1.0;
+		bool measured = false;
+		uint64_t lastUsed = 0;
+	};
+
+	Estimate* Find(PayloadEncoding encoding);
+
+	// expected encode time of the next frame
+	double ExpectedSeconds(const Estimate& estimate) const;
+
+	bool Fits(const Estimate& estimate) const;
+
+	void Refill(Clock::time_point now);
+
+	std::vector<Estimate> m_estimates;
+	double m_cpuBudget;
+	// seconds of encode time that may still be spent, negative after an
+	// expensive frame
+	double m_budget;
+	Clock::time_point m_lastRefill;
+	// time between frames, running average
+	double m_frameInterval = 0.0;
+	bool m_started = false;
+
+	uint64_t m_frame = 0;
+	size_t m_lastRawSize = 0;
+	Clock::time_point m_lastReport;
+	double m_cpuLoad = 0.0;
+
+	std::atomic<Clock::rep> m_lastCongestion;
+	std::atomic<Clock::rep> m_congestionHold;
+};
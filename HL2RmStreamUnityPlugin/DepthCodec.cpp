@@ -0,0 +1,310 @@
+#include "DepthCodec.h"
+
+#include <cstring>
+
+namespace
+{
+	class NibbleWriter
+	{
+	public:
+		NibbleWriter(uint8_t* out, size_t capacity) :
+			m_out(out),
+			m_end(out + (capacity & ~(size_t)3))
+		{
+		}
+
+		// 3 bits per nibble, high bit set while more nibbles follow
+		void WriteVle(uint32_t value)
+		{
+			do
+			{
+				uint32_t nibble = value & 0x7;
+				value >>= 3;
+				if (value)
+				{
+					nibble |= 0x8;
+				}
+				m_word = (m_word << 4) | nibble;
+				if (++m_nibbles == 8)
+				{
+					Flush();
+				}
+			} while (value);
+		}
+
+		// returns the number of bytes written, 0 on overflow
+		size_t Finish()
+		{
+			if (m_nibbles)
+			{
+				m_word <<= 4 * (8 - m_nibbles);
+				Flush();
+			}
+			return m_overflow ? 0 : m_written;
+		}
+
+	private:
+		void Flush()
+		{
+			if (m_out + m_written + 4 <= m_end)
+			{
+				const uint8_t bytes[4] = {
+					(uint8_t)m_word, (uint8_t)(m_word >> 8), (uint8_t)(m_word >> 16), (uint8_t)(m_word >> 24) };
+				memcpy(m_out + m_written, bytes, 4);
+				m_written += 4;
+			}
+			else
+			{
+				m_overflow = true;
+			}
+			m_word = 0;
+			m_nibbles = 0;
+		}
+
+		uint8_t* m_out;
+		uint8_t* m_end;
+		size_t m_written = 0;
+		uint32_t m_word = 0;
+		int m_nibbles = 0;
+		bool m_overflow = false;
+	};
+
+	class NibbleReader
+	{
+	public:
+		NibbleReader(const uint8_t* in, size_t size) :
+			m_in(in),
+			m_words(size / 4)
+		{
+		}
+
+		bool ReadVle(uint32_t& value)
+		{
+			value = 0;
+			int shift = 0;
+			uint32_t nibble;
+			do
+			{
+				if (m_nibbles == 0)
+				{
+					if (m_read == m_words)
+					{
+						return false;
+					}
+					const uint8_t* p = m_in + 4 * m_read++;
+					m_word = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+					m_nibbles = 8;
+				}
+				nibble = m_word >> 28;
+				m_word <<= 4;
+				m_nibbles--;
+				if (shift > 30)
+				{
+					return false;
+				}
+				value |= (nibble & 0x7) << shift;
+				shift += 3;
+			} while (nibble & 0x8);
+			return true;
+		}
+
+		size_t BytesConsumed() const
+		{
+			return 4 * m_read;
+		}
+
+	private:
+		const uint8_t* m_in;
+		size_t m_words;
+		size_t m_read = 0;
+		uint32_t m_word = 0;
+		int m_nibbles = 0;
+	};
+
+	template <typename Store>
+	size_t RvlDecodeTo(
+		const uint8_t* in,
+		size_t size,
+		size_t count,
+		Store store)
+	{
+		NibbleReader reader(in, size);
+		size_t i = 0;
+		int32_t previous = 0;
+		while (i < count)
+		{
+			uint32_t zeros;
+			uint32_t nonZeros;
+			if (!reader.ReadVle(zeros) || zeros > count - i)
+			{
+				return 0;
+			}
+			for (uint32_t z = 0; z < zeros; z++)
+			{
+				store(i++, 0);
+			}
+
+			if (!reader.ReadVle(nonZeros) || nonZeros > count - i)
+			{
+				return 0;
+			}
+			for (uint32_t n = 0; n < nonZeros; n++)
+			{
+				uint32_t positive;
+				if (!reader.ReadVle(positive))
+				{
+					return 0;
+				}
+				const int32_t delta = (int32_t)(positive >> 1) ^ -(int32_t)(positive & 1);
+				previous += delta;
+				store(i++, (uint16_t)previous);
+			}
+		}
+		return reader.BytesConsumed();
+	}
+
+	void StoreUInt32(uint8_t* out, uint32_t value)
+	{
+		const uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+		memcpy(out, bytes, 4);
+	}
+
+	uint32_t LoadUInt32(const uint8_t* in)
+	{
+		return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+	}
+}
+
+namespace DepthCodec
+{
+	size_t RvlMaxEncodedSize(size_t count)
+	{
+		// worst case per pixel: a zero run of length 0 (1 nibble), a non-zero
+		// run of length 1 (1 nibble) and a 17 bit zigzag delta (6 nibbles)
+		return count * 4 + 8;
+	}
+
+	size_t RvlEncode(
+		const uint16_t* values,
+		size_t count,
+		uint32_t invalidFrom,
+		uint8_t* out,
+		size_t capacity)
+	{
+		NibbleWriter writer(out, capacity);
+
+		auto valueAt = [values, invalidFrom](size_t i) -> int32_t
+		{
+			const uint16_t value = values[i];
+			return value >= invalidFrom ? 0 : value;
+		};
+
+		size_t i = 0;
+		int32_t previous = 0;
+		while (i < count)
+		{
+			size_t start = i;
+			while (i < count && valueAt(i) == 0)
+			{
+				i++;
+			}
+			writer.WriteVle((uint32_t)(i - start));
+
+			start = i;
+			while (i < count && valueAt(i) != 0)
+			{
+				i++;
+			}
+			writer.WriteVle((uint32_t)(i - start));
+
+			for (size_t j = start; j < i; j++)
+			{
+				const int32_t current = valueAt(j);
+				const int32_t delta = current - previous;
+				writer.WriteVle((uint32_t)((delta << 1) ^ (delta >> 31)));
+				previous = current;
+			}
+		}
+		return writer.Finish();
+	}
+
+	size_t RvlDecode(
+		const uint8_t* in,
+		size_t size,
+		size_t count,
+		uint16_t* values)
+	{
+		return RvlDecodeTo(in, size, count,
+			[values](size_t i, uint16_t value) { values[i] = value; });
+	}
+
+	size_t EncodeDepthAb(
+		const uint16_t* pDepth,
+		const uint16_t* pAb,
+		size_t count,
+		uint32_t depthInvalidFrom,
+		uint32_t abInvalidFrom,
+		bool bigEndianPlanes,
+		uint8_t* out,
+		size_t capacity)
+	{
+		if (capacity < kDepthAbHeaderSize)
+		{
+			return 0;
+		}
+
+		uint8_t* pStreams = out + kDepthAbHeaderSize;
+		const size_t streamCapacity = capacity - kDepthAbHeaderSize;
+
+		const size_t depthBytes = RvlEncode(pDepth, count, depthInvalidFrom, pStreams, streamCapacity);
+		if (depthBytes == 0)
+		{
+			return 0;
+		}
+		const size_t abBytes = RvlEncode(pAb, count, abInvalidFrom, pStreams + depthBytes, streamCapacity - depthBytes);
+		if (abBytes == 0)
+		{
+			return 0;
+		}
+
+		StoreUInt32(out, (uint32_t)depthBytes);
+		StoreUInt32(out + 4, bigEndianPlanes ? kBigEndianPlanes : 0);
+		return kDepthAbHeaderSize + depthBytes + abBytes;
+	}
+
+	bool DecodeDepthAb(
+		const uint8_t* in,
+		size_t size,
+		size_t count,
+		uint8_t* out)
+	{
+		if (size < kDepthAbHeaderSize)
+		{
+			return false;
+		}
+
+		const size_t depthBytes = LoadUInt32(in);
+		const bool bigEndian = (LoadUInt32(in + 4) & kBigEndianPlanes) != 0;
+		const uint8_t* pStreams = in + kDepthAbHeaderSize;
+		const size_t streamSize = size - kDepthAbHeaderSize;
+		if (depthBytes > streamSize)
+		{
+			return false;
+		}
+
+		// images are written byte by byte, out may not be 2 byte aligned
+		auto decodePlane = [count, bigEndian](const uint8_t* stream, size_t streamBytes, uint8_t* plane)
+		{
+			const int hi = bigEndian ? 0 : 1;
+			return RvlDecodeTo(stream, streamBytes, count,
+				[plane, hi](size_t i, uint16_t value)
+				{
+					plane[2 * i + hi] = (uint8_t)(value >> 8);
+					plane[2 * i + 1 - hi] = (uint8_t)value;
+				}) != 0 || count == 0;
+		};
+
+		return decodePlane(pStreams, depthBytes, out) &&
+			decodePlane(pStreams + depthBytes, streamSize - depthBytes, out + 2 * count);
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Lossless codec for 16-bit depth images in the style of RVL (A. Wilson,
+// "Fast Lossless Depth Image Compression", 2017). The image is coded as
+// alternating runs of zeros and of non-zero pixels; the non-zero pixels are
+// stored as zigzag deltas to their predecessor. Run lengths and deltas are
+// variable-length coded in 3-bit groups (one nibble each, the 4th bit marks a
+// continuation) and the nibbles are packed into little-endian 32-bit words.
+//
+// Depth images are smooth with large invalid (zero) regions, so most pixels
+// cost a single nibble. There are no tables and no state between frames;
+// encoding and decoding are a single pass with a handful of shifts per pixel.
+//
+// PythonReceiver/native decodes with this same file.
+namespace DepthCodec
+{
+	// Values >= this are never invalidated.
+	static constexpr uint32_t kKeepAllValues = 0x10000;
+
+	// Upper bound of RvlEncode's output for count pixels.
+	size_t RvlMaxEncodedSize(size_t count);
+
+	// RVL codes count values into out; values >= invalidFrom are coded as 0.
+	// Returns the number of bytes written (a multiple of 4), or 0 if the
+	// result would not fit into capacity bytes.
+	size_t RvlEncode(
+		const uint16_t* values,
+		size_t count,
+		uint32_t invalidFrom,
+		uint8_t* out,
+		size_t capacity);
+
+	// Decodes count values. Returns the number of bytes consumed, or 0 if
+	// the input is truncated or corrupt.
+	size_t RvlDecode(
+		const uint8_t* in,
+		size_t size,
+		size_t count,
+		uint16_t* values);
+
+	// Depth + AB payload (PayloadEncoding::Rvl):
+	//
+	//   uint32 depthBytes   size of the depth stream
+	//   uint32 flags        kBigEndianPlanes if the decoded images are
+	//                       big-endian (AHAT), little-endian otherwise
+	//   depth stream        RVL, depthBytes bytes
+	//   AB stream           RVL, the rest of the payload
+	//
+	// Decoding yields exactly the bytes the raw payload of the same frame
+	// would have had: depth image first, AB image directly after it.
+	static constexpr uint32_t kBigEndianPlanes = 1;
+	static constexpr size_t kDepthAbHeaderSize = 2 * sizeof(uint32_t);
+
+	// Returns the payload size, or 0 if it would not fit into capacity (the
+	// caller then sends the frame raw).
+	size_t EncodeDepthAb(
+		const uint16_t* pDepth,
+		const uint16_t* pAb,
+		size_t count,
+		uint32_t depthInvalidFrom,
+		uint32_t abInvalidFrom,
+		bool bigEndianPlanes,
+		uint8_t* out,
+		size_t capacity);
+
+	// out must hold 4 * count bytes. Returns false on corrupt input.
+	bool DecodeDepthAb(
+		const uint8_t* in,
+		size_t size,
+		size_t count,
+		uint8_t* out);
+}
@@ -0,0 +1,131 @@
+#include "pch.h"
+
+#define DBG_ENABLE_VERBOSE_LOGGING 0
+#define DBG_ENABLE_INFO_LOGGING 1
+#define DBG_ENABLE_ERROR_LOGGING 1
+
+FrameBufferPool::FrameBufferPool(size_t budgetBytes) :
+    m_budgetBytes(budgetBytes)
+{
+}
+
+size_t FrameBufferPool::ClassSize(size_t size)
+{
+    if (size <= kMinClassSize)
+    {
+        return kMinClassSize;
+    }
+
+    // largest power of two below size, then the first quarter step above it
+    size_t base = kMinClassSize;
+    while (base * 2 < size)
+    {
+        base *= 2;
+    }
+    const size_t step = base / 4;
+    return base + ((size - base + step - 1) / step) * step;
+}
+
+FrameBufferPool::SizeClass& FrameBufferPool::GetClass(size_t classSize)
+{
+    for (SizeClass& sizeClass : m_classes)
+    {
+        if (sizeClass.size == classSize)
+        {
+            return sizeClass;
+        }
+    }
+
+    SizeClass sizeClass;
+    sizeClass.size = classSize;
+    m_classes.push_back(std::move(sizeClass));
+    return m_classes.back();
+}
+
+bool FrameBufferPool::Grow(SizeClass& sizeClass)
+{
+    if (m_allocatedBytes + sizeClass.size > m_budgetBytes)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"FrameBufferPool::Grow: Budget of %zu bytes exhausted, no buffer of %zu bytes.\n",
+            m_budgetBytes, sizeClass.size);
+        OutputDebugStringW(msgBuffer);
+#endif
+        return false;
+    }
+
+    sizeClass.free.push_back(std::make_unique<FrameSendSlot>(sizeClass.size));
+    m_allocatedBytes += sizeClass.size;
+    m_allocationCount++;
+    return true;
+}
+
+bool FrameBufferPool::Reserve(
+    size_t size,
+    int count)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    SizeClass& sizeClass = GetClass(ClassSize(size));
+    bool reserved = true;
+    for (int i = 0; i < count && reserved; i++)
+    {
+        reserved = Grow(sizeClass);
+    }
+
+#if DBG_ENABLE_INFO_LOGGING
+    wchar_t msgBuffer[200];
+    swprintf_s(msgBuffer, L"FrameBufferPool::Reserve: %d buffers of %zu bytes, %zu bytes allocated in total.\n",
+        count, sizeClass.size, m_allocatedBytes);
+    OutputDebugStringW(msgBuffer);
+#endif
+    return reserved;
+}
+
+std::shared_ptr<FrameSendSlot> FrameBufferPool::Acquire(
+    size_t headerSize,
+    size_t payloadSize)
+{
+    std::unique_ptr<FrameSendSlot> slot;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        SizeClass& sizeClass = GetClass(ClassSize(headerSize + payloadSize));
+        if (sizeClass.free.empty() && !Grow(sizeClass))
+        {
+            return nullptr;
+        }
+
+        slot = std::move(sizeClass.free.back());
+        sizeClass.free.pop_back();
+    }
+
+    slot->SetHeaderSize(headerSize);
+
+    // the handle keeps the pool alive, buffers may still sit in a socket
+    // write or the transport queue when the streamers go away
+    auto pool = shared_from_this();
+    return std::shared_ptr<FrameSendSlot>(slot.release(), [pool](FrameSendSlot* pSlot)
+        {
+            pool->Release(pSlot);
+        });
+}
+
+void FrameBufferPool::Release(FrameSendSlot* pSlot)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    GetClass(pSlot->Capacity()).free.emplace_back(pSlot);
+}
+
+size_t FrameBufferPool::AllocatedBytes() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_allocatedBytes;
+}
+
+uint64_t FrameBufferPool::AllocationCount() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_allocationCount;
+}
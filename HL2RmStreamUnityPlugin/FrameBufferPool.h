@@ -0,0 +1,73 @@
+#pragma once
+
+// Recycles the send buffers of all streamers, so that no frame sized
+// allocation is made once every stream has seen its first frame. Each frame
+// still makes a few small ones: the control block of the handle Acquire
+// returns and the FrameSendBuffer that wraps it for the socket or the
+// transport.
+//
+// Buffers are grouped in size classes: powers of two split into four steps
+// (1, 1.25, 1.5 and 1.75 times 2^n), starting at kMinClassSize. A request is
+// served from the smallest class that fits it, so sensors with the same frame
+// size (the two VLC cameras) share buffers, and the waste per buffer stays
+// below 25%.
+//
+// Acquire hands out a reference counted handle. Whoever holds the last copy
+// (the streamer, the socket write or the transport queue) returns the buffer
+// to its class when it lets go, so a frame can be packed into one buffer while
+// the previous one is still being sent.
+class FrameBufferPool : public std::enable_shared_from_this<FrameBufferPool>
+{
+public:
+	static constexpr size_t kMinClassSize = 64 * 1024;
+	// upper bound on the memory held by the pool
+	static constexpr size_t kDefaultBudgetBytes = 64 * 1024 * 1024;
+
+	explicit FrameBufferPool(size_t budgetBytes = kDefaultBudgetBytes);
+
+	FrameBufferPool(const FrameBufferPool&) = delete;
+	FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+	// Adds count buffers of at least size bytes to the pool, allocating them
+	// now. Streamers call this with their frame size when a stream starts (or
+	// its resolution changes). Returns false if the budget did not allow all
+	// of them.
+	bool Reserve(
+		size_t size,
+		int count);
+
+	// Returns a buffer of at least headerSize + payloadSize bytes with the
+	// header size set, or nullptr if the class is empty and growing it would
+	// exceed the budget.
+	std::shared_ptr<FrameSendSlot> Acquire(
+		size_t headerSize,
+		size_t payloadSize);
+
+	// Size of the class that serves requests of size bytes.
+	static size_t ClassSize(size_t size);
+
+	size_t AllocatedBytes() const;
+
+	// number of buffers allocated since the pool was created, stays flat while
+	// streaming once all streams have reserved their buffers
+	uint64_t AllocationCount() const;
+
+private:
+	struct SizeClass
+	{
+		size_t size;
+		std::vector<std::unique_ptr<FrameSendSlot>> free;
+	};
+
+	// called with m_mutex held
+	SizeClass& GetClass(size_t classSize);
+	bool Grow(SizeClass& sizeClass);
+
+	void Release(FrameSendSlot* pSlot);
+
+	mutable std::mutex m_mutex;
+	std::vector<SizeClass> m_classes;
+	size_t m_budgetBytes;
+	size_t m_allocatedBytes = 0;
+	uint64_t m_allocationCount = 0;
+};
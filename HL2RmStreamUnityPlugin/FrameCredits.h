@@ -0,0 +1,103 @@
+#pragma once
+
+// Flow-control window granted by the receiver over the request socket.
+//
+// Every frame put on the wire consumes one credit and the receiver hands one
+// back as soon as it has read a frame, so at most "window" frames are ever in
+// flight. That keeps the latency-buildup protection of the old one-frame-per-
+// request scheme while letting a few frames overlap on links with a longer
+// round trip.
+//
+// Request datagrams (the trailing newline keeps netcat usable):
+//   "<n>\n"  grant n more credits. "1\n" is the old single-frame request.
+//   "R<n>\n" reset the window to n credits, dropping whatever was left. The
+//            receiver sends this when it (re)connects or when it has not seen
+//            a frame for a while, so lost datagrams cannot stall a stream.
+//
+// "K\n" (keyframe request) is not a credit request, ResearchModeFrameProcessor
+// forwards it to its sink.
+class FrameCredits
+{
+public:
+	// upper bound on the window, whatever the receiver asks for
+	static constexpr int kMaxCredits = 8;
+
+	// one frame may be sent before the first request arrives, as before
+	explicit FrameCredits(int initialCredits = 1)
+	{
+		Reset(initialCredits);
+	}
+
+	FrameCredits(const FrameCredits&) = delete;
+	FrameCredits& operator=(const FrameCredits&) = delete;
+
+	void Grant(int count)
+	{
+		if (count <= 0)
+		{
+			return;
+		}
+
+		int current = m_credits.load(std::memory_order_relaxed);
+		int updated;
+		do
+		{
+			updated = (std::min)(current + count, kMaxCredits);
+		} while (!m_credits.compare_exchange_weak(current, updated, std::memory_order_acq_rel));
+	}
+
+	void Reset(int count)
+	{
+		m_credits = (std::max)(0, (std::min)(count, kMaxCredits));
+	}
+
+	bool Available() const
+	{
+		return m_credits.load(std::memory_order_acquire) > 0;
+	}
+
+	// Takes one credit if there is one. Returns false if the window is closed.
+	bool TryConsume()
+	{
+		int current = m_credits.load(std::memory_order_relaxed);
+		while (current > 0)
+		{
+			if (m_credits.compare_exchange_weak(current, current - 1, std::memory_order_acq_rel))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Applies a request datagram. Returns false if it was not understood.
+	bool HandleRequest(const wchar_t* request)
+	{
+		bool reset = false;
+		if (*request == L'R')
+		{
+			reset = true;
+			++request;
+		}
+
+		wchar_t* end = nullptr;
+		long count = wcstol(request, &end, 10);
+		if (end == request || (*end != L'\0' && *end != L'\n'))
+		{
+			return false;
+		}
+
+		if (reset)
+		{
+			Reset((int)count);
+		}
+		else
+		{
+			Grant((int)count);
+		}
+		return true;
+	}
+
+private:
+	std::atomic<int> m_credits{ 0 };
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "PoseCodec.h"
+
+// Header in front of every frame payload, the same for all sensors.
+//
+// Fixed layout, little-endian, no padding. The streamers fill the struct and
+// copy it into the send slot's headroom in one go; both HoloLens 2 (ARM64)
+// and the emulator (x64) are little-endian, so the fields go out as they are.
+// The pose block follows, in the format the streamer was configured with.
+// Receivers check magic and version, read headerSize and payloadLength at
+// their fixed offsets and can skip frames they do not want without unpacking
+// the rest.
+//
+//   offset  field
+//        0  uint32 magic          "HL2F"
+//        4  uint16 version        kFrameHeaderVersion
+//        6  uint16 headerSize     sizeof(FrameHeader) + pose block
+//        8  uint8  sensorId       StreamId (0 PV, 1 Long Throw, 2 LF, 3 RF, 4 IMU,
+//                                 5 LL, 6 RR, 7 AHAT, 8 LF + RF stereo pair)
+//        9  uint8  poseFormat     PoseCodec::Format of the pose block
+//       10  uint16 codec          PayloadEncoding of the payload
+//       12  uint32 sequence       per sensor, gaps are frames that were dropped
+//       16  uint64 timestamp
+//       24  uint32 width
+//       28  uint32 height
+//       32  uint32 pixelStride    of the decoded image
+//       36  uint32 rowStride      of the decoded image
+//       40  uint32 payloadLength  bytes following the header
+//       44  float  fx, fy         PV focal length, 0 for Research Mode sensors
+//       52  pose block            PV camera or rig to world transform, 64
+//                                 bytes as a matrix, 28 or 20 bytes compact
+//                                 (see PoseCodec.h)
+//
+// Magic, version, headerSize and payloadLength keep their offsets in later
+// versions. Version 2 had a uint16 sensor id and always the matrix; version 1
+// was the unversioned header written field by field, 92 bytes for Research
+// Mode and 100 bytes for PV, with the codec in the upper 16 bits of
+// PixelStride.
+//
+// PythonReceiver/native parses the header with this file as well.
+static constexpr uint32_t kFrameHeaderMagic = 0x46324C48; // "HL2F" in memory
+static constexpr uint16_t kFrameHeaderVersion = 3;
+
+#pragma pack(push, 1)
+struct FrameHeader
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t headerSize;
+	uint8_t sensorId;
+	uint8_t poseFormat;
+	uint16_t codec;
+	uint32_t sequence;
+	uint64_t timestamp;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pixelStride;
+	uint32_t rowStride;
+	uint32_t payloadLength;
+	float fx;
+	float fy;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FrameHeader) == 52, "FrameHeader is part of the wire format");
+static_assert(offsetof(FrameHeader, timestamp) == 16, "FrameHeader is part of the wire format");
+static_assert(offsetof(FrameHeader, payloadLength) == 40, "FrameHeader is part of the wire format");
+
+// Bytes on the wire, pose block included.
+inline size_t FrameHeaderSize(PoseCodec::Format poseFormat)
+{
+	return sizeof(FrameHeader) + PoseCodec::EncodedSize(poseFormat);
+}
+
+// A header with magic, version and size set and everything else zero.
+inline FrameHeader MakeFrameHeader(
+	uint8_t sensorId,
+	PoseCodec::Format poseFormat,
+	uint16_t codec,
+	uint32_t sequence)
+{
+	FrameHeader header = {};
+	header.magic = kFrameHeaderMagic;
+	header.version = kFrameHeaderVersion;
+	header.headerSize = (uint16_t)FrameHeaderSize(poseFormat);
+	header.sensorId = sensorId;
+	header.poseFormat = (uint8_t)poseFormat;
+	header.codec = codec;
+	header.sequence = sequence;
+	return header;
+}
+
+// Writes header and pose, header.headerSize bytes.
+inline void WriteFrameHeader(
+	const FrameHeader& header,
+	const float pose[16],
+	uint8_t* out)
+{
+	memcpy(out, &header, sizeof(header));
+	PoseCodec::Encode(pose, (PoseCodec::Format)header.poseFormat, out + sizeof(header));
+}
+
+// False if in (at least sizeof(FrameHeader) bytes) does not start with a
+// header this build understands. header is filled either way.
+inline bool ReadFrameHeader(
+	const uint8_t* in,
+	FrameHeader& header)
+{
+	memcpy(&header, in, sizeof(header));
+	const size_t poseSize = PoseCodec::EncodedSize((PoseCodec::Format)header.poseFormat);
+	return header.magic == kFrameHeaderMagic &&
+		header.version == kFrameHeaderVersion &&
+		poseSize != 0 &&
+		header.headerSize == sizeof(FrameHeader) + poseSize;
+}
@@ -0,0 +1,1274 @@
+#include "FramePacking.h"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRAMEPACKING_HAS_SSE2 1
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define FRAMEPACKING_TARGET_SSSE3
+#else
+#define FRAMEPACKING_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#endif
+
+#if defined(_M_ARM64) || defined(_M_ARM) || defined(__ARM_NEON)
+#define FRAMEPACKING_HAS_NEON 1
+#include <arm_neon.h>
+#endif
+
+using namespace FramePacking;
+
+namespace
+{
+    ////////////////////////////////////////////////////////
+    // scalar kernels
+    //
+    // These are the reference loops that used to live in
+    // ResearchModeFrameStreamer::SendAHAT and SendLongThrow. The SIMD
+    // kernels handle the bulk of the frame and call these for the tail.
+
+    void PackAhatDepthAbScalar(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t begin,
+        size_t count,
+        uint16_t invalidValue,
+        uint8_t* out)
+    {
+        uint8_t* outAb = out + count * 2;
+
+        for (size_t i = begin; i < count; ++i)
+        {
+            const uint16_t d = (pDepth[i] >= invalidValue) ? 0 : pDepth[i];
+            out[i * 2] = (uint8_t)(d >> 8);
+            out[i * 2 + 1] = (uint8_t)(d);
+        }
+
+        for (size_t i = begin; i < count; ++i)
+        {
+            const uint16_t ab = (pAb[i] >= invalidValue) ? 0 : pAb[i];
+            outAb[i * 2] = (uint8_t)(ab >> 8);
+            outAb[i * 2 + 1] = (uint8_t)(ab);
+        }
+    }
+
+    void PackLongThrowDepthAbScalar(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const uint16_t* pAb,
+        size_t begin,
+        size_t count,
+        uint8_t invalidMask,
+        uint8_t* out)
+    {
+        uint8_t* outAb = out + count * 2;
+
+        for (size_t i = begin; i < count; ++i)
+        {
+            const uint16_t d = ((pSigma[i] & invalidMask) > 0) ? 0 : pDepth[i];
+            out[i * 2] = (uint8_t)(d);
+            out[i * 2 + 1] = (uint8_t)(d >> 8);
+        }
+
+        for (size_t i = begin; i < count; ++i)
+        {
+            const uint16_t ab = pAb[i];
+            outAb[i * 2] = (uint8_t)(ab);
+            outAb[i * 2 + 1] = (uint8_t)(ab >> 8);
+        }
+    }
+
+    size_t Packed12Bytes(size_t count)
+    {
+        return count / 2 * 3 + (count & 1) * 2;
+    }
+
+    // packs pixels [begin, count) of one image, begin must be even. Returns
+    // the OR of all packed values so the caller can check they fit.
+    template <typename ValueAt>
+    uint16_t Pack12Scalar(
+        ValueAt valueAt,
+        size_t begin,
+        size_t count,
+        uint8_t* out)
+    {
+        uint16_t bits = 0;
+
+        size_t i = begin;
+        for (; i + 2 <= count; i += 2)
+        {
+            const uint16_t a = valueAt(i);
+            const uint16_t b = valueAt(i + 1);
+            bits |= a | b;
+
+            uint8_t* p = out + i / 2 * 3;
+            p[0] = (uint8_t)(a);
+            p[1] = (uint8_t)((a >> 8) | (b << 4));
+            p[2] = (uint8_t)(b >> 4);
+        }
+
+        if (i < count)
+        {
+            const uint16_t a = valueAt(i);
+            bits |= a;
+            out[i / 2 * 3] = (uint8_t)(a);
+            out[i / 2 * 3 + 1] = (uint8_t)(a >> 8);
+        }
+
+        return bits;
+    }
+
+    bool PackAhatDepthAb12Scalar(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t begin,
+        size_t count,
+        uint16_t invalidValue,
+        uint8_t* out)
+    {
+        uint8_t* outAb = out + Packed12Bytes(count);
+
+        const uint16_t bits =
+            Pack12Scalar([=](size_t i) { return (uint16_t)((pDepth[i] >= invalidValue) ? 0 : pDepth[i]); }, begin, count, out) |
+            Pack12Scalar([=](size_t i) { return (uint16_t)((pAb[i] >= invalidValue) ? 0 : pAb[i]); }, begin, count, outAb);
+
+        return (bits & 0xF000) == 0;
+    }
+
+    bool PackLongThrowDepthAb12Scalar(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const uint16_t* pAb,
+        size_t begin,
+        size_t count,
+        uint8_t invalidMask,
+        uint8_t* out)
+    {
+        uint8_t* outAb = out + Packed12Bytes(count);
+
+        const uint16_t bits =
+            Pack12Scalar([=](size_t i) { return (uint16_t)(((pSigma[i] & invalidMask) > 0) ? 0 : pDepth[i]); }, begin, count, out) |
+            Pack12Scalar([=](size_t i) { return pAb[i]; }, begin, count, outAb);
+
+        return (bits & 0xF000) == 0;
+    }
+
+    // unpacks pixels [begin, count), begin must be even
+    void Unpack12Scalar(
+        const uint8_t* in,
+        size_t begin,
+        size_t count,
+        bool bigEndian,
+        uint8_t* out)
+    {
+        const int hi = bigEndian ? 0 : 1;
+
+        size_t i = begin;
+        for (; i + 2 <= count; i += 2)
+        {
+            const uint8_t* p = in + i / 2 * 3;
+            const uint16_t a = (uint16_t)(p[0] | ((p[1] & 0x0F) << 8));
+            const uint16_t b = (uint16_t)((p[1] >> 4) | (p[2] << 4));
+
+            out[i * 2 + hi] = (uint8_t)(a >> 8);
+            out[i * 2 + 1 - hi] = (uint8_t)(a);
+            out[i * 2 + 2 + hi] = (uint8_t)(b >> 8);
+            out[i * 2 + 3 - hi] = (uint8_t)(b);
+        }
+
+        if (i < count)
+        {
+            const uint8_t* p = in + i / 2 * 3;
+            const uint16_t a = (uint16_t)(p[0] | ((p[1] & 0x0F) << 8));
+            out[i * 2 + hi] = (uint8_t)(a >> 8);
+            out[i * 2 + 1 - hi] = (uint8_t)(a);
+        }
+    }
+
+    void PackBgraRowToBgrScalar(
+        const uint8_t* pBgra,
+        int begin,
+        int width,
+        uint8_t* out)
+    {
+        for (int col = begin; col < width; ++col)
+        {
+            out[col * 3] = pBgra[col * 4];
+            out[col * 3 + 1] = pBgra[col * 4 + 1];
+            out[col * 3 + 2] = pBgra[col * 4 + 2];
+        }
+    }
+
+    // averages factor x factor blocks of the factor source rows starting at
+    // pBgra into output pixels [begin, outWidth)
+    void DownscaleRowToBgrScalar(
+        const uint8_t* pBgra,
+        int rowStride,
+        int factor,
+        int begin,
+        int outWidth,
+        uint8_t* out)
+    {
+        const unsigned int area = (unsigned int)(factor * factor);
+
+        for (int col = begin; col < outWidth; ++col)
+        {
+            unsigned int sum[3] = { 0, 0, 0 };
+            for (int y = 0; y < factor; ++y)
+            {
+                const uint8_t* pBlock = pBgra + y * rowStride + col * factor * 4;
+                for (int x = 0; x < factor; ++x)
+                {
+                    sum[0] += pBlock[x * 4];
+                    sum[1] += pBlock[x * 4 + 1];
+                    sum[2] += pBlock[x * 4 + 2];
+                }
+            }
+
+            out[col * 3] = (uint8_t)((sum[0] + area / 2) / area);
+            out[col * 3 + 1] = (uint8_t)((sum[1] + area / 2) / area);
+            out[col * 3 + 2] = (uint8_t)((sum[2] + area / 2) / area);
+        }
+    }
+
+    void PackBgraToBgrScalar(
+        const uint8_t* pBgra,
+        int width,
+        int height,
+        int rowStride,
+        uint8_t* out)
+    {
+        for (int row = 0; row < height; ++row)
+        {
+            PackBgraRowToBgrScalar(pBgra + row * rowStride, 0, width, out + row * width * 3);
+        }
+    }
+
+    void DownscaleBgraToBgrScalar(
+        const uint8_t* pBgra,
+        int width,
+        int height,
+        int rowStride,
+        int factor,
+        uint8_t* out)
+    {
+        const int outWidth = width / factor;
+        const int outHeight = height / factor;
+
+        for (int row = 0; row < outHeight; ++row)
+        {
+            DownscaleRowToBgrScalar(pBgra + row * factor * rowStride, rowStride, factor,
+                0, outWidth, out + row * outWidth * 3);
+        }
+    }
+
+#if FRAMEPACKING_HAS_SSE2
+    ////////////////////////////////////////////////////////
+    // SSE2 kernels, 8 pixels per iteration
+
+    // v >= invalidValue -> 0, swapped to big-endian. SSE2 has no unsigned
+    // 16 bit compare: v >= invalidValue is the same as a non-zero saturated
+    // v - (invalidValue - 1).
+    __m128i MaskAndSwapSse2(
+        __m128i v,
+        __m128i threshold)
+    {
+        v = _mm_and_si128(v, _mm_cmpeq_epi16(_mm_subs_epu16(v, threshold), _mm_setzero_si128()));
+        return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    }
+
+    // one plane of count values, returns how many it packed
+    size_t PackAhatPlaneSse2(
+        const uint16_t* pValues,
+        size_t count,
+        uint16_t invalidValue,
+        uint8_t* out)
+    {
+        const __m128i threshold = _mm_set1_epi16((short)(invalidValue - 1));
+
+        // 16 values per iteration, two independent loads in flight
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            const __m128i v0 = _mm_loadu_si128((const __m128i*)(pValues + i));
+            const __m128i v1 = _mm_loadu_si128((const __m128i*)(pValues + i + 8));
+            _mm_storeu_si128((__m128i*)(out + i * 2), MaskAndSwapSse2(v0, threshold));
+            _mm_storeu_si128((__m128i*)(out + i * 2 + 16), MaskAndSwapSse2(v1, threshold));
+        }
+        return i;
+    }
+
+    void PackAhatDepthAbSse2(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t count,
+        uint16_t invalidValue,
+        uint8_t* out)
+    {
+        // the planes one after the other, like the scalar loop: two streams
+        // in flight instead of four
+        size_t i = 0;
+        if (invalidValue > 0)
+        {
+            i = PackAhatPlaneSse2(pDepth, count, invalidValue, out);
+            PackAhatPlaneSse2(pAb, count, invalidValue, out + count * 2);
+        }
+
+        PackAhatDepthAbScalar(pDepth, pAb, i, count, invalidValue, out);
+    }
+
+    void PackLongThrowDepthAbSse2(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const uint16_t* pAb,
+        size_t count,
+        uint8_t invalidMask,
+        uint8_t* out)
+    {
+        uint8_t* outAb = out + count * 2;
+
+        const __m128i mask = _mm_set1_epi8((char)invalidMask);
+        const __m128i zero = _mm_setzero_si128();
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m128i d = _mm_loadu_si128((const __m128i*)(pDepth + i));
+            const __m128i ab = _mm_loadu_si128((const __m128i*)(pAb + i));
+            const __m128i sigma = _mm_loadl_epi64((const __m128i*)(pSigma + i));
+
+            // 0xFF for every sigma byte without the invalid bit, widened
+            // to one 0xFFFF lane per depth pixel
+            const __m128i valid8 = _mm_cmpeq_epi8(_mm_and_si128(sigma, mask), zero);
+            const __m128i valid16 = _mm_unpacklo_epi8(valid8, valid8);
+
+            _mm_storeu_si128((__m128i*)(out + i * 2), _mm_and_si128(d, valid16));
+            _mm_storeu_si128((__m128i*)(outAb + i * 2), ab);
+        }
+
+        PackLongThrowDepthAbScalar(pDepth, pSigma, pAb, i, count, invalidMask, out);
+    }
+    // The alpha drop needs a byte shuffle, which x86 only has from SSSE3 on.
+    // The check is done once; CPUs without it use the scalar loop.
+    bool HasSsse3()
+    {
+#if defined(_MSC_VER)
+        static const bool hasSsse3 = []()
+        {
+            int cpuInfo[4];
+            __cpuid(cpuInfo, 1);
+            return (cpuInfo[2] & (1 << 9)) != 0;
+        }();
+#else
+        static const bool hasSsse3 = __builtin_cpu_supports("ssse3") != 0;
+#endif
+        return hasSsse3;
+    }
+
+    FRAMEPACKING_TARGET_SSSE3
+    void PackBgraToBgrSsse3(
+        const uint8_t* pBgra,
+        int width,
+        int height,
+        int rowStride,
+        uint8_t* out)
+    {
+        // BGRA BGRA BGRA BGRA -> BGRBGRBGRBGR ____
+        const __m128i dropAlpha = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        for (int row = 0; row < height; ++row)
+        {
+            const uint8_t* pRow = pBgra + row * rowStride;
+            uint8_t* outRow = out + row * width * 3;
+
+            // 16 pixels (64 bytes in, 48 bytes out) per iteration
+            int col = 0;
+            for (; col + 16 <= width; col += 16)
+            {
+                const __m128i p0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pRow + col * 4)), dropAlpha);
+                const __m128i p1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pRow + col * 4 + 16)), dropAlpha);
+                const __m128i p2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pRow + col * 4 + 32)), dropAlpha);
+                const __m128i p3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pRow + col * 4 + 48)), dropAlpha);
+
+                _mm_storeu_si128((__m128i*)(outRow + col * 3), _mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+                _mm_storeu_si128((__m128i*)(outRow + col * 3 + 16), _mm_or_si128(_mm_srli_si128(p1, 4), _mm_slli_si128(p2, 8)));
+                _mm_storeu_si128((__m128i*)(outRow + col * 3 + 32), _mm_or_si128(_mm_srli_si128(p2, 8), _mm_slli_si128(p3, 4)));
+            }
+
+            PackBgraRowToBgrScalar(pRow, col, width, outRow);
+        }
+    }
+
+    void PackBgraToBgrSse2(
+        const uint8_t* pBgra,
+        int width,
+        int height,
+        int rowStride,
+        uint8_t* out)
+    {
+        if (HasSsse3())
+        {
+            PackBgraToBgrSsse3(pBgra, width, height, rowStride, out);
+        }
+        else
+        {
+            PackBgraToBgrScalar(pBgra, width, height, rowStride, out);
+        }
+    }
+
+    // 4 BGRA pixels -> 12 BGR bytes. Every pixel is stored whole and the
+    // next one overwrites its alpha, so the byte behind the 12 is written as
+    // well: the caller keeps at least one pixel of the row for later.
+    void StoreBgrOverlappingSse2(
+        __m128i bgra,
+        uint8_t* out)
+    {
+        const int32_t p0 = _mm_cvtsi128_si32(bgra);
+        const int32_t p1 = _mm_cvtsi128_si32(_mm_srli_si128(bgra, 4));
+        const int32_t p2 = _mm_cvtsi128_si32(_mm_srli_si128(bgra, 8));
+        const int32_t p3 = _mm_cvtsi128_si32(_mm_srli_si128(bgra, 12));
+        memcpy(out, &p0, 4);
+        memcpy(out + 3, &p1, 4);
+        memcpy(out + 6, &p2, 4);
+        memcpy(out + 9, &p3, 4);
+    }
+
+    // sums of the 4 channels of a 2 pixel wide block in the low half and of
+    // the next block in the high half, from 16 bit column sums of 4 pixels
+    __m128i SumPairsSse2(
+        __m128i lo,
+        __m128i hi)
+    {
+        return _mm_unpacklo_epi64(_mm_add_epi16(lo, _mm_srli_si128(lo, 8)), _mm_add_epi16(hi, _mm_srli_si128(hi, 8)));
+    }
+
+    void DownscaleBgraToBgrSse2(
+        const uint8_t* pBgra,
+        int width,
+        int height,
+        int rowStride,
+        int factor,
+        uint8_t* out)
+    {
+        const int outWidth = width / factor;
+        const int outHeight = height / factor;
+        const __m128i zero = _mm_setzero_si128();
+
+        for (int row = 0; row < outHeight; ++row)
+        {
+            const uint8_t* pRows = pBgra + row * factor * rowStride;
+            uint8_t* outRow = out + row * outWidth * 3;
+
+            // 4 output pixels per iteration, the last one is left to the
+            // scalar loop for StoreBgrOverlappingSse2
+            int col = 0;
+            if (factor == 2)
+            {
+                const __m128i round = _mm_set1_epi16(2);
+                for (; col + 4 < outWidth; col += 4)
+                {
+                    const uint8_t* pBlock = pRows + col * 2 * 4;
+                    __m128i sums[2];
+                    for (int half = 0; half < 2; ++half)
+                    {
+                        const __m128i top = _mm_loadu_si128((const __m128i*)(pBlock + half * 16));
+                        const __m128i bottom = _mm_loadu_si128((const __m128i*)(pBlock + rowStride + half * 16));
+                        sums[half] = SumPairsSse2(
+                            _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero)),
+                            _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero)));
+                    }
+
+                    // (sum + 2) >> 2
+                    const __m128i bgra = _mm_packus_epi16(
+                        _mm_srli_epi16(_mm_add_epi16(sums[0], round), 2),
+                        _mm_srli_epi16(_mm_add_epi16(sums[1], round), 2));
+                    StoreBgrOverlappingSse2(bgra, outRow + col * 3);
+                }
+            }
+            else if (factor == 4)
+            {
+                const __m128i round = _mm_set1_epi16(8);
+                for (; col + 4 < outWidth; col += 4)
+                {
+                    const uint8_t* pBlock = pRows + col * 4 * 4;
+                    __m128i sums[2];
+                    for (int half = 0; half < 2; ++half)
+                    {
+                        // columns of two blocks, at most 16 * 255 per channel
+                        __m128i lo = zero;
+                        __m128i hi = zero;
+                        for (int y = 0; y < 4; ++y)
+                        {
+                            const __m128i a = _mm_loadu_si128((const __m128i*)(pBlock + y * rowStride + half * 32));
+                            const __m128i b = _mm_loadu_si128((const __m128i*)(pBlock + y * rowStride + half * 32 + 16));
+                            lo = _mm_add_epi16(lo, _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpackhi_epi8(a, zero)));
+                            hi = _mm_add_epi16(hi, _mm_add_epi16(_mm_unpacklo_epi8(b, zero), _mm_unpackhi_epi8(b, zero)));
+                        }
+                        sums[half] = SumPairsSse2(lo, hi);
+                    }
+
+                    // (sum + 8) >> 4
+                    const __m128i bgra = _mm_packus_epi16(
+                        _mm_srli_epi16(_mm_add_epi16(sums[0], round), 4),
+                        _mm_srli_epi16(_mm_add_epi16(sums[1], round), 4));
+                    StoreBgrOverlappingSse2(bgra, outRow + col * 3);
+                }
+            }
+
+            DownscaleRowToBgrScalar(pRows, rowStride, factor, col, outWidth, outRow);
+        }
+    }
+
+    // 8 pixels (4 pairs a, b) -> 12 bytes. Each 32-bit lane holds a | b << 16
+    // and becomes a | b << 12, then the top byte of every lane is dropped.
+    FRAMEPACKING_TARGET_SSSE3
+    void Store12Ssse3(
+        __m128i pairs,
+        uint8_t* out)
+    {
+        const __m128i lo12 = _mm_set1_epi32(0x00000FFF);
+        const __m128i hi12 = _mm_set1_epi32(0x00FFF000);
+        const __m128i dropTopByte = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        const __m128i packed = _mm_or_si128(_mm_and_si128(pairs, lo12), _mm_and_si128(_mm_srli_epi32(pairs, 4), hi12));
+        const __m128i bytes = _mm_shuffle_epi8(packed, dropTopByte);
+
+        _mm_storel_epi64((__m128i*)out, bytes);
+        const int32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+        memcpy(out + 8, &tail, 4);
+    }
+
+    bool Fits12Bits(__m128i bits)
+    {
+        const __m128i top = _mm_and_si128(bits, _mm_set1_epi16((short)0xF000));
+        return _mm_movemask_epi8(_mm_cmpeq_epi16(top, _mm_setzero_si128())) == 0xFFFF;
+    }
+
+    FRAMEPACKING_TARGET_SSSE3
+    bool PackAhatDepthAb12Ssse3(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t count,
+        uint16_t invalidValue,
+        uint8_t* out)
+    {
+        uint8_t* outAb = out + Packed12Bytes(count);
+
+        // see PackAhatDepthAbSse2 for the unsigned compare
+        const __m128i threshold = _mm_set1_epi16((short)(invalidValue - 1));
+        const __m128i zero = _mm_setzero_si128();
+        __m128i bits = zero;
+
+        size_t i = 0;
+        if (invalidValue > 0)
+        {
+            for (; i + 8 <= count; i += 8)
+            {
+                __m128i d = _mm_loadu_si128((const __m128i*)(pDepth + i));
+                __m128i ab = _mm_loadu_si128((const __m128i*)(pAb + i));
+
+                d = _mm_and_si128(d, _mm_cmpeq_epi16(_mm_subs_epu16(d, threshold), zero));
+                ab = _mm_and_si128(ab, _mm_cmpeq_epi16(_mm_subs_epu16(ab, threshold), zero));
+                bits = _mm_or_si128(bits, _mm_or_si128(d, ab));
+
+                Store12Ssse3(d, out + i / 2 * 3);
+                Store12Ssse3(ab, outAb + i / 2 * 3);
+            }
+        }
+
+        const bool tailFits = PackAhatDepthAb12Scalar(pDepth, pAb, i, count, invalidValue, out);
+        return tailFits && Fits12Bits(bits);
+    }
+
+    FRAMEPACKING_TARGET_SSSE3
+    bool PackLongThrowDepthAb12Ssse3(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const uint16_t* pAb,
+        size_t count,
+        uint8_t invalidMask,
+        uint8_t* out)
+    {
+        uint8_t* outAb = out + Packed12Bytes(count);
+
+        const __m128i mask = _mm_set1_epi8((char)invalidMask);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i bits = zero;
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i d = _mm_loadu_si128((const __m128i*)(pDepth + i));
+            const __m128i ab = _mm_loadu_si128((const __m128i*)(pAb + i));
+            const __m128i sigma = _mm_loadl_epi64((const __m128i*)(pSigma + i));
+
+            const __m128i valid8 = _mm_cmpeq_epi8(_mm_and_si128(sigma, mask), zero);
+            d = _mm_and_si128(d, _mm_unpacklo_epi8(valid8, valid8));
+            bits = _mm_or_si128(bits, _mm_or_si128(d, ab));
+
+            Store12Ssse3(d, out + i / 2 * 3);
+            Store12Ssse3(ab, outAb + i / 2 * 3);
+        }
+
+        const bool tailFits = PackLongThrowDepthAb12Scalar(pDepth, pSigma, pAb, i, count, invalidMask, out);
+        return tailFits && Fits12Bits(bits);
+    }
+
+    FRAMEPACKING_TARGET_SSSE3
+    void Unpack12Ssse3(
+        const uint8_t* in,
+        size_t count,
+        bool bigEndian,
+        uint8_t* out)
+    {
+        // 12 bytes -> 4 lanes of a | b << 12, then a | b << 16
+        const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i lo12 = _mm_set1_epi32(0x00000FFF);
+        const __m128i hi12 = _mm_set1_epi32(0x0FFF0000);
+        const size_t inSize = Packed12Bytes(count);
+
+        // every load reads 16 bytes, stop while 4 of them are past the image
+        size_t i = 0;
+        for (; i + 8 <= count && i / 2 * 3 + 16 <= inSize; i += 8)
+        {
+            const __m128i packed = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + i / 2 * 3)), expand);
+            __m128i values = _mm_or_si128(_mm_and_si128(packed, lo12), _mm_and_si128(_mm_slli_epi32(packed, 4), hi12));
+            if (bigEndian)
+            {
+                values = _mm_or_si128(_mm_slli_epi16(values, 8), _mm_srli_epi16(values, 8));
+            }
+            _mm_storeu_si128((__m128i*)(out + i * 2), values);
+        }
+
+        Unpack12Scalar(in, i, count, bigEndian, out);
+    }
+
+    bool PackAhatDepthAb12Sse2(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t count,
+        uint16_t invalidValue,
+        uint8_t* out)
+    {
+        if (HasSsse3())
+        {
+            return PackAhatDepthAb12Ssse3(pDepth, pAb, count, invalidValue, out);
+        }
+        return PackAhatDepthAb12Scalar(pDepth, pAb, 0, count, invalidValue, out);
+    }
+
+    bool PackLongThrowDepthAb12Sse2(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const uint16_t* pAb,
+        size_t count,
+        uint8_t invalidMask,
+        uint8_t* out)
+    {
+        if (HasSsse3())
+        {
+            return PackLongThrowDepthAb12Ssse3(pDepth, pSigma, pAb, count, invalidMask, out);
+        }
+        return PackLongThrowDepthAb12Scalar(pDepth, pSigma, pAb, 0, count, invalidMask, out);
+    }
+
+    void Unpack12Sse2(
+        const uint8_t* in,
+        size_t count,
+        bool bigEndian,
+        uint8_t* out)
+    {
+        if (HasSsse3())
+        {
+            Unpack12Ssse3(in, count, bigEndian, out);
+        }
+        else
+        {
+            Unpack12Scalar(in, 0, count, bigEndian, out);
+        }
+    }
+#endif
+
+#if FRAMEPACKING_HAS_NEON
+    ////////////////////////////////////////////////////////
+    // NEON kernels, 8 pixels per iteration
+
+    void PackAhatDepthAbNeon(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t count,
+        uint16_t invalidValue,
+        uint8_t* out)
+    {
+        uint8_t* outAb = out + count * 2;
+
+        const uint16x8_t threshold = vdupq_n_u16(invalidValue);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            uint16x8_t d = vld1q_u16(pDepth + i);
+            uint16x8_t ab = vld1q_u16(pAb + i);
+
+            d = vbicq_u16(d, vcgeq_u16(d, threshold));
+            ab = vbicq_u16(ab, vcgeq_u16(ab, threshold));
+
+            // swap to big-endian
+            vst1q_u8(out + i * 2, vrev16q_u8(vreinterpretq_u8_u16(d)));
+            vst1q_u8(outAb + i * 2, vrev16q_u8(vreinterpretq_u8_u16(ab)));
+        }
+
+        PackAhatDepthAbScalar(pDepth, pAb, i, count, invalidValue, out);
+    }
+
+    void PackLongThrowDepthAbNeon(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const uint16_t* pAb,
+        size_t count,
+        uint8_t invalidMask,
+        uint8_t* out)
+    {
+        uint8_t* outAb = out + count * 2;
+
+        const uint8x8_t mask = vdup_n_u8(invalidMask);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const uint16x8_t d = vld1q_u16(pDepth + i);
+            const uint16x8_t ab = vld1q_u16(pAb + i);
+
+            // 0xFF for every sigma byte with the invalid bit set,
+            // sign-extended to one 0xFFFF lane per depth pixel
+            const uint8x8_t invalid8 = vtst_u8(vld1_u8(pSigma + i), mask);
+            const uint16x8_t invalid16 = vreinterpretq_u16_s16(vmovl_s8(vreinterpret_s8_u8(invalid8)));
+
+            vst1q_u8(out + i * 2, vreinterpretq_u8_u16(vbicq_u16(d, invalid16)));
+            vst1q_u8(outAb + i * 2, vreinterpretq_u8_u16(ab));
+        }
+
+        PackLongThrowDepthAbScalar(pDepth, pSigma, pAb, i, count, invalidMask, out);
+    }
+    void PackBgraToBgrNeon(
+        const uint8_t* pBgra,
+        int width,
+        int height,
+        int rowStride,
+        uint8_t* out)
+    {
+        for (int row = 0; row < height; ++row)
+        {
+            const uint8_t* pRow = pBgra + row * rowStride;
+            uint8_t* outRow = out + row * width * 3;
+
+            // 16 pixels per iteration: de-interleave into B, G, R, A planes
+            // and re-interleave only B, G, R
+            int col = 0;
+            for (; col + 16 <= width; col += 16)
+            {
+                const uint8x16x4_t bgra = vld4q_u8(pRow + col * 4);
+
+                uint8x16x3_t bgr;
+                bgr.val[0] = bgra.val[0];
+                bgr.val[1] = bgra.val[1];
+                bgr.val[2] = bgra.val[2];
+
+                vst3q_u8(outRow + col * 3, bgr);
+            }
+
+            PackBgraRowToBgrScalar(pRow, col, width, outRow);
+        }
+    }
+
+    void DownscaleBgraToBgrNeon(
+        const uint8_t* pBgra,
+        int width,
+        int height,
+        int rowStride,
+        int factor,
+        uint8_t* out)
+    {
+        const int outWidth = width / factor;
+        const int outHeight = height / factor;
+
+        for (int row = 0; row < outHeight; ++row)
+        {
+            const uint8_t* pRows = pBgra + row * factor * rowStride;
+            uint8_t* outRow = out + row * outWidth * 3;
+
+            // 8 output pixels per iteration
+            int col = 0;
+            if (factor == 2)
+            {
+                for (; col + 8 <= outWidth; col += 8)
+                {
+                    const uint8x16x4_t top = vld4q_u8(pRows + col * 2 * 4);
+                    const uint8x16x4_t bottom = vld4q_u8(pRows + rowStride + col * 2 * 4);
+
+                    uint8x8x3_t bgr;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        // horizontal pairs of both rows, then (sum + 2) >> 2
+                        const uint16x8_t sum = vpadalq_u8(vpaddlq_u8(top.val[c]), bottom.val[c]);
+                        bgr.val[c] = vrshrn_n_u16(sum, 2);
+                    }
+
+                    vst3_u8(outRow + col * 3, bgr);
+                }
+            }
+            else if (factor == 4)
+            {
+                for (; col + 8 <= outWidth; col += 8)
+                {
+                    uint16x8_t sumLo[3] = { vdupq_n_u16(0), vdupq_n_u16(0), vdupq_n_u16(0) };
+                    uint16x8_t sumHi[3] = { vdupq_n_u16(0), vdupq_n_u16(0), vdupq_n_u16(0) };
+
+                    for (int y = 0; y < 4; ++y)
+                    {
+                        const uint8x16x4_t lo = vld4q_u8(pRows + y * rowStride + col * 4 * 4);
+                        const uint8x16x4_t hi = vld4q_u8(pRows + y * rowStride + col * 4 * 4 + 64);
+
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            sumLo[c] = vpadalq_u8(sumLo[c], lo.val[c]);
+                            sumHi[c] = vpadalq_u8(sumHi[c], hi.val[c]);
+                        }
+                    }
+
+                    uint8x8x3_t bgr;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        // add the remaining horizontal pairs, then (sum + 8) >> 4
+                        const uint16x8_t sum = vcombine_u16(
+                            vpadd_u16(vget_low_u16(sumLo[c]), vget_high_u16(sumLo[c])),
+                            vpadd_u16(vget_low_u16(sumHi[c]), vget_high_u16(sumHi[c])));
+                        bgr.val[c] = vrshrn_n_u16(sum, 4);
+                    }
+
+                    vst3_u8(outRow + col * 3, bgr);
+                }
+            }
+
+            DownscaleRowToBgrScalar(pRows, rowStride, factor, col, outWidth, outRow);
+        }
+    }
+
+    // 16 pixels, de-interleaved into pairs a, b -> 8 triples of 3 bytes
+    void Store12Neon(
+        uint16x8x2_t pairs,
+        uint8_t* out)
+    {
+        const uint16x8_t a = pairs.val[0];
+        const uint16x8_t b = pairs.val[1];
+
+        uint8x8x3_t bytes;
+        bytes.val[0] = vmovn_u16(a);
+        bytes.val[1] = vmovn_u16(vorrq_u16(vshrq_n_u16(a, 8), vshlq_n_u16(b, 4)));
+        bytes.val[2] = vmovn_u16(vshrq_n_u16(b, 4));
+        vst3_u8(out, bytes);
+    }
+
+    bool Fits12Bits(uint16x8_t bits)
+    {
+        const uint16x8_t top = vandq_u16(bits, vdupq_n_u16(0xF000));
+        const uint16x4_t folded = vorr_u16(vget_low_u16(top), vget_high_u16(top));
+        return vget_lane_u64(vreinterpret_u64_u16(folded), 0) == 0;
+    }
+
+    bool PackAhatDepthAb12Neon(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t count,
+        uint16_t invalidValue,
+        uint8_t* out)
+    {
+        uint8_t* outAb = out + Packed12Bytes(count);
+
+        const uint16x8_t threshold = vdupq_n_u16(invalidValue);
+        uint16x8_t bits = vdupq_n_u16(0);
+
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            uint16x8x2_t d = vld2q_u16(pDepth + i);
+            uint16x8x2_t ab = vld2q_u16(pAb + i);
+
+            for (int k = 0; k < 2; ++k)
+            {
+                d.val[k] = vbicq_u16(d.val[k], vcgeq_u16(d.val[k], threshold));
+                ab.val[k] = vbicq_u16(ab.val[k], vcgeq_u16(ab.val[k], threshold));
+                bits = vorrq_u16(bits, vorrq_u16(d.val[k], ab.val[k]));
+            }
+
+            Store12Neon(d, out + i / 2 * 3);
+            Store12Neon(ab, outAb + i / 2 * 3);
+        }
+
+        const bool tailFits = PackAhatDepthAb12Scalar(pDepth, pAb, i, count, invalidValue, out);
+        return tailFits && Fits12Bits(bits);
+    }
+
+    bool PackLongThrowDepthAb12Neon(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const uint16_t* pAb,
+        size_t count,
+        uint8_t invalidMask,
+        uint8_t* out)
+    {
+        uint8_t* outAb = out + Packed12Bytes(count);
+
+        const uint8x8_t mask = vdup_n_u8(invalidMask);
+        uint16x8_t bits = vdupq_n_u16(0);
+
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            uint16x8x2_t d = vld2q_u16(pDepth + i);
+            const uint16x8x2_t ab = vld2q_u16(pAb + i);
+
+            // sigma split the same way as the depth pixels: even and odd
+            const uint8x8x2_t sigma = vld2_u8(pSigma + i);
+            for (int k = 0; k < 2; ++k)
+            {
+                const uint8x8_t invalid8 = vtst_u8(sigma.val[k], mask);
+                const uint16x8_t invalid16 = vreinterpretq_u16_s16(vmovl_s8(vreinterpret_s8_u8(invalid8)));
+                d.val[k] = vbicq_u16(d.val[k], invalid16);
+                bits = vorrq_u16(bits, vorrq_u16(d.val[k], ab.val[k]));
+            }
+
+            Store12Neon(d, out + i / 2 * 3);
+            Store12Neon(ab, outAb + i / 2 * 3);
+        }
+
+        const bool tailFits = PackLongThrowDepthAb12Scalar(pDepth, pSigma, pAb, i, count, invalidMask, out);
+        return tailFits && Fits12Bits(bits);
+    }
+
+    void Unpack12Neon(
+        const uint8_t* in,
+        size_t count,
+        bool bigEndian,
+        uint8_t* out)
+    {
+        // 8 triples -> 16 pixels per iteration
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            const uint8x8x3_t bytes = vld3_u8(in + i / 2 * 3);
+            const uint16x8_t b0 = vmovl_u8(bytes.val[0]);
+            const uint16x8_t b1 = vmovl_u8(bytes.val[1]);
+            const uint16x8_t b2 = vmovl_u8(bytes.val[2]);
+
+            uint16x8x2_t pairs;
+            pairs.val[0] = vorrq_u16(b0, vshlq_n_u16(vandq_u16(b1, vdupq_n_u16(0x0F)), 8));
+            pairs.val[1] = vorrq_u16(vshrq_n_u16(b1, 4), vshlq_n_u16(b2, 4));
+            if (bigEndian)
+            {
+                pairs.val[0] = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(pairs.val[0])));
+                pairs.val[1] = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(pairs.val[1])));
+            }
+            vst2q_u16((uint16_t*)(out + i * 2), pairs);
+        }
+
+        Unpack12Scalar(in, i, count, bigEndian, out);
+    }
+#endif
+
+    ////////////////////////////////////////////////////////
+    // dispatch
+
+    void PackAhatDepthAbDefault(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t count,
+        uint16_t invalidValue,
+        uint8_t* out)
+    {
+        PackAhatDepthAbScalar(pDepth, pAb, 0, count, invalidValue, out);
+    }
+
+    void PackLongThrowDepthAbDefault(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const uint16_t* pAb,
+        size_t count,
+        uint8_t invalidMask,
+        uint8_t* out)
+    {
+        PackLongThrowDepthAbScalar(pDepth, pSigma, pAb, 0, count, invalidMask, out);
+    }
+
+    bool PackAhatDepthAb12Default(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t count,
+        uint16_t invalidValue,
+        uint8_t* out)
+    {
+        return PackAhatDepthAb12Scalar(pDepth, pAb, 0, count, invalidValue, out);
+    }
+
+    bool PackLongThrowDepthAb12Default(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const uint16_t* pAb,
+        size_t count,
+        uint8_t invalidMask,
+        uint8_t* out)
+    {
+        return PackLongThrowDepthAb12Scalar(pDepth, pSigma, pAb, 0, count, invalidMask, out);
+    }
+
+    void Unpack12Default(
+        const uint8_t* in,
+        size_t count,
+        bool bigEndian,
+        uint8_t* out)
+    {
+        Unpack12Scalar(in, 0, count, bigEndian, out);
+    }
+
+    typedef void (*PFN_PACKAHAT)(const uint16_t*, const uint16_t*, size_t, uint16_t, uint8_t*);
+    typedef void (*PFN_PACKLONGTHROW)(const uint16_t*, const uint8_t*, const uint16_t*, size_t, uint8_t, uint8_t*);
+    typedef void (*PFN_PACKBGR)(const uint8_t*, int, int, int, uint8_t*);
+    typedef void (*PFN_DOWNSCALEBGR)(const uint8_t*, int, int, int, int, uint8_t*);
+    typedef bool (*PFN_PACKAHAT12)(const uint16_t*, const uint16_t*, size_t, uint16_t, uint8_t*);
+    typedef bool (*PFN_PACKLONGTHROW12)(const uint16_t*, const uint8_t*, const uint16_t*, size_t, uint8_t, uint8_t*);
+    typedef void (*PFN_UNPACK12)(const uint8_t*, size_t, bool, uint8_t*);
+
+    struct KernelTable
+    {
+        KernelPath path;
+        PFN_PACKAHAT packAhat;
+        PFN_PACKLONGTHROW packLongThrow;
+        PFN_PACKBGR packBgr;
+        PFN_DOWNSCALEBGR downscaleBgr;
+        PFN_PACKAHAT12 packAhat12;
+        PFN_PACKLONGTHROW12 packLongThrow12;
+        PFN_UNPACK12 unpack12;
+    };
+
+    const KernelTable kScalarKernels = {
+        KernelPath::Scalar,
+        PackAhatDepthAbDefault,
+        PackLongThrowDepthAbDefault,
+        PackBgraToBgrScalar,
+        DownscaleBgraToBgrScalar,
+        PackAhatDepthAb12Default,
+        PackLongThrowDepthAb12Default,
+        Unpack12Default };
+#if FRAMEPACKING_HAS_SSE2
+    const KernelTable kSse2Kernels = {
+        KernelPath::Sse2,
+        PackAhatDepthAbSse2,
+        PackLongThrowDepthAbSse2,
+        PackBgraToBgrSse2,
+        DownscaleBgraToBgrSse2,
+        PackAhatDepthAb12Sse2,
+        PackLongThrowDepthAb12Sse2,
+        Unpack12Sse2 };
+#endif
+#if FRAMEPACKING_HAS_NEON
+    const KernelTable kNeonKernels = {
+        KernelPath::Neon,
+        PackAhatDepthAbNeon,
+        PackLongThrowDepthAbNeon,
+        PackBgraToBgrNeon,
+        DownscaleBgraToBgrNeon,
+        PackAhatDepthAb12Neon,
+        PackLongThrowDepthAb12Neon,
+        Unpack12Neon };
+#endif
+
+    bool IsKernelPathSupported(KernelPath path)
+    {
+        switch (path)
+        {
+        case KernelPath::Scalar:
+            return true;
+#if FRAMEPACKING_HAS_SSE2
+        case KernelPath::Sse2:
+#if defined(_WIN32)
+            return IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE) != 0;
+#else
+            return __builtin_cpu_supports("sse2") != 0;
+#endif
+#endif
+#if FRAMEPACKING_HAS_NEON
+        case KernelPath::Neon:
+#if defined(_M_ARM)
+            return IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE) != 0;
+#else
+            // NEON is mandatory on ARM64
+            return true;
+#endif
+#endif
+        default:
+            return false;
+        }
+    }
+
+    const KernelTable* GetKernelTable(KernelPath path)
+    {
+        if (!IsKernelPathSupported(path))
+        {
+            return &kScalarKernels;
+        }
+
+        switch (path)
+        {
+#if FRAMEPACKING_HAS_SSE2
+        case KernelPath::Sse2:
+            return &kSse2Kernels;
+#endif
+#if FRAMEPACKING_HAS_NEON
+        case KernelPath::Neon:
+            return &kNeonKernels;
+#endif
+        default:
+            return &kScalarKernels;
+        }
+    }
+
+    std::atomic<const KernelTable*>& ActiveKernels()
+    {
+        static std::atomic<const KernelTable*> kernels{ GetKernelTable(DetectKernelPath()) };
+        return kernels;
+    }
+}
+
+KernelPath FramePacking::DetectKernelPath()
+{
+#if FRAMEPACKING_HAS_NEON
+    if (IsKernelPathSupported(KernelPath::Neon))
+    {
+        return KernelPath::Neon;
+    }
+#endif
+#if FRAMEPACKING_HAS_SSE2
+    if (IsKernelPathSupported(KernelPath::Sse2))
+    {
+        return KernelPath::Sse2;
+    }
+#endif
+    return KernelPath::Scalar;
+}
+
+KernelPath FramePacking::ActiveKernelPath()
+{
+    return ActiveKernels().load(std::memory_order_relaxed)->path;
+}
+
+void FramePacking::SetKernelPath(KernelPath path)
+{
+    ActiveKernels().store(GetKernelTable(path), std::memory_order_relaxed);
+}
+
+const wchar_t* FramePacking::KernelPathName(KernelPath path)
+{
+    switch (path)
+    {
+    case KernelPath::Sse2:
+        return L"SSE2";
+    case KernelPath::Neon:
+        return L"NEON";
+    default:
+        return L"scalar";
+    }
+}
+
+void FramePacking::PackAhatDepthAb(
+    const uint16_t* pDepth,
+    const uint16_t* pAb,
+    size_t count,
+    uint16_t invalidValue,
+    uint8_t* out)
+{
+    ActiveKernels().load(std::memory_order_relaxed)->packAhat(pDepth, pAb, count, invalidValue, out);
+}
+
+void FramePacking::PackLongThrowDepthAb(
+    const uint16_t* pDepth,
+    const uint8_t* pSigma,
+    const uint16_t* pAb,
+    size_t count,
+    uint8_t invalidMask,
+    uint8_t* out)
+{
+    ActiveKernels().load(std::memory_order_relaxed)->packLongThrow(pDepth, pSigma, pAb, count, invalidMask, out);
+}
+
+void FramePacking::PackBgraToBgr(
+    const uint8_t* pBgra,
+    int width,
+    int height,
+    int rowStride,
+    uint8_t* out)
+{
+    ActiveKernels().load(std::memory_order_relaxed)->packBgr(pBgra, width, height, rowStride, out);
+}
+
+void FramePacking::DownscaleBgraToBgr(
+    const uint8_t* pBgra,
+    int width,
+    int height,
+    int rowStride,
+    int factor,
+    uint8_t* out)
+{
+    if (factor <= 1)
+    {
+        PackBgraToBgr(pBgra, width, height, rowStride, out);
+        return;
+    }
+
+    ActiveKernels().load(std::memory_order_relaxed)->downscaleBgr(pBgra, width, height, rowStride, factor, out);
+}
+
+size_t FramePacking::Packed12Size(size_t count)
+{
+    return Packed12Bytes(count);
+}
+
+bool FramePacking::PackAhatDepthAb12(
+    const uint16_t* pDepth,
+    const uint16_t* pAb,
+    size_t count,
+    uint16_t invalidValue,
+    uint8_t* out)
+{
+    return ActiveKernels().load(std::memory_order_relaxed)->packAhat12(pDepth, pAb, count, invalidValue, out);
+}
+
+bool FramePacking::PackLongThrowDepthAb12(
+    const uint16_t* pDepth,
+    const uint8_t* pSigma,
+    const uint16_t* pAb,
+    size_t count,
+    uint8_t invalidMask,
+    uint8_t* out)
+{
+    return ActiveKernels().load(std::memory_order_relaxed)->packLongThrow12(pDepth, pSigma, pAb, count, invalidMask, out);
+}
+
+void FramePacking::Unpack12(
+    const uint8_t* in,
+    size_t count,
+    bool bigEndian,
+    uint8_t* out)
+{
+    ActiveKernels().load(std::memory_order_relaxed)->unpack12(in, count, bigEndian, out);
+}
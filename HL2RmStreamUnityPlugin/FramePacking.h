@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Pixel packing kernels used by the streamers to turn sensor buffers into the
+// byte layout that goes on the wire. Every kernel has a scalar reference
+// implementation and, where the target supports it, an SSE2 or NEON version.
+// The vectorized versions produce exactly the same bytes as the scalar ones.
+namespace FramePacking
+{
+	enum class KernelPath
+	{
+		Scalar,
+		Sse2,
+		Neon,
+	};
+
+	// Path picked by the runtime dispatcher for this CPU.
+	KernelPath DetectKernelPath();
+
+	// Path currently used by the packing functions below.
+	KernelPath ActiveKernelPath();
+
+	// Forces a specific path, e.g. to compare against the scalar loops.
+	// Requests for a path the CPU does not support fall back to scalar.
+	void SetKernelPath(KernelPath path);
+
+	const wchar_t* KernelPathName(KernelPath path);
+
+	// AHAT: depth and AB values >= invalidValue are zeroed and both images
+	// are written big-endian, depth first, AB directly after it.
+	// out must hold 2 * count bytes for each image (4 * count in total).
+	void PackAhatDepthAb(
+		const uint16_t* pDepth,
+		const uint16_t* pAb,
+		size_t count,
+		uint16_t invalidValue,
+		uint8_t* out);
+
+	// Long Throw: depth pixels whose sigma byte has the invalid bit set are
+	// zeroed, AB is passed through. Both images are written little-endian,
+	// depth first, AB directly after it.
+	void PackLongThrowDepthAb(
+		const uint16_t* pDepth,
+		const uint8_t* pSigma,
+		const uint16_t* pAb,
+		size_t count,
+		uint8_t invalidMask,
+		uint8_t* out);
+
+	// 12-bit wire mode (PayloadEncoding::Packed12). Valid depth and AB values
+	// stay below 4096, so two pixels a, b are stored in 3 bytes as the
+	// little-endian 24-bit value a | b << 12. An odd count ends with the last
+	// pixel in 2 bytes. Images are Packed12Size(count) bytes each, depth
+	// first, AB directly after it.
+	size_t Packed12Size(size_t count);
+
+	// AHAT in 12 bits, invalidation as in PackAhatDepthAb. out must hold
+	// 2 * Packed12Size(count) bytes. Returns false if a value that survived
+	// invalidation needs more than 12 bits (only possible with an
+	// invalidValue above 4096); out is then incomplete.
+	bool PackAhatDepthAb12(
+		const uint16_t* pDepth,
+		const uint16_t* pAb,
+		size_t count,
+		uint16_t invalidValue,
+		uint8_t* out);
+
+	// Long Throw in 12 bits, invalidation as in PackLongThrowDepthAb.
+	// Returns false if a depth or AB value needs more than 12 bits, the
+	// frame then has to be sent raw.
+	bool PackLongThrowDepthAb12(
+		const uint16_t* pDepth,
+		const uint8_t* pSigma,
+		const uint16_t* pAb,
+		size_t count,
+		uint8_t invalidMask,
+		uint8_t* out);
+
+	// Receiver side: unpacks count 12-bit pixels into 2 * count bytes of
+	// 16-bit values, big- or little-endian like the raw payload.
+	void Unpack12(
+		const uint8_t* in,
+		size_t count,
+		bool bigEndian,
+		uint8_t* out);
+
+	// PV: drops the alpha channel of a BGRA image. rowStride is the distance
+	// in bytes between two source rows; out is written tightly packed
+	// (width * 3 bytes per row).
+	void PackBgraToBgr(
+		const uint8_t* pBgra,
+		int width,
+		int height,
+		int rowStride,
+		uint8_t* out);
+
+	// PV: box-filter downscale of a BGRA image by factor (1, 2 or 4) while
+	// dropping the alpha channel. Every output pixel is the rounded average
+	// of a factor x factor block; the output is (width / factor) x
+	// (height / factor) pixels, tightly packed. factor 1 is PackBgraToBgr.
+	void DownscaleBgraToBgr(
+		const uint8_t* pBgra,
+		int width,
+		int height,
+		int rowStride,
+		int factor,
+		uint8_t* out);
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Fixed capacity FIFO between two pipeline stages. When it is full the oldest
+// item is dropped to make room, so a slow consumer sees the most recent
+// frames instead of building up latency.
+template <typename T>
+class BoundedDropOldestQueue
+{
+public:
+	explicit BoundedDropOldestQueue(size_t capacity) :
+		m_capacity(capacity > 0 ? capacity : 1)
+	{
+	}
+
+	BoundedDropOldestQueue(const BoundedDropOldestQueue&) = delete;
+	BoundedDropOldestQueue& operator=(const BoundedDropOldestQueue&) = delete;
+
+	// Returns false if an item had to be dropped (or the queue is closed).
+	bool Push(T item)
+	{
+		bool dropped = false;
+		{
+			std::lock_guard<std::mutex> guard(m_mutex);
+			if (m_closed)
+			{
+				return false;
+			}
+			if (m_items.size() >= m_capacity)
+			{
+				m_items.pop_front();
+				dropped = true;
+			}
+			m_items.push_back(std::move(item));
+		}
+		m_notEmpty.notify_one();
+		return !dropped;
+	}
+
+	// Blocks until an item is available. Returns false once the queue is
+	// closed, pending items are discarded.
+	bool Pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+		if (m_closed)
+		{
+			return false;
+		}
+		item = std::move(m_items.front());
+		m_items.pop_front();
+		return true;
+	}
+
+	void Close()
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_mutex);
+			m_closed = true;
+			m_items.clear();
+		}
+		m_notEmpty.notify_all();
+	}
+
+	size_t Size() const
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		return m_items.size();
+	}
+
+private:
+	mutable std::mutex m_mutex;
+	std::condition_variable m_notEmpty;
+	std::deque<T> m_items;
+	size_t m_capacity;
+	bool m_closed = false;
+};
+
+// Three stage send pipeline of one sensor:
+//
+//   acquire  -> [queue] -> pack/encode -> [queue] -> transmit
+//
+// The acquire stage is the frame processor thread calling Submit; pack and
+// transmit each run on their own thread, so packing frame N+1 overlaps the
+// socket write of frame N. Both queues are bounded and drop the oldest frame
+// when full. onDrop is called for every frame that does not go out, dropped
+// from a queue or skipped by pack, e.g. to hand the flow control credit of
+// that frame back.
+template <typename TFrame, typename TPacked>
+class FramePipeline
+{
+public:
+	// Turns an acquired frame into a packed one. Returning false skips the
+	// frame (no pose, no connection, ...).
+	using PackFunction = std::function<bool(TFrame&, TPacked&)>;
+	using TransmitFunction = std::function<void(TPacked&)>;
+	// skipped is true for a frame pack skipped, false for one dropped from
+	// a full queue
+	using DropFunction = std::function<void(bool skipped)>;
+
+	struct Stats
+	{
+		std::atomic<uint64_t> submitted{ 0 };
+		std::atomic<uint64_t> packed{ 0 };
+		std::atomic<uint64_t> transmitted{ 0 };
+		std::atomic<uint64_t> dropped{ 0 };
+		std::atomic<uint64_t> skipped{ 0 };
+	};
+
+	FramePipeline(
+		PackFunction pack,
+		TransmitFunction transmit,
+		size_t queueCapacity = 2,
+		DropFunction onDrop = nullptr) :
+		m_pack(std::move(pack)),
+		m_transmit(std::move(transmit)),
+		m_onDrop(std::move(onDrop)),
+		m_packQueue(queueCapacity),
+		m_transmitQueue(queueCapacity)
+	{
+		m_packThread = std::thread(&FramePipeline::PackLoop, this);
+		m_transmitThread = std::thread(&FramePipeline::TransmitLoop, this);
+	}
+
+	~FramePipeline()
+	{
+		Stop();
+	}
+
+	FramePipeline(const FramePipeline&) = delete;
+	FramePipeline& operator=(const FramePipeline&) = delete;
+
+	// acquire stage, never blocks on packing or the socket
+	void Submit(TFrame frame)
+	{
+		m_stats.submitted++;
+		if (!m_packQueue.Push(std::move(frame)))
+		{
+			Dropped(false);
+		}
+	}
+
+	// Stops both worker threads. Frames still queued are discarded.
+	void Stop()
+	{
+		m_packQueue.Close();
+		m_transmitQueue.Close();
+		if (m_packThread.joinable())
+		{
+			m_packThread.join();
+		}
+		if (m_transmitThread.joinable())
+		{
+			m_transmitThread.join();
+		}
+	}
+
+	const Stats& GetStats() const
+	{
+		return m_stats;
+	}
+
+private:
+	void PackLoop()
+	{
+		TFrame frame;
+		while (m_packQueue.Pop(frame))
+		{
+			TPacked packed;
+			const bool ok = m_pack(frame, packed);
+			// release the sensor frame before waiting for the next one
+			frame = TFrame();
+			if (!ok)
+			{
+				Dropped(true);
+				continue;
+			}
+
+			m_stats.packed++;
+			if (!m_transmitQueue.Push(std::move(packed)))
+			{
+				Dropped(false);
+			}
+		}
+	}
+
+	void TransmitLoop()
+	{
+		TPacked packed;
+		while (m_transmitQueue.Pop(packed))
+		{
+			m_transmit(packed);
+			// return the send buffer to its pool
+			packed = TPacked();
+			m_stats.transmitted++;
+		}
+	}
+
+	void Dropped(bool skipped)
+	{
+		if (skipped)
+		{
+			m_stats.skipped++;
+		}
+		else
+		{
+			m_stats.dropped++;
+		}
+		if (m_onDrop)
+		{
+			m_onDrop(skipped);
+		}
+	}
+
+	PackFunction m_pack;
+	TransmitFunction m_transmit;
+	DropFunction m_onDrop;
+
+	BoundedDropOldestQueue<TFrame> m_packQueue;
+	BoundedDropOldestQueue<TPacked> m_transmitQueue;
+
+	Stats m_stats;
+
+	std::thread m_packThread;
+	std::thread m_transmitThread;
+};
@@ -0,0 +1,43 @@
+#include "pch.h"
+
+FrameSendSlot::FrameSendSlot(size_t capacity) :
+    m_storage(capacity)
+{
+}
+
+FrameSendBuffer::FrameSendBuffer(
+    std::shared_ptr<FrameSendSlot> slot,
+    uint32_t length) :
+    m_slot(std::move(slot)),
+    m_length(length)
+{
+    if (m_length > m_slot->m_storage.size())
+    {
+        throw winrt::hresult_invalid_argument();
+    }
+}
+
+uint32_t FrameSendBuffer::Capacity() const
+{
+    return (uint32_t)m_slot->m_storage.size();
+}
+
+uint32_t FrameSendBuffer::Length() const
+{
+    return m_length;
+}
+
+void FrameSendBuffer::Length(uint32_t value)
+{
+    if (value > Capacity())
+    {
+        throw winrt::hresult_invalid_argument();
+    }
+    m_length = value;
+}
+
+HRESULT __stdcall FrameSendBuffer::Buffer(uint8_t** value)
+{
+    *value = m_slot->m_storage.data();
+    return S_OK;
+}
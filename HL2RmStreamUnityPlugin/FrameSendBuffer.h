@@ -0,0 +1,99 @@
+#pragma once
+
+// Memory a frame is packed into and sent from without any further copies.
+// The first HeaderSize() bytes are headroom for the frame header, the payload
+// is packed right behind it, so header and pixels leave in a single socket
+// write. Slots are handed out by the FrameBufferPool.
+class FrameSendSlot
+{
+public:
+	explicit FrameSendSlot(size_t capacity);
+
+	FrameSendSlot(const FrameSendSlot&) = delete;
+	FrameSendSlot& operator=(const FrameSendSlot&) = delete;
+
+	uint8_t* Header()
+	{
+		return m_storage.data();
+	}
+
+	uint8_t* Payload()
+	{
+		return m_storage.data() + m_headerSize;
+	}
+
+	size_t Capacity() const
+	{
+		return m_storage.size();
+	}
+
+	size_t HeaderSize() const
+	{
+		return m_headerSize;
+	}
+
+	size_t PayloadCapacity() const
+	{
+		return m_storage.size() - m_headerSize;
+	}
+
+	void SetHeaderSize(size_t headerSize)
+	{
+		m_headerSize = (std::min)(headerSize, m_storage.size());
+	}
+
+private:
+	friend struct FrameSendBuffer;
+
+	std::vector<uint8_t> m_storage;
+	size_t m_headerSize = 0;
+};
+
+// IBuffer over the first length bytes of a slot, handed straight to
+// IOutputStream::WriteAsync or the multiplexed transport. Holds a reference to
+// the slot, so it only returns to the pool once the socket is done with it.
+struct FrameSendBuffer : winrt::implements<
+	FrameSendBuffer,
+	winrt::Windows::Storage::Streams::IBuffer,
+	::Windows::Storage::Streams::IBufferByteAccess>
+{
+	FrameSendBuffer(
+		std::shared_ptr<FrameSendSlot> slot,
+		uint32_t length);
+
+	uint32_t Capacity() const;
+	uint32_t Length() const;
+	void Length(uint32_t value);
+
+	HRESULT __stdcall Buffer(uint8_t** value) final;
+
+private:
+	std::shared_ptr<FrameSendSlot> m_slot;
+	uint32_t m_length;
+};
+
+// Per-streamer counters, bytesCopied proves the payload reaches the socket
+// without intermediate copies (it only counts plain memcpy's of frame data,
+// not the packing kernels that produce the payload).
+struct SendStats
+{
+	std::atomic<uint64_t> framesSent{ 0 };
+	std::atomic<uint64_t> bytesSent{ 0 };
+	std::atomic<uint64_t> bytesCopied{ 0 };
+	// frames skipped because the pool had no buffer left
+	std::atomic<uint64_t> framesDropped{ 0 };
+
+	void RecordFrame(uint64_t sent, uint64_t copied)
+	{
+		framesSent.fetch_add(1, std::memory_order_relaxed);
+		bytesSent.fetch_add(sent, std::memory_order_relaxed);
+		bytesCopied.fetch_add(copied, std::memory_order_relaxed);
+	}
+
+	// average memcpy'd bytes per sent frame
+	uint64_t BytesCopiedPerFrame() const
+	{
+		uint64_t frames = framesSent.load(std::memory_order_relaxed);
+		return frames ? bytesCopied.load(std::memory_order_relaxed) / frames : 0;
+	}
+};
@@ -17,8 +17,27 @@ static HANDLE imuConsentGiven;
 using namespace winrt::Windows::Perception::Spatial;
 
 
-ResearchModeSensorType depth_type = ResearchModeSensorType::DEPTH_LONG_THROW;
-
+// the encodings a stream can be fixed to with ConfigureSensor
+static bool SupportsEncoding(
+	StreamId id,
+	PayloadEncoding encoding)
+{
+	switch (encoding)
+	{
+	case PayloadEncoding::Raw:
+	case PayloadEncoding::Lz4:
+	case PayloadEncoding::DeltaLz4:
+		return id != StreamId::Imu;
+	case PayloadEncoding::Rvl:
+	case PayloadEncoding::Packed12:
+		return IsDepthStream(id);
+	case PayloadEncoding::QoiTiled:
+		return id == StreamId::PhotoVideo;
+	case PayloadEncoding::ImuBatch:
+		return id == StreamId::Imu;
+	}
+	return false;
+}
 
 
 void __stdcall HL2Stream::Initialize()
@@ -30,6 +49,32 @@ void __stdcall HL2Stream::Initialize()
 	SpatialLocator m_locator = SpatialLocator::GetDefault();
 	m_worldOrigin = m_locator.CreateStationaryFrameOfReferenceAtCurrentLocation().CoordinateSystem();
 
+	if (!m_pBufferPool)
+	{
+		m_pBufferPool = std::make_shared<FrameBufferPool>();
+	}
+
+	const bool pvTiledQoi = sensorSettings[(size_t)StreamId::PhotoVideo].codec == (int)PayloadEncoding::QoiTiled;
+	if ((useTiledQoi || useAdaptiveEncoding || pvTiledQoi) && !m_pWorkerPool)
+	{
+		m_pWorkerPool = std::make_shared<WorkerPool>(WorkerPool::DefaultThreadCount());
+	}
+
+	if (useMultiplexedTransport && !m_pTransport)
+	{
+		m_pTransport = std::make_shared<MultiplexedStreamTransport>(L"23950", L"21120");
+	}
+
+	if (useAdaptiveFrameRate && !m_pRateController)
+	{
+		m_pRateController = std::make_shared<RateController>(kStreamCount, latencyBound);
+		if (m_pTransport)
+		{
+			// all frames go through the transport, it sees them leave
+			m_pTransport->SetRateController(m_pRateController);
+		}
+	}
+
 	InitializeResearchModeSensors();
 	InitializeResearchModeProcessing();
 	auto processOp{ InitializeVideoFrameProcessorAsync() };
@@ -54,22 +99,141 @@ void HL2Stream::StreamingToggle()
 	}
 }
 
-void HL2Stream::StartStreaming()
+void HL2Stream::EnableMultiplexedTransport(bool enable)
+{
+	useMultiplexedTransport = enable;
+}
+
+void HL2Stream::EnableDepthCompression(bool enable)
+{
+	useDepthCompression = enable;
+}
+
+void HL2Stream::EnableDepthBitPacking(bool enable)
+{
+	useDepthBitPacking = enable;
+}
+
+void HL2Stream::EnableTemporalDelta(bool enable, int keyframeInterval)
+{
+	useTemporalDelta = enable;
+	if (keyframeInterval > 0)
+	{
+		temporalKeyframeInterval = keyframeInterval;
+	}
+}
+
+void HL2Stream::SetTemporalCompression(bool previousFrameDictionary, int acceleration)
+{
+	temporalMethod = previousFrameDictionary ? TemporalCodec::Method::Lz4Dictionary : TemporalCodec::Method::XorDelta;
+	temporalAcceleration = acceleration > 0 ? acceleration : 1;
+}
+
+void HL2Stream::EnableTiledQoi(bool enable, int bandCount)
+{
+	useTiledQoi = enable;
+	if (bandCount > 0)
+	{
+		qoiBandCount = bandCount;
+	}
+}
+
+void HL2Stream::SetPvScaleFactor(int scaleFactor)
+{
+	pvScaleFactor = scaleFactor;
+}
+
+void HL2Stream::EnableAdaptiveEncoding(bool enable, float cpuBudget)
+{
+	useAdaptiveEncoding = enable;
+	if (cpuBudget > 0.0f)
+	{
+		adaptiveCpuBudget = cpuBudget;
+	}
+}
+
+void HL2Stream::EnableAdaptiveFrameRate(bool enable, float latencyBoundMs)
+{
+	useAdaptiveFrameRate = enable;
+	if (latencyBoundMs > 0.0f)
+	{
+		latencyBound = latencyBoundMs / 1000.0;
+	}
+}
+
+void HL2Stream::EnableCompactPose(bool enable, bool quantized)
+{
+	if (!enable)
+	{
+		poseFormat = PoseCodec::Format::Matrix;
+	}
+	else
+	{
+		poseFormat = quantized ? PoseCodec::Format::Quantized : PoseCodec::Format::Quaternion;
+	}
+}
+
+void HL2Stream::EnableImuStreaming(bool enable)
 {
+	sensorSettings[(size_t)StreamId::Imu].enabled = enable;
+}
+
+void HL2Stream::ConfigureSensor(int sensor, bool enable, int port, int requestPort, float targetRate, int codec)
+{
+	if (sensor < 0 || sensor >= (int)kStreamCount)
+	{
 #if DBG_ENABLE_INFO_LOGGING
-	OutputDebugStringW(L"HL2Stream::StartStreaming: Starting streaming!\n");
+		OutputDebugStringW(L"HL2Stream::ConfigureSensor: Unknown sensor.\n");
 #endif
-	// start the AHAT processor
-	m_pAHATProcessor->Start(); // Comment this line to disable sensor
+		return;
+	}
 
-	// start the LF processor
-	m_pLFProcessor->Start(); // Comment this line to disable sensor
+	SensorSettings& settings = sensorSettings[sensor];
+	settings.enabled = enable;
+	settings.port = port > 0 && port <= UINT16_MAX ? port : 0;
+	settings.requestPort = requestPort > 0 && requestPort <= UINT16_MAX ? requestPort : 0;
+	settings.targetRate = targetRate > 0.0f ? targetRate : 0.0f;
+	settings.codec = SensorSettings::kDefaultCodec;
+	if (codec != SensorSettings::kDefaultCodec)
+	{
+		if (codec >= 0 && codec <= UINT16_MAX && SupportsEncoding((StreamId)sensor, (PayloadEncoding)codec))
+		{
+			settings.codec = codec;
+		}
+#if DBG_ENABLE_INFO_LOGGING
+		else
+		{
+			wchar_t msgBuffer[200];
+			swprintf_s(msgBuffer, L"HL2Stream::ConfigureSensor: Sensor %d does not support encoding %d, using the defaults.\n",
+				sensor, codec);
+			OutputDebugStringW(msgBuffer);
+		}
+#endif
+	}
+}
 
-	// start the RF processor
-	m_pRFProcessor->Start();  // Comment this line to disable sensor
+void HL2Stream::StartStreaming()
+{
+#if DBG_ENABLE_INFO_LOGGING
+	OutputDebugStringW(L"HL2Stream::StartStreaming: Starting streaming!\n");
+#endif
+	// start the processors of the enabled sensors (see ConfigureSensor)
+	for (const auto& processor : ResearchModeProcessors())
+	{
+		processor->Start();
+	}
 
 	// start the Video video processor
-	m_pVideoFrameProcessor->StartAsync(); // Comment this line to disable sensor
+	if (m_pVideoFrameProcessor)
+	{
+		m_pVideoFrameProcessor->StartAsync();
+	}
+
+	// start the IMU streamer
+	if (m_pImuStreamer)
+	{
+		m_pImuStreamer->Start();
+	}
 
 
 	isStreaming = true;
@@ -77,14 +241,21 @@ void HL2Stream::StartStreaming()
 
 void HL2Stream::StopStreaming()
 {
-	if (m_pAHATProcessor && m_pAHATProcessor->isRunning)
+	for (const auto& processor : ResearchModeProcessors())
 	{
-		m_pAHATProcessor->Stop();
+		if (processor->isRunning)
+		{
+			processor->Stop();
+		}
 	}
-	if (m_pVideoFrameStreamer && m_pVideoFrameProcessor->isRunning)
+	if (m_pVideoFrameProcessor && m_pVideoFrameProcessor->isRunning)
 	{
 		m_pVideoFrameProcessor->Stop();
 	}
+	if (m_pImuStreamer && m_pImuStreamer->isRunning)
+	{
+		m_pImuStreamer->Stop();
+	}
 	isStreaming = false;
 }
 
@@ -94,18 +265,77 @@ winrt::Windows::Foundation::IAsyncAction HL2Stream::InitializeVideoFrameProcesso
 	if (m_videoFrameProcessorOperation &&
 		m_videoFrameProcessorOperation.Status() == winrt::Windows::Foundation::AsyncStatus::Completed)
 	{
-		return;
+		co_return;
+	}
+
+	const SensorSettings& settings = sensorSettings[(size_t)StreamId::PhotoVideo];
+	if (!settings.enabled)
+	{
+		co_return;
 	}
 
 	// the frame processor
-	m_pVideoFrameProcessor = std::make_unique<VideoCameraFrameProcessor>(L"21110");
-	m_pVideoFrameStreamer = std::make_shared<VideoCameraStreamer>(m_worldOrigin, L"23940");
+	m_pVideoFrameProcessor = std::make_unique<VideoCameraFrameProcessor>(
+		m_pTransport ? L"" : settings.RequestPortName(StreamId::PhotoVideo));
+	m_pVideoFrameStreamer = std::make_shared<VideoCameraStreamer>(
+		m_worldOrigin, settings.PortName(StreamId::PhotoVideo), pvScaleFactor, m_pTransport, m_pBufferPool);
 	if (!m_pVideoFrameStreamer.get())
 	{
 		throw winrt::hresult(E_POINTER);
 	}
+	if (settings.codec == (int)PayloadEncoding::QoiTiled)
+	{
+		m_pVideoFrameStreamer->SetTiledQoi(m_pWorkerPool, qoiBandCount);
+	}
+	else if (settings.codec == (int)PayloadEncoding::DeltaLz4)
+	{
+		m_pVideoFrameStreamer->SetTemporalDelta(temporalKeyframeInterval, TemporalCodec::Method::Lz4Dictionary,
+			temporalAcceleration);
+	}
+	else if (settings.codec == (int)PayloadEncoding::Lz4)
+	{
+		m_pVideoFrameStreamer->EnableLz4();
+	}
+	else if (settings.codec == SensorSettings::kDefaultCodec)
+	{
+		// QOI wins over the temporal coding unless the codec controller picks
+		if (useTiledQoi || useAdaptiveEncoding)
+		{
+			m_pVideoFrameStreamer->SetTiledQoi(m_pWorkerPool, qoiBandCount);
+		}
+		// the colour image changes everywhere with camera motion, only the
+		// dictionary coding pays off there
+		if (useTemporalDelta && temporalMethod == TemporalCodec::Method::Lz4Dictionary)
+		{
+			m_pVideoFrameStreamer->SetTemporalDelta(temporalKeyframeInterval, temporalMethod, temporalAcceleration);
+		}
+		if (useAdaptiveEncoding)
+		{
+			m_pVideoFrameStreamer->EnableAdaptiveEncoding(adaptiveCpuBudget);
+		}
+	}
+	m_pVideoFrameStreamer->SetPoseFormat(poseFormat);
+	if (m_pRateController)
+	{
+		m_pRateController->AddStream((size_t)StreamId::PhotoVideo);
+		m_pVideoFrameStreamer->SetRateController(m_pRateController);
+		m_pVideoFrameProcessor->SetRateController(m_pRateController);
+	}
+
+	VideoCameraFrameProcessor* pProcessor = m_pVideoFrameProcessor.get();
+	// a frame dropped by the pipeline never reaches the receiver, give its
+	// credit back so the window does not shrink
+	m_pVideoFrameStreamer->EnablePipeline(
+		[pProcessor]() { pProcessor->HandleRequest(L"1"); });
+
+	if (m_pTransport)
+	{
+		m_pTransport->RegisterStream(StreamId::PhotoVideo, 1,
+			[pProcessor](const wchar_t* request) { return pProcessor->HandleRequest(request); },
+			[pProcessor]() { pProcessor->HandleRequest(L"1"); });
+	}
 	// initialize the frame processor with a streamer sink
-	co_await m_pVideoFrameProcessor->InitializeAsync(m_pVideoFrameStreamer);
+	co_await m_pVideoFrameProcessor->InitializeAsync(m_pVideoFrameStreamer, settings.MinFrameInterval());
 }
 
 
@@ -114,6 +344,7 @@ void HL2Stream::InitializeResearchModeSensors()
 	HRESULT hr = S_OK;
 	size_t sensorCount = 0;
 	camConsentGiven = CreateEvent(nullptr, true, false, nullptr);
+	imuConsentGiven = CreateEvent(nullptr, true, false, nullptr);
 
 	// Load research mode library
 	HMODULE hrResearchMode = LoadLibraryA("ResearchModeAPI");
@@ -151,60 +382,66 @@ void HL2Stream::InitializeResearchModeSensors()
 
 	for (const auto& sensorDescriptor : m_sensorDescriptors)
 	{
-		wchar_t msgBuffer[200];
-		if (depth_type == DEPTH_AHAT && sensorDescriptor.sensorType == DEPTH_AHAT)
-		{
-			winrt::check_hresult(m_pSensorDevice->GetSensor(sensorDescriptor.sensorType, &m_pAHATSensor));
-
-			swprintf_s(msgBuffer, L"HL2Stream::InitializeResearchModeSensors: Sensor %ls\n",
-				m_pAHATSensor->GetFriendlyName());
-			
-			OutputDebugStringW(msgBuffer);
-		}
-
-		else if (depth_type == DEPTH_LONG_THROW && sensorDescriptor.sensorType == DEPTH_LONG_THROW)
+		// only the sensors of the sensor set are opened
+		StreamId id = StreamId::Depth;
+		IResearchModeSensor** ppSensor = nullptr;
+		switch (sensorDescriptor.sensorType)
 		{
-			winrt::check_hresult(m_pSensorDevice->GetSensor(sensorDescriptor.sensorType, &m_pAHATSensor));
-
-			swprintf_s(msgBuffer, L"HL2Stream::InitializeResearchModeSensors: Sensor %ls\n",
-				m_pAHATSensor->GetFriendlyName());
-
-			OutputDebugStringW(msgBuffer);
+		case DEPTH_LONG_THROW:
+			id = StreamId::Depth;
+			ppSensor = &m_pLongThrowSensor;
+			break;
+		case DEPTH_AHAT:
+			id = StreamId::Ahat;
+			ppSensor = &m_pAHATSensor;
+			break;
+		case LEFT_FRONT:
+			id = StreamId::LeftFront;
+			ppSensor = &m_pLFCameraSensor;
+			break;
+		case RIGHT_FRONT:
+			id = StreamId::RightFront;
+			ppSensor = &m_pRFCameraSensor;
+			break;
+		case LEFT_LEFT:
+			id = StreamId::LeftLeft;
+			ppSensor = &m_pLLCameraSensor;
+			break;
+		case RIGHT_RIGHT:
+			id = StreamId::RightRight;
+			ppSensor = &m_pRRCameraSensor;
+			break;
+		case IMU_ACCEL:
+			id = StreamId::Imu;
+			ppSensor = &m_pAccelSensor;
+			break;
+		case IMU_GYRO:
+			id = StreamId::Imu;
+			ppSensor = &m_pGyroSensor;
+			break;
+		case IMU_MAG:
+			id = StreamId::Imu;
+			ppSensor = &m_pMagSensor;
+			break;
+		default:
+			break;
 		}
 
-		if (sensorDescriptor.sensorType == LEFT_FRONT)
+		// the front cameras are opened for the stereo stream as well
+		const bool stereo = (id == StreamId::LeftFront || id == StreamId::RightFront) &&
+			sensorSettings[(size_t)StreamId::Stereo].enabled;
+		if (!ppSensor || !(sensorSettings[(size_t)id].enabled || stereo))
 		{
-			// TODO: Add options to Unity Interface for which sensors to activate
-			/*if (std::find(m_kenabledsensortypes.begin(), m_kenabledsensortypes.end(), left_front) == m_kenabledsensortypes.end())
-			{
-				continue;
-			}*/
-
-			winrt::check_hresult(m_pSensorDevice->GetSensor(sensorDescriptor.sensorType, &m_pLFCameraSensor));
-
-			swprintf_s(msgBuffer, L"HL2Stream::InitializeResearchModeSensors: Sensor %ls\n",
-				m_pLFCameraSensor->GetFriendlyName());
-
-			OutputDebugStringW(msgBuffer);
+			continue;
 		}
 
+		winrt::check_hresult(m_pSensorDevice->GetSensor(sensorDescriptor.sensorType, ppSensor));
 
-		if (sensorDescriptor.sensorType == RIGHT_FRONT)
-		{
-			/*if (std::find(m_kenabledsensortypes.begin(), m_kenabledsensortypes.end(), left_front) == m_kenabledsensortypes.end())
-			{
-				continue;
-			}*/
-
-			winrt::check_hresult(m_pSensorDevice->GetSensor(sensorDescriptor.sensorType, &m_pRFCameraSensor));
-
-			swprintf_s(msgBuffer, L"HL2Stream::InitializeResearchModeSensors: Sensor %ls\n",
-				m_pRFCameraSensor->GetFriendlyName());
-
-			OutputDebugStringW(msgBuffer);
-		}
-
+		wchar_t msgBuffer[200];
+		swprintf_s(msgBuffer, L"HL2Stream::InitializeResearchModeSensors: Sensor %ls\n",
+			(*ppSensor)->GetFriendlyName());
 
+		OutputDebugStringW(msgBuffer);
 	}
 	OutputDebugStringW(L"HL2Stream::InitializeResearchModeSensors: Done.\n");
 	return;
@@ -217,43 +454,207 @@ void HL2Stream::InitializeResearchModeProcessing()
 	GUID guid;
 	GetRigNodeId(guid);
 
-	// initialize the AHAT depth streamer
-	auto ahatStreamer = std::make_shared<ResearchModeFrameStreamer>(L"23941", guid, m_worldOrigin);
-	m_pAHATStreamer = ahatStreamer;
+	// one pose sampler for all Research Mode streamers, they share the rig
+	m_pRigPoseService = std::make_shared<RigPoseService>(guid, m_worldOrigin);
 
-	if (m_pAHATSensor)
+	// the cameras that are not in the sensor set were not opened and get no
+	// streamer, processor or socket. The two depth modes are separate
+	// streams with their own rate, encoding and buffer sizes.
+	InitializeResearchModeStream(StreamId::Depth, m_pLongThrowSensor, guid, m_pLongThrowStreamer, m_pLongThrowProcessor);
+	InitializeResearchModeStream(StreamId::Ahat, m_pAHATSensor, guid, m_pAHATStreamer, m_pAHATProcessor);
+	if (sensorSettings[(size_t)StreamId::Stereo].enabled)
+	{
+		// a sensor can only be read by one processor, the stereo stream
+		// takes over both front cameras
+		InitializeStereoStream(guid);
+	}
+	else
+	{
+		InitializeResearchModeStream(StreamId::LeftFront, m_pLFCameraSensor, guid, m_pLFStreamer, m_pLFProcessor);
+		InitializeResearchModeStream(StreamId::RightFront, m_pRFCameraSensor, guid, m_pRFStreamer, m_pRFProcessor);
+	}
+	InitializeResearchModeStream(StreamId::LeftLeft, m_pLLCameraSensor, guid, m_pLLStreamer, m_pLLProcessor);
+	InitializeResearchModeStream(StreamId::RightRight, m_pRRCameraSensor, guid, m_pRRStreamer, m_pRRProcessor);
+
+	// initialize the IMU streamer, all three sensors go out as one stream
+	if (m_pAccelSensor || m_pGyroSensor || m_pMagSensor)
 	{
-		auto processor = std::make_shared<ResearchModeFrameProcessor>(
-			m_pAHATSensor, camConsentGiven, &camAccessCheck, 0, m_pAHATStreamer, L"21111");
+		const SensorSettings& settings = sensorSettings[(size_t)StreamId::Imu];
+		auto imuStreamer = std::make_shared<ImuStreamer>(
+			m_pAccelSensor, m_pGyroSensor, m_pMagSensor, imuConsentGiven, &imuAccessCheck,
+			settings.PortName(StreamId::Imu), m_pTransport ? L"" : settings.RequestPortName(StreamId::Imu),
+			m_pTransport, m_pBufferPool);
+		m_pImuStreamer = imuStreamer;
+		imuStreamer->SetPoseFormat(poseFormat);
+		imuStreamer->SetPoseService(m_pRigPoseService);
+
+		if (m_pTransport)
+		{
+			m_pTransport->RegisterStream(StreamId::Imu, 1,
+				[imuStreamer](const wchar_t* request) { return imuStreamer->HandleRequest(request); },
+				[imuStreamer]() { imuStreamer->HandleRequest(L"1"); });
+		}
+	}
+}
 
-		m_pAHATProcessor = processor;
+void HL2Stream::InitializeResearchModeStream(
+	StreamId id,
+	IResearchModeSensor* pSensor,
+	const GUID& guid,
+	std::shared_ptr<ResearchModeFrameStreamer>& streamer,
+	std::shared_ptr<ResearchModeFrameProcessor>& processor)
+{
+	if (!pSensor)
+	{
+		return;
 	}
 
+	const SensorSettings& settings = sensorSettings[(size_t)id];
+	streamer = CreateResearchModeStreamer(id, guid);
 
-	// initialize the VLC Left Front streamer
-	auto lfStreamer = std::make_shared<ResearchModeFrameStreamer>(L"23942", guid, m_worldOrigin);
-	m_pLFStreamer = lfStreamer;
+	processor = std::make_shared<ResearchModeFrameProcessor>(
+		pSensor, camConsentGiven, &camAccessCheck, settings.MinFrameInterval(), streamer,
+		m_pTransport ? L"" : settings.RequestPortName(id));
 
-	if (m_pLFCameraSensor)
+	EnableSendPipeline(streamer, processor);
+	EnableRateControl(id, streamer, processor);
+	RegisterMultiplexedStream(id, processor);
+}
+
+void HL2Stream::InitializeStereoStream(const GUID& guid)
+{
+	if (!m_pLFCameraSensor || !m_pRFCameraSensor)
 	{
-		auto processor = std::make_shared<ResearchModeFrameProcessor>(
-			m_pLFCameraSensor, camConsentGiven, &camAccessCheck, 0, m_pLFStreamer, L"21112");
+		return;
+	}
 
-		m_pLFProcessor = processor;
+#if DBG_ENABLE_INFO_LOGGING
+	if (sensorSettings[(size_t)StreamId::LeftFront].enabled || sensorSettings[(size_t)StreamId::RightFront].enabled)
+	{
+		OutputDebugStringW(L"HL2Stream::InitializeStereoStream: The front cameras only stream as stereo pairs.\n");
 	}
+#endif
 
+	const StreamId id = StreamId::Stereo;
+	const SensorSettings& settings = sensorSettings[(size_t)id];
+	m_pStereoStreamer = CreateResearchModeStreamer(id, guid);
 
-	// initialize the VLC Right Front streamer
-	auto rfStreamer = std::make_shared<ResearchModeFrameStreamer>(L"23943", guid, m_worldOrigin);
-	m_pRFStreamer = rfStreamer;
+	m_pStereoProcessor = std::make_shared<StereoFrameProcessor>(
+		m_pLFCameraSensor, m_pRFCameraSensor, camConsentGiven, &camAccessCheck, settings.MinFrameInterval(),
+		m_pStereoStreamer, m_pTransport ? L"" : settings.RequestPortName(id));
 
-	if (m_pRFCameraSensor)
+	EnableSendPipeline(m_pStereoStreamer, m_pStereoProcessor);
+	EnableRateControl(id, m_pStereoStreamer, m_pStereoProcessor);
+	RegisterMultiplexedStream(id, m_pStereoProcessor);
+}
+
+std::shared_ptr<ResearchModeFrameStreamer> HL2Stream::CreateResearchModeStreamer(
+	StreamId id,
+	const GUID& guid)
+{
+	auto streamer = std::make_shared<ResearchModeFrameStreamer>(
+		sensorSettings[(size_t)id].PortName(id), guid, m_worldOrigin, m_pTransport, id, m_pBufferPool);
+	ConfigureEncoding(id, streamer);
+	streamer->SetPoseFormat(poseFormat);
+	streamer->SetPoseService(m_pRigPoseService);
+	return streamer;
+}
+
+void HL2Stream::ConfigureEncoding(
+	StreamId id,
+	std::shared_ptr<ResearchModeFrameStreamer> streamer)
+{
+	const int codec = sensorSettings[(size_t)id].codec;
+	if (codec == (int)PayloadEncoding::DeltaLz4)
+	{
+		streamer->SetTemporalDelta(temporalKeyframeInterval, temporalMethod, temporalAcceleration);
+		return;
+	}
+	if (codec != SensorSettings::kDefaultCodec)
+	{
+		streamer->SetEncoding((PayloadEncoding)codec);
+		return;
+	}
+
+	if (IsDepthStream(id) && useDepthCompression)
+	{
+		streamer->SetEncoding(PayloadEncoding::Rvl);
+	}
+	else if (IsDepthStream(id) && useDepthBitPacking)
+	{
+		streamer->SetEncoding(PayloadEncoding::Packed12);
+	}
+	if (useTemporalDelta)
+	{
+		streamer->SetTemporalDelta(temporalKeyframeInterval, temporalMethod, temporalAcceleration);
+	}
+	if (useAdaptiveEncoding)
+	{
+		streamer->EnableAdaptiveEncoding(adaptiveCpuBudget);
+	}
+}
+
+std::vector<std::shared_ptr<ResearchModeFrameProcessor>> HL2Stream::ResearchModeProcessors()
+{
+	std::vector<std::shared_ptr<ResearchModeFrameProcessor>> processors;
+	for (const auto& processor : { m_pLongThrowProcessor, m_pAHATProcessor, m_pLFProcessor, m_pRFProcessor,
+		m_pLLProcessor, m_pRRProcessor, m_pStereoProcessor })
+	{
+		if (processor)
+		{
+			processors.push_back(processor);
+		}
+	}
+	return processors;
+}
+
+void HL2Stream::RegisterMultiplexedStream(
+	StreamId id,
+	std::shared_ptr<ResearchModeFrameProcessor> processor)
+{
+	if (!m_pTransport)
 	{
-		auto processor = std::make_shared<ResearchModeFrameProcessor>(
-			m_pRFCameraSensor, camConsentGiven, &camAccessCheck, 0, m_pRFStreamer, L"21113");
+		return;
+	}
+
+	// all streams share the link equally by bytes; a message the transport
+	// drops never reaches the receiver, so its credit is given back
+	m_pTransport->RegisterStream(id, 1,
+		[processor](const wchar_t* request) { return processor->HandleRequest(request); },
+		[processor]() { processor->HandleRequest(L"1"); });
+}
 
-		m_pRFProcessor = processor;
+void HL2Stream::EnableSendPipeline(
+	std::shared_ptr<ResearchModeFrameStreamer> streamer,
+	std::shared_ptr<ResearchModeFrameProcessor> processor)
+{
+	// a frame dropped by the pipeline never reaches the receiver, give its
+	// credit back so the window does not shrink. The streamer outlives the
+	// processor, hence the weak reference.
+	std::weak_ptr<ResearchModeFrameProcessor> weakProcessor = processor;
+	streamer->EnablePipeline([weakProcessor]()
+		{
+			if (auto processor = weakProcessor.lock())
+			{
+				processor->HandleRequest(L"1");
+			}
+		});
+}
+
+void HL2Stream::EnableRateControl(
+	StreamId id,
+	std::shared_ptr<ResearchModeFrameStreamer> streamer,
+	std::shared_ptr<ResearchModeFrameProcessor> processor)
+{
+	if (!m_pRateController)
+	{
+		return;
 	}
+
+	// equal weights, like the streams of the multiplexed transport
+	m_pRateController->AddStream((size_t)id);
+	streamer->SetRateController(m_pRateController);
+	processor->SetRateController(m_pRateController, id);
 }
 
 void HL2Stream::CamAccessOnComplete(ResearchModeSensorConsent consent)
@@ -277,6 +678,10 @@ void HL2Stream::DisableSensors()
 	{
 		m_pAHATSensor->Release();
 	}
+	if (m_pLongThrowSensor)
+	{
+		m_pLongThrowSensor->Release();
+	}
 	if (m_pLFCameraSensor)
 	{
 		m_pLFCameraSensor->Release();
@@ -285,6 +690,26 @@ void HL2Stream::DisableSensors()
 	{
 		m_pRFCameraSensor->Release();
 	}
+	if (m_pLLCameraSensor)
+	{
+		m_pLLCameraSensor->Release();
+	}
+	if (m_pRRCameraSensor)
+	{
+		m_pRRCameraSensor->Release();
+	}
+	if (m_pAccelSensor)
+	{
+		m_pAccelSensor->Release();
+	}
+	if (m_pGyroSensor)
+	{
+		m_pGyroSensor->Release();
+	}
+	if (m_pMagSensor)
+	{
+		m_pMagSensor->Release();
+	}
 	if (m_pSensorDevice)
 	{
 		m_pSensorDevice->EnableEyeSelection();
@@ -12,6 +12,78 @@ namespace HL2Stream
 
 	FUNCTIONS_EXPORTS_API void StreamingToggle();
 
+	// Call before Initialize to send all sensors over one connection
+	// (see MultiplexedStreamTransport) instead of one socket pair per sensor.
+	FUNCTIONS_EXPORTS_API void EnableMultiplexedTransport(bool enable);
+
+	// Call before Initialize to RVL code the depth + AB frames (see
+	// DepthCodec). The receiver picks the decoder from the frame header.
+	FUNCTIONS_EXPORTS_API void EnableDepthCompression(bool enable);
+
+	// Call before Initialize to send depth + AB with 12 bits per pixel, a
+	// fixed 25% cut at almost no CPU cost. Compression takes precedence.
+	FUNCTIONS_EXPORTS_API void EnableDepthBitPacking(bool enable);
+
+	// Call before Initialize to send the VLC frames, and depth + AB frames
+	// that are not otherwise encoded, as LZ4 compressed deltas to the previous
+	// frame with a keyframe every keyframeInterval frames (see TemporalCodec).
+	FUNCTIONS_EXPORTS_API void EnableTemporalDelta(bool enable, int keyframeInterval);
+
+	// Call before Initialize to tune EnableTemporalDelta: code every frame
+	// with the previous one as LZ4 dictionary instead of XORing them (better
+	// with motion, and then also used for the PV frames), and LZ4's
+	// acceleration (1 = best ratio, higher = faster).
+	FUNCTIONS_EXPORTS_API void SetTemporalCompression(bool previousFrameDictionary, int acceleration);
+
+	// Call before Initialize to send the PV frames as QOI images in bandCount
+	// bands, coded in parallel on all cores (see TiledQoi). Takes precedence
+	// over the temporal coding of the PV frames.
+	FUNCTIONS_EXPORTS_API void EnableTiledQoi(bool enable, int bandCount);
+
+	// Call before Initialize to send the PV frames downscaled by scaleFactor
+	// (1, 2 or 4, others send full size), box-filtered on the device. The
+	// frame header carries the reduced size and focal lengths.
+	FUNCTIONS_EXPORTS_API void SetPvScaleFactor(int scaleFactor);
+
+	// Call before Initialize to pick the encoding of every frame at run time
+	// (see CodecController): raw while the link keeps up, otherwise the best
+	// of LZ4, 12-bit packing, RVL, tiled QOI and the temporal coding (where
+	// enabled) that fits cpuBudget, the share of one core each stream may
+	// spend encoding. Overrides the fixed depth and PV encodings above.
+	FUNCTIONS_EXPORTS_API void EnableAdaptiveEncoding(bool enable, float cpuBudget);
+
+	// Call before Initialize to adapt the frame rates of the camera streams
+	// to the measured link capacity (see RateController): every stream is
+	// limited to its fair share of what the link carries, and frames that
+	// would wait longer than latencyBoundMs are skipped. The IMU is never
+	// limited.
+	FUNCTIONS_EXPORTS_API void EnableAdaptiveFrameRate(bool enable, float latencyBoundMs);
+
+	// Call before Initialize to send the camera / rig to world transform in
+	// the frame header as quaternion and translation (28 instead of 64 bytes)
+	// or, with quantized, as 20 byte smallest three quaternion and fixed point
+	// translation (see PoseCodec for the error bounds).
+	FUNCTIONS_EXPORTS_API void EnableCompactPose(bool enable, bool quantized);
+
+	// Call before Initialize to stream the accelerometer, gyroscope and
+	// magnetometer samples (see ImuStreamer) on TCP 23944 / UDP 21114, or as
+	// stream 4 of the multiplexed connection.
+	FUNCTIONS_EXPORTS_API void EnableImuStreaming(bool enable);
+
+	// Call before Initialize to enable or disable one sensor and set how it
+	// is streamed. sensor is the stream id: 0 PV, 1 Long Throw depth, 2 left
+	// front, 3 right front, 4 IMU, 5 left left, 6 right right, 7 AHAT depth,
+	// 8 left and right front as stereo pairs (see StereoFrameProcessor; takes
+	// over both front cameras, 2 and 3 then do not stream).
+	// port and requestPort replace the default TCP and UDP ports
+	// (23940 + id, 21110 + id) unless 0, targetRate limits the frames per
+	// second unless 0, and codec fixes the payload encoding of the stream (a
+	// PayloadEncoding id the sensor supports) unless -1, which follows the
+	// options above. The IMU only takes enable and the ports. PV, Long Throw
+	// and the front cameras are enabled by default.
+	FUNCTIONS_EXPORTS_API void ConfigureSensor(int sensor, bool enable, int port, int requestPort,
+		float targetRate, int codec);
+
 	void StartStreaming();
 	
 	void StopStreaming();
@@ -25,13 +97,81 @@ namespace HL2Stream
 
 	void InitializeResearchModeProcessing();
 
+	// creates streamer and processor of a Research Mode camera, unless the
+	// sensor was not opened
+	void InitializeResearchModeStream(
+		StreamId id,
+		IResearchModeSensor* pSensor,
+		const GUID& guid,
+		std::shared_ptr<ResearchModeFrameStreamer>& streamer,
+		std::shared_ptr<ResearchModeFrameProcessor>& processor);
+
+	// the same for the stereo stream of the two front cameras
+	void InitializeStereoStream(const GUID& guid);
+
+	// streamer of stream id with the encoding and pose options applied
+	std::shared_ptr<ResearchModeFrameStreamer> CreateResearchModeStreamer(
+		StreamId id,
+		const GUID& guid);
+
+	// applies the stream's codec setting, or the global encoding options
+	void ConfigureEncoding(
+		StreamId id,
+		std::shared_ptr<ResearchModeFrameStreamer> streamer);
+
+	// the processors of the Research Mode cameras that stream
+	std::vector<std::shared_ptr<ResearchModeFrameProcessor>> ResearchModeProcessors();
+
 	void GetRigNodeId(GUID& outGuid);
 
+	void RegisterMultiplexedStream(
+		StreamId id,
+		std::shared_ptr<ResearchModeFrameProcessor> processor);
+
+	void EnableSendPipeline(
+		std::shared_ptr<ResearchModeFrameStreamer> streamer,
+		std::shared_ptr<ResearchModeFrameProcessor> processor);
+
+	// hands the rate controller to the stream's streamer and processor,
+	// if EnableAdaptiveFrameRate is set
+	void EnableRateControl(
+		StreamId id,
+		std::shared_ptr<ResearchModeFrameStreamer> streamer,
+		std::shared_ptr<ResearchModeFrameProcessor> processor);
+
 	static void CamAccessOnComplete(ResearchModeSensorConsent consent);
 	static void ImuAccessOnComplete(ResearchModeSensorConsent consent);
 
 	bool isStreaming = false;
 
+	bool useMultiplexedTransport = false;
+	bool useDepthCompression = false;
+	bool useDepthBitPacking = false;
+	bool useTemporalDelta = false;
+	int temporalKeyframeInterval = TemporalCodec::kDefaultKeyframeInterval;
+	TemporalCodec::Method temporalMethod = TemporalCodec::Method::XorDelta;
+	int temporalAcceleration = 1;
+	bool useTiledQoi = false;
+	int qoiBandCount = TiledQoi::kDefaultBandCount;
+	int pvScaleFactor = 1;
+	bool useAdaptiveEncoding = false;
+	double adaptiveCpuBudget = CodecController::kDefaultCpuBudget;
+	bool useAdaptiveFrameRate = false;
+	double latencyBound = RateController::kDefaultLatencyBound;
+	PoseCodec::Format poseFormat = PoseCodec::Format::Matrix;
+	// the sensor set, indexed by StreamId
+	SensorSettings sensorSettings[kStreamCount] = {
+		{ true }, { true }, { true }, { true }, { false }, { false }, { false }, { false }, { false } };
+	std::shared_ptr<MultiplexedStreamTransport> m_pTransport = nullptr;
+	// threads of the tiled QOI encoder
+	std::shared_ptr<WorkerPool> m_pWorkerPool = nullptr;
+	// send buffers of all streamers
+	std::shared_ptr<FrameBufferPool> m_pBufferPool = nullptr;
+	// rig poses of the Research Mode streamers
+	std::shared_ptr<RigPoseService> m_pRigPoseService = nullptr;
+	// frame rates of all camera streams
+	std::shared_ptr<RateController> m_pRateController = nullptr;
+
 	winrt::Windows::Perception::Spatial::SpatialCoordinateSystem
 		m_worldOrigin{ nullptr };
 
@@ -46,14 +186,33 @@ namespace HL2Stream
 
 	// rm sensors processing & streaming
 	IResearchModeSensor* m_pAHATSensor = nullptr;
+	IResearchModeSensor* m_pLongThrowSensor = nullptr;
 	IResearchModeSensor* m_pLFCameraSensor = nullptr;
 	IResearchModeSensor* m_pRFCameraSensor = nullptr;
+	IResearchModeSensor* m_pLLCameraSensor = nullptr;
+	IResearchModeSensor* m_pRRCameraSensor = nullptr;
 
 	std::shared_ptr<ResearchModeFrameProcessor> m_pAHATProcessor;
+	std::shared_ptr<ResearchModeFrameProcessor> m_pLongThrowProcessor;
 	std::shared_ptr<ResearchModeFrameProcessor> m_pLFProcessor;
 	std::shared_ptr<ResearchModeFrameProcessor> m_pRFProcessor;
+	std::shared_ptr<ResearchModeFrameProcessor> m_pLLProcessor;
+	std::shared_ptr<ResearchModeFrameProcessor> m_pRRProcessor;
+	// LF + RF pairs, a StereoFrameProcessor
+	std::shared_ptr<ResearchModeFrameProcessor> m_pStereoProcessor;
 
 	std::shared_ptr<ResearchModeFrameStreamer> m_pAHATStreamer = nullptr;
+	std::shared_ptr<ResearchModeFrameStreamer> m_pLongThrowStreamer = nullptr;
 	std::shared_ptr<ResearchModeFrameStreamer> m_pLFStreamer = nullptr;
 	std::shared_ptr<ResearchModeFrameStreamer> m_pRFStreamer = nullptr;
+	std::shared_ptr<ResearchModeFrameStreamer> m_pLLStreamer = nullptr;
+	std::shared_ptr<ResearchModeFrameStreamer> m_pRRStreamer = nullptr;
+	std::shared_ptr<ResearchModeFrameStreamer> m_pStereoStreamer = nullptr;
+
+	// imu sensors streaming
+	IResearchModeSensor* m_pAccelSensor = nullptr;
+	IResearchModeSensor* m_pGyroSensor = nullptr;
+	IResearchModeSensor* m_pMagSensor = nullptr;
+
+	std::shared_ptr<ImuStreamer> m_pImuStreamer = nullptr;
 }
\ No newline at end of file
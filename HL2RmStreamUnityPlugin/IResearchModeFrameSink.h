@@ -8,6 +8,15 @@ public:
 		std::shared_ptr<IResearchModeSensorFrame> pSensorFrame,
 		ResearchModeSensorType pSensorType) = 0;
 
+	// A stereo pair from StereoFrameProcessor, sent as a single frame.
+	virtual void SendPair(
+		std::shared_ptr<IResearchModeSensorFrame> pLeftFrame,
+		std::shared_ptr<IResearchModeSensorFrame> pRightFrame) {};
+
+	// The receiver lost its reference frame, the next frame must not depend
+	// on earlier ones (see TemporalCodec).
+	virtual void RequestKeyframe() {};
+
 	//virtual winrt::Windows::Foundation::IAsyncAction SendAndWait(
 	//	std::shared_ptr<IResearchModeSensorFrame> pSensorFrame,
 	//	ResearchModeSensorType pSensorType) = 0;
@@ -7,4 +7,8 @@ public:
 	virtual void Send(
 		winrt::Windows::Media::Capture::Frames::MediaFrameReference frame,
 		long long pTimestamp) = 0;
+
+	// The receiver lost its reference frame, the next frame must not depend
+	// on earlier ones (see TemporalCodec).
+	virtual void RequestKeyframe() {};
 };
\ No newline at end of file
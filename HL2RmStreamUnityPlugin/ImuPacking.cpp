@@ -0,0 +1,125 @@
+#include "ImuPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	using namespace ImuPacking;
+
+	// Both devices and the receivers are little-endian, values are copied as
+	// they are (like FrameHeader).
+	template <typename T>
+	void Store(uint8_t*& out, T value)
+	{
+		memcpy(out, &value, sizeof(value));
+		out += sizeof(value);
+	}
+
+	template <typename T>
+	T Load(const uint8_t*& in)
+	{
+		T value;
+		memcpy(&value, in, sizeof(value));
+		in += sizeof(value);
+		return value;
+	}
+}
+
+size_t ImuPacking::EncodeBlock(
+	SensorKind kind,
+	const Sample* samples,
+	size_t count,
+	float temperature,
+	int64_t baseTime,
+	uint8_t* out)
+{
+	count = (std::min)(count, kMaxBlockSamples);
+
+	float largest = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float value = samples[i].values[axis];
+			if (std::isfinite(value))
+			{
+				largest = (std::max)(largest, std::fabs(value));
+			}
+		}
+	}
+	const float scale = largest / 32767.0f;
+	// an all zero block keeps scale 0 and decodes to zeros
+	const double inverse = scale > 0.0f ? 1.0 / scale : 0.0;
+
+	uint8_t* start = out;
+	Store<uint8_t>(out, (uint8_t)kind);
+	Store<uint8_t>(out, 0);
+	Store<uint16_t>(out, (uint16_t)count);
+	Store<float>(out, scale);
+	Store<float>(out, temperature);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const int64_t offset = (std::min)((std::max)(samples[i].time - baseTime, (int64_t)0), (int64_t)UINT32_MAX);
+		Store<uint32_t>(out, (uint32_t)offset);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float value = samples[i].values[axis];
+			const long quantized = std::isfinite(value) ? std::lround(value * inverse) : 0;
+			Store<int16_t>(out, (int16_t)(std::min)((std::max)(quantized, -32767L), 32767L));
+		}
+	}
+	return out - start;
+}
+
+bool ImuPacking::Decode(
+	const uint8_t* in,
+	size_t size,
+	int64_t baseTime,
+	std::vector<Block>& blocks)
+{
+	const uint8_t* end = in + size;
+	while (in < end)
+	{
+		if ((size_t)(end - in) < kBlockHeaderSize)
+		{
+			return false;
+		}
+
+		Block block;
+		const uint8_t kind = Load<uint8_t>(in);
+		Load<uint8_t>(in);
+		const uint16_t count = Load<uint16_t>(in);
+		block.kind = (SensorKind)kind;
+		block.scale = Load<float>(in);
+		block.temperature = Load<float>(in);
+		if (kind > (uint8_t)SensorKind::Mag || (size_t)(end - in) < (size_t)count * kSampleSize)
+		{
+			return false;
+		}
+
+		block.samples.resize(count);
+		for (Sample& sample : block.samples)
+		{
+			sample.time = baseTime + Load<uint32_t>(in);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				sample.values[axis] = Load<int16_t>(in) * block.scale;
+			}
+		}
+		blocks.push_back(std::move(block));
+	}
+	return true;
+}
+
+void ImuPacking::ClockAligner::Update(
+	int64_t hostTicks,
+	uint64_t deviceNs)
+{
+	m_offsets[m_next] = hostTicks - (int64_t)(deviceNs / 100);
+	m_next = (m_next + 1) % kWindow;
+	m_count = (std::min)(m_count + 1, kWindow);
+	m_offset = *std::min_element(m_offsets, m_offsets + m_count);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Wire format of the IMU stream (PayloadEncoding::ImuBatch), see ImuStreamer.
+//
+// A message carries the samples of one or more sensors in blocks. The values
+// of a block are block fixed point: one float scale per block, three int16
+// per sample, so the error of a value is at most scale / 2 and scale is the
+// largest magnitude in the block / 32767. Sample times are offsets in 100 ns
+// ticks from the header timestamp, on the host clock of the camera frames.
+//
+// Payload, little-endian, blocks back to back:
+//   uint8  kind           SensorKind
+//   uint8  reserved
+//   uint16 count          samples in the block
+//   float  scale          per LSB, in the units of the Research Mode values
+//   float  temperature    mean over the block, NaN for the magnetometer
+//   count times:
+//     uint32 timeOffset   100 ns ticks after the header timestamp
+//     int16  x, y, z      value / scale
+//
+// 10 bytes per sample instead of the 32 of the Research Mode structs, plus
+// 12 bytes per block.
+namespace ImuPacking
+{
+	enum class SensorKind : uint8_t
+	{
+		Accel = 0,
+		Gyro = 1,
+		Mag = 2,
+	};
+
+	static constexpr size_t kBlockHeaderSize = 12;
+	static constexpr size_t kSampleSize = 10;
+	static constexpr size_t kMaxBlockSamples = UINT16_MAX;
+
+	struct Sample
+	{
+		// host ticks (100 ns)
+		int64_t time;
+		float values[3];
+	};
+
+	struct Block
+	{
+		SensorKind kind;
+		float scale;
+		float temperature;
+		std::vector<Sample> samples;
+	};
+
+	inline size_t EncodedSize(
+		size_t blockCount,
+		size_t sampleCount)
+	{
+		return blockCount * kBlockHeaderSize + sampleCount * kSampleSize;
+	}
+
+	// Writes a block of count samples (at most kMaxBlockSamples) to out,
+	// EncodedSize(1, count) bytes, and returns the number of bytes written.
+	// Sample times are clamped to [baseTime, baseTime + UINT32_MAX], values
+	// that are not finite go out as 0.
+	size_t EncodeBlock(
+		SensorKind kind,
+		const Sample* samples,
+		size_t count,
+		float temperature,
+		int64_t baseTime,
+		uint8_t* out);
+
+	// Appends the blocks of a payload to blocks. Returns false if the
+	// payload is cut short or has an unknown block kind.
+	bool Decode(
+		const uint8_t* in,
+		size_t size,
+		int64_t baseTime,
+		std::vector<Block>& blocks);
+
+	// Maps the device clock of an IMU (VinylHupTicks, nanoseconds) to host
+	// ticks.
+	//
+	// The host ticks of a sample batch are taken when the batch is handed
+	// out, so they are late by a varying delivery delay. The offset between
+	// the clocks is the smallest host - device difference over the last
+	// kWindow batches: the batches that came through quickest, which takes
+	// the jitter out and leaves only the shortest delivery delay as a
+	// constant bias. The window keeps slow drift between the clocks from
+	// adding up.
+	class ClockAligner
+	{
+	public:
+		static constexpr size_t kWindow = 64;
+
+		// hostTicks of a batch whose newest sample has deviceNs
+		void Update(
+			int64_t hostTicks,
+			uint64_t deviceNs);
+
+		bool IsAligned() const
+		{
+			return m_count > 0;
+		}
+
+		int64_t HostTicks(uint64_t deviceNs) const
+		{
+			return (int64_t)(deviceNs / 100) + m_offset;
+		}
+
+	private:
+		int64_t m_offsets[kWindow] = {};
+		size_t m_count = 0;
+		size_t m_next = 0;
+		int64_t m_offset = 0;
+	};
+}
@@ -0,0 +1,669 @@
+#include "pch.h"
+
+#define DBG_ENABLE_VERBOSE_LOGGING 0
+#define DBG_ENABLE_INFO_LOGGING 1
+#define DBG_ENABLE_ERROR_LOGGING 1
+
+using namespace winrt::Windows::Networking::Sockets;
+using namespace winrt::Windows::Storage::Streams;
+using namespace winrt::Windows::Foundation::Numerics;
+using namespace std::chrono_literals;
+
+namespace
+{
+    // largest message: a full block of every sensor
+    const size_t kPayloadCapacity = ImuPacking::EncodedSize(3, 3 * ImuStreamer::kMaxMessageSamples);
+
+    // SocTicks are taken on the host clock (the QPC ticks of HostTicks) where
+    // the driver fills them in. Batches whose SocTicks are missing or further
+    // than this from their host ticks are timed from VinylHupTicks instead.
+    constexpr int64_t kSocTicksTolerance = 10'000'000;
+
+    const float* Values(const AccelDataStruct& sample)
+    {
+        return sample.AccelValues;
+    }
+
+    const float* Values(const GyroDataStruct& sample)
+    {
+        return sample.GyroValues;
+    }
+
+    const float* Values(const MagDataStruct& sample)
+    {
+        return sample.MagValues;
+    }
+
+    bool Temperature(const AccelDataStruct& sample, float& temperature)
+    {
+        temperature = sample.temperature;
+        return true;
+    }
+
+    bool Temperature(const GyroDataStruct& sample, float& temperature)
+    {
+        temperature = sample.temperature;
+        return true;
+    }
+
+    bool Temperature(const MagDataStruct& /* sample */, float& /* temperature */)
+    {
+        return false;
+    }
+
+    bool ImuAccessGranted(
+        HANDLE imuConsentGiven,
+        ResearchModeSensorConsent* imuAccessConsent)
+    {
+        // wait for the event to be set and check for the consent provided by the user.
+        if (WaitForSingleObject(imuConsentGiven, INFINITE) != WAIT_OBJECT_0)
+        {
+            return false;
+        }
+
+        switch (*imuAccessConsent)
+        {
+        case ResearchModeSensorConsent::Allowed:
+            OutputDebugStringW(L"ImuStreamer::SensorUpdateThread: Access is granted. \n");
+            return true;
+        case ResearchModeSensorConsent::DeniedByUser:
+            OutputDebugStringW(L"ImuStreamer::SensorUpdateThread: Access is denied by the user. \n");
+            return false;
+        case ResearchModeSensorConsent::NotDeclaredByApp:
+            OutputDebugStringW(L"ImuStreamer::SensorUpdateThread: Capability is not declared in the app manifest. \n");
+            return false;
+        default:
+            OutputDebugStringW(L"ImuStreamer::SensorUpdateThread: Access is denied by the system. \n");
+            return false;
+        }
+    }
+}
+
+ImuStreamer::ImuStreamer(
+    IResearchModeSensor* pAccelSensor,
+    IResearchModeSensor* pGyroSensor,
+    IResearchModeSensor* pMagSensor,
+    HANDLE imuConsentGiven,
+    ResearchModeSensorConsent* imuAccessConsent,
+    std::wstring portName,
+    std::wstring reqPortName,
+    std::shared_ptr<MultiplexedStreamTransport> transport,
+    std::shared_ptr<FrameBufferPool> bufferPool) :
+    m_imuConsentGiven(imuConsentGiven),
+    m_pImuAccessConsent(imuAccessConsent),
+    m_portName(portName),
+    m_reqPortName(reqPortName),
+    m_pTransport(transport)
+{
+    IResearchModeSensor* sensors[3] = { pAccelSensor, pGyroSensor, pMagSensor };
+    const ImuPacking::SensorKind kinds[3] = {
+        ImuPacking::SensorKind::Accel, ImuPacking::SensorKind::Gyro, ImuPacking::SensorKind::Mag };
+    for (int i = 0; i < 3; i++)
+    {
+        m_sensors[i].pSensor = sensors[i];
+        m_sensors[i].kind = kinds[i];
+        if (sensors[i])
+        {
+            sensors[i]->AddRef();
+        }
+    }
+
+    m_pBufferPool = bufferPool ? bufferPool : std::make_shared<FrameBufferPool>();
+
+    if (!m_pTransport)
+    {
+        StartServer();
+    }
+    // without a port of its own the requests come in through the multiplexed transport
+    if (!m_reqPortName.empty())
+    {
+        StartReqListener();
+    }
+}
+
+ImuStreamer::~ImuStreamer()
+{
+    Stop();
+    for (SensorState& state : m_sensors)
+    {
+        if (state.pSensor)
+        {
+            state.pSensor->Release();
+        }
+    }
+}
+
+void ImuStreamer::Start()
+{
+    if (isRunning)
+    {
+        return;
+    }
+
+    m_pBufferPool->Reserve(FrameHeaderSize(m_poseFormat) + kPayloadCapacity, kBuffersPerStream);
+
+    m_fExit = false;
+    for (SensorState& state : m_sensors)
+    {
+        if (state.pSensor)
+        {
+            state.thread = std::thread(SensorUpdateThread, this, &state);
+        }
+    }
+    m_sendThread = std::thread(SendThread, this);
+    isRunning = true;
+}
+
+void ImuStreamer::Stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_pendingMutex);
+        m_fExit = true;
+    }
+    m_wake.notify_all();
+
+    for (SensorState& state : m_sensors)
+    {
+        if (state.thread.joinable())
+        {
+            state.thread.join();
+        }
+    }
+    if (m_sendThread.joinable())
+    {
+        m_sendThread.join();
+    }
+    isRunning = false;
+}
+
+bool ImuStreamer::HandleRequest(const wchar_t* request)
+{
+    // there are no keyframes, every message stands on its own
+    if (*request == L'K')
+    {
+        return true;
+    }
+
+    if (!m_credits.HandleRequest(request))
+    {
+        return false;
+    }
+
+    // taken so the send thread cannot miss the credit between checking for
+    // one and going to sleep
+    {
+        std::lock_guard<std::mutex> guard(m_pendingMutex);
+    }
+    m_wake.notify_all();
+    return true;
+}
+
+void ImuStreamer::SensorUpdateThread(
+    ImuStreamer* pStreamer,
+    SensorState* pState)
+{
+    IResearchModeSensor* pSensor = pState->pSensor;
+    if (!ImuAccessGranted(pStreamer->m_imuConsentGiven, pStreamer->m_pImuAccessConsent))
+    {
+        return;
+    }
+
+    if (FAILED(pSensor->OpenStream()))
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"ImuStreamer::SensorUpdateThread: Opening the Stream failed.\n");
+#endif
+        return;
+    }
+
+#if DBG_ENABLE_INFO_LOGGING
+    wchar_t msgBuffer[200];
+    swprintf_s(msgBuffer, L"ImuStreamer::SensorUpdateThread: Starting acquisition loop for %ls.\n",
+        pSensor->GetFriendlyName());
+    OutputDebugStringW(msgBuffer);
+#endif
+
+    // every batch is read, the samples of a batch only come once
+    while (!pStreamer->m_fExit)
+    {
+        IResearchModeSensorFrame* pSensorFrame = nullptr;
+        if (FAILED(pSensor->GetNextBuffer(&pSensorFrame)))
+        {
+#if DBG_ENABLE_ERROR_LOGGING
+            OutputDebugStringW(L"ImuStreamer::SensorUpdateThread: Failed getting frame.\n");
+#endif
+            std::this_thread::sleep_for(1ms);
+            continue;
+        }
+
+        pStreamer->ReadBatch(*pState, pSensorFrame);
+        pSensorFrame->Release();
+    }
+
+#if DBG_ENABLE_INFO_LOGGING
+    OutputDebugStringW(L"ImuStreamer::SensorUpdateThread: Closing the stream.\n");
+#endif
+    pSensor->CloseStream();
+}
+
+template <typename T>
+void ImuStreamer::QueueSamples(
+    SensorState& state,
+    const T* pSamples,
+    size_t count,
+    uint64_t hostTicks)
+{
+    if (!pSamples || count == 0)
+    {
+        return;
+    }
+
+    const int64_t batchTicks = checkAndConvertUnsigned(hostTicks);
+    const T& newest = pSamples[count - 1];
+    const bool socTicksOnHostClock = newest.SocTicks != 0 &&
+        std::abs((int64_t)newest.SocTicks - batchTicks) < kSocTicksTolerance;
+    if (!socTicksOnHostClock)
+    {
+        state.aligner.Update(batchTicks, newest.VinylHupTicks);
+    }
+
+    std::lock_guard<std::mutex> guard(m_pendingMutex);
+    if (!IsConnected())
+    {
+        // nobody to send them to, and stale by the time someone connects
+        state.pending.clear();
+        state.temperatureSum = 0.0;
+        state.temperatureCount = 0;
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const T& sample = pSamples[i];
+        ImuPacking::Sample packed;
+        packed.time = socTicksOnHostClock ? (int64_t)sample.SocTicks : state.aligner.HostTicks(sample.VinylHupTicks);
+        memcpy(packed.values, Values(sample), sizeof(packed.values));
+        state.pending.push_back(packed);
+
+        float temperature;
+        if (Temperature(sample, temperature))
+        {
+            state.temperatureSum += temperature;
+            state.temperatureCount++;
+        }
+    }
+
+    if (state.pending.size() > kMaxPendingSamples)
+    {
+        // the link is behind, the oldest samples go
+        const size_t excess = state.pending.size() - kMaxPendingSamples;
+        state.pending.erase(state.pending.begin(), state.pending.begin() + excess);
+        state.samplesDropped += excess;
+    }
+    m_wake.notify_all();
+}
+
+void ImuStreamer::ReadBatch(
+    SensorState& state,
+    IResearchModeSensorFrame* pSensorFrame)
+{
+    ResearchModeSensorTimestamp timestamp;
+    if (FAILED(pSensorFrame->GetTimeStamp(&timestamp)))
+    {
+        return;
+    }
+
+    if (state.kind == ImuPacking::SensorKind::Accel)
+    {
+        IResearchModeAccelFrame* pFrame = nullptr;
+        if (SUCCEEDED(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pFrame))))
+        {
+            const AccelDataStruct* pSamples = nullptr;
+            size_t count = 0;
+            if (SUCCEEDED(pFrame->GetCalibratedAccelarationSamples(&pSamples, &count)))
+            {
+                QueueSamples(state, pSamples, count, timestamp.HostTicks);
+            }
+            pFrame->Release();
+        }
+    }
+    else if (state.kind == ImuPacking::SensorKind::Gyro)
+    {
+        IResearchModeGyroFrame* pFrame = nullptr;
+        if (SUCCEEDED(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pFrame))))
+        {
+            const GyroDataStruct* pSamples = nullptr;
+            size_t count = 0;
+            if (SUCCEEDED(pFrame->GetCalibratedGyroSamples(&pSamples, &count)))
+            {
+                QueueSamples(state, pSamples, count, timestamp.HostTicks);
+            }
+            pFrame->Release();
+        }
+    }
+    else
+    {
+        IResearchModeMagFrame* pFrame = nullptr;
+        if (SUCCEEDED(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pFrame))))
+        {
+            const MagDataStruct* pSamples = nullptr;
+            size_t count = 0;
+            if (SUCCEEDED(pFrame->GetMagnetometerSamples(&pSamples, &count)))
+            {
+                QueueSamples(state, pSamples, count, timestamp.HostTicks);
+            }
+            pFrame->Release();
+        }
+    }
+}
+
+void ImuStreamer::SendThread(ImuStreamer* pStreamer)
+{
+#if DBG_ENABLE_INFO_LOGGING
+    OutputDebugStringW(L"ImuStreamer::SendThread: Starting send thread.\n");
+#endif
+    const auto anyPending = [pStreamer]()
+    {
+        for (const SensorState& state : pStreamer->m_sensors)
+        {
+            if (!state.pending.empty())
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::unique_lock<std::mutex> lock(pStreamer->m_pendingMutex);
+    while (!pStreamer->m_fExit)
+    {
+        // a message goes out while the receiver has credits left and there
+        // is something to send; everything that piles up meanwhile goes out
+        // in the next one
+        pStreamer->m_wake.wait(lock, [&]()
+            {
+                return pStreamer->m_fExit || (pStreamer->m_credits.Available() && anyPending());
+            });
+        if (pStreamer->m_fExit)
+        {
+            break;
+        }
+        if (pStreamer->m_pTransport && pStreamer->m_pTransport->QueuedMessages(StreamId::Imu) > 0)
+        {
+            // The previous message still waits for the link. The samples stay
+            // queued and go out together once it left, rather than the
+            // transport dropping a whole message.
+            pStreamer->m_wake.wait_for(lock, 5ms, [pStreamer]() { return pStreamer->m_fExit.load(); });
+            continue;
+        }
+
+        lock.unlock();
+        uint32_t payloadLength = 0;
+        std::shared_ptr<FrameSendSlot> slot = pStreamer->Pack(payloadLength);
+        if (slot)
+        {
+            // only this thread consumes credits, so the one seen above is still there
+            pStreamer->m_credits.TryConsume();
+            pStreamer->Transmit(slot, payloadLength);
+        }
+        lock.lock();
+
+        if (!slot)
+        {
+            // out of buffers, the samples stay queued
+            pStreamer->m_wake.wait_for(lock, 5ms, [pStreamer]() { return pStreamer->m_fExit.load(); });
+        }
+    }
+}
+
+std::shared_ptr<FrameSendSlot> ImuStreamer::Pack(uint32_t& payloadLength)
+{
+    std::shared_ptr<FrameSendSlot> slot = m_pBufferPool->Acquire(FrameHeaderSize(m_poseFormat), kPayloadCapacity);
+    if (!slot)
+    {
+        m_stats.framesDropped++;
+        return nullptr;
+    }
+
+    int64_t baseTime = INT64_MAX;
+    uint32_t sampleCount = 0;
+    uint32_t blockCount = 0;
+    uint8_t* out = slot->Payload();
+    {
+        std::lock_guard<std::mutex> guard(m_pendingMutex);
+        for (const SensorState& state : m_sensors)
+        {
+            const size_t count = (std::min)(state.pending.size(), kMaxMessageSamples);
+            for (size_t i = 0; i < count; i++)
+            {
+                baseTime = (std::min)(baseTime, state.pending[i].time);
+            }
+        }
+
+        for (SensorState& state : m_sensors)
+        {
+            const size_t count = (std::min)(state.pending.size(), kMaxMessageSamples);
+            if (count == 0)
+            {
+                continue;
+            }
+
+            const float temperature = state.temperatureCount > 0 ?
+                (float)(state.temperatureSum / state.temperatureCount) : NAN;
+            out += ImuPacking::EncodeBlock(state.kind, state.pending.data(), count, temperature, baseTime, out);
+            state.pending.erase(state.pending.begin(), state.pending.begin() + count);
+            state.temperatureSum = 0.0;
+            state.temperatureCount = 0;
+            sampleCount += (uint32_t)count;
+            blockCount++;
+        }
+    }
+
+    if (blockCount == 0)
+    {
+        return nullptr;
+    }
+    payloadLength = (uint32_t)(out - slot->Payload());
+
+    float4x4 rig2world = float4x4::identity();
+    if (m_pPoseService && !m_pPoseService->Locate((uint64_t)baseTime, rig2world))
+    {
+        rig2world = float4x4::identity();
+    }
+
+    FrameHeader header = MakeFrameHeader((uint8_t)StreamId::Imu, m_poseFormat, (uint16_t)PayloadEncoding::ImuBatch, m_sequence++);
+    header.timestamp = (uint64_t)m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds(baseTime)).count();
+    header.width = sampleCount;
+    header.height = blockCount;
+    header.pixelStride = (uint32_t)ImuPacking::kSampleSize;
+    header.payloadLength = payloadLength;
+    WriteFrameHeader(header, &rig2world.m11, slot->Header());
+    return slot;
+}
+
+void ImuStreamer::Transmit(
+    std::shared_ptr<FrameSendSlot> const& slot,
+    uint32_t payloadLength)
+{
+    const uint32_t length = (uint32_t)slot->HeaderSize() + payloadLength;
+    IBuffer buffer = winrt::make<FrameSendBuffer>(slot, length);
+
+    if (m_pTransport)
+    {
+        if (m_pTransport->Submit(StreamId::Imu, buffer) == MultiplexedStreamTransport::SubmitResult::DroppedOldest)
+        {
+            // only if another thread submitted to the stream, the transport
+            // handed the dropped message's credit back
+            m_stats.framesDropped++;
+        }
+    }
+    else
+    {
+        StreamSocket socket = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(m_socketMutex);
+            socket = m_streamSocket;
+        }
+        if (!socket)
+        {
+            return;
+        }
+
+        try
+        {
+            // the messages are small and this thread has nothing else to do
+            socket.OutputStream().WriteAsync(buffer).get();
+        }
+        catch (winrt::hresult_error const& ex)
+        {
+            SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+            if (webErrorStatus == SocketErrorStatus::ConnectionResetByPeer ||
+                webErrorStatus == SocketErrorStatus::ConnectionAborted)
+            {
+                // the client disconnected!
+                std::lock_guard<std::mutex> guard(m_socketMutex);
+                if (m_streamSocket == socket)
+                {
+                    m_streamSocket = nullptr;
+                }
+            }
+#if DBG_ENABLE_ERROR_LOGGING
+            winrt::hstring message = ex.message();
+            OutputDebugStringW(L"ImuStreamer::Transmit: Sending failed with ");
+            OutputDebugStringW(message.c_str());
+            OutputDebugStringW(L"\n");
+#endif // DBG_ENABLE_ERROR_LOGGING
+            return;
+        }
+    }
+
+    m_stats.RecordFrame(length, 0);
+
+#if DBG_ENABLE_INFO_LOGGING
+    if (m_stats.framesSent % kStatsLogInterval == 0)
+    {
+        uint64_t samplesDropped = 0;
+        {
+            std::lock_guard<std::mutex> guard(m_pendingMutex);
+            for (const SensorState& state : m_sensors)
+            {
+                samplesDropped += state.samplesDropped;
+            }
+        }
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"ImuStreamer: sent %llu messages, %llu bytes, %llu samples dropped.\n",
+            m_stats.framesSent.load(), m_stats.bytesSent.load(), samplesDropped);
+        OutputDebugStringW(msgBuffer);
+    }
+#endif
+}
+
+bool ImuStreamer::IsConnected() const
+{
+    if (m_pTransport)
+    {
+        return m_pTransport->IsConnected();
+    }
+    std::lock_guard<std::mutex> guard(m_socketMutex);
+    return m_streamSocket != nullptr;
+}
+
+// https://docs.microsoft.com/en-us/windows/uwp/networking/sockets
+winrt::Windows::Foundation::IAsyncAction ImuStreamer::StartServer()
+{
+    try
+    {
+        m_streamSocketListener.Control().NoDelay(true);
+        m_streamSocketListener.Control().QualityOfService(SocketQualityOfService::LowLatency);
+
+        // The ConnectionReceived event is raised when connections are received.
+        m_streamSocketListener.ConnectionReceived({ this, &ImuStreamer::OnConnectionReceived });
+
+        co_await m_streamSocketListener.BindServiceNameAsync(m_portName);
+#if DBG_ENABLE_INFO_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"ImuStreamer::StartServer: Server is listening at %ls. \n",
+            m_portName.c_str());
+        OutputDebugStringW(msgBuffer);
+#endif // DBG_ENABLE_INFO_LOGGING
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+        winrt::hstring message = webErrorStatus != SocketErrorStatus::Unknown ?
+            winrt::to_hstring((int32_t)webErrorStatus) : winrt::to_hstring(ex.to_abi());
+        OutputDebugStringW(L"ImuStreamer::StartServer: Failed to open listener with ");
+        OutputDebugStringW(message.c_str());
+        OutputDebugStringW(L"\n");
+#endif
+    }
+}
+
+void ImuStreamer::OnConnectionReceived(
+    StreamSocketListener /* sender */,
+    StreamSocketListenerConnectionReceivedEventArgs args)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_socketMutex);
+        m_streamSocket = args.Socket();
+    }
+    // the receiver resets the window once it is connected
+    m_credits.Reset(1);
+
+#if DBG_ENABLE_INFO_LOGGING
+    wchar_t msgBuffer[200];
+    swprintf_s(msgBuffer, L"ImuStreamer::OnConnectionReceived: Received connection at %ls. \n",
+        m_portName.c_str());
+    OutputDebugStringW(msgBuffer);
+#endif // DBG_ENABLE_INFO_LOGGING
+}
+
+winrt::Windows::Foundation::IAsyncAction ImuStreamer::StartReqListener()
+{
+    try
+    {
+        m_datagramSocket = DatagramSocket();
+        m_datagramSocket.Control().QualityOfService(SocketQualityOfService::LowLatency);
+        m_datagramSocket.MessageReceived({ this, &ImuStreamer::datagramSocket_MessageReceived });
+
+        co_await m_datagramSocket.BindServiceNameAsync(m_reqPortName);
+#if DBG_ENABLE_INFO_LOGGING
+        OutputDebugStringW(L"ImuStreamer::StartReqListener bound to port number ");
+        OutputDebugStringW(m_reqPortName.c_str());
+        OutputDebugStringW(L". Listener ready.\n");
+#endif
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+        winrt::hstring message = webErrorStatus != SocketErrorStatus::Unknown ?
+            winrt::to_hstring((int32_t)webErrorStatus) : winrt::to_hstring(ex.to_abi());
+        OutputDebugStringW(L"ImuStreamer::StartReqListener: Failed to open listener with ");
+        OutputDebugStringW(message.c_str());
+        OutputDebugStringW(L"\n");
+#endif
+    }
+}
+
+void ImuStreamer::datagramSocket_MessageReceived(
+    DatagramSocket const& /* sender */,
+    DatagramSocketMessageReceivedEventArgs const& args)
+{
+    DataReader dataReader{ args.GetDataReader() };
+    winrt::hstring request{ dataReader.ReadString(dataReader.UnconsumedBufferLength()) };
+
+    if (!HandleRequest(request.c_str()))
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"ImuStreamer::datagramSocket_MessageReceived: unexpected request\n");
+#endif
+    }
+
+#if DBG_ENABLE_VERBOSE_LOGGING
+    OutputDebugStringW(L"ImuStreamer::datagramSocket_MessageReceived: server received the request:");
+    OutputDebugStringW(request.c_str());
+    OutputDebugStringW(L"\n");
+#endif
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+// Streams the accelerometer, gyroscope and magnetometer samples as one stream
+// (StreamId::Imu).
+//
+// The IMU sensors hand out their samples in batches. A thread per sensor
+// reads every batch and queues all its samples; nothing is dropped in favour
+// of a newer batch, as the camera streams do with their frames. Whenever the
+// receiver has a credit left (see FrameCredits) and, over the multiplexed
+// connection, the previous message left the transport's queue, the send
+// thread packs everything queued since the previous message into one (see
+// ImuPacking):
+// the usual frame header (sensorId 4, codec PayloadEncoding::ImuBatch,
+// width = sample count, height = block count) followed by a block per
+// sensor.
+//
+// Sample times are host ticks like the camera frame timestamps, converted
+// the same way, so the IMU lines up with the other streams. The header
+// timestamp is that of the oldest sample in the message and the pose block
+// holds the rig pose at that time (identity if the rig was not located).
+class ImuStreamer
+{
+public:
+	// per sensor, about two seconds of gyroscope samples; the oldest go
+	// first if the link falls further behind
+	static constexpr size_t kMaxPendingSamples = 16384;
+	// per sensor and message, the rest waits for the next message
+	static constexpr size_t kMaxMessageSamples = 4096;
+
+	// Sensors may be null. With a transport the messages go out over the
+	// multiplexed connection and the ports are not used.
+	ImuStreamer(
+		IResearchModeSensor* pAccelSensor,
+		IResearchModeSensor* pGyroSensor,
+		IResearchModeSensor* pMagSensor,
+		HANDLE imuConsentGiven,
+		ResearchModeSensorConsent* imuAccessConsent,
+		std::wstring portName,
+		std::wstring reqPortName,
+		std::shared_ptr<MultiplexedStreamTransport> transport = nullptr,
+		std::shared_ptr<FrameBufferPool> bufferPool = nullptr);
+
+	~ImuStreamer();
+
+	ImuStreamer(const ImuStreamer&) = delete;
+	ImuStreamer& operator=(const ImuStreamer&) = delete;
+
+	void Start();
+
+	void Stop();
+
+	bool isRunning = false;
+
+	// Applies a credit request from the receiver. Called by the request
+	// listener, or by the multiplexed transport when reqPortName is empty.
+	bool HandleRequest(const wchar_t* request);
+
+	// Format of the rig pose in the header (see PoseCodec). Set it before the
+	// stream starts.
+	void SetPoseFormat(PoseCodec::Format format)
+	{
+		m_poseFormat = format;
+	}
+
+	// Rig poses for the header. Set it before the stream starts.
+	void SetPoseService(std::shared_ptr<RigPoseService> poseService)
+	{
+		m_pPoseService = poseService;
+	}
+
+	const SendStats& GetSendStats() const
+	{
+		return m_stats;
+	}
+
+private:
+	struct SensorState
+	{
+		IResearchModeSensor* pSensor = nullptr;
+		ImuPacking::SensorKind kind = ImuPacking::SensorKind::Accel;
+		std::thread thread;
+		// only used on the sensor's thread
+		ImuPacking::ClockAligner aligner;
+
+		// guarded by m_pendingMutex
+		std::vector<ImuPacking::Sample> pending;
+		double temperatureSum = 0.0;
+		uint32_t temperatureCount = 0;
+		uint64_t samplesDropped = 0;
+	};
+
+	static void SensorUpdateThread(
+		ImuStreamer* pStreamer,
+		SensorState* pState);
+
+	static void SendThread(ImuStreamer* pStreamer);
+
+	// reads one batch of the sensor into its pending samples
+	void ReadBatch(
+		SensorState& state,
+		IResearchModeSensorFrame* pSensorFrame);
+
+	// T is AccelDataStruct, GyroDataStruct or MagDataStruct
+	template <typename T>
+	void QueueSamples(
+		SensorState& state,
+		const T* pSamples,
+		size_t count,
+		uint64_t hostTicks);
+
+	// moves up to kMaxMessageSamples of every sensor into a message, returns
+	// nullptr if nothing was pending
+	std::shared_ptr<FrameSendSlot> Pack(uint32_t& payloadLength);
+
+	void Transmit(
+		std::shared_ptr<FrameSendSlot> const& slot,
+		uint32_t payloadLength);
+
+	bool IsConnected() const;
+
+	winrt::Windows::Foundation::IAsyncAction StartServer();
+	winrt::Windows::Foundation::IAsyncAction StartReqListener();
+
+	void OnConnectionReceived(
+		winrt::Windows::Networking::Sockets::StreamSocketListener /* sender */,
+		winrt::Windows::Networking::Sockets::StreamSocketListenerConnectionReceivedEventArgs args);
+
+	void datagramSocket_MessageReceived(
+		winrt::Windows::Networking::Sockets::DatagramSocket const& /* sender */,
+		winrt::Windows::Networking::Sockets::DatagramSocketMessageReceivedEventArgs const& args);
+
+	SensorState m_sensors[3];
+	HANDLE m_imuConsentGiven;
+	ResearchModeSensorConsent* m_pImuAccessConsent;
+
+	std::mutex m_pendingMutex;
+	// samples queued, a credit granted, the connection changed or Stop()
+	std::condition_variable m_wake;
+	FrameCredits m_credits;
+	std::atomic<bool> m_fExit{ false };
+	std::thread m_sendThread;
+
+	std::wstring m_portName;
+	std::wstring m_reqPortName;
+	winrt::Windows::Networking::Sockets::StreamSocketListener m_streamSocketListener;
+	// guarded by m_socketMutex
+	winrt::Windows::Networking::Sockets::StreamSocket m_streamSocket = nullptr;
+	mutable std::mutex m_socketMutex;
+	winrt::Windows::Networking::Sockets::DatagramSocket m_datagramSocket = nullptr;
+	std::shared_ptr<MultiplexedStreamTransport> m_pTransport;
+
+	std::shared_ptr<FrameBufferPool> m_pBufferPool;
+	std::shared_ptr<RigPoseService> m_pPoseService;
+	PoseCodec::Format m_poseFormat = PoseCodec::Format::Matrix;
+	TimeConverter m_converter;
+	// only used on the send thread
+	uint32_t m_sequence = 0;
+	SendStats m_stats;
+
+	static constexpr int kBuffersPerStream = 2;
+	static constexpr uint64_t kStatsLogInterval = 1000;
+};
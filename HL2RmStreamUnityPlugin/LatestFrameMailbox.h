@@ -0,0 +1,64 @@
+#pragma once
+
+// Single-producer / single-consumer "latest value" slot.
+//
+// The producer (the sensor thread) publishes every new frame with Publish,
+// which replaces whatever the consumer has not picked up yet and never
+// blocks. The consumer (the sending thread) sleeps in Wait until something
+// happened (a new frame, a request or shutdown) and then grabs the newest
+// frame with Take. The slot itself is a single atomic pointer, so neither
+// side ever waits for the other while it holds a frame.
+template <typename T>
+class LatestFrameMailbox
+{
+public:
+	LatestFrameMailbox()
+	{
+		// auto-reset: every Wait consumes one wake-up
+		m_wakeEvent = CreateEvent(nullptr, false, false, nullptr);
+	}
+
+	~LatestFrameMailbox()
+	{
+		delete m_slot.exchange(nullptr, std::memory_order_acq_rel);
+		if (m_wakeEvent)
+		{
+			CloseHandle(m_wakeEvent);
+		}
+	}
+
+	LatestFrameMailbox(const LatestFrameMailbox&) = delete;
+	LatestFrameMailbox& operator=(const LatestFrameMailbox&) = delete;
+
+	// Producer side: stores value as the latest one, dropping an older value
+	// that was never taken, and wakes the consumer.
+	void Publish(std::unique_ptr<T> value)
+	{
+		delete m_slot.exchange(value.release(), std::memory_order_acq_rel);
+		Wake();
+	}
+
+	// Consumer side: removes and returns the latest value, or nullptr if
+	// nothing new was published since the last Take.
+	std::unique_ptr<T> Take()
+	{
+		return std::unique_ptr<T>(m_slot.exchange(nullptr, std::memory_order_acq_rel));
+	}
+
+	// Wakes the consumer without publishing anything, e.g. when a frame was
+	// requested or the consumer should check for shutdown.
+	void Wake()
+	{
+		SetEvent(m_wakeEvent);
+	}
+
+	// Blocks until the next Publish or Wake. Returns false on timeout.
+	bool Wait(DWORD timeoutMs = INFINITE)
+	{
+		return WaitForSingleObject(m_wakeEvent, timeoutMs) == WAIT_OBJECT_0;
+	}
+
+private:
+	std::atomic<T*> m_slot{ nullptr };
+	HANDLE m_wakeEvent = nullptr;
+};
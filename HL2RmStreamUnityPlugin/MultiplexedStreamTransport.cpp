@@ -0,0 +1,432 @@
+#include "pch.h"
+
+#define DBG_ENABLE_VERBOSE_LOGGING 0
+#define DBG_ENABLE_INFO_LOGGING 1
+#define DBG_ENABLE_ERROR_LOGGING 1
+
+using namespace winrt::Windows::Networking::Sockets;
+using namespace winrt::Windows::Storage::Streams;
+
+MultiplexedStreamTransport::MultiplexedStreamTransport(
+    std::wstring portName,
+    std::wstring reqPortName) :
+    m_portName(portName),
+    m_reqPortName(reqPortName)
+{
+    StartServer();
+    StartReqListener();
+
+    m_sendThread = std::thread(SendThread, this);
+}
+
+MultiplexedStreamTransport::~MultiplexedStreamTransport()
+{
+    m_fExit = true;
+    m_queueNotEmpty.notify_all();
+    if (m_sendThread.joinable())
+    {
+        m_sendThread.join();
+    }
+}
+
+void MultiplexedStreamTransport::RegisterStream(
+    StreamId id,
+    int weight,
+    std::function<bool(const wchar_t*)> requestHandler,
+    std::function<void()> dropHandler)
+{
+    std::lock_guard<std::mutex> guard(m_queueMutex);
+
+    Stream stream;
+    stream.id = id;
+    stream.weight = (std::max)(weight, 1);
+    stream.requestHandler = requestHandler;
+    stream.dropHandler = dropHandler;
+    m_streams.push_back(std::move(stream));
+}
+
+MultiplexedStreamTransport::SubmitResult MultiplexedStreamTransport::Submit(
+    StreamId id,
+    IBuffer message)
+{
+    if (!m_isConnected)
+    {
+        return SubmitResult::NotConnected;
+    }
+
+    SubmitResult result = SubmitResult::Idle;
+    std::function<void()> dropHandler;
+    {
+        std::lock_guard<std::mutex> guard(m_queueMutex);
+        for (Stream& stream : m_streams)
+        {
+            if (stream.id != id)
+            {
+                continue;
+            }
+
+            if (!stream.queue.empty())
+            {
+                result = SubmitResult::Queued;
+            }
+            if (stream.queue.size() >= kMaxQueuedMessages)
+            {
+#if DBG_ENABLE_VERBOSE_LOGGING
+                OutputDebugStringW(L"MultiplexedStreamTransport::Submit: Queue full, dropping oldest message.\n");
+#endif
+                if (m_pRateController)
+                {
+                    m_pRateController->ReportDropped((size_t)id, stream.queue.front().Length());
+                }
+                stream.queue.pop_front();
+                dropHandler = stream.dropHandler;
+                result = SubmitResult::DroppedOldest;
+            }
+            stream.queue.push_back(message);
+            if (m_pRateController)
+            {
+                m_pRateController->ReportQueued((size_t)id, message.Length());
+            }
+            break;
+        }
+    }
+    m_queueNotEmpty.notify_one();
+    if (dropHandler)
+    {
+        dropHandler();
+    }
+    return result;
+}
+
+size_t MultiplexedStreamTransport::QueuedMessages(StreamId id) const
+{
+    std::lock_guard<std::mutex> guard(m_queueMutex);
+    for (const Stream& stream : m_streams)
+    {
+        if (stream.id == id)
+        {
+            return stream.queue.size();
+        }
+    }
+    return 0;
+}
+
+bool MultiplexedStreamTransport::PopNext(
+    StreamId& id,
+    uint32_t& sequence,
+    IBuffer& message)
+{
+    bool anyQueued = false;
+    for (Stream& stream : m_streams)
+    {
+        if (stream.queue.empty())
+        {
+            // idle streams do not hoard budget
+            stream.deficit = 0;
+        }
+        else
+        {
+            anyQueued = true;
+        }
+    }
+    if (!anyQueued)
+    {
+        return false;
+    }
+
+    // terminates because every round adds budget to at least one non-empty queue
+    while (true)
+    {
+        Stream& current = m_streams[m_nextStream];
+        if (!current.queue.empty())
+        {
+            const uint32_t length = current.queue.front().Length();
+            if (current.deficit >= length)
+            {
+                current.deficit -= length;
+                id = current.id;
+                sequence = current.sequence++;
+                message = current.queue.front();
+                current.queue.pop_front();
+                if (current.queue.empty())
+                {
+                    current.deficit = 0;
+                }
+                return true;
+            }
+        }
+
+        // this stream's turn is over, the next one earns its quantum
+        m_nextStream = (m_nextStream + 1) % m_streams.size();
+        Stream& next = m_streams[m_nextStream];
+        if (!next.queue.empty())
+        {
+            next.deficit += (uint64_t)next.weight * kQuantumBytes;
+        }
+    }
+}
+
+void MultiplexedStreamTransport::SendThread(MultiplexedStreamTransport* pTransport)
+{
+#if DBG_ENABLE_INFO_LOGGING
+    OutputDebugStringW(L"MultiplexedStreamTransport::SendThread: Starting send thread.\n");
+#endif
+    while (!pTransport->m_fExit)
+    {
+        StreamId id;
+        uint32_t sequence = 0;
+        IBuffer message = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(pTransport->m_queueMutex);
+            pTransport->m_queueNotEmpty.wait(lock, [&]
+                {
+                    return pTransport->m_fExit || pTransport->PopNext(id, sequence, message);
+                });
+        }
+
+        if (pTransport->m_fExit)
+        {
+            break;
+        }
+
+        // blocks until the socket took the message, so the round robin order
+        // above is the order on the wire
+        pTransport->WriteMessage(id, sequence, message);
+    }
+}
+
+void MultiplexedStreamTransport::WriteMessage(
+    StreamId id,
+    uint32_t sequence,
+    IBuffer const& message)
+{
+    DataWriter writer = nullptr;
+    StreamSocket socket = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(m_queueMutex);
+        writer = m_writer;
+        socket = m_streamSocket;
+    }
+    if (!writer || !socket)
+    {
+        Drop(id, message.Length());
+        return;
+    }
+
+    uint8_t header[kMuxHeaderSize] = {};
+    const uint32_t length = message.Length();
+    header[0] = (uint8_t)id;
+    memcpy(header + 4, &sequence, sizeof(sequence)); // little-endian on ARM64 and x64
+    memcpy(header + 8, &length, sizeof(length));
+
+    try
+    {
+        writer.WriteBytes(header);
+        writer.StoreAsync().get();
+        // the frame buffer goes to the socket as it is, WriteBuffer would copy it
+        socket.OutputStream().WriteAsync(message).get();
+        if (m_pRateController)
+        {
+            m_pRateController->ReportSent((size_t)id, message.Length());
+        }
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+        Drop(id, message.Length());
+        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+        if (webErrorStatus == SocketErrorStatus::ConnectionResetByPeer ||
+            webErrorStatus == SocketErrorStatus::ConnectionAborted)
+        {
+            // the client disconnected!
+            std::vector<std::pair<StreamId, uint32_t>> dropped;
+            {
+                std::lock_guard<std::mutex> guard(m_queueMutex);
+                m_writer = nullptr;
+                m_streamSocket = nullptr;
+                m_isConnected = false;
+                for (Stream& stream : m_streams)
+                {
+                    for (IBuffer const& queued : stream.queue)
+                    {
+                        dropped.emplace_back(stream.id, queued.Length());
+                    }
+                    stream.queue.clear();
+                }
+            }
+            for (const auto& [droppedId, length] : dropped)
+            {
+                Drop(droppedId, length);
+            }
+        }
+#if DBG_ENABLE_ERROR_LOGGING
+        winrt::hstring errorMessage = ex.message();
+        OutputDebugStringW(L"MultiplexedStreamTransport::WriteMessage: Sending failed with ");
+        OutputDebugStringW(errorMessage.c_str());
+        OutputDebugStringW(L"\n");
+#endif // DBG_ENABLE_ERROR_LOGGING
+    }
+}
+
+void MultiplexedStreamTransport::Drop(
+    StreamId id,
+    uint32_t length)
+{
+    if (m_pRateController)
+    {
+        m_pRateController->ReportDropped((size_t)id, length);
+    }
+
+    std::function<void()> dropHandler;
+    {
+        std::lock_guard<std::mutex> guard(m_queueMutex);
+        for (const Stream& stream : m_streams)
+        {
+            if (stream.id == id)
+            {
+                dropHandler = stream.dropHandler;
+                break;
+            }
+        }
+    }
+    if (dropHandler)
+    {
+        dropHandler();
+    }
+}
+
+winrt::Windows::Foundation::IAsyncAction MultiplexedStreamTransport::StartServer()
+{
+    try
+    {
+        m_streamSocketListener.Control().NoDelay(true);
+        m_streamSocketListener.Control().QualityOfService(SocketQualityOfService::LowLatency);
+
+        // The ConnectionReceived event is raised when connections are received.
+        m_streamSocketListener.ConnectionReceived({ this, &MultiplexedStreamTransport::OnConnectionReceived });
+
+        co_await m_streamSocketListener.BindServiceNameAsync(m_portName);
+#if DBG_ENABLE_INFO_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"MultiplexedStreamTransport::StartServer: Server is listening at %ls. \n",
+            m_portName.c_str());
+        OutputDebugStringW(msgBuffer);
+#endif // DBG_ENABLE_INFO_LOGGING
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+        winrt::hstring message = webErrorStatus != SocketErrorStatus::Unknown ?
+            winrt::to_hstring((int32_t)webErrorStatus) : winrt::to_hstring(ex.to_abi());
+        OutputDebugStringW(L"MultiplexedStreamTransport::StartServer: Failed to open listener with ");
+        OutputDebugStringW(message.c_str());
+        OutputDebugStringW(L"\n");
+#endif
+    }
+}
+
+void MultiplexedStreamTransport::OnConnectionReceived(
+    StreamSocketListener /* sender */,
+    StreamSocketListenerConnectionReceivedEventArgs args)
+{
+    try
+    {
+        DataWriter writer(args.Socket().OutputStream());
+        writer.UnicodeEncoding(UnicodeEncoding::Utf8);
+        writer.ByteOrder(ByteOrder::LittleEndian);
+
+        {
+            std::lock_guard<std::mutex> guard(m_queueMutex);
+            m_streamSocket = args.Socket();
+            m_writer = writer;
+            m_isConnected = true;
+        }
+
+#if DBG_ENABLE_INFO_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"MultiplexedStreamTransport::OnConnectionReceived: Received connection at %ls. \n",
+            m_portName.c_str());
+        OutputDebugStringW(msgBuffer);
+#endif // DBG_ENABLE_INFO_LOGGING
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+        winrt::hstring message = webErrorStatus != SocketErrorStatus::Unknown ?
+            winrt::to_hstring((int32_t)webErrorStatus) : winrt::to_hstring(ex.to_abi());
+        OutputDebugStringW(L"MultiplexedStreamTransport::OnConnectionReceived: Failed to establish connection with error ");
+        OutputDebugStringW(message.c_str());
+        OutputDebugStringW(L"\n");
+#endif
+    }
+}
+
+winrt::Windows::Foundation::IAsyncAction MultiplexedStreamTransport::StartReqListener()
+{
+    try
+    {
+        m_datagramSocket = DatagramSocket();
+        m_datagramSocket.Control().QualityOfService(SocketQualityOfService::LowLatency);
+        m_datagramSocket.MessageReceived({ this, &MultiplexedStreamTransport::datagramSocket_MessageReceived });
+
+        co_await m_datagramSocket.BindServiceNameAsync(m_reqPortName);
+
+#if DBG_ENABLE_INFO_LOGGING
+        OutputDebugStringW(L"MultiplexedStreamTransport::StartReqListener bound to port number ");
+        OutputDebugStringW(m_reqPortName.c_str());
+        OutputDebugStringW(L". Listener ready.\n");
+#endif
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+        winrt::hstring message = webErrorStatus != SocketErrorStatus::Unknown ?
+            winrt::to_hstring((int32_t)webErrorStatus) : winrt::to_hstring(ex.to_abi());
+        OutputDebugStringW(L"MultiplexedStreamTransport::StartReqListener: Failed to open listener with ");
+        OutputDebugStringW(message.c_str());
+        OutputDebugStringW(L"\n");
+#endif
+    }
+}
+
+void MultiplexedStreamTransport::datagramSocket_MessageReceived(
+    DatagramSocket const& /* sender */,
+    DatagramSocketMessageReceivedEventArgs const& args)
+{
+    DataReader dataReader{ args.GetDataReader() };
+    winrt::hstring request{ dataReader.ReadString(dataReader.UnconsumedBufferLength()) };
+
+    // "<stream id>:<credit request>"
+    const wchar_t* pRequest = request.c_str();
+    wchar_t* end = nullptr;
+    long id = wcstol(pRequest, &end, 10);
+    if (end == pRequest || *end != L':')
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"MultiplexedStreamTransport::datagramSocket_MessageReceived: unexpected request\n");
+#endif
+        return;
+    }
+
+    std::function<bool(const wchar_t*)> handler;
+    {
+        std::lock_guard<std::mutex> guard(m_queueMutex);
+        for (const Stream& stream : m_streams)
+        {
+            if ((long)stream.id == id)
+            {
+                handler = stream.requestHandler;
+                break;
+            }
+        }
+    }
+
+    if (!handler || !handler(end + 1))
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"MultiplexedStreamTransport::datagramSocket_MessageReceived: unexpected request\n");
+#endif
+    }
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+// Stream ids used on the multiplexed connection. The per-sensor ports are the
+// base ports plus the id (23940 + id for TCP, 21110 + id for UDP requests).
+enum class StreamId : uint8_t
+{
+	PhotoVideo = 0,
+	// Long Throw depth + AB
+	Depth = 1,
+	LeftFront = 2,
+	RightFront = 3,
+	// accelerometer, gyroscope and magnetometer samples (see ImuStreamer)
+	Imu = 4,
+	// the side facing VLC cameras
+	LeftLeft = 5,
+	RightRight = 6,
+	// AHAT depth + AB
+	Ahat = 7,
+	// LF and RF as stereo pairs (see StereoFrameProcessor)
+	Stereo = 8,
+};
+
+static constexpr size_t kStreamCount = 9;
+
+// streams that carry depth + AB frames
+inline bool IsDepthStream(StreamId id)
+{
+	return id == StreamId::Depth || id == StreamId::Ahat;
+}
+
+// Carries the frames of every sensor over a single TCP connection, plus a
+// single UDP socket for the credit requests of all of them.
+//
+// Each message the streamers hand in (their usual frame header + payload) is
+// prefixed with a 12 byte little-endian mux header:
+//   uint8  stream id
+//   uint8  reserved[3]
+//   uint32 per-stream sequence number
+//   uint32 message length in bytes
+//
+// Requests are the usual credit datagrams prefixed with the stream id, e.g.
+// "2:1\n" or "2:R3\n".
+//
+// Messages are sent by a dedicated thread using deficit round robin over the
+// per-stream queues. Every stream earns weight * kQuantumBytes of send budget
+// per round, so a stream of large frames (PV) cannot hold back the smaller
+// depth and VLC frames queued behind it.
+class MultiplexedStreamTransport
+{
+public:
+	MultiplexedStreamTransport(
+		std::wstring portName,
+		std::wstring reqPortName);
+
+	~MultiplexedStreamTransport();
+
+	// What Submit did with a message.
+	enum class SubmitResult
+	{
+		// no receiver is connected, the message was discarded
+		NotConnected,
+		// queued, the stream had nothing else waiting
+		Idle,
+		// queued behind earlier messages of the stream, the link is behind
+		Queued,
+		// queued, and the stream's oldest message was dropped to make room
+		DroppedOldest,
+	};
+
+	// Adds a stream before streaming starts. weight is its share of the link
+	// (>= 1); requestHandler receives the credit requests for it. dropHandler
+	// is called for every message of the stream that is dropped before it
+	// went out: the receiver never sees it, so it never returns its credit.
+	void RegisterStream(
+		StreamId id,
+		int weight,
+		std::function<bool(const wchar_t*)> requestHandler,
+		std::function<void()> dropHandler);
+
+	// Queues one message for sending. If the stream already has
+	// kMaxQueuedMessages waiting, the oldest one is dropped.
+	SubmitResult Submit(
+		StreamId id,
+		winrt::Windows::Storage::Streams::IBuffer message);
+
+	// messages of the stream waiting for the link, not counting the one
+	// being written
+	size_t QueuedMessages(StreamId id) const;
+
+	// Reports every message to the controller as queued, then as sent or
+	// dropped. Call it before streaming starts.
+	void SetRateController(std::shared_ptr<RateController> rateController)
+	{
+		m_pRateController = rateController;
+	}
+
+	bool IsConnected() const
+	{
+		return m_isConnected;
+	}
+
+	static constexpr uint32_t kQuantumBytes = 64 * 1024;
+	static constexpr size_t kMaxQueuedMessages = 2;
+	static constexpr size_t kMuxHeaderSize = 12;
+
+private:
+	struct Stream
+	{
+		StreamId id;
+		int weight = 1;
+		std::function<bool(const wchar_t*)> requestHandler;
+		std::function<void()> dropHandler;
+		std::deque<winrt::Windows::Storage::Streams::IBuffer> queue;
+		uint64_t deficit = 0;
+		uint32_t sequence = 0;
+	};
+
+	winrt::Windows::Foundation::IAsyncAction StartServer();
+	winrt::Windows::Foundation::IAsyncAction StartReqListener();
+
+	void OnConnectionReceived(
+		winrt::Windows::Networking::Sockets::StreamSocketListener /* sender */,
+		winrt::Windows::Networking::Sockets::StreamSocketListenerConnectionReceivedEventArgs args);
+
+	void datagramSocket_MessageReceived(
+		winrt::Windows::Networking::Sockets::DatagramSocket const& /* sender */,
+		winrt::Windows::Networking::Sockets::DatagramSocketMessageReceivedEventArgs const& args);
+
+	static void SendThread(MultiplexedStreamTransport* pTransport);
+
+	// picks the next message in deficit round robin order, called with m_queueMutex held
+	bool PopNext(
+		StreamId& id,
+		uint32_t& sequence,
+		winrt::Windows::Storage::Streams::IBuffer& message);
+
+	void WriteMessage(
+		StreamId id,
+		uint32_t sequence,
+		winrt::Windows::Storage::Streams::IBuffer const& message);
+
+	// a message that did not go out, called without m_queueMutex held
+	void Drop(
+		StreamId id,
+		uint32_t length);
+
+	std::wstring m_portName;
+	std::wstring m_reqPortName;
+
+	winrt::Windows::Networking::Sockets::StreamSocketListener m_streamSocketListener;
+	winrt::Windows::Networking::Sockets::StreamSocket m_streamSocket = nullptr;
+	winrt::Windows::Storage::Streams::DataWriter m_writer = nullptr;
+	winrt::Windows::Networking::Sockets::DatagramSocket m_datagramSocket = nullptr;
+	std::atomic<bool> m_isConnected{ false };
+	std::shared_ptr<RateController> m_pRateController;
+
+	// guards m_streams, m_nextStream and the connection members above
+	mutable std::mutex m_queueMutex;
+	std::condition_variable m_queueNotEmpty;
+	std::vector<Stream> m_streams;
+	size_t m_nextStream = 0;
+
+	std::atomic<bool> m_fExit{ false };
+	std::thread m_sendThread;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// How the payload of a frame is encoded on the wire.
+//
+// The id travels in the codec field of the FrameHeader.
+enum class PayloadEncoding : uint16_t
+{
+	// packed pixels, as produced by FramePacking
+	Raw = 0,
+	// depth + AB, each image RVL coded (see DepthCodec)
+	Rvl = 1,
+	// depth + AB, 12 bits per pixel (see FramePacking::Packed12Size) after a
+	// little-endian uint32 flags word
+	Packed12 = 2,
+	// coded relative to the previous frame (or a keyframe) with LZ4 (see
+	// TemporalCodec); decodes to the raw payload
+	DeltaLz4 = 3,
+	// QOI image in independent horizontal bands (see TiledQoi); decodes to
+	// the raw payload
+	QoiTiled = 4,
+	// the raw payload as one LZ4 block
+	Lz4 = 5,
+	// IMU samples in fixed point blocks (see ImuPacking), only on the IMU
+	// stream
+	ImuBatch = 6,
+};
+
+// Packed12 flags: the unpacked images are big-endian, like raw AHAT frames
+static constexpr uint32_t kPacked12BigEndianPlanes = 1;
+static constexpr size_t kPacked12HeaderSize = sizeof(uint32_t);
@@ -0,0 +1,171 @@
+#include "PoseCache.h"
+
+#include <cmath>
+
+PoseCache::PoseCache(size_t capacity) :
+	m_samples(capacity > 2 ? capacity : 2)
+{
+}
+
+void PoseCache::Add(
+	int64_t time,
+	const Pose& pose)
+{
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		if (m_count > 0 && time <= m_samples[(m_first + m_count - 1) % m_samples.size()].time)
+		{
+			return;
+		}
+		if (m_count == m_samples.size())
+		{
+			// overwrite the oldest
+			m_first = (m_first + 1) % m_samples.size();
+			m_count--;
+		}
+		m_samples[(m_first + m_count) % m_samples.size()] = { time, pose };
+		m_count++;
+	}
+	m_sampleCount++;
+}
+
+bool PoseCache::Lookup(
+	int64_t time,
+	Pose& pose)
+{
+	bool hit = false;
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		const auto at = [this](size_t i) -> const Sample& { return m_samples[(m_first + i) % m_samples.size()]; };
+
+		if (m_count > 0 && time >= at(0).time && time <= at(m_count - 1).time)
+		{
+			// first sample at or after time
+			size_t low = 0;
+			size_t high = m_count - 1;
+			while (low < high)
+			{
+				const size_t middle = (low + high) / 2;
+				if (at(middle).time < time)
+				{
+					low = middle + 1;
+				}
+				else
+				{
+					high = middle;
+				}
+			}
+
+			const Sample& after = at(low);
+			if (after.time == time)
+			{
+				pose = after.pose;
+				hit = true;
+			}
+			else
+			{
+				const Sample& before = at(low - 1);
+				if (after.time - before.time <= kMaxGap)
+				{
+					pose = Interpolate(before.pose, after.pose,
+						(double)(time - before.time) / (double)(after.time - before.time));
+					hit = true;
+				}
+			}
+		}
+	}
+
+	if (hit)
+	{
+		m_hits++;
+	}
+	else
+	{
+		m_misses++;
+	}
+	return hit;
+}
+
+bool PoseCache::Lookup(
+	int64_t time,
+	float matrix[16])
+{
+	Pose pose;
+	if (!Lookup(time, pose))
+	{
+		return false;
+	}
+
+	const double x = pose.orientation[0];
+	const double y = pose.orientation[1];
+	const double z = pose.orientation[2];
+	const double w = pose.orientation[3];
+	float* m = matrix;
+	m[0] = (float)(1.0 - 2.0 * (y * y + z * z));
+	m[1] = (float)(2.0 * (x * y + z * w));
+	m[2] = (float)(2.0 * (x * z - y * w));
+	m[3] = 0.0f;
+	m[4] = (float)(2.0 * (x * y - z * w));
+	m[5] = (float)(1.0 - 2.0 * (x * x + z * z));
+	m[6] = (float)(2.0 * (y * z + x * w));
+	m[7] = 0.0f;
+	m[8] = (float)(2.0 * (x * z + y * w));
+	m[9] = (float)(2.0 * (y * z - x * w));
+	m[10] = (float)(1.0 - 2.0 * (x * x + y * y));
+	m[11] = 0.0f;
+	m[12] = pose.position[0];
+	m[13] = pose.position[1];
+	m[14] = pose.position[2];
+	m[15] = 1.0f;
+	return true;
+}
+
+PoseCache::Stats PoseCache::GetStats() const
+{
+	return { m_sampleCount.load(), m_hits.load(), m_misses.load() };
+}
+
+PoseCache::Pose PoseCache::Interpolate(
+	const Pose& a,
+	const Pose& b,
+	double t)
+{
+	Pose pose;
+	for (int i = 0; i < 3; i++)
+	{
+		pose.position[i] = (float)(a.position[i] + (b.position[i] - a.position[i]) * t);
+	}
+
+	double dot = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		dot += (double)a.orientation[i] * b.orientation[i];
+	}
+	// q and -q are the same rotation, take the short way
+	const double sign = dot < 0.0 ? -1.0 : 1.0;
+	dot *= sign;
+
+	double wa = 1.0 - t;
+	double wb = t * sign;
+	if (dot < 0.9995)
+	{
+		const double angle = std::acos(dot);
+		const double sine = std::sin(angle);
+		wa = std::sin((1.0 - t) * angle) / sine;
+		wb = std::sin(t * angle) / sine * sign;
+	}
+
+	double q[4];
+	double norm = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		q[i] = wa * a.orientation[i] + wb * b.orientation[i];
+		norm += q[i] * q[i];
+	}
+	norm = std::sqrt(norm);
+	for (int i = 0; i < 4; i++)
+	{
+		pose.orientation[i] = (float)(q[i] / norm);
+	}
+	return pose;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Time-indexed ring of rig poses, filled by a sampler on its own schedule
+// (see RigPoseService) and read by the streamers for every frame.
+//
+// A lookup between two samples interpolates: slerp for the orientation, lerp
+// for the position. Samples further apart than kMaxGap are not interpolated
+// between, so a long tracking loss is a miss rather than a guess; shorter
+// gaps, e.g. a few samples the locator could not provide, are bridged.
+// Lookups before the oldest or after the newest sample are misses as well,
+// the caller then falls back to locating the frame itself.
+//
+// Times are in 100 ns ticks on one clock (the QPC based host ticks of the
+// Research Mode frames). Add is called from one thread, Lookup from any.
+class PoseCache
+{
+public:
+	// 2.5 s at the default sample rate, longer than any frame waits to be
+	// packed
+	static constexpr size_t kDefaultCapacity = 256;
+	// 100 ms
+	static constexpr int64_t kMaxGap = 1000000;
+
+	struct Pose
+	{
+		// x, y, z, w as in make_float4x4_from_quaternion
+		float orientation[4];
+		float position[3];
+	};
+
+	struct Stats
+	{
+		uint64_t samples;
+		uint64_t hits;
+		uint64_t misses;
+	};
+
+	explicit PoseCache(size_t capacity = kDefaultCapacity);
+
+	// time has to be later than that of the previous sample, older ones are
+	// ignored
+	void Add(
+		int64_t time,
+		const Pose& pose);
+
+	// The pose at time, false on a miss.
+	bool Lookup(
+		int64_t time,
+		Pose& pose);
+
+	// Lookup as rig to world float4x4 (rotation, then translation; row by
+	// row, m11 first).
+	bool Lookup(
+		int64_t time,
+		float matrix[16]);
+
+	Stats GetStats() const;
+
+private:
+	struct Sample
+	{
+		int64_t time;
+		Pose pose;
+	};
+
+	static Pose Interpolate(
+		const Pose& a,
+		const Pose& b,
+		double t);
+
+	mutable std::mutex m_mutex;
+	std::vector<Sample> m_samples;
+	// index of the oldest sample, m_count samples follow it
+	size_t m_first = 0;
+	size_t m_count = 0;
+
+	std::atomic<uint64_t> m_sampleCount{ 0 };
+	std::atomic<uint64_t> m_hits{ 0 };
+	std::atomic<uint64_t> m_misses{ 0 };
+};
@@ -0,0 +1,252 @@
+#include "PoseCodec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	using namespace PoseCodec;
+
+	constexpr double kComponentScale = 32767.0 * 1.4142135623730951;
+	constexpr double kTranslationScale = 65536.0;
+
+	struct Pose
+	{
+		// x, y, z, w
+		double q[4];
+		double t[3];
+	};
+
+	// Both devices and the receivers are little-endian, values are copied as
+	// they are (like FrameHeader).
+	template <typename T>
+	void Store(uint8_t*& out, T value)
+	{
+		memcpy(out, &value, sizeof(value));
+		out += sizeof(value);
+	}
+
+	template <typename T>
+	T Load(const uint8_t*& in)
+	{
+		T value;
+		memcpy(&value, in, sizeof(value));
+		in += sizeof(value);
+		return value;
+	}
+
+	// element (i, j) of the rotation for column vectors, the transpose of
+	// the float4x4's upper 3x3
+	double R(const float m[16], int i, int j)
+	{
+		return m[j * 4 + i];
+	}
+
+	Pose ToPose(const float m[16])
+	{
+		Pose pose;
+		double* q = pose.q;
+		const double trace = R(m, 0, 0) + R(m, 1, 1) + R(m, 2, 2);
+		if (trace > 0.0)
+		{
+			const double s = 2.0 * std::sqrt(trace + 1.0);
+			q[3] = 0.25 * s;
+			q[0] = (R(m, 2, 1) - R(m, 1, 2)) / s;
+			q[1] = (R(m, 0, 2) - R(m, 2, 0)) / s;
+			q[2] = (R(m, 1, 0) - R(m, 0, 1)) / s;
+		}
+		else if (R(m, 0, 0) > R(m, 1, 1) && R(m, 0, 0) > R(m, 2, 2))
+		{
+			const double s = 2.0 * std::sqrt(1.0 + R(m, 0, 0) - R(m, 1, 1) - R(m, 2, 2));
+			q[3] = (R(m, 2, 1) - R(m, 1, 2)) / s;
+			q[0] = 0.25 * s;
+			q[1] = (R(m, 0, 1) + R(m, 1, 0)) / s;
+			q[2] = (R(m, 0, 2) + R(m, 2, 0)) / s;
+		}
+		else if (R(m, 1, 1) > R(m, 2, 2))
+		{
+			const double s = 2.0 * std::sqrt(1.0 + R(m, 1, 1) - R(m, 0, 0) - R(m, 2, 2));
+			q[3] = (R(m, 0, 2) - R(m, 2, 0)) / s;
+			q[0] = (R(m, 0, 1) + R(m, 1, 0)) / s;
+			q[1] = 0.25 * s;
+			q[2] = (R(m, 1, 2) + R(m, 2, 1)) / s;
+		}
+		else
+		{
+			const double s = 2.0 * std::sqrt(1.0 + R(m, 2, 2) - R(m, 0, 0) - R(m, 1, 1));
+			q[3] = (R(m, 1, 0) - R(m, 0, 1)) / s;
+			q[0] = (R(m, 0, 2) + R(m, 2, 0)) / s;
+			q[1] = (R(m, 1, 2) + R(m, 2, 1)) / s;
+			q[2] = 0.25 * s;
+		}
+
+		const double norm = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		const double sign = q[3] < 0.0 ? -1.0 : 1.0;
+		for (int i = 0; i < 4; i++)
+		{
+			q[i] *= sign / norm;
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			pose.t[i] = m[12 + i];
+		}
+		return pose;
+	}
+
+	void ToMatrix(const Pose& pose, float m[16])
+	{
+		const double x = pose.q[0];
+		const double y = pose.q[1];
+		const double z = pose.q[2];
+		const double w = pose.q[3];
+		const double r[3][3] = {
+			{ 1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y - z * w), 2.0 * (x * z + y * w) },
+			{ 2.0 * (x * y + z * w), 1.0 - 2.0 * (x * x + z * z), 2.0 * (y * z - x * w) },
+			{ 2.0 * (x * z - y * w), 2.0 * (y * z + x * w), 1.0 - 2.0 * (x * x + y * y) },
+		};
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				m[j * 4 + i] = (float)r[i][j];
+			}
+			m[i * 4 + 3] = 0.0f;
+			m[12 + i] = (float)pose.t[i];
+		}
+		m[15] = 1.0f;
+	}
+}
+
+namespace PoseCodec
+{
+	size_t EncodedSize(Format format)
+	{
+		switch (format)
+		{
+		case Format::Matrix: return 16 * sizeof(float);
+		case Format::Quaternion: return 7 * sizeof(float);
+		case Format::Quantized: return 4 * sizeof(int16_t) + 3 * sizeof(int32_t);
+		}
+		return 0;
+	}
+
+	size_t Encode(
+		const float matrix[16],
+		Format format,
+		uint8_t* out)
+	{
+		uint8_t* p = out;
+		switch (format)
+		{
+		case Format::Matrix:
+			memcpy(p, matrix, 16 * sizeof(float));
+			p += 16 * sizeof(float);
+			break;
+
+		case Format::Quaternion:
+		{
+			const Pose pose = ToPose(matrix);
+			for (double value : pose.q)
+			{
+				Store(p, (float)value);
+			}
+			for (double value : pose.t)
+			{
+				Store(p, (float)value);
+			}
+			break;
+		}
+
+		case Format::Quantized:
+		{
+			Pose pose = ToPose(matrix);
+			int largest = 0;
+			for (int i = 1; i < 4; i++)
+			{
+				if (std::fabs(pose.q[i]) > std::fabs(pose.q[largest]))
+				{
+					largest = i;
+				}
+			}
+			// q and -q are the same rotation
+			const double sign = pose.q[largest] < 0.0 ? -1.0 : 1.0;
+			for (int i = 0; i < 4; i++)
+			{
+				if (i != largest)
+				{
+					const double value = std::round(sign * pose.q[i] * kComponentScale);
+					Store(p, (int16_t)(std::min)(32767.0, (std::max)(-32767.0, value)));
+				}
+			}
+			Store(p, (uint16_t)largest);
+			for (double value : pose.t)
+			{
+				const double clamped = (std::min)(kQuantizedMaxTranslation, (std::max)(-kQuantizedMaxTranslation, value));
+				Store(p, (int32_t)std::lround(clamped * kTranslationScale));
+			}
+			break;
+		}
+
+		default:
+			return 0;
+		}
+		return (size_t)(p - out);
+	}
+
+	bool Decode(
+		const uint8_t* in,
+		Format format,
+		float matrix[16])
+	{
+		Pose pose;
+		switch (format)
+		{
+		case Format::Matrix:
+			memcpy(matrix, in, 16 * sizeof(float));
+			return true;
+
+		case Format::Quaternion:
+			for (double& value : pose.q)
+			{
+				value = Load<float>(in);
+			}
+			for (double& value : pose.t)
+			{
+				value = Load<float>(in);
+			}
+			break;
+
+		case Format::Quantized:
+		{
+			double components[3];
+			for (double& value : components)
+			{
+				value = Load<int16_t>(in) / kComponentScale;
+			}
+			const int largest = Load<uint16_t>(in) & 3;
+			double sum = 0.0;
+			for (int i = 0, c = 0; i < 4; i++)
+			{
+				if (i != largest)
+				{
+					pose.q[i] = components[c++];
+					sum += pose.q[i] * pose.q[i];
+				}
+			}
+			pose.q[largest] = std::sqrt((std::max)(0.0, 1.0 - sum));
+			for (double& value : pose.t)
+			{
+				value = Load<int32_t>(in) / kTranslationScale;
+			}
+			break;
+		}
+
+		default:
+			return false;
+		}
+
+		ToMatrix(pose, matrix);
+		return true;
+	}
+}
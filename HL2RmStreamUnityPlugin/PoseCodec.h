@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Compact encodings of the camera / rig to world transform that goes out with
+// every frame (see FrameHeader.h).
+//
+// The transforms are rigid: an orthonormal rotation plus a translation, with
+// (0, 0, 0, 1) as last column. Row-vector convention, as
+// winrt::Windows::Foundation::Numerics::float4x4: the rotation is the upper
+// 3x3, the translation m41 m42 m43. A rotation and a translation describe the
+// matrix completely:
+//
+//   Matrix      float m[16], row by row, m11 first                  64 bytes
+//   Quaternion  float qx, qy, qz, qw, tx, ty, tz                    28 bytes
+//               q as in make_float4x4_from_quaternion, qw >= 0
+//   Quantized   int16 c[3], uint16 largest, int32 t[3]              20 bytes
+//               smallest three quaternion components scaled by
+//               32767 * sqrt(2), the index (0 x .. 3 w) of the
+//               left out largest one, which is positive, and the
+//               translation in 1/65536 m (16.16 fixed point)
+//
+// All fields are little-endian. Decoding rebuilds the matrix; the error
+// against the original is bounded by the constants below (checked by
+// Benchmarks/PoseCodecBench). Matrices that are not rigid come back as the
+// closest rigid transform, translations beyond kQuantizedMaxTranslation are
+// clamped. PythonReceiver/native decodes with this same file.
+namespace PoseCodec
+{
+	enum class Format : uint8_t
+	{
+		Matrix = 0,
+		Quaternion = 1,
+		Quantized = 2,
+	};
+
+	static constexpr size_t kMaxEncodedSize = 16 * sizeof(float);
+
+	// rotation error in radians, translation error in meters per axis. The
+	// quantized rotation is within 0.006 degrees, the translation within
+	// 8 micrometers; the quaternion format keeps the translation exactly.
+	static constexpr double kQuaternionMaxRotationError = 1e-6;
+	static constexpr double kQuantizedMaxRotationError = 1e-4;
+	static constexpr double kQuantizedMaxTranslationError = 8e-6;
+	static constexpr double kQuantizedMaxTranslation = 32767.0;
+
+	// Size of the pose block, 0 for an unknown format.
+	size_t EncodedSize(Format format);
+
+	// Writes EncodedSize(format) bytes to out. Returns the number of bytes
+	// written, 0 for an unknown format.
+	size_t Encode(
+		const float matrix[16],
+		Format format,
+		uint8_t* out);
+
+	// Rebuilds the matrix from EncodedSize(format) bytes. Returns false for
+	// an unknown format.
+	bool Decode(
+		const uint8_t* in,
+		Format format,
+		float matrix[16]);
+}
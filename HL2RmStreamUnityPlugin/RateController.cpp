@@ -0,0 +1,323 @@
+#include "RateController.h"
+
+#include <algorithm>
+
+RateController::RateController(
+	size_t streamCount,
+	double latencyBound) :
+	m_latencyBound(latencyBound > 0.0 ? latencyBound : kDefaultLatencyBound)
+{
+	for (size_t i = 0; i < streamCount; i++)
+	{
+		m_streams.push_back(std::make_unique<Stream>());
+	}
+}
+
+void RateController::AddStream(
+	size_t stream,
+	int weight)
+{
+	if (stream >= m_streams.size())
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_streams[stream]->added = true;
+	m_streams[stream]->weight = (std::max)(1, weight);
+}
+
+bool RateController::Admit(
+	size_t stream,
+	uint64_t frameTicks,
+	Clock::time_point now)
+{
+	if (stream >= m_streams.size() || !m_streams[stream]->added)
+	{
+		return true;
+	}
+
+	Stream& current = *m_streams[stream];
+	current.offered.fetch_add(1, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (Wait(current, now) > kBacklogShare * m_latencyBound)
+		{
+			// would wait too long behind the frames still being written
+			return false;
+		}
+	}
+	const uint64_t interval = (uint64_t)current.interval.load(std::memory_order_relaxed);
+	if (interval == 0)
+	{
+		return true;
+	}
+	if (frameTicks < current.nextAdmit)
+	{
+		return false;
+	}
+	// The schedule moves on by one interval, so the stream keeps its rate on
+	// average even where the interval is not a multiple of the sensor's. It
+	// never lags more than one interval behind, so a sensor that paused does
+	// not get a burst of frames afterwards.
+	current.nextAdmit = (std::max)(current.nextAdmit, frameTicks - (std::min)(frameTicks, interval)) + interval;
+	return true;
+}
+
+void RateController::ReportQueued(
+	size_t stream,
+	size_t bytes,
+	Clock::time_point now)
+{
+	if (stream >= m_streams.size() || bytes == 0)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Stream& current = *m_streams[stream];
+	if (current.backlog == 0)
+	{
+		current.writeStart = now;
+		if (m_busyStreams++ == 0)
+		{
+			m_busySince = now;
+		}
+	}
+	current.backlog += (uint64_t)bytes;
+}
+
+void RateController::ReportSent(
+	size_t stream,
+	size_t bytes,
+	Clock::time_point now)
+{
+	if (stream >= m_streams.size())
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Stream& current = *m_streams[stream];
+	// the frame went out since writeStart, at the stream's share of the link
+	const double seconds = current.backlog > 0 ?
+		std::chrono::duration<double>(now - current.writeStart).count() : 0.0;
+	Release(current, bytes, now);
+	m_bytes += bytes;
+	if (current.added)
+	{
+		if (seconds > 0.0)
+		{
+			const double serviceRate = (double)bytes / seconds;
+			current.serviceRate = current.serviceRate > 0.0 ?
+				(1.0 - kSmoothing) * current.serviceRate + kSmoothing * serviceRate : serviceRate;
+		}
+		current.frameSize = current.frameSize > 0.0 ?
+			(1.0 - kSmoothing) * current.frameSize + kSmoothing * (double)bytes : (double)bytes;
+	}
+
+	if (!m_started)
+	{
+		m_started = true;
+		m_lastControl = now;
+		return;
+	}
+	if (now - m_lastControl >= kControlInterval)
+	{
+		Control(now);
+	}
+}
+
+void RateController::ReportDropped(
+	size_t stream,
+	size_t bytes,
+	Clock::time_point now)
+{
+	if (stream >= m_streams.size())
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Release(*m_streams[stream], bytes, now);
+}
+
+double RateController::Rate(size_t stream) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return stream < m_streams.size() ? m_streams[stream]->rate : 0.0;
+}
+
+double RateController::Capacity() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_capacity;
+}
+
+double RateController::Wait(
+	const Stream& stream,
+	Clock::time_point now) const
+{
+	if (stream.backlog == 0)
+	{
+		return 0.0;
+	}
+	// The streams with a backlog share the link, a limited stream gets its
+	// share of it. The service rate only follows once frames went out at
+	// that share, which takes seconds for PV on a weak link.
+	double rate = stream.serviceRate;
+	if (m_capacity > 0.0)
+	{
+		rate = (std::min)(rate, m_capacity / (std::max)(1, m_busyStreams));
+	}
+	if (stream.rate > 0.0)
+	{
+		rate = (std::min)(rate, stream.rate * stream.frameSize);
+	}
+	if (rate <= 0.0)
+	{
+		return 0.0;
+	}
+	// the frame being written has been going out since writeStart
+	const double written = std::chrono::duration<double>(now - stream.writeStart).count();
+	return (std::max)(0.0, (double)stream.backlog / rate - written);
+}
+
+void RateController::Release(
+	Stream& stream,
+	size_t bytes,
+	Clock::time_point now)
+{
+	const uint64_t backlog = stream.backlog;
+	if (backlog == 0)
+	{
+		return;
+	}
+	stream.backlog = backlog - (std::min)((uint64_t)bytes, backlog);
+	// the next frame starts going out
+	stream.writeStart = now;
+	if (stream.backlog == 0 && --m_busyStreams == 0)
+	{
+		m_busySeconds += std::chrono::duration<double>(now - m_busySince).count();
+	}
+}
+
+void RateController::Control(Clock::time_point now)
+{
+	const double elapsed = std::chrono::duration<double>(now - m_lastControl).count();
+	m_lastControl = now;
+
+	for (const std::unique_ptr<Stream>& pStream : m_streams)
+	{
+		Stream& stream = *pStream;
+		if (!stream.added)
+		{
+			continue;
+		}
+		const double offeredRate = stream.offered.exchange(0, std::memory_order_relaxed) / elapsed;
+		stream.offeredRate = (1.0 - kSmoothing) * stream.offeredRate + kSmoothing * offeredRate;
+	}
+
+	if (m_busyStreams > 0)
+	{
+		m_busySeconds += std::chrono::duration<double>(now - m_busySince).count();
+		m_busySince = now;
+	}
+	// frames complete in bursts, a raw PV frame takes longer than a control
+	// interval on a weak link, so the capacity is taken over the last
+	// kCapacitySteps intervals
+	m_stepBytes[m_step] = m_bytes;
+	m_stepBusySeconds[m_step] = m_busySeconds;
+	m_step = (m_step + 1) % kCapacitySteps;
+	m_bytes = 0;
+	m_busySeconds = 0.0;
+	uint64_t bytes = 0;
+	double busySeconds = 0.0;
+	for (int i = 0; i < kCapacitySteps; i++)
+	{
+		bytes += m_stepBytes[i];
+		busySeconds += m_stepBusySeconds[i];
+	}
+	if (busySeconds > 0.0)
+	{
+		m_capacity = (double)bytes / busySeconds;
+	}
+
+	Allocate();
+}
+
+void RateController::Allocate()
+{
+	if (m_capacity <= 0.0)
+	{
+		return;
+	}
+
+	// the streams that send, the others keep their limit until they do
+	std::vector<Stream*> open;
+	for (const std::unique_ptr<Stream>& pStream : m_streams)
+	{
+		if (pStream->added && pStream->frameSize > 0.0 && pStream->offeredRate > 0.0)
+		{
+			open.push_back(pStream.get());
+		}
+	}
+
+	// water filling: streams below the fair share are satisfied first and
+	// leave the rest of the link to the others
+	double remaining = m_capacity;
+	while (!open.empty())
+	{
+		int weights = 0;
+		for (Stream* pStream : open)
+		{
+			weights += pStream->weight;
+		}
+		const double perWeight = remaining / weights;
+
+		// streams that need less than their share get all they need, streams
+		// whose share is below kMinRate get kMinRate; either way the others
+		// split what is left
+		bool fixed = false;
+		for (auto it = open.begin(); it != open.end();)
+		{
+			Stream& stream = **it;
+			const double needed = stream.offeredRate * stream.frameSize;
+			const double floor = kMinRate * stream.frameSize;
+			if (needed <= perWeight * stream.weight)
+			{
+				remaining -= needed;
+				stream.rate = 0.0;
+				stream.interval = 0;
+			}
+			else if (perWeight * stream.weight < floor)
+			{
+				remaining -= floor;
+				Limit(stream, kMinRate);
+			}
+			else
+			{
+				++it;
+				continue;
+			}
+			it = open.erase(it);
+			fixed = true;
+		}
+		if (fixed)
+		{
+			remaining = (std::max)(0.0, remaining);
+			continue;
+		}
+
+		for (Stream* pStream : open)
+		{
+			Limit(*pStream, perWeight * pStream->weight / pStream->frameSize);
+		}
+		break;
+	}
+}
+
+void RateController::Limit(
+	Stream& stream,
+	double rate)
+{
+	stream.rate = rate;
+	stream.interval = (int64_t)(1e7 / rate);
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Shares the link between the streams by adapting their frame rates, so
+// that one heavy stream on a weak link does not hold back all the others.
+//
+// The streamers report every frame they hand to the socket (or the
+// multiplexed transport) and every write that completes. From that the
+// controller knows the bytes each stream has waiting, its service rate (a
+// frame's bytes over the time from when it started going out until its write
+// completed) and the link capacity: the bytes written per second while any
+// stream had something to write, over the last kCapacitySteps intervals.
+//
+// Every kControlInterval the capacity is shared max-min fairly by bytes,
+// weighted: a stream that needs less than its share gets all it needs, the
+// rest is split among the others. A stream's share over its average frame
+// size is its frame rate. Every stream keeps kMinRate, which comes out of the
+// others' shares.
+//
+// The frame a stream is writing takes its time on the wire, which no rate
+// can shorten: a raw PV frame alone takes a third of a second on a weak
+// link. Admit turns a frame away if it would wait longer than kBacklogShare
+// of the latency bound behind the frames its stream still has to write, so
+// no frame that goes out waits longer than the bound. Those drain at the
+// lowest of the stream's service rate, its share and the capacity split
+// among the streams writing.
+//
+// Admit is called from each stream's processing thread, the Report functions
+// from any thread.
+class RateController
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr std::chrono::milliseconds kControlInterval{ 500 };
+	// latency bound: seconds a frame may wait for the link before it goes
+	// out
+	static constexpr double kDefaultLatencyBound = 0.2;
+	// frames per second every stream keeps, however weak the link; a raw PV
+	// frame every two seconds is a quarter of an 8 MB/s link
+	static constexpr double kMinRate = 0.5;
+	// share of the latency bound a new frame may wait behind its stream's
+	// backlog, the rest covers packing and the service rate dropping while
+	// it waits
+	static constexpr double kBacklogShare = 0.8;
+	// control steps the capacity is measured over
+	static constexpr int kCapacitySteps = 4;
+	// weight of the newest sample in the running averages
+	static constexpr double kSmoothing = 0.3;
+
+	// streamCount is the number of stream ids, latencyBound in seconds
+	explicit RateController(
+		size_t streamCount,
+		double latencyBound = kDefaultLatencyBound);
+
+	RateController(const RateController&) = delete;
+	RateController& operator=(const RateController&) = delete;
+
+	// Before streaming. weight is the stream's share of the link relative to
+	// the other streams (>= 1).
+	void AddStream(
+		size_t stream,
+		int weight = 1);
+
+	// A new frame of the stream, taken at frameTicks (100 ns), that passed
+	// the stream's own rate limit. False if sending it would exceed the rate
+	// the stream is limited to on average, or it would wait longer than the
+	// latency bound. Streams that were not added always pass.
+	bool Admit(
+		size_t stream,
+		uint64_t frameTicks,
+		Clock::time_point now = Clock::now());
+
+	// A frame of bytes bytes was handed to the socket or transport.
+	void ReportQueued(
+		size_t stream,
+		size_t bytes,
+		Clock::time_point now = Clock::now());
+
+	// The write of a queued frame completed.
+	void ReportSent(
+		size_t stream,
+		size_t bytes,
+		Clock::time_point now = Clock::now());
+
+	// A queued frame was dropped or its write failed.
+	void ReportDropped(
+		size_t stream,
+		size_t bytes,
+		Clock::time_point now = Clock::now());
+
+	// frames per second the stream is limited to, 0 if it is not
+	double Rate(size_t stream) const;
+
+	// estimated link capacity in bytes per second, 0 before the first
+	// control step
+	double Capacity() const;
+
+	double LatencyBound() const
+	{
+		return m_latencyBound;
+	}
+
+private:
+	struct Stream
+	{
+		bool added = false;
+		int weight = 1;
+
+		// processing thread only
+		// frame time in 100 ns ticks from which the next frame is admitted
+		uint64_t nextAdmit = 0;
+
+		// frames passed to Admit since the last control step
+		std::atomic<uint64_t> offered{ 0 };
+		// ticks between admitted frames on average, 0 for no limit
+		std::atomic<int64_t> interval{ 0 };
+
+		// guarded by m_mutex
+		// handed over and not written yet
+		uint64_t backlog = 0;
+		// when the frame being written started going out
+		Clock::time_point writeStart;
+		double frameSize = 0.0;
+		double offeredRate = 0.0;
+		// bytes per second the stream's frames went out at
+		double serviceRate = 0.0;
+		double rate = 0.0;
+	};
+
+	// seconds a new frame of the stream would wait before it goes out, with
+	// m_mutex held
+	double Wait(
+		const Stream& stream,
+		Clock::time_point now) const;
+
+	// takes a written or dropped frame off the backlog, with m_mutex held
+	void Release(
+		Stream& stream,
+		size_t bytes,
+		Clock::time_point now);
+
+	// updates the capacity and the rates, with m_mutex held
+	void Control(Clock::time_point now);
+
+	void Allocate();
+
+	static void Limit(
+		Stream& stream,
+		double rate);
+
+	std::vector<std::unique_ptr<Stream>> m_streams;
+	double m_latencyBound;
+
+	mutable std::mutex m_mutex;
+	Clock::time_point m_lastControl;
+	bool m_started = false;
+	double m_capacity = 0.0;
+	// streams with a backlog, and since when one of them had
+	int m_busyStreams = 0;
+	Clock::time_point m_busySince;
+	// written, and seconds the link was busy, since the last control step
+	uint64_t m_bytes = 0;
+	double m_busySeconds = 0.0;
+	// both for the last kCapacitySteps control steps
+	uint64_t m_stepBytes[kCapacitySteps] = {};
+	double m_stepBusySeconds[kCapacitySteps] = {};
+	int m_step = 0;
+};
@@ -27,7 +27,6 @@ ResearchModeFrameProcessor::ResearchModeFrameProcessor(
     m_reqPortName(reqPortName)
 {
     m_pRMSensor->AddRef();
-    m_pSensorFrame = nullptr;
     m_fExit = false;
  
 
@@ -41,18 +40,23 @@ ResearchModeFrameProcessor::ResearchModeFrameProcessor(
 
 
 
+    // without a port of its own the requests come in through the multiplexed transport
+    if (!m_reqPortName.empty())
+    {
 #if DBG_ENABLE_INFO_LOGGING
-    swprintf_s(msgBuffer, L"ResearchModeFrameProcessor: attempting to start Req Listener %ls\n",
-        pLLSensor->GetFriendlyName());
-    OutputDebugStringW(msgBuffer);
+        swprintf_s(msgBuffer, L"ResearchModeFrameProcessor: attempting to start Req Listener %ls\n",
+            pLLSensor->GetFriendlyName());
+        OutputDebugStringW(msgBuffer);
 #endif
-    StartReqListener();
+        StartReqListener();
+    }
 
 }
 
 ResearchModeFrameProcessor::~ResearchModeFrameProcessor()
 {
     m_fExit = true;
+    m_frameMailbox.Wake();
     if (m_cameraUpdateThread.joinable())
     {
         m_cameraUpdateThread.join();
@@ -71,6 +75,7 @@ ResearchModeFrameProcessor::~ResearchModeFrameProcessor()
 void ResearchModeFrameProcessor::Stop()
 {
     m_fExit = true;
+    m_frameMailbox.Wake();
     if (m_cameraUpdateThread.joinable())
     {
         m_cameraUpdateThread.join();
@@ -89,7 +94,8 @@ void ResearchModeFrameProcessor::Stop()
 void ResearchModeFrameProcessor::Start()
 {
     m_fExit = false;
-    m_cameraUpdateThread = std::thread(CameraUpdateThread, this, m_camConsentGiven, m_pCamAccessConsent);
+    m_cameraUpdateThread = std::thread(CameraUpdateThread, this, &m_pRMSensor, &m_frameMailbox,
+        m_camConsentGiven, m_pCamAccessConsent);
     m_processThread = std::thread(FrameProcessingThread, this);
     isRunning = true;
 }
@@ -97,6 +103,8 @@ void ResearchModeFrameProcessor::Start()
 
 void ResearchModeFrameProcessor::CameraUpdateThread(
     ResearchModeFrameProcessor* pResearchModeFrameProcessor,
+    IResearchModeSensor** ppSensor,
+    LatestFrameMailbox<std::shared_ptr<IResearchModeSensorFrame>>* pMailbox,
     HANDLE camConsentGiven,
     ResearchModeSensorConsent* camAccessConsent)
 {
@@ -141,11 +149,11 @@ void ResearchModeFrameProcessor::CameraUpdateThread(
     if (SUCCEEDED(hr))
     {
         // try to open the camera stream
-        hr = pResearchModeFrameProcessor->m_pRMSensor->OpenStream();
+        hr = (*ppSensor)->OpenStream();
         if (FAILED(hr))
         {
-            pResearchModeFrameProcessor->m_pRMSensor->Release();
-            pResearchModeFrameProcessor->m_pRMSensor = nullptr;
+            (*ppSensor)->Release();
+            *ppSensor = nullptr;
 #if DBG_ENABLE_ERROR_LOGGING
             OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Opening the Stream failed.\n");
 #endif
@@ -157,7 +165,7 @@ void ResearchModeFrameProcessor::CameraUpdateThread(
         }
 #endif
         // frame acquisition loop
-        while (!pResearchModeFrameProcessor->m_fExit && pResearchModeFrameProcessor->m_pRMSensor)
+        while (!pResearchModeFrameProcessor->m_fExit && *ppSensor)
         {
 
             //OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: acquisition loop.\n");
@@ -165,16 +173,20 @@ void ResearchModeFrameProcessor::CameraUpdateThread(
             hr = S_OK;
             // try to grab the next frame
             IResearchModeSensorFrame* pSensorFrame = nullptr;
-            hr = pResearchModeFrameProcessor->m_pRMSensor->GetNextBuffer(&pSensorFrame);
+            hr = (*ppSensor)->GetNextBuffer(&pSensorFrame);
 
             if (SUCCEEDED(hr))
             {
-                std::lock_guard<std::mutex> guard(pResearchModeFrameProcessor->
-                    m_sensorFrameMutex);
-
                 std::shared_ptr<IResearchModeSensorFrame> spSensorFrame(pSensorFrame, [](IResearchModeSensorFrame* sf) { sf->Release(); });
 
-                pResearchModeFrameProcessor->m_pSensorFrame = spSensorFrame;
+                // never blocks, even while the previous frame is being sent
+                pMailbox->Publish(
+                    std::make_unique<std::shared_ptr<IResearchModeSensorFrame>>(std::move(spSensorFrame)));
+                if (pMailbox != &pResearchModeFrameProcessor->m_frameMailbox)
+                {
+                    // the processing thread only waits on the first mailbox
+                    pResearchModeFrameProcessor->m_frameMailbox.Wake();
+                }
 #if DBG_ENABLE_VERBOSE_LOGGING
                 OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Updated frame.\n");
 #endif
@@ -190,12 +202,12 @@ void ResearchModeFrameProcessor::CameraUpdateThread(
         }
 
         // if thread should exit...
-        if (pResearchModeFrameProcessor->m_pRMSensor)
+        if (*ppSensor)
         {
 #if DBG_ENABLE_INFO_LOGGING
             OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Closing the stream.\n");
 #endif
-            pResearchModeFrameProcessor->m_pRMSensor->CloseStream();
+            (*ppSensor)->CloseStream();
         }
     }
 }
@@ -207,37 +219,71 @@ void ResearchModeFrameProcessor::FrameProcessingThread(
 #if DBG_ENABLE_INFO_LOGGING
     OutputDebugString(L"ResearchModeFrameProcessor::FrameProcessingThread: Starting processing thread.\n");
 #endif
-    while (true)
+    while (!pProcessor->m_fExit && pProcessor->m_pFrameSink)
     {
-        if (pProcessor->m_sendNextFrame)
+        // sleep until a new frame, a request or Stop() wakes us up
+        pProcessor->m_frameMailbox.Wait();
+
+        if (pProcessor->m_fExit)
         {
-            if (!pProcessor->m_fExit && pProcessor->m_pFrameSink)
-            {
-                std::lock_guard<std::mutex> reader_guard(pProcessor->m_sensorFrameMutex);
-                if (pProcessor->m_pSensorFrame)
-                {
-                    if (pProcessor->IsValidTimestamp(pProcessor->m_pSensorFrame))
-                    {
-                        //OutputDebugString(L"ResearchModeFrameProcessor::FrameProcessingThread: about to send\n");
-
-                        pProcessor->m_pFrameSink->Send(
-                            pProcessor->m_pSensorFrame,
-                            pProcessor->m_pRMSensor->GetSensorType());
-                    }
-                }
+            break;
+        }
 
-                pProcessor->m_sendNextFrame = false;
-            }
+        // a frame is only sent while the receiver has credits left *and* a
+        // new one arrived
+        if (!pProcessor->m_credits.Available())
+        {
+            continue;
+        }
 
-            else
-            {
-                break;
-            }
+        pProcessor->SendLatestFrame();
+    }
+}
+
+void ResearchModeFrameProcessor::SendLatestFrame()
+{
+    std::unique_ptr<std::shared_ptr<IResearchModeSensorFrame>> pSensorFrame =
+        m_frameMailbox.Take();
+
+    if (!pSensorFrame || !IsValidTimestamp(*pSensorFrame))
+    {
+        return;
+    }
+
+    // only the processing thread consumes credits, so the one it saw is
+    // still there
+    m_credits.TryConsume();
 
+    //OutputDebugString(L"ResearchModeFrameProcessor::FrameProcessingThread: about to send\n");
+    m_pFrameSink->Send(
+        *pSensorFrame,
+        m_pRMSensor->GetSensorType());
+}
+
+bool ResearchModeFrameProcessor::HandleRequest(const wchar_t* request)
+{
+    if (*request == L'K')
+    {
+        if (m_pFrameSink)
+        {
+            m_pFrameSink->RequestKeyframe();
         }
+        return true;
+    }
+
+    if (!m_credits.HandleRequest(request))
+    {
+        return false;
+    }
 
-        std::this_thread::sleep_for(1ms); 
+    // a receiver that (re)connects has no reference frame yet
+    if (*request == L'R' && m_pFrameSink)
+    {
+        m_pFrameSink->RequestKeyframe();
     }
+
+    m_frameMailbox.Wake();
+    return true;
 }
 
 bool ResearchModeFrameProcessor::IsValidTimestamp(
@@ -256,6 +302,10 @@ bool ResearchModeFrameProcessor::IsValidTimestamp(
         {
             return false;
         }
+        if (m_pRateController && !m_pRateController->Admit((size_t)m_streamId, timestamp.HostTicks))
+        {
+            return false;
+        }
         m_prevTimestamp = timestamp.HostTicks;
         return true;
     }
@@ -336,14 +386,11 @@ void ResearchModeFrameProcessor::datagramSocket_MessageReceived(winrt::Windows::
     DataReader dataReader{ args.GetDataReader() };
     winrt::hstring request{ dataReader.ReadString(dataReader.UnconsumedBufferLength()) };
    
-    if (request == L"1\n")
-    {
-        //OutputDebugStringW(L"ResearchModeFrameProcessor::datagramSocket_MessageReceived request == 1 = true\n");
-        m_sendNextFrame = true;
-    }
-    else
+    if (!HandleRequest(request.c_str()))
     {
-        //OutputDebugStringW(L"ResearchModeFrameProcessor::datagramSocket_MessageReceived request == 1 = false \n");
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"ResearchModeFrameProcessor::datagramSocket_MessageReceived: unexpected request\n");
+#endif
     }
 
 #if DBG_ENABLE_INFO_LOGGING
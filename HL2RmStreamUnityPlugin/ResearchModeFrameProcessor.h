@@ -10,37 +10,60 @@ public:
 		std::shared_ptr<IResearchModeFrameSink> frameSink,
 		std::wstring reqPortName);
 
-	~ResearchModeFrameProcessor();
+	virtual ~ResearchModeFrameProcessor();
 
-	void Stop();
+	virtual void Stop();
 
-	void Start();
+	virtual void Start();
 
 	bool isRunning = false;
 
-	bool m_sendNextFrame = true;
+	// Applies a credit or keyframe request from the receiver. Called by the
+	// request listener, or by the multiplexed transport when reqPortName is
+	// empty.
+	bool HandleRequest(const wchar_t* request);
+
+	// frames the receiver allows to be in flight, refilled by its requests
+	FrameCredits m_credits;
+
+	// Also drops the frames the controller has no room for on the link,
+	// after the minDelta check. Call it before Start().
+	void SetRateController(
+		std::shared_ptr<RateController> rateController,
+		StreamId streamId)
+	{
+		m_pRateController = rateController;
+		m_streamId = streamId;
+	}
 
 
 protected:
+	// Opens *ppSensor and publishes its frames to pMailbox until Stop().
+	// Clears *ppSensor if the stream cannot be opened.
 	static void CameraUpdateThread(
 		ResearchModeFrameProcessor* pProcessor,
+		IResearchModeSensor** ppSensor,
+		LatestFrameMailbox<std::shared_ptr<IResearchModeSensorFrame>>* pMailbox,
 		HANDLE camConsentGiven,
 		ResearchModeSensorConsent* camAccessConsent);
 
 	static void FrameProcessingThread(
 		ResearchModeFrameProcessor* pProcessor);
 
+	// Called on the processing thread while the receiver has credits: hands
+	// the newest frame to the sink if it passes the rate limit.
+	virtual void SendLatestFrame();
+
 	bool IsValidTimestamp(
 		std::shared_ptr<IResearchModeSensorFrame> pSensorFrame);
 
-	// Mutex to access sensor frame
-	std::mutex m_sensorFrameMutex;
+	// latest frame handed from the camera thread to the processing thread
+	LatestFrameMailbox<std::shared_ptr<IResearchModeSensorFrame>> m_frameMailbox;
 
 	IResearchModeSensor* m_pRMSensor = nullptr;
-	std::shared_ptr<IResearchModeSensorFrame> m_pSensorFrame = nullptr;
 	std::shared_ptr<IResearchModeFrameSink> m_pFrameSink = nullptr;
 
-	bool m_fExit = false;
+	std::atomic<bool> m_fExit{ false };
 
 
 
@@ -51,6 +74,8 @@ protected:
 
 	UINT64 m_prevTimestamp = 0;
 	unsigned long long m_minDelta = 0;
+	std::shared_ptr<RateController> m_pRateController;
+	StreamId m_streamId = StreamId::Depth;
 	HANDLE m_camConsentGiven;
 	ResearchModeSensorConsent* m_pCamAccessConsent;
 
@@ -1,5 +1,4 @@
 #include "pch.h"
-#include "qoi.h"
 
 #define DBG_ENABLE_VERBOSE_LOGGING 0
 #define DBG_ENABLE_INFO_LOGGING 1
@@ -15,48 +14,35 @@ using namespace winrt::Windows::Foundation::Numerics;
 ResearchModeFrameStreamer::ResearchModeFrameStreamer(
     std::wstring portName,
     const GUID& guid,
-    const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& coordSystem)
+    const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& coordSystem,
+    std::shared_ptr<MultiplexedStreamTransport> transport,
+    StreamId streamId,
+    std::shared_ptr<FrameBufferPool> bufferPool)
 {
     m_portName = portName;
     m_worldCoordSystem = coordSystem;
+    m_pTransport = transport;
+    m_streamId = streamId;
 
+    // buffers are reserved once the first frame tells the frame size
+    m_pBufferPool = bufferPool ? bufferPool : std::make_shared<FrameBufferPool>();
 
-    m_qoi_desc = (qoi_desc*)malloc(sizeof(qoi_desc));
-    if (m_qoi_desc == NULL)
-    {
-        throw new std::bad_alloc();
-    }
-
-    m_qoi_desc->width = 0;
-    m_qoi_desc->height = 0;
-    m_qoi_desc->channels = 3;
-    m_qoi_desc->colorspace = 0;
-
-
-
-    //m_qoi_desc_depth = (qoi_desc*)malloc(sizeof(qoi_desc));
-    //if (m_qoi_desc_depth == NULL)
-    //{
-    //    throw new std::bad_alloc();
-    //}
 
-    //m_qoi_desc_depth->width = 0;
-    //m_qoi_desc_depth->height = 0;
-    //m_qoi_desc_depth->channels = 3;
-    //m_qoi_desc_depth->colorspace = 0;
-
-
-    depth_combined_buf = (BYTE*)malloc(sizeof(BYTE)*512*512*2*2); // combined
-    if (depth_combined_buf == NULL)
-    {
-        throw new std::bad_alloc();
-    }
+#if DBG_ENABLE_INFO_LOGGING
+    wchar_t msgBuffer[200];
+    swprintf_s(msgBuffer, L"ResearchModeFrameStreamer: Using %ls packing kernels.\n",
+        FramePacking::KernelPathName(FramePacking::ActiveKernelPath()));
+    OutputDebugStringW(msgBuffer);
+#endif
 
     // Get GUID identifying the rigNode to
     // initialize the SpatialLocator
     SetLocator(guid);
 
-    StartServer();
+    if (!m_pTransport)
+    {
+        StartServer();
+    }
 }
 
 
@@ -102,13 +88,12 @@ void ResearchModeFrameStreamer::OnConnectionReceived(
 {
     try
     {
-        m_streamSocket = args.Socket();
-        m_writer = DataWriter(args.Socket().OutputStream());
-        m_writer.UnicodeEncoding(UnicodeEncoding::Utf8);
-        m_writer.ByteOrder(ByteOrder::LittleEndian);
-
-        m_writeInProgress = false;
+        {
+            std::lock_guard<std::mutex> guard(m_socketMutex);
+            m_streamSocket = args.Socket();
+        }
         isConnected = true;
+        RequestKeyframe();
         //m_streamingEnabled = true;
 
         //m_reader = DataReader(m_streamSocket.InputStream());
@@ -141,21 +126,17 @@ void ResearchModeFrameStreamer::Send(
 {
     //if (!m_nextFrameRequested)
     //{
-    if (pSensorType == ResearchModeSensorType::DEPTH_AHAT)
+    if (m_pPipeline)
     {
-        SendAHAT(frame);
+        // packing and the socket write happen on the pipeline's threads
+        m_pPipeline->Submit({ frame, pSensorType });
+        return;
     }
 
-    else if (pSensorType == ResearchModeSensorType::DEPTH_LONG_THROW)
+    PackedFrame packed;
+    if (Pack(frame, pSensorType, packed))
     {
-        SendLongThrow(frame);
-    }
-
-
-    else
-    {
-        // both left and right ahat
-        SendVLC(frame);
+        Transmit(packed);
     }
     //}
  
@@ -171,6 +152,180 @@ void ResearchModeFrameStreamer::Send(
 
 }
 
+void ResearchModeFrameStreamer::SendPair(
+    std::shared_ptr<IResearchModeSensorFrame> pLeftFrame,
+    std::shared_ptr<IResearchModeSensorFrame> pRightFrame)
+{
+    if (m_pPipeline)
+    {
+        m_pPipeline->Submit({ pLeftFrame, ResearchModeSensorType::LEFT_FRONT, pRightFrame });
+        return;
+    }
+
+    PackedFrame packed;
+    if (PackVLC(pLeftFrame, packed, pRightFrame))
+    {
+        Transmit(packed);
+    }
+}
+
+
+void ResearchModeFrameStreamer::EnablePipeline(std::function<void()> onDrop)
+{
+    if (m_pPipeline)
+    {
+        return;
+    }
+
+    m_pPipeline = std::make_unique<FramePipeline<PendingFrame, PackedFrame>>(
+        [this](PendingFrame& pending, PackedFrame& packed)
+        {
+            if (pending.rightFrame)
+            {
+                return PackVLC(pending.frame, packed, pending.rightFrame);
+            }
+            return Pack(pending.frame, pending.sensorType, packed);
+        },
+        [this](PackedFrame& packed)
+        {
+            Transmit(packed);
+        },
+        kPipelineQueueCapacity,
+        [this, onDrop](bool skipped)
+        {
+            // the dropped frame may have been the reference of the next delta
+            RequestKeyframe();
+            // a skipped frame (no pose, no connection) says nothing about
+            // the link
+            if (!skipped)
+            {
+                ReportCongestion();
+            }
+            if (onDrop)
+            {
+                onDrop();
+            }
+        });
+}
+
+void ResearchModeFrameStreamer::SetTemporalDelta(
+    uint32_t keyframeInterval,
+    TemporalCodec::Method method,
+    int acceleration)
+{
+    m_pTemporalEncoder = std::make_unique<TemporalCodec::Encoder>(keyframeInterval, acceleration, method);
+}
+
+void ResearchModeFrameStreamer::RequestKeyframe()
+{
+    if (m_pTemporalEncoder)
+    {
+        m_pTemporalEncoder->RequestKeyframe();
+    }
+}
+
+void ResearchModeFrameStreamer::EnableAdaptiveEncoding(double cpuBudget)
+{
+    std::vector<PayloadEncoding> candidates = { PayloadEncoding::Raw, PayloadEncoding::Lz4 };
+    if (IsDepthStream(m_streamId))
+    {
+        candidates.push_back(PayloadEncoding::Packed12);
+        candidates.push_back(PayloadEncoding::Rvl);
+    }
+    if (m_pTemporalEncoder)
+    {
+        candidates.push_back(PayloadEncoding::DeltaLz4);
+    }
+    m_pCodecController = std::make_unique<CodecController>(candidates, cpuBudget);
+}
+
+void ResearchModeFrameStreamer::ReportCongestion()
+{
+    if (m_pCodecController)
+    {
+        m_pCodecController->ReportCongestion();
+    }
+}
+
+bool ResearchModeFrameStreamer::Pack(
+    std::shared_ptr<IResearchModeSensorFrame> frame,
+    ResearchModeSensorType sensorType,
+    PackedFrame& packed)
+{
+    if (sensorType == ResearchModeSensorType::DEPTH_AHAT)
+    {
+        return PackAHAT(frame, packed);
+    }
+    else if (sensorType == ResearchModeSensorType::DEPTH_LONG_THROW)
+    {
+        return PackLongThrow(frame, packed);
+    }
+    else
+    {
+        // both left and right ahat
+        return PackVLC(frame, packed);
+    }
+}
+
+void ResearchModeFrameStreamer::Transmit(PackedFrame& packed)
+{
+    if (m_pendingWrite)
+    {
+        if (m_pendingWrite.Status() == winrt::Windows::Foundation::AsyncStatus::Started)
+        {
+            // the previous frame is still on the wire
+            ReportCongestion();
+        }
+        // Writes do not pile up behind each other: the frames that arrive
+        // meanwhile wait in the transmit queue, which drops the oldest and
+        // hands its credit back.
+        CompletePendingWrite();
+    }
+
+    StreamSocket socket = nullptr;
+    if (!m_pTransport)
+    {
+        std::lock_guard<std::mutex> guard(m_socketMutex);
+        socket = m_streamSocket;
+    }
+    if (m_pTransport ? !m_pTransport->IsConnected() : !socket)
+    {
+#if DBG_ENABLE_VERBOSE_LOGGING
+        OutputDebugStringW(L"ResearchModeFrameStreamer::Send: No connection.\n");
+#endif
+        RequestKeyframe();
+        return;
+    }
+
+    try
+    {
+#if DBG_ENABLE_VERBOSE_LOGGING
+        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Trying to store writer...\n");
+#endif
+        SendSlot(packed.slot, packed.payloadLength, packed.bytesCopied, socket);
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+        RequestKeyframe();
+        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+        if (webErrorStatus == SocketErrorStatus::ConnectionResetByPeer)
+        {
+            // the client disconnected!
+            DropSocket(socket);
+        }
+#if DBG_ENABLE_ERROR_LOGGING
+        winrt::hstring message = ex.message();
+        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Sending failed with ");
+        OutputDebugStringW(message.c_str());
+        OutputDebugStringW(L"\n");
+#endif // DBG_ENABLE_ERROR_LOGGING
+    }
+
+#if DBG_ENABLE_VERBOSE_LOGGING
+    OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Frame sent!\n");
+#endif
+}
+
 
 //winrt::Windows::Foundation::IAsyncAction ResearchModeFrameStreamer::SendAndWait(
 //    std::shared_ptr<IResearchModeSensorFrame> frame,
@@ -202,16 +357,10 @@ void ResearchModeFrameStreamer::Send(
 
 
 
-void ResearchModeFrameStreamer::SendAHAT(
-    std::shared_ptr<IResearchModeSensorFrame> frame)
+bool ResearchModeFrameStreamer::PackAHAT(
+    std::shared_ptr<IResearchModeSensorFrame> frame,
+    PackedFrame& packed)
 {
-    if (m_writeInProgress)
-    {
-#if DBG_ENABLE_VERBOSE_LOGGING
-        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Write already in progress.\n");
-#endif
-        return;
-    }
 
 
 
@@ -219,12 +368,12 @@ void ResearchModeFrameStreamer::SendAHAT(
     OutputDebugStringW(L"ResearchModeFrameStreamer::Send: Received frame for sending!\n");
 #endif
 
-    if (!m_streamSocket || !m_writer)
+    if (!IsConnected())
     {
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"ResearchModeFrameStreamer::Send: No connection.\n");
 #endif
-        return;
+        return false;
     }
 
     // grab the frame info
@@ -237,16 +386,14 @@ void ResearchModeFrameStreamer::SendAHAT(
 
     auto prevTimestamp = rmTimestamp.HostTicks;
 
-    auto timestamp = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(prevTimestamp)));
-    auto location = m_locator.TryLocateAtTimestamp(timestamp, m_worldCoordSystem);
-    if (!location)
+    float4x4 rig2worldTransform;
+    if (!LocateRig(prevTimestamp, rig2worldTransform))
     {
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"ResearchModeFrameStreamer::Send: Can't locate frame.\n");
 #endif
-        return;
+        return false;
     }
-    const float4x4 rig2worldTransform = make_float4x4_from_quaternion(location.Orientation()) * make_float4x4_translation(location.Position());
     auto absoluteTimestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds((long long)prevTimestamp)).count();
 
     // grab the frame data
@@ -260,7 +407,7 @@ void ResearchModeFrameStreamer::SendAHAT(
     const UINT16* pAbImage = nullptr;
 
     // invalidation value for AHAT 
-    USHORT maxValue = 4090;
+    USHORT maxValue = Depth::AHAT_INVALID_VALUE;
 
     frame->GetResolution(&resolution);
     HRESULT hr = frame->QueryInterface(IID_PPV_ARGS(&pDepthFrame));
@@ -270,7 +417,7 @@ void ResearchModeFrameStreamer::SendAHAT(
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"ResearchModeFrameStreamer::Send: Failed to grab depth frame.\n");
 #endif
-        return;
+        return false;
     }
 
     std::shared_ptr<IResearchModeSensorDepthFrame> spDepthFrame(pDepthFrame, [](IResearchModeSensorDepthFrame* sf) { sf->Release(); });
@@ -285,198 +432,103 @@ void ResearchModeFrameStreamer::SendAHAT(
 
     if (!SUCCEEDED(hr))
     {
-        return;
+        return false;
     }
 
-    /*std::vector<BYTE> depthByteData;
-    depthByteData.reserve( (outBufferCountDepth) * sizeof(UINT16));*/
-
-
-    // validate depth & append to vector
-    for (size_t i = 0; i < outBufferCountDepth; ++i)
-    {
-        // use a different invalidation condition for Long Throw and AHAT 
-        const bool invalid = (pDepth[i] >= maxValue);
-        UINT16 d;
-        if (invalid)
-        {
-            d = 0;
-        }
-        else
-        {
-            d = pDepth[i];
-        }
-        depth_combined_buf[i * 2] = (BYTE)(d >> 8);
-        depth_combined_buf[i * 2 + 1] = (BYTE)(d);
-        //depthByteData.push_back((BYTE)(d >> 8));
-        //depthByteData.push_back((BYTE)d);
-
-    }
-
-
-
     hr = spDepthFrame->GetAbDepthBuffer(&pAbImage, &outBufferCountAb);
     if (!SUCCEEDED(hr))
     {
-        return;
+        return false;
     }
 
-    //std::vector<BYTE> AbByteData;
-    //AbByteData.reserve((outBufferCountAb) * sizeof(UINT16));
-
-    // ab Image
-    for (size_t i = 0; i < (outBufferCountAb); ++i)
+    if (outBufferCountAb != outBufferCountDepth ||
+        outBufferCountDepth > Depth::AHAT_PIXEL_COUNT)
     {
-        // use a different invalidation condition for Long Throw and AHAT 
-        const bool invalid = (pAbImage[i] >= maxValue);
-        UINT16 d;
-        if (invalid)
-        {
-            d = 0;
-        }
-        else
-        {
-            d = pAbImage[i];
-            //depth_combined_buf[outBufferCountDepth+i] = pAbImage[i];
-        }
-        //AbByteData.push_back((BYTE)(d >> 8));
-        //AbByteData.push_back((BYTE)d);
-        depth_combined_buf[outBufferCountDepth * 2 + i * 2] = (BYTE)(d >> 8);
-        depth_combined_buf[outBufferCountDepth * 2 + i * 2 + 1] = (BYTE)(d);
-
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"ResearchModeFrameStreamer::SendAHAT: Unexpected depth buffer size.\n");
+#endif
+        return false;
     }
 
-    m_qoi_desc->width = 512;    // trick for encoding a greyscale image
-    m_qoi_desc->height = 512;
-    m_qoi_desc->channels = 4; // already initialized to 4
-
-    int out_len = 0;
-
-    //uint8_t* qoi_buf = (uint8_t*)qoi_encode(depth_combined_buf, m_qoi_desc, &out_len);  // m_qoi_desc has the size of the buffer
-    //if (qoi_buf == NULL)
-    //{
-    //    throw std::bad_alloc();
-    //}
-
-    //const int max_dst_size = LZ4_compressBound(out_len);
-    //char* compressed_data = (char*)malloc((size_t)max_dst_size);
-
-    //if (compressed_data == NULL)
-    //{
-    //    OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Malloc failed for lz4.\n");
-    //    throw std::bad_alloc();
-    //}
-
-    //const int compressed_data_size = LZ4_compress_default((char*)qoi_buf, compressed_data, out_len, max_dst_size);
-
-
-    //free(qoi_buf);
-
-    //if (compressed_data_size <= 0)
-    //{
-    //    // lz4 error
-    //    free(compressed_data);
-    //    return;
-    //}
-
-
-    //const int max_dst_size2 = LZ4_compressBound(compressed_data_size);
-    //char* compressed_data2 = (char*)malloc((size_t)max_dst_size2);
-
-    //if (compressed_data2 == NULL)
-    //{
-    //    OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Malloc failed for lz4.\n");
-    //    throw std::bad_alloc();
-    //}
-
-    //const int compressed_data_size2 = LZ4_compress_default(compressed_data, compressed_data2, compressed_data_size, max_dst_size2);
-
-    //if (compressed_data_size2 <= 0)
-    //{
-    //    // lz4 error
-    //    free(compressed_data);
-    //    free(compressed_data2);
-    //    return;
-    //}
-
-
-    //std::vector<BYTE> DepthCombinedByteBuffer(compressed_data2, compressed_data2 + compressed_data_size2); // TODO: does this make a copy?
-
-    int combined_buf_size = imageHeight * imageHeight * pixelStride * 2; //use bytes per pixel instead of hard coding
-    std::vector<BYTE> DepthCombinedByteBuffer(depth_combined_buf, depth_combined_buf + combined_buf_size); // TODO: does this make a copy?
-
-    //free(compressed_data);
-    //free(compressed_data2);
-
-
-
-    m_writeInProgress = true;
-
-    try
+    const size_t rawSize = outBufferCountDepth * 2 * 2;
+    ReserveBuffers(PayloadCapacity(rawSize));
+    std::shared_ptr<FrameSendSlot> slot = m_pBufferPool->Acquire(FrameHeaderSize(m_poseFormat), PayloadCapacity(rawSize));
+    if (!slot)
     {
-        // Write header
-        m_writer.WriteUInt64(absoluteTimestamp);
-        m_writer.WriteInt32(imageWidth);
-        m_writer.WriteInt32(imageHeight);
-        m_writer.WriteInt32(pixelStride);
-        m_writer.WriteInt32(rowStride);
-        //m_writer.WriteInt32(compressed_data_size2);
-        m_writer.WriteInt32(combined_buf_size);
-
-
-        WriteMatrix4x4(rig2worldTransform);
-
-        m_writer.WriteBytes(DepthCombinedByteBuffer);
-        //m_writer.WriteBytes(AbByteData);
-
+        m_stats.framesDropped++;
 #if DBG_ENABLE_VERBOSE_LOGGING
-        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Trying to store writer...\n");
+        OutputDebugStringW(L"ResearchModeFrameStreamer::SendAHAT: No send buffer available.\n");
 #endif
-        m_writer.StoreAsync();
+        return false;
     }
-    catch (winrt::hresult_error const& ex)
+
+    // RVL code or 12-bit pack depth & AB into the send buffer, or invalidate
+    // both and pack them big-endian if that is turned off (or would not save
+    // anything). Raw frames may still be LZ4 or temporal coded.
+    const PayloadEncoding requested = NextEncoding(m_encoding);
+    const CodecController::Clock::time_point encodeStart = CodecController::Clock::now();
+    PayloadEncoding encoding = PayloadEncoding::Raw;
+    size_t payloadSize = 0;
+    uint32_t bytesCopied = 0;
+    if (requested == PayloadEncoding::Rvl)
     {
-        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
-        if (webErrorStatus == SocketErrorStatus::ConnectionResetByPeer)
-        {
-            // the client disconnected!
-            m_writer == nullptr;
-            m_streamSocket == nullptr;
-            m_writeInProgress = false;
-        }
-#if DBG_ENABLE_ERROR_LOGGING
-        winrt::hstring message = ex.message();
-        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Sending failed with ");
-        OutputDebugStringW(message.c_str());
-        OutputDebugStringW(L"\n");
-#endif // DBG_ENABLE_ERROR_LOGGING
+        payloadSize = DepthCodec::EncodeDepthAb(pDepth, pAbImage, outBufferCountDepth,
+            maxValue, maxValue, true, slot->Payload(), rawSize);
+        encoding = payloadSize ? PayloadEncoding::Rvl : PayloadEncoding::Raw;
     }
-
-    m_writeInProgress = false;
-
-#if DBG_ENABLE_VERBOSE_LOGGING
-    OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Frame sent!\n");
-#endif
+    else if (requested == PayloadEncoding::Packed12 &&
+        FramePacking::PackAhatDepthAb12(pDepth, pAbImage, outBufferCountDepth, maxValue,
+            slot->Payload() + kPacked12HeaderSize))
+    {
+        const uint32_t flags = kPacked12BigEndianPlanes;
+        memcpy(slot->Payload(), &flags, sizeof(flags));
+        encoding = PayloadEncoding::Packed12;
+        payloadSize = kPacked12HeaderSize + 2 * FramePacking::Packed12Size(outBufferCountDepth);
+    }
+    if (encoding == PayloadEncoding::Raw)
+    {
+        encoding = RawPayloadEncoding(requested);
+    }
+    if (encoding == PayloadEncoding::DeltaLz4 || encoding == PayloadEncoding::Lz4)
+    {
+        m_rawPayload.resize(rawSize);
+        FramePacking::PackAhatDepthAb(pDepth, pAbImage, outBufferCountDepth, maxValue, m_rawPayload.data());
+        payloadSize = EncodeRawPayload(encoding, m_rawPayload.data(), rawSize, *slot, bytesCopied);
+    }
+    else if (encoding == PayloadEncoding::Raw)
+    {
+        FramePacking::PackAhatDepthAb(pDepth, pAbImage, outBufferCountDepth, maxValue, slot->Payload());
+        payloadSize = rawSize;
+    }
+    ReportEncoding(requested, rawSize, payloadSize, encodeStart);
+
+    // Write header
+    FrameHeader header = MakeFrameHeader((uint8_t)m_streamId, m_poseFormat, (uint16_t)encoding, m_sequence++);
+    header.timestamp = (uint64_t)absoluteTimestamp;
+    header.width = imageWidth;
+    header.height = imageHeight;
+    header.pixelStride = pixelStride;
+    header.rowStride = rowStride;
+    header.payloadLength = (uint32_t)payloadSize;
+    WriteFrameHeader(header, &rig2worldTransform.m11, slot->Header());
+
+    packed.slot = slot;
+    packed.payloadLength = (uint32_t)payloadSize;
+    packed.bytesCopied = bytesCopied;
 
     // Release() not needed because the shared pointer spDepthFrame calls it when it goes out of scope
     //if (pDepthFrame)
     //    pDepthFrame->Release();
 
-
+    return true;
 }
 
 
 
-void ResearchModeFrameStreamer::SendLongThrow(
-    std::shared_ptr<IResearchModeSensorFrame> frame)
+bool ResearchModeFrameStreamer::PackLongThrow(
+    std::shared_ptr<IResearchModeSensorFrame> frame,
+    PackedFrame& packed)
 {
-    if (m_writeInProgress)
-    {
-#if DBG_ENABLE_VERBOSE_LOGGING
-        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Write already in progress.\n");
-#endif
-        return;
-    }
 
 
 
@@ -484,12 +536,12 @@ void ResearchModeFrameStreamer::SendLongThrow(
     OutputDebugStringW(L"ResearchModeFrameStreamer::Send: Received frame for sending!\n");
 #endif
 
-    if (!m_streamSocket || !m_writer)
+    if (!IsConnected())
     {
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"ResearchModeFrameStreamer::Send: No connection.\n");
 #endif
-        return;
+        return false;
     }
 
     // grab the frame info
@@ -502,16 +554,14 @@ void ResearchModeFrameStreamer::SendLongThrow(
 
     auto prevTimestamp = rmTimestamp.HostTicks;
 
-    auto timestamp = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(prevTimestamp)));
-    auto location = m_locator.TryLocateAtTimestamp(timestamp, m_worldCoordSystem);
-    if (!location)
+    float4x4 rig2worldTransform;
+    if (!LocateRig(prevTimestamp, rig2worldTransform))
     {
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"ResearchModeFrameStreamer::Send: Can't locate frame.\n");
 #endif
-        return;
+        return false;
     }
-    const float4x4 rig2worldTransform = make_float4x4_from_quaternion(location.Orientation()) * make_float4x4_translation(location.Position());
     auto absoluteTimestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds((long long)prevTimestamp)).count();
 
     // grab the frame data
@@ -528,9 +578,6 @@ void ResearchModeFrameStreamer::SendLongThrow(
     const BYTE* pSigma = nullptr;
     size_t outSigmaBufferCount = 0;
 
-    // invalidation value for AHAT 
-    USHORT maxValue = 4090;
-
     frame->GetResolution(&resolution);
     HRESULT hr = frame->QueryInterface(IID_PPV_ARGS(&pDepthFrame));
 
@@ -539,7 +586,7 @@ void ResearchModeFrameStreamer::SendLongThrow(
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"ResearchModeFrameStreamer::Send: Failed to grab depth frame.\n");
 #endif
-        return;
+        return false;
     }
 
     std::shared_ptr<IResearchModeSensorDepthFrame> spDepthFrame(pDepthFrame, [](IResearchModeSensorDepthFrame* sf) { sf->Release(); });
@@ -554,210 +601,132 @@ void ResearchModeFrameStreamer::SendLongThrow(
 
     if (!SUCCEEDED(hr))
     {
-        return;
+        return false;
     }
 
     hr = pDepthFrame->GetSigmaBuffer(&pSigma, &outSigmaBufferCount);
 
     if (!SUCCEEDED(hr))
     {
-        return;
-    }
-
-    /*std::vector<BYTE> depthByteData;
-    depthByteData.reserve( (outBufferCountDepth) * sizeof(UINT16));*/
-
-
-    // validate depth & append to vector
-    for (size_t i = 0; i < outBufferCountDepth; ++i)
-    {
-        //// use a different invalidation condition for Long Throw and AHAT 
-        const bool invalid = (pSigma[i] & Depth::InvalidationMasks::Invalid) > 0;
-        UINT16 d;
-        if (invalid)
-        {
-            d = 0;
-        }
-        else
-        {
-            d = pDepth[i];
-        }
-
-        depth_combined_buf[i * 2] = (BYTE)(d);
-        depth_combined_buf[i * 2 + 1] = (BYTE)(d >> 8);
-        //depthByteData.push_back((BYTE)(d >> 8));
-        //depthByteData.push_back((BYTE)d);
-
+        return false;
     }
 
-
-
     hr = spDepthFrame->GetAbDepthBuffer(&pAbImage, &outBufferCountAb);
     if (!SUCCEEDED(hr))
     {
-        return;
+        return false;
     }
 
-    //std::vector<BYTE> AbByteData;
-    //AbByteData.reserve((outBufferCountAb) * sizeof(UINT16));
-
-    // ab Image
-    for (size_t i = 0; i < (outBufferCountAb); ++i)
+    if (outBufferCountAb != outBufferCountDepth ||
+        outSigmaBufferCount != outBufferCountDepth ||
+        outBufferCountDepth > Depth::LONG_THROW_PIXEL_COUNT)
     {
-        // use a different invalidation condition for Long Throw and AHAT 
-        //const bool invalid = (pAbImage[i] >= maxValue);
-        UINT16 d;
-      /*  if (invalid)
-        {
-            d = 0;
-        }
-        else
-        {*/
-            d = pAbImage[i];
-            //depth_combined_buf[outBufferCountDepth+i] = pAbImage[i];
-        //}
-        //AbByteData.push_back((BYTE)(d >> 8));
-        //AbByteData.push_back((BYTE)d);
-        depth_combined_buf[outBufferCountDepth * 2 + i * 2] = (BYTE)(d);
-        depth_combined_buf[outBufferCountDepth * 2 + i * 2 + 1] = (BYTE)(d >> 8);
-
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"ResearchModeFrameStreamer::SendLongThrow: Unexpected depth buffer size.\n");
+#endif
+        return false;
     }
 
-    m_qoi_desc->width = 320;    // trick for encoding a greyscale image
-    m_qoi_desc->height = 288;
-    m_qoi_desc->channels = 4; // already initialized to 4
-
-    int out_len = 0;
-
-    //uint8_t* qoi_buf = (uint8_t*)qoi_encode(depth_combined_buf, m_qoi_desc, &out_len);  // m_qoi_desc has the size of the buffer
-    //if (qoi_buf == NULL)
-    //{
-    //    throw std::bad_alloc();
-    //}
-
-    //const int max_dst_size = LZ4_compressBound(out_len);
-    //char* compressed_data = (char*)malloc((size_t)max_dst_size);
-
-    //if (compressed_data == NULL)
-    //{
-    //    OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Malloc failed for lz4.\n");
-    //    throw std::bad_alloc();
-    //}
-
-    //const int compressed_data_size = LZ4_compress_default((char*)qoi_buf, compressed_data, out_len, max_dst_size);
-
-
-    //free(qoi_buf);
-
-    //if (compressed_data_size <= 0)
-    //{
-    //    // lz4 error
-    //    free(compressed_data);
-    //    return;
-    //}
-
-
-    //const int max_dst_size2 = LZ4_compressBound(compressed_data_size);
-    //char* compressed_data2 = (char*)malloc((size_t)max_dst_size2);
-
-    //if (compressed_data2 == NULL)
-    //{
-    //    OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Malloc failed for lz4.\n");
-    //    throw std::bad_alloc();
-    //}
-
-    //const int compressed_data_size2 = LZ4_compress_default(compressed_data, compressed_data2, compressed_data_size, max_dst_size2);
-
-    //if (compressed_data_size2 <= 0)
-    //{
-    //    // lz4 error
-    //    free(compressed_data);
-    //    free(compressed_data2);
-    //    return;
-    //}
-
-
-    //std::vector<BYTE> DepthCombinedByteBuffer(compressed_data2, compressed_data2 + compressed_data_size2); // TODO: does this make a copy?
-
-    int depth_combined_size = imageHeight * imageWidth * pixelStride * 2;
-    std::vector<BYTE> DepthCombinedByteBuffer(depth_combined_buf, depth_combined_buf + depth_combined_size); // TODO: does this make a copy?
-
-    /*free(compressed_data);
-    free(compressed_data2);*/
-
-
-
-    m_writeInProgress = true;
-
-    try
+    // invalidate depth using the sigma buffer and pack depth & AB
+    // little-endian into the send buffer
+    const size_t rawSize = outBufferCountDepth * 2 * 2;
+    ReserveBuffers(PayloadCapacity(rawSize));
+    std::shared_ptr<FrameSendSlot> slot = m_pBufferPool->Acquire(FrameHeaderSize(m_poseFormat), PayloadCapacity(rawSize));
+    if (!slot)
     {
-        // Write header
-        m_writer.WriteUInt64(absoluteTimestamp);
-        m_writer.WriteInt32(imageWidth);
-        m_writer.WriteInt32(imageHeight);
-        m_writer.WriteInt32(pixelStride);
-        m_writer.WriteInt32(rowStride);
-        //m_writer.WriteInt32(compressed_data_size2);
-        m_writer.WriteInt32(depth_combined_size);
-
-
-        WriteMatrix4x4(rig2worldTransform);
-
-        m_writer.WriteBytes(DepthCombinedByteBuffer);
-        //m_writer.WriteBytes(AbByteData);
-
+        m_stats.framesDropped++;
 #if DBG_ENABLE_VERBOSE_LOGGING
-        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Trying to store writer...\n");
+        OutputDebugStringW(L"ResearchModeFrameStreamer::SendLongThrow: No send buffer available.\n");
 #endif
-        m_writer.StoreAsync();
+        return false;
     }
-    catch (winrt::hresult_error const& ex)
+
+    const PayloadEncoding requested = NextEncoding(m_encoding);
+    const CodecController::Clock::time_point encodeStart = CodecController::Clock::now();
+    PayloadEncoding encoding = PayloadEncoding::Raw;
+    size_t payloadSize = 0;
+    uint32_t bytesCopied = 0;
+    if (requested == PayloadEncoding::Rvl)
     {
-        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
-        if (webErrorStatus == SocketErrorStatus::ConnectionResetByPeer)
+        // RVL only knows "zero is invalid", apply the sigma mask first
+        m_maskedDepth.resize(outBufferCountDepth);
+        for (size_t i = 0; i < outBufferCountDepth; i++)
         {
-            // the client disconnected!
-            m_writer == nullptr;
-            m_streamSocket == nullptr;
-            m_writeInProgress = false;
+            m_maskedDepth[i] = (pSigma[i] & Depth::InvalidationMasks::Invalid) ? 0 : pDepth[i];
         }
-#if DBG_ENABLE_ERROR_LOGGING
-        winrt::hstring message = ex.message();
-        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Sending failed with ");
-        OutputDebugStringW(message.c_str());
-        OutputDebugStringW(L"\n");
-#endif // DBG_ENABLE_ERROR_LOGGING
-    }
 
-    m_writeInProgress = false;
-
-#if DBG_ENABLE_VERBOSE_LOGGING
-    OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Frame sent!\n");
-#endif
+        payloadSize = DepthCodec::EncodeDepthAb(m_maskedDepth.data(), pAbImage, outBufferCountDepth,
+            DepthCodec::kKeepAllValues, DepthCodec::kKeepAllValues, false, slot->Payload(), rawSize);
+        encoding = payloadSize ? PayloadEncoding::Rvl : PayloadEncoding::Raw;
+    }
+    else if (requested == PayloadEncoding::Packed12 &&
+        FramePacking::PackLongThrowDepthAb12(pDepth, pSigma, pAbImage, outBufferCountDepth,
+            Depth::InvalidationMasks::Invalid, slot->Payload() + kPacked12HeaderSize))
+    {
+        // far depth or bright AB values above 4095 send the frame raw
+        const uint32_t flags = 0;
+        memcpy(slot->Payload(), &flags, sizeof(flags));
+        encoding = PayloadEncoding::Packed12;
+        payloadSize = kPacked12HeaderSize + 2 * FramePacking::Packed12Size(outBufferCountDepth);
+    }
+    if (encoding == PayloadEncoding::Raw)
+    {
+        encoding = RawPayloadEncoding(requested);
+    }
+    if (encoding == PayloadEncoding::DeltaLz4 || encoding == PayloadEncoding::Lz4)
+    {
+        m_rawPayload.resize(rawSize);
+        FramePacking::PackLongThrowDepthAb(pDepth, pSigma, pAbImage, outBufferCountDepth,
+            Depth::InvalidationMasks::Invalid, m_rawPayload.data());
+        payloadSize = EncodeRawPayload(encoding, m_rawPayload.data(), rawSize, *slot, bytesCopied);
+    }
+    else if (encoding == PayloadEncoding::Raw)
+    {
+        FramePacking::PackLongThrowDepthAb(pDepth, pSigma, pAbImage, outBufferCountDepth,
+            Depth::InvalidationMasks::Invalid, slot->Payload());
+        payloadSize = rawSize;
+    }
+    ReportEncoding(requested, rawSize, payloadSize, encodeStart);
+
+    // Write header
+    FrameHeader header = MakeFrameHeader((uint8_t)m_streamId, m_poseFormat, (uint16_t)encoding, m_sequence++);
+    header.timestamp = (uint64_t)absoluteTimestamp;
+    header.width = imageWidth;
+    header.height = imageHeight;
+    header.pixelStride = pixelStride;
+    header.rowStride = rowStride;
+    header.payloadLength = (uint32_t)payloadSize;
+    WriteFrameHeader(header, &rig2worldTransform.m11, slot->Header());
+
+    packed.slot = slot;
+    packed.payloadLength = (uint32_t)payloadSize;
+    packed.bytesCopied = bytesCopied;
 
     // Release() not needed because the shared pointer spDepthFrame calls it when it goes out of scope
     //if (pDepthFrame)
     //    pDepthFrame->Release();
 
-
+    return true;
 }
 
 
 
 
-void ResearchModeFrameStreamer::SendVLC(
-    std::shared_ptr<IResearchModeSensorFrame> frame)
+bool ResearchModeFrameStreamer::PackVLC(
+    std::shared_ptr<IResearchModeSensorFrame> frame,
+    PackedFrame& packed,
+    std::shared_ptr<IResearchModeSensorFrame> rightFrame)
 {
 #if DBG_ENABLE_VERBOSE_LOGGING
     OutputDebugStringW(L"ResearchModeFrameStreamer::Send: Received frame for sending!\n");
 #endif
 
-    if (!m_streamSocket || !m_writer)
+    if (!IsConnected())
     {
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"ResearchModeFrameStreamer::Send: No connection.\n");
 #endif
-        return;
+        return false;
     }
 
     // grab the frame info
@@ -769,16 +738,14 @@ void ResearchModeFrameStreamer::SendVLC(
 
     auto prevTimestamp = rmTimestamp.HostTicks;
 
-    auto timestamp = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(prevTimestamp)));
-    auto location = m_locator.TryLocateAtTimestamp(timestamp, m_worldCoordSystem);
-    if (!location)
+    float4x4 rig2worldTransform;
+    if (!LocateRig(prevTimestamp, rig2worldTransform))
     {
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"ResearchModeFrameStreamer::Send: Can't locate frame.\n");
 #endif
-        return;
+        return false;
     }
-    const float4x4 rig2worldTransform = make_float4x4_from_quaternion(location.Orientation()) * make_float4x4_translation(location.Position());
     auto absoluteTimestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds((long long)prevTimestamp)).count();
 
     // grab the frame data
@@ -794,7 +761,7 @@ void ResearchModeFrameStreamer::SendVLC(
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"ResearchModeFrameStreamer::Send: Failed to grab depth frame.\n");
 #endif
-        return;
+        return false;
     }
     
     // TODO: Why shared pointers???
@@ -807,66 +774,6 @@ void ResearchModeFrameStreamer::SendVLC(
 
     winrt::check_hresult(spVLCFrame->GetBuffer(&pImage, &outBufferCount));
 
-    m_qoi_desc->width = 320;    // trick for encoding a greyscale image
-    m_qoi_desc->height = 320;
-    m_qoi_desc->channels = 3; // already initialized to 4
-
-    int out_len = 0;
-
-    //uint8_t* qoi_buf = (uint8_t*)qoi_encode(pImage, m_qoi_desc, &out_len);  // m_qoi_desc has the size of the buffer
-    //if (qoi_buf == NULL)
-    //{
-    //    throw std::bad_alloc();
-    //}
-
-                        //std::vector<uint8_t> imageBufferAsVector;
-
-
-                        //for (int i = 0; i < out_len; i++)
-                        //{
-                        //    imageBufferAsVector.emplace_back(qoi_buf[i]);
-                        //}
-
-
-
-    //const int max_dst_size = LZ4_compressBound(out_len);
-    //char* compressed_data = (char*)malloc((size_t)max_dst_size);
-
-    //if (compressed_data == NULL)
-    //{
-    //    OutputDebugStringW(L"ResearchModeCameraStreamer::SendVLC: Malloc failed for lz4.\n");
-    //    throw std::bad_alloc();
-    //}
-
-    //const int compressed_data_size = LZ4_compress_default((char*)qoi_buf, compressed_data, out_len, max_dst_size);
-
-    //free(qoi_buf);
-
-    //if (compressed_data_size <= 0)
-    //{
-    //    // lz4 error
-    //    free(compressed_data);
-    //    return;
-    //}
-
-    //const int max_dst_size2 = LZ4_compressBound(compressed_data_size);
-    //char* compressed_data2 = (char*)malloc((size_t)max_dst_size2);
-
-    //if (compressed_data2 == NULL)
-    //{
-    //    OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Malloc failed for lz4.\n");
-    //    throw std::bad_alloc();
-    //}
-
-    //const int compressed_data_size2 = LZ4_compress_default(compressed_data, compressed_data2, compressed_data_size, max_dst_size2);
-
-    //if (compressed_data_size2 <= 0)
-    //{
-    //    // lz4 error
-    //    free(compressed_data);
-    //    free(compressed_data2);
-    //    return;
-    //}
     int imageWidth = resolution.Width;
     int imageHeight = resolution.Height;
     int pixelStride = resolution.BytesPerPixel;
@@ -874,72 +781,102 @@ void ResearchModeFrameStreamer::SendVLC(
     int rowStride = imageWidth * pixelStride;
 
 
-    //std::vector<BYTE> VLCByteBuffer(compressed_data2, compressed_data2 + compressed_data_size2); // TODO: does this make a copy?
     int vlc_image_size = imageWidth * imageHeight * pixelStride;
-    std::vector<BYTE> VLCByteBuffer(pImage, pImage + vlc_image_size); // TODO: does this make a copy?
-
-    //free(compressed_data/*);
-    //free(compressed_data2);*/
-
-
-    //std::array<BYTE, outBufferCount> pixelBuffer = { p_image }
-
-
-
-    if (m_writeInProgress)
+    if ((size_t)vlc_image_size > outBufferCount)
     {
-#if DBG_ENABLE_VERBOSE_LOGGING
-        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Write already in progress.\n");
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"ResearchModeFrameStreamer::SendVLC: Unexpected image buffer size.\n");
 #endif
-        return;
+        return false;
     }
 
-    m_writeInProgress = true;
-
-    try
+    // a stereo pair goes out as one image, the right one below the left one
+    const BYTE* pRightImage = nullptr;
+    std::shared_ptr<IResearchModeSensorVLCFrame> spRightVLCFrame;
+    if (rightFrame)
     {
-        // Write header
-        m_writer.WriteUInt64(absoluteTimestamp);
-        m_writer.WriteInt32(imageWidth);
-        m_writer.WriteInt32(imageHeight);
-        m_writer.WriteInt32(pixelStride);
-        m_writer.WriteInt32(rowStride);
-        //m_writer.WriteInt32(compressed_data_size2);
-
-        m_writer.WriteInt32(vlc_image_size);
-
-        WriteMatrix4x4(rig2worldTransform);
+        IResearchModeSensorVLCFrame* pRightVLCFrame = nullptr;
+        hr = rightFrame->QueryInterface(IID_PPV_ARGS(&pRightVLCFrame));
+        if (!pRightVLCFrame || !SUCCEEDED(hr))
+        {
+#if DBG_ENABLE_VERBOSE_LOGGING
+            OutputDebugStringW(L"ResearchModeFrameStreamer::SendVLC: Failed to grab right frame.\n");
+#endif
+            return false;
+        }
+        spRightVLCFrame.reset(pRightVLCFrame, [](IResearchModeSensorVLCFrame* sf) { sf->Release(); });
 
-        m_writer.WriteBytes(VLCByteBuffer);
+        size_t rightBufferCount = 0;
+        winrt::check_hresult(spRightVLCFrame->GetBuffer(&pRightImage, &rightBufferCount));
+        if ((size_t)vlc_image_size > rightBufferCount)
+        {
+#if DBG_ENABLE_ERROR_LOGGING
+            OutputDebugStringW(L"ResearchModeFrameStreamer::SendVLC: Unexpected right image buffer size.\n");
+#endif
+            return false;
+        }
+    }
+    const int imageCount = pRightImage ? 2 : 1;
+    const size_t rawSize = (size_t)vlc_image_size * imageCount;
 
+    ReserveBuffers(PayloadCapacity(rawSize));
+    std::shared_ptr<FrameSendSlot> slot = m_pBufferPool->Acquire(FrameHeaderSize(m_poseFormat), PayloadCapacity(rawSize));
+    if (!slot)
+    {
+        m_stats.framesDropped++;
 #if DBG_ENABLE_VERBOSE_LOGGING
-        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Trying to store writer...\n");
+        OutputDebugStringW(L"ResearchModeFrameStreamer::SendVLC: No send buffer available.\n");
 #endif
-        m_writer.StoreAsync();
+        return false;
     }
-    catch (winrt::hresult_error const& ex)
+
+    // the only copy on the way out: the sensor buffer goes back to the
+    // driver when the frame is released. The LZ4 and temporal encoders read
+    // the sensor buffer directly.
+    const PayloadEncoding requested = NextEncoding(m_encoding);
+    const CodecController::Clock::time_point encodeStart = CodecController::Clock::now();
+    PayloadEncoding encoding = RawPayloadEncoding(requested);
+    size_t payloadSize = rawSize;
+    uint32_t bytesCopied = 0;
+    if (encoding == PayloadEncoding::Raw)
     {
-        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
-        if (webErrorStatus == SocketErrorStatus::ConnectionResetByPeer)
+        memcpy(slot->Payload(), pImage, vlc_image_size);
+        if (pRightImage)
         {
-            // the client disconnected!
-            m_writer == nullptr;
-            m_streamSocket == nullptr;
-            m_writeInProgress = false;
+            memcpy(slot->Payload() + vlc_image_size, pRightImage, vlc_image_size);
         }
-#if DBG_ENABLE_ERROR_LOGGING
-        winrt::hstring message = ex.message();
-        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Sending failed with ");
-        OutputDebugStringW(message.c_str());
-        OutputDebugStringW(L"\n");
-#endif // DBG_ENABLE_ERROR_LOGGING
+        bytesCopied = (uint32_t)rawSize;
     }
-
-    m_writeInProgress = false;
-
-#if DBG_ENABLE_VERBOSE_LOGGING
-    OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Frame sent!\n");
-#endif
+    else if (pRightImage)
+    {
+        // the encoders take one contiguous image
+        m_rawPayload.resize(rawSize);
+        memcpy(m_rawPayload.data(), pImage, vlc_image_size);
+        memcpy(m_rawPayload.data() + vlc_image_size, pRightImage, vlc_image_size);
+        bytesCopied = (uint32_t)rawSize;
+        payloadSize = EncodeRawPayload(encoding, m_rawPayload.data(), rawSize, *slot, bytesCopied);
+    }
+    else
+    {
+        payloadSize = EncodeRawPayload(encoding, pImage, vlc_image_size, *slot, bytesCopied);
+    }
+    ReportEncoding(requested, rawSize, payloadSize, encodeStart);
+
+    // Write header
+    FrameHeader header = MakeFrameHeader((uint8_t)m_streamId, m_poseFormat, (uint16_t)encoding, m_sequence++);
+    header.timestamp = (uint64_t)absoluteTimestamp;
+    header.width = imageWidth;
+    header.height = imageHeight * imageCount;
+    header.pixelStride = pixelStride;
+    header.rowStride = rowStride;
+    header.payloadLength = (uint32_t)payloadSize;
+    WriteFrameHeader(header, &rig2worldTransform.m11, slot->Header());
+
+    packed.slot = slot;
+    packed.payloadLength = (uint32_t)payloadSize;
+    packed.bytesCopied = bytesCopied;
+
+    return true;
 }
 
 
@@ -1131,31 +1068,230 @@ void ResearchModeFrameStreamer::SendVLC(
 
 
 
-void ResearchModeFrameStreamer::WriteMatrix4x4(
-    _In_ winrt::Windows::Foundation::Numerics::float4x4 matrix)
+bool ResearchModeFrameStreamer::IsConnected() const
 {
-    m_writer.WriteSingle(matrix.m11);
-    m_writer.WriteSingle(matrix.m12);
-    m_writer.WriteSingle(matrix.m13);
-    m_writer.WriteSingle(matrix.m14);
-
-    m_writer.WriteSingle(matrix.m21);
-    m_writer.WriteSingle(matrix.m22);
-    m_writer.WriteSingle(matrix.m23);
-    m_writer.WriteSingle(matrix.m24);
-
-    m_writer.WriteSingle(matrix.m31);
-    m_writer.WriteSingle(matrix.m32);
-    m_writer.WriteSingle(matrix.m33);
-    m_writer.WriteSingle(matrix.m34);
-
-    m_writer.WriteSingle(matrix.m41);
-    m_writer.WriteSingle(matrix.m42);
-    m_writer.WriteSingle(matrix.m43);
-    m_writer.WriteSingle(matrix.m44);
+    if (m_pTransport)
+    {
+        return m_pTransport->IsConnected();
+    }
+    std::lock_guard<std::mutex> guard(m_socketMutex);
+    return m_streamSocket != nullptr;
+}
+
+void ResearchModeFrameStreamer::SendSlot(
+    std::shared_ptr<FrameSendSlot> const& slot,
+    uint32_t payloadLength,
+    uint32_t bytesCopied,
+    StreamSocket const& socket)
+{
+    // header and payload are contiguous in the slot and go out as one buffer
+    const uint32_t length = (uint32_t)slot->HeaderSize() + payloadLength;
+    IBuffer buffer = winrt::make<FrameSendBuffer>(slot, length);
+
+    if (m_pTransport)
+    {
+        using SubmitResult = MultiplexedStreamTransport::SubmitResult;
+        const SubmitResult result = m_pTransport->Submit(m_streamId, buffer);
+        if (result == SubmitResult::DroppedOldest)
+        {
+            // the transport handed the dropped frame's credit back
+            m_stats.framesDropped++;
+        }
+        if (result == SubmitResult::Queued || result == SubmitResult::DroppedOldest)
+        {
+            ReportCongestion();
+        }
+    }
+    else
+    {
+        // not awaited, the slot stays in flight until the socket is done with
+        // it and the next Transmit waits for the write
+        m_pendingWrite = socket.OutputStream().WriteAsync(buffer);
+        m_pendingWriteSocket = socket;
+        std::shared_ptr<std::promise<void>> pDone = std::make_shared<std::promise<void>>();
+        m_writeDone = pDone->get_future();
+        // the write completes once the socket took the whole frame, which is
+        // what the rate controller measures the link by
+        std::shared_ptr<RateController> pRateController = m_pRateController;
+        const size_t stream = (size_t)m_streamId;
+        if (pRateController)
+        {
+            pRateController->ReportQueued(stream, length);
+        }
+        // the completion handler can only be set once, so it also tells
+        // CompletePendingWrite that the write is done
+        m_pendingWrite.Completed([pRateController, stream, length, pDone](
+            winrt::Windows::Foundation::IAsyncOperationWithProgress<uint32_t, uint32_t> const& /* write */,
+            winrt::Windows::Foundation::AsyncStatus status)
+            {
+                if (pRateController)
+                {
+                    if (status == winrt::Windows::Foundation::AsyncStatus::Completed)
+                    {
+                        pRateController->ReportSent(stream, length);
+                    }
+                    else
+                    {
+                        pRateController->ReportDropped(stream, length);
+                    }
+                }
+                pDone->set_value();
+            });
+    }
+
+    m_stats.RecordFrame(length, bytesCopied);
+
+#if DBG_ENABLE_INFO_LOGGING
+    if (m_stats.framesSent % kStatsLogInterval == 0)
+    {
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"ResearchModeFrameStreamer: %ls sent %llu frames, %llu bytes copied per frame, %llu dropped.\n",
+            m_portName.c_str(), m_stats.framesSent.load(), m_stats.BytesCopiedPerFrame(), m_stats.framesDropped.load());
+        OutputDebugStringW(msgBuffer);
+        if (m_pRateController)
+        {
+            swprintf_s(msgBuffer, L"ResearchModeFrameStreamer: %ls limited to %.1f fps (0 for none), link %.2f MB/s.\n",
+                m_portName.c_str(), m_pRateController->Rate((size_t)m_streamId), m_pRateController->Capacity() / 1e6);
+            OutputDebugStringW(msgBuffer);
+        }
+        if (m_pPoseService)
+        {
+            // shared by all streamers
+            const PoseCache::Stats poseStats = m_pPoseService->GetCacheStats();
+            swprintf_s(msgBuffer, L"ResearchModeFrameStreamer: rig poses %llu hits, %llu misses, %llu locate failures.\n",
+                poseStats.hits, poseStats.misses, m_pPoseService->LocateFailures());
+            OutputDebugStringW(msgBuffer);
+        }
+    }
+#endif
+}
+
+void ResearchModeFrameStreamer::CompletePendingWrite()
+{
+    m_writeDone.wait();
+    try
+    {
+        // rethrows the error of a failed write
+        m_pendingWrite.GetResults();
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+        if (webErrorStatus == SocketErrorStatus::ConnectionResetByPeer ||
+            webErrorStatus == SocketErrorStatus::ConnectionAborted)
+        {
+            // the client disconnected!
+            DropSocket(m_pendingWriteSocket);
+        }
+#if DBG_ENABLE_ERROR_LOGGING
+        winrt::hstring message = ex.message();
+        OutputDebugStringW(L"ResearchModeFrameStreamer::CompletePendingWrite: Sending failed with ");
+        OutputDebugStringW(message.c_str());
+        OutputDebugStringW(L"\n");
+#endif // DBG_ENABLE_ERROR_LOGGING
+    }
+    m_pendingWrite = nullptr;
+    m_pendingWriteSocket = nullptr;
+}
+
+void ResearchModeFrameStreamer::DropSocket(StreamSocket const& socket)
+{
+    std::lock_guard<std::mutex> guard(m_socketMutex);
+    if (m_streamSocket == socket)
+    {
+        m_streamSocket = nullptr;
+    }
+}
+
+size_t ResearchModeFrameStreamer::PayloadCapacity(size_t rawSize) const
+{
+    return m_pTemporalEncoder ? TemporalCodec::MaxEncodedSize(rawSize) : rawSize;
+}
+
+PayloadEncoding ResearchModeFrameStreamer::NextEncoding(PayloadEncoding configured)
+{
+    return m_pCodecController ? m_pCodecController->Choose() : configured;
+}
+
+PayloadEncoding ResearchModeFrameStreamer::RawPayloadEncoding(PayloadEncoding requested) const
+{
+    if (requested == PayloadEncoding::Lz4 || requested == PayloadEncoding::DeltaLz4)
+    {
+        return requested;
+    }
+    // without the controller everything that would go out raw is temporal
+    // coded once that is enabled
+    return !m_pCodecController && m_pTemporalEncoder ? PayloadEncoding::DeltaLz4 : PayloadEncoding::Raw;
+}
+
+size_t ResearchModeFrameStreamer::EncodeRawPayload(
+    PayloadEncoding& encoding,
+    const uint8_t* pRaw,
+    size_t rawSize,
+    FrameSendSlot& slot,
+    uint32_t& bytesCopied)
+{
+    if (encoding == PayloadEncoding::DeltaLz4)
+    {
+        // the slot holds PayloadCapacity(rawSize) bytes, so this cannot fail
+        return m_pTemporalEncoder->Encode(pRaw, rawSize, slot.Payload(), slot.PayloadCapacity());
+    }
+
+    const int size = LZ4_compress_default((const char*)pRaw, (char*)slot.Payload(), (int)rawSize, (int)rawSize - 1);
+    if (size > 0)
+    {
+        return (size_t)size;
+    }
+    memcpy(slot.Payload(), pRaw, rawSize);
+    bytesCopied += (uint32_t)rawSize;
+    encoding = PayloadEncoding::Raw;
+    return rawSize;
+}
+
+void ResearchModeFrameStreamer::ReportEncoding(
+    PayloadEncoding requested,
+    size_t rawSize,
+    size_t payloadSize,
+    CodecController::Clock::time_point start)
+{
+    if (m_pCodecController)
+    {
+        const CodecController::Clock::time_point now = CodecController::Clock::now();
+        m_pCodecController->Report(requested, rawSize, payloadSize, now - start, now);
+    }
+}
+
+void ResearchModeFrameStreamer::ReserveBuffers(size_t payloadSize)
+{
+    if (payloadSize == m_reservedPayloadSize)
+    {
+        return;
+    }
+
+    m_pBufferPool->Reserve(FrameHeaderSize(m_poseFormat) + payloadSize, kBuffersPerStream);
+    m_reservedPayloadSize = payloadSize;
 }
 
 void ResearchModeFrameStreamer::SetLocator(const GUID& guid)
 {
     m_locator = Preview::SpatialGraphInteropPreview::CreateLocatorForNode(guid);
 }
+
+bool ResearchModeFrameStreamer::LocateRig(
+    uint64_t hostTicks,
+    float4x4& rig2world)
+{
+    if (m_pPoseService)
+    {
+        return m_pPoseService->Locate(hostTicks, rig2world);
+    }
+
+    auto timestamp = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(hostTicks)));
+    auto location = m_locator.TryLocateAtTimestamp(timestamp, m_worldCoordSystem);
+    if (!location)
+    {
+        return false;
+    }
+    rig2world = make_float4x4_from_quaternion(location.Orientation()) * make_float4x4_translation(location.Position());
+    return true;
+}
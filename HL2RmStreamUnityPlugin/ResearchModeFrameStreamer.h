@@ -1,5 +1,4 @@
 #pragma once
-#include "qoi.h"
 
 namespace Depth
 {
@@ -8,33 +7,98 @@ namespace Depth
 		Invalid = 0x80,
 	};
 	static constexpr UINT16 AHAT_INVALID_VALUE = 4090;
+	static constexpr size_t AHAT_PIXEL_COUNT = 512 * 512;
+	static constexpr size_t LONG_THROW_PIXEL_COUNT = 320 * 288;
 }
 
 
 class ResearchModeFrameStreamer : public IResearchModeFrameSink
 {
 public:
+	// With a transport the frames go out over the multiplexed connection as
+	// stream streamId and portName is not used.
 	ResearchModeFrameStreamer(
 		std::wstring portName,
 		const GUID& guid,
-		const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& coordSystem);
+		const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& coordSystem,
+		std::shared_ptr<MultiplexedStreamTransport> transport = nullptr,
+		StreamId streamId = StreamId::Depth,
+		std::shared_ptr<FrameBufferPool> bufferPool = nullptr);
 
 	void Send(
 		std::shared_ptr<IResearchModeSensorFrame> frame,
 		ResearchModeSensorType pSensorType);
 
+	// Sends both VLC images as one frame of twice the height, the right image
+	// below the left one, with the left frame's timestamp and the rig pose
+	// at that time.
+	void SendPair(
+		std::shared_ptr<IResearchModeSensorFrame> pLeftFrame,
+		std::shared_ptr<IResearchModeSensorFrame> pRightFrame) override;
+
 	//winrt::Windows::Foundation::IAsyncAction SendAndWait(
 	//	std::shared_ptr<IResearchModeSensorFrame> frame,
 	//	ResearchModeSensorType pSensorType);
 
-	void SendAHAT(
-		std::shared_ptr<IResearchModeSensorFrame> frame);
+	// Moves packing and the socket write onto their own threads (see
+	// FramePipeline), Send then only queues the frame. onDrop is called for
+	// every frame the pipeline drops.
+	void EnablePipeline(std::function<void()> onDrop = nullptr);
+
+	// Encoding of every frame: Lz4 for any frame, Rvl and Packed12 for the
+	// depth + AB payload of AHAT and Long Throw frames (VLC frames go out
+	// raw then). Set it before the stream starts; frames the encoder cannot
+	// shrink are still sent raw.
+	void SetEncoding(PayloadEncoding encoding)
+	{
+		m_encoding = encoding;
+	}
+
+	// Sends every frame that would otherwise go out raw (VLC images, depth +
+	// AB without a depth encoding) relative to the previous one, as LZ4
+	// compressed XOR delta or with the previous frame as LZ4 dictionary, and
+	// a keyframe every keyframeInterval frames (see TemporalCodec). Set it
+	// before the stream starts.
+	void SetTemporalDelta(
+		uint32_t keyframeInterval = TemporalCodec::kDefaultKeyframeInterval,
+		TemporalCodec::Method method = TemporalCodec::Method::XorDelta,
+		int acceleration = 1);
+
+	void RequestKeyframe() override;
+
+	// Lets a CodecController choose the encoding of every frame: raw, LZ4,
+	// the temporal coding if enabled and, for depth + AB, 12-bit packing and
+	// RVL. Replaces SetEncoding. Call it after SetTemporalDelta, before
+	// the stream starts.
+	void EnableAdaptiveEncoding(double cpuBudget = CodecController::kDefaultCpuBudget);
 
-	void SendLongThrow(
-		std::shared_ptr<IResearchModeSensorFrame> frame);
+	// Format of the rig to world transform in the frame header (see
+	// PoseCodec). Set it before the stream starts.
+	void SetPoseFormat(PoseCodec::Format format)
+	{
+		m_poseFormat = format;
+	}
+
+	// Takes the rig poses from a RigPoseService shared with the other
+	// streamers instead of locating every frame. Set it before the stream
+	// starts.
+	void SetPoseService(std::shared_ptr<RigPoseService> poseService)
+	{
+		m_pPoseService = poseService;
+	}
 
-	void SendVLC(
-		std::shared_ptr<IResearchModeSensorFrame> frame);
+	// Reports every frame written to the socket to the controller. With a
+	// transport the transport reports them instead. Set it before the stream
+	// starts.
+	void SetRateController(std::shared_ptr<RateController> rateController)
+	{
+		m_pRateController = rateController;
+	}
+
+	const SendStats& GetSendStats() const
+	{
+		return m_stats;
+	}
 
 public:
 	bool isConnected = false;
@@ -46,31 +110,134 @@ public:
 
 
 private:
+	// a frame waiting to be packed
+	struct PendingFrame
+	{
+		std::shared_ptr<IResearchModeSensorFrame> frame;
+		ResearchModeSensorType sensorType = ResearchModeSensorType::DEPTH_AHAT;
+		// set for a stereo pair, frame is the left image then
+		std::shared_ptr<IResearchModeSensorFrame> rightFrame;
+	};
+
+	// header and payload packed into a send buffer, ready for the socket
+	struct PackedFrame
+	{
+		std::shared_ptr<FrameSendSlot> slot;
+		uint32_t payloadLength = 0;
+		uint32_t bytesCopied = 0;
+	};
+
 	winrt::Windows::Foundation::IAsyncAction StartServer();
 
+	// pose lookup and pixel packing, returns false if the frame is skipped
+	bool Pack(
+		std::shared_ptr<IResearchModeSensorFrame> frame,
+		ResearchModeSensorType sensorType,
+		PackedFrame& packed);
+
+	bool PackAHAT(
+		std::shared_ptr<IResearchModeSensorFrame> frame,
+		PackedFrame& packed);
+
+	bool PackLongThrow(
+		std::shared_ptr<IResearchModeSensorFrame> frame,
+		PackedFrame& packed);
+
+	// with rightFrame the two images of a stereo pair
+	bool PackVLC(
+		std::shared_ptr<IResearchModeSensorFrame> frame,
+		PackedFrame& packed,
+		std::shared_ptr<IResearchModeSensorFrame> rightFrame = nullptr);
+
+	void Transmit(PackedFrame& packed);
+
+	// payload capacity to reserve for a frame of rawSize bytes
+	size_t PayloadCapacity(size_t rawSize) const;
+
+	// encoding the next frame should get: the controller's choice, or the
+	// configured one
+	PayloadEncoding NextEncoding(PayloadEncoding configured);
+
+	// how a payload that goes out as plain bytes is coded
+	PayloadEncoding RawPayloadEncoding(PayloadEncoding requested) const;
+
+	// LZ4 or temporal codes the raw payload into the slot and returns the
+	// payload size. If LZ4 does not shrink it, the raw bytes are copied and
+	// encoding becomes Raw. bytesCopied is increased by the bytes copied.
+	size_t EncodeRawPayload(
+		PayloadEncoding& encoding,
+		const uint8_t* pRaw,
+		size_t rawSize,
+		FrameSendSlot& slot,
+		uint32_t& bytesCopied);
+
+	void ReportEncoding(
+		PayloadEncoding requested,
+		size_t rawSize,
+		size_t payloadSize,
+		CodecController::Clock::time_point start);
+
+	// a frame was dropped or had to wait for the link
+	void ReportCongestion();
+
 	void OnConnectionReceived(
 		winrt::Windows::Networking::Sockets::StreamSocketListener /* sender */,
 		winrt::Windows::Networking::Sockets::StreamSocketListenerConnectionReceivedEventArgs args);
 
-	void WriteMatrix4x4(
-		_In_ winrt::Windows::Foundation::Numerics::float4x4 matrix);
+	bool IsConnected() const;
+
+	// sends the header and the first payloadLength payload bytes of the slot
+	// in a single write, to socket unless there is a transport. bytesCopied is
+	// only used for the statistics.
+	void SendSlot(
+		std::shared_ptr<FrameSendSlot> const& slot,
+		uint32_t payloadLength,
+		uint32_t bytesCopied,
+		winrt::Windows::Networking::Sockets::StreamSocket const& socket);
+
+	// waits for the previous write and picks up its result, dropping the
+	// connection if the client went away
+	void CompletePendingWrite();
+
+	// clears m_streamSocket unless a new client connected in the meantime
+	void DropSocket(winrt::Windows::Networking::Sockets::StreamSocket const& socket);
+
+	// reserves this stream's buffers in the pool when the frame size changes
+	void ReserveBuffers(size_t payloadSize);
 
 	void SetLocator(const GUID& guid);
 
+	// rig to world transform at the frame's host ticks, from the pose
+	// service if there is one
+	bool LocateRig(
+		uint64_t hostTicks,
+		winrt::Windows::Foundation::Numerics::float4x4& rig2world);
+
 	// spatial locators
 	winrt::Windows::Perception::Spatial::SpatialLocator m_locator = nullptr;
 	winrt::Windows::Perception::Spatial::SpatialCoordinateSystem m_worldCoordSystem = nullptr;
+	std::shared_ptr<RigPoseService> m_pPoseService;
 
-	// socket, listener and writer
+	// socket and listener
 	winrt::Windows::Networking::Sockets::StreamSocketListener m_streamSocketListener;
+	// guarded by m_socketMutex, the transmit thread writes to a copy
 	winrt::Windows::Networking::Sockets::StreamSocket m_streamSocket = nullptr;
-	winrt::Windows::Storage::Streams::DataWriter m_writer = nullptr;
+	mutable std::mutex m_socketMutex;
+	// transmit thread only: the write still going out, the socket it goes out
+	// on and the future its completion handler fulfils
+	winrt::Windows::Foundation::IAsyncOperationWithProgress<uint32_t, uint32_t> m_pendingWrite = nullptr;
+	winrt::Windows::Networking::Sockets::StreamSocket m_pendingWriteSocket = nullptr;
+	std::future<void> m_writeDone;
 
+	// set when streaming over the multiplexed connection, the send buffers
+	// are then handed to the transport instead of the socket
+	std::shared_ptr<MultiplexedStreamTransport> m_pTransport;
+	StreamId m_streamId;
+	std::shared_ptr<RateController> m_pRateController;
 
-	//winrt::Windows::Storage::Streams::DataReader m_reader = nullptr;
 
+	//winrt::Windows::Storage::Streams::DataReader m_reader = nullptr;
 
-	bool m_writeInProgress = false;
 
 	std::wstring m_portName;
 
@@ -79,10 +246,35 @@ private:
 
 
 	//void ResearchModeFrameStreamer::WaitForRequest();
-	qoi_desc* m_qoi_desc;
-	//qoi_desc* m_qoi_desc_depth;
-	
-	BYTE* depth_combined_buf;
+
+	// one buffer can be packed while the other one is still being sent
+	static constexpr int kBuffersPerStream = 2;
+	static constexpr uint64_t kStatsLogInterval = 300;
+
+	std::shared_ptr<FrameBufferPool> m_pBufferPool;
+	size_t m_reservedPayloadSize = 0;
+	SendStats m_stats;
+
+	PayloadEncoding m_encoding = PayloadEncoding::Raw;
+	// Long Throw depth with the sigma mask applied, input of the RVL encoder
+	std::vector<uint16_t> m_maskedDepth;
+
+	// set by SetTemporalDelta, only used on the packing thread
+	std::unique_ptr<TemporalCodec::Encoder> m_pTemporalEncoder;
+	// depth + AB or a stereo pair packed for the temporal or LZ4 encoder
+	std::vector<uint8_t> m_rawPayload;
+
+	// set by EnableAdaptiveEncoding, only used on the packing thread (except
+	// ReportCongestion)
+	std::unique_ptr<CodecController> m_pCodecController;
+
+	// FrameHeader::sequence of the next frame, only used on the packing thread
+	uint32_t m_sequence = 0;
+	PoseCodec::Format m_poseFormat = PoseCodec::Format::Matrix;
+
+	static constexpr size_t kPipelineQueueCapacity = 2;
+	// declared last so its threads stop before the members they use go away
+	std::unique_ptr<FramePipeline<PendingFrame, PackedFrame>> m_pPipeline;
 
 };
 
@@ -0,0 +1,99 @@
+#include "pch.h"
+
+#define DBG_ENABLE_VERBOSE_LOGGING 0
+#define DBG_ENABLE_INFO_LOGGING 1
+
+using namespace winrt::Windows::Perception;
+using namespace winrt::Windows::Perception::Spatial;
+using namespace winrt::Windows::Foundation::Numerics;
+
+RigPoseService::RigPoseService(
+    const GUID& rigNodeId,
+    const SpatialCoordinateSystem& worldCoordSystem,
+    std::chrono::milliseconds sampleInterval) :
+    m_worldCoordSystem(worldCoordSystem),
+    m_sampleInterval(sampleInterval)
+{
+    m_locator = Preview::SpatialGraphInteropPreview::CreateLocatorForNode(rigNodeId);
+    m_sampleThread = std::thread(SampleThread, this);
+}
+
+RigPoseService::~RigPoseService()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_exitMutex);
+        m_fExit = true;
+    }
+    m_exitSignal.notify_all();
+    if (m_sampleThread.joinable())
+    {
+        m_sampleThread.join();
+    }
+}
+
+bool RigPoseService::Locate(
+    uint64_t hostTicks,
+    float4x4& rig2world)
+{
+    if (m_cache.Lookup(checkAndConvertUnsigned(hostTicks), &rig2world.m11))
+    {
+        return true;
+    }
+
+    // not covered by the samples, locate the frame itself
+    auto timestamp = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(hostTicks)));
+    auto location = m_locator.TryLocateAtTimestamp(timestamp, m_worldCoordSystem);
+    if (!location)
+    {
+        m_locateFailures++;
+        return false;
+    }
+    rig2world = make_float4x4_from_quaternion(location.Orientation()) * make_float4x4_translation(location.Position());
+    return true;
+}
+
+void RigPoseService::SampleThread(RigPoseService* pService)
+{
+#if DBG_ENABLE_INFO_LOGGING
+    OutputDebugStringW(L"RigPoseService::SampleThread: Starting sample thread.\n");
+#endif
+    std::unique_lock<std::mutex> lock(pService->m_exitMutex);
+    while (!pService->m_fExit)
+    {
+        lock.unlock();
+
+        const int64_t now = HostTicksNow();
+        auto timestamp = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(now));
+        auto location = pService->m_locator.TryLocateAtTimestamp(timestamp, pService->m_worldCoordSystem);
+        if (location)
+        {
+            const quaternion orientation = location.Orientation();
+            const float3 position = location.Position();
+            pService->m_cache.Add(now, { { orientation.x, orientation.y, orientation.z, orientation.w },
+                { position.x, position.y, position.z } });
+        }
+        else
+        {
+            pService->m_locateFailures++;
+#if DBG_ENABLE_VERBOSE_LOGGING
+            OutputDebugStringW(L"RigPoseService::SampleThread: Can't locate rig.\n");
+#endif
+        }
+
+        lock.lock();
+        pService->m_exitSignal.wait_for(lock, pService->m_sampleInterval, [pService]() { return pService->m_fExit; });
+    }
+}
+
+int64_t RigPoseService::HostTicksNow()
+{
+    LARGE_INTEGER qpc;
+    LARGE_INTEGER qpf;
+    QueryPerformanceCounter(&qpc);
+    QueryPerformanceFrequency(&qpf);
+
+    // split to keep qpc * 10^7 from overflowing
+    const int64_t seconds = qpc.QuadPart / qpf.QuadPart;
+    const int64_t remainder = qpc.QuadPart % qpf.QuadPart;
+    return seconds * 10'000'000 + remainder * 10'000'000 / qpf.QuadPart;
+}
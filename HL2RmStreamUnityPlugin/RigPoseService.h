@@ -0,0 +1,62 @@
+#pragma once
+
+// Rig to world poses for the Research Mode streamers, shared by all of them.
+//
+// A thread samples the rig node's locator every sampleInterval into a
+// PoseCache, so the packing threads interpolate the pose of a frame instead
+// of calling TryLocateAtTimestamp for every frame. A short tracking hiccup
+// is bridged by interpolating over the missing samples instead of dropping
+// the frame. Only a lookup the cache cannot serve (a frame newer than the
+// last sample, or a gap longer than PoseCache::kMaxGap) still locates the
+// frame directly.
+class RigPoseService
+{
+public:
+	static constexpr std::chrono::milliseconds kDefaultSampleInterval{ 10 };
+
+	RigPoseService(
+		const GUID& rigNodeId,
+		const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem,
+		std::chrono::milliseconds sampleInterval = kDefaultSampleInterval);
+
+	~RigPoseService();
+
+	RigPoseService(const RigPoseService&) = delete;
+	RigPoseService& operator=(const RigPoseService&) = delete;
+
+	// Rig to world transform at hostTicks (ResearchModeSensorTimestamp::HostTicks).
+	// False if the rig could not be located at that time.
+	bool Locate(
+		uint64_t hostTicks,
+		winrt::Windows::Foundation::Numerics::float4x4& rig2world);
+
+	// hits and misses of the cache; every miss located the frame directly
+	PoseCache::Stats GetCacheStats() const
+	{
+		return m_cache.GetStats();
+	}
+
+	// samples and direct lookups the locator could not serve
+	uint64_t LocateFailures() const
+	{
+		return m_locateFailures;
+	}
+
+private:
+	static void SampleThread(RigPoseService* pService);
+
+	// the QPC clock of the host ticks, in 100 ns
+	static int64_t HostTicksNow();
+
+	winrt::Windows::Perception::Spatial::SpatialLocator m_locator = nullptr;
+	winrt::Windows::Perception::Spatial::SpatialCoordinateSystem m_worldCoordSystem = nullptr;
+	std::chrono::milliseconds m_sampleInterval;
+
+	PoseCache m_cache;
+	std::atomic<uint64_t> m_locateFailures{ 0 };
+
+	std::mutex m_exitMutex;
+	std::condition_variable m_exitSignal;
+	bool m_fExit = false;
+	std::thread m_sampleThread;
+};
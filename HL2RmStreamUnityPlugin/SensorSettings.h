@@ -0,0 +1,48 @@
+#pragma once
+
+// How one sensor of the sensor set is streamed, see HL2Stream::ConfigureSensor.
+// HL2Stream keeps one per StreamId.
+struct SensorSettings
+{
+	// follow the global encoding options (EnableDepthCompression etc.)
+	static constexpr int kDefaultCodec = -1;
+	// the default ports are these plus the stream id
+	static constexpr int kBasePort = 23940;
+	static constexpr int kBaseRequestPort = 21110;
+	// share of the target frame interval a frame may come early and still be
+	// sent, so that timestamp jitter does not turn every other frame of a
+	// 30 fps sensor limited to 15 fps into every third one
+	static constexpr double kFrameIntervalTolerance = 0.9;
+
+	// a disabled sensor gets no processor, streamer, thread or socket
+	bool enabled = false;
+	// TCP port of the frames and UDP port of the requests, 0 for the
+	// default. Not used with the multiplexed transport.
+	int port = 0;
+	int requestPort = 0;
+	// frames per second at most, 0 for every frame of the sensor
+	float targetRate = 0.0f;
+	// a PayloadEncoding id, or kDefaultCodec
+	int codec = kDefaultCodec;
+
+	std::wstring PortName(StreamId id) const
+	{
+		return std::to_wstring(port > 0 ? port : kBasePort + (int)id);
+	}
+
+	std::wstring RequestPortName(StreamId id) const
+	{
+		return std::to_wstring(requestPort > 0 ? requestPort : kBaseRequestPort + (int)id);
+	}
+
+	// shortest interval between the frames sent in host ticks (100 ns), the
+	// minDelta of the frame processors
+	long long MinFrameInterval() const
+	{
+		if (targetRate <= 0.0f)
+		{
+			return 0;
+		}
+		return (long long)(kFrameIntervalTolerance * 1e7 / targetRate);
+	}
+};
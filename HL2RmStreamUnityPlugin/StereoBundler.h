@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+// Pairs the frames of the two front VLC cameras into stereo pairs.
+//
+// Both sides offer their newest frame with its host ticks. A frame waits
+// until the other side offers one; the two are a pair if their timestamps
+// are at most maxSkew apart. Otherwise the older frame is dropped: every
+// later frame of the other side is further away from it, so it can never
+// become part of a pair. A side that offers a new frame while its previous
+// one still waits replaces it, the newer one is always the closer match for
+// whatever the other side offers next.
+//
+// Only one frame per side is ever held, so an unpaired frame gives its
+// sensor buffer back to the driver as soon as it is dropped. Not thread
+// safe, StereoFrameProcessor calls it from its processing thread.
+template <typename T>
+class StereoBundler
+{
+public:
+	// 1 ms in 100 ns ticks. The two cameras are triggered together, their
+	// timestamps are far closer than that; frames of different exposures
+	// are 30 ms or more apart.
+	static constexpr uint64_t kDefaultMaxSkew = 10000;
+
+	enum class Side
+	{
+		Left,
+		Right,
+	};
+
+	struct Pair
+	{
+		T left;
+		T right;
+		uint64_t leftTicks = 0;
+		uint64_t rightTicks = 0;
+	};
+
+	explicit StereoBundler(uint64_t maxSkew = kDefaultMaxSkew) :
+		m_maxSkew(maxSkew)
+	{
+	}
+
+	void Offer(
+		Side side,
+		T frame,
+		uint64_t ticks)
+	{
+		Pending& pending = side == Side::Left ? m_left : m_right;
+		if (pending.valid)
+		{
+			m_dropped++;
+		}
+		pending.frame = std::move(frame);
+		pending.ticks = ticks;
+		pending.valid = true;
+	}
+
+	// Moves the waiting frames into pair if they match. Returns false while
+	// a side has no frame yet, or after dropping the older of two frames
+	// that are too far apart.
+	bool TakePair(Pair& pair)
+	{
+		if (!m_left.valid || !m_right.valid)
+		{
+			return false;
+		}
+
+		const uint64_t skew = m_left.ticks > m_right.ticks ?
+			m_left.ticks - m_right.ticks : m_right.ticks - m_left.ticks;
+		if (skew > m_maxSkew)
+		{
+			Pending& older = m_left.ticks < m_right.ticks ? m_left : m_right;
+			older.frame = T();
+			older.valid = false;
+			m_dropped++;
+			return false;
+		}
+
+		pair.left = std::move(m_left.frame);
+		pair.right = std::move(m_right.frame);
+		pair.leftTicks = m_left.ticks;
+		pair.rightTicks = m_right.ticks;
+		m_left = Pending();
+		m_right = Pending();
+		m_paired++;
+		return true;
+	}
+
+	// pairs taken so far
+	uint64_t Paired() const
+	{
+		return m_paired;
+	}
+
+	// frames dropped without a partner
+	uint64_t Dropped() const
+	{
+		return m_dropped;
+	}
+
+private:
+	struct Pending
+	{
+		T frame = T();
+		uint64_t ticks = 0;
+		bool valid = false;
+	};
+
+	uint64_t m_maxSkew;
+	Pending m_left;
+	Pending m_right;
+	uint64_t m_paired = 0;
+	uint64_t m_dropped = 0;
+};
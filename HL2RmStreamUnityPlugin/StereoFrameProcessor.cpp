@@ -0,0 +1,113 @@
+#include "pch.h"
+
+#define DBG_ENABLE_VERBOSE_LOGGING 0
+#define DBG_ENABLE_INFO_LOGGING 1
+#define DBG_ENABLE_ERROR_LOGGING 1
+
+namespace
+{
+    uint64_t HostTicks(const std::shared_ptr<IResearchModeSensorFrame>& frame)
+    {
+        ResearchModeSensorTimestamp timestamp;
+        winrt::check_hresult(frame->GetTimeStamp(&timestamp));
+        return timestamp.HostTicks;
+    }
+}
+
+StereoFrameProcessor::StereoFrameProcessor(
+    IResearchModeSensor* pLeftSensor,
+    IResearchModeSensor* pRightSensor,
+    HANDLE camConsentGiven,
+    ResearchModeSensorConsent* camAccessConsent,
+    const unsigned long long minDelta,
+    std::shared_ptr<IResearchModeFrameSink> frameSink,
+    std::wstring reqPortName,
+    uint64_t maxSkew) :
+    ResearchModeFrameProcessor(pLeftSensor, camConsentGiven, camAccessConsent, minDelta, frameSink, reqPortName),
+    m_pRightSensor(pRightSensor),
+    m_bundler(maxSkew)
+{
+    m_pRightSensor->AddRef();
+
+#if DBG_ENABLE_INFO_LOGGING
+    wchar_t msgBuffer[200];
+    swprintf_s(msgBuffer, L"StereoFrameProcessor: Pairing %ls with %ls\n",
+        pLeftSensor->GetFriendlyName(), pRightSensor->GetFriendlyName());
+    OutputDebugStringW(msgBuffer);
+#endif
+}
+
+StereoFrameProcessor::~StereoFrameProcessor()
+{
+    // the processing thread calls SendLatestFrame, it has to be gone before
+    // the members of this class
+    m_fExit = true;
+    m_frameMailbox.Wake();
+    if (m_rightCameraThread.joinable())
+    {
+        m_rightCameraThread.join();
+    }
+    if (m_processThread.joinable())
+    {
+        m_processThread.join();
+    }
+    if (m_pRightSensor)
+    {
+        m_pRightSensor->CloseStream();
+        m_pRightSensor->Release();
+    }
+}
+
+void StereoFrameProcessor::Stop()
+{
+    ResearchModeFrameProcessor::Stop();
+    if (m_rightCameraThread.joinable())
+    {
+        m_rightCameraThread.join();
+    }
+    if (m_pRightSensor)
+    {
+        m_pRightSensor->CloseStream();
+    }
+
+#if DBG_ENABLE_INFO_LOGGING
+    wchar_t msgBuffer[200];
+    swprintf_s(msgBuffer, L"StereoFrameProcessor::Stop: %llu pairs, %llu frames without a partner\n",
+        m_bundler.Paired(), m_bundler.Dropped());
+    OutputDebugStringW(msgBuffer);
+#endif
+}
+
+void StereoFrameProcessor::Start()
+{
+    ResearchModeFrameProcessor::Start();
+    m_rightCameraThread = std::thread(CameraUpdateThread, this, &m_pRightSensor, &m_rightMailbox,
+        m_camConsentGiven, m_pCamAccessConsent);
+}
+
+void StereoFrameProcessor::SendLatestFrame()
+{
+    std::unique_ptr<SensorFrame> pLeftFrame = m_frameMailbox.Take();
+    if (pLeftFrame && *pLeftFrame)
+    {
+        m_bundler.Offer(StereoBundler<SensorFrame>::Side::Left, *pLeftFrame, HostTicks(*pLeftFrame));
+    }
+    std::unique_ptr<SensorFrame> pRightFrame = m_rightMailbox.Take();
+    if (pRightFrame && *pRightFrame)
+    {
+        m_bundler.Offer(StereoBundler<SensorFrame>::Side::Right, *pRightFrame, HostTicks(*pRightFrame));
+    }
+
+    // the rate limit applies to the pair, by the left frame's timestamp
+    StereoBundler<SensorFrame>::Pair pair;
+    if (!m_bundler.TakePair(pair) || !IsValidTimestamp(pair.left))
+    {
+        return;
+    }
+
+    // only the processing thread consumes credits, so the one it saw is
+    // still there
+    m_credits.TryConsume();
+
+    m_pFrameSink->SendPair(pair.left, pair.right);
+}
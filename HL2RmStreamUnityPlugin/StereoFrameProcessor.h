@@ -0,0 +1,42 @@
+#pragma once
+
+// Streams the two front VLC cameras as one stereo stream. The frames of both
+// are paired by their host ticks (see StereoBundler) and every pair goes to
+// the sink's SendPair as a single frame, so the pair shares one header, one
+// pose, one credit window, one request port and one rate limit. Frames
+// without a partner are dropped here, before anything is packed.
+//
+// The left camera is the processor's own sensor, the right one gets a second
+// camera thread.
+class StereoFrameProcessor : public ResearchModeFrameProcessor
+{
+public:
+	StereoFrameProcessor(
+		IResearchModeSensor* pLeftSensor,
+		IResearchModeSensor* pRightSensor,
+		HANDLE camConsentGiven,
+		ResearchModeSensorConsent* camAccessConsent,
+		const unsigned long long minDelta,
+		std::shared_ptr<IResearchModeFrameSink> frameSink,
+		std::wstring reqPortName,
+		uint64_t maxSkew = StereoBundler<std::shared_ptr<IResearchModeSensorFrame>>::kDefaultMaxSkew);
+
+	~StereoFrameProcessor() override;
+
+	void Stop() override;
+
+	void Start() override;
+
+protected:
+	void SendLatestFrame() override;
+
+private:
+	using SensorFrame = std::shared_ptr<IResearchModeSensorFrame>;
+
+	IResearchModeSensor* m_pRightSensor = nullptr;
+	LatestFrameMailbox<SensorFrame> m_rightMailbox;
+	std::thread m_rightCameraThread;
+
+	// only used on the processing thread
+	StereoBundler<SensorFrame> m_bundler;
+};
@@ -0,0 +1,302 @@
+#include "TemporalCodec.h"
+
+#include "lz4.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// out = a ^ b, 8 bytes at a time (vectorized by the compiler)
+	void XorBytes(
+		const uint8_t* a,
+		const uint8_t* b,
+		size_t size,
+		uint8_t* out)
+	{
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t x;
+			uint64_t y;
+			memcpy(&x, a + i, 8);
+			memcpy(&y, b + i, 8);
+			x ^= y;
+			memcpy(out + i, &x, 8);
+		}
+		for (; i < size; i++)
+		{
+			out[i] = a[i] ^ b[i];
+		}
+	}
+
+	void StoreUInt32(uint8_t* out, uint32_t value)
+	{
+		const uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+		memcpy(out, bytes, 4);
+	}
+
+	uint32_t LoadUInt32(const uint8_t* in)
+	{
+		return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+	}
+}
+
+namespace TemporalCodec
+{
+	void Encoder::StreamDeleter::operator()(LZ4_stream_u* stream) const
+	{
+		LZ4_freeStream(stream);
+	}
+
+	Encoder::Encoder(
+		uint32_t keyframeInterval,
+		int acceleration,
+		Method method) :
+		m_keyframeInterval(keyframeInterval > 0 ? keyframeInterval : 1),
+		m_acceleration(acceleration > 0 ? acceleration : 1),
+		m_method(method)
+	{
+	}
+
+	Encoder::~Encoder() = default;
+
+	size_t Encoder::Encode(
+		const uint8_t* frame,
+		size_t size,
+		uint8_t* out,
+		size_t capacity)
+	{
+		if (capacity < MaxEncodedSize(size) || size > (size_t)LZ4_MAX_INPUT_SIZE)
+		{
+			return 0;
+		}
+
+		const bool keyframe = m_keyframeRequested.exchange(false) ||
+			m_frameSize != size ||
+			m_framesSinceKeyframe + 1 >= m_keyframeInterval;
+
+		uint32_t flags = keyframe ? kKeyframe : 0;
+		uint8_t* pData = out + kHeaderSize;
+		size_t dataSize;
+		if (m_method == Method::Lz4Dictionary)
+		{
+			flags |= kDictionary;
+			dataSize = EncodeBands(frame, size, keyframe, pData);
+		}
+		else
+		{
+			dataSize = EncodeXor(frame, size, keyframe, pData, flags);
+		}
+
+		m_sequence++;
+		m_framesSinceKeyframe = keyframe ? 0 : m_framesSinceKeyframe + 1;
+		m_frameSize = size;
+
+		StoreUInt32(out, flags);
+		StoreUInt32(out + 4, m_sequence);
+		StoreUInt32(out + 8, (uint32_t)size);
+		return kHeaderSize + dataSize;
+	}
+
+	size_t Encoder::EncodeXor(
+		const uint8_t* frame,
+		size_t size,
+		bool keyframe,
+		uint8_t* pData,
+		uint32_t& flags)
+	{
+		const uint8_t* source = frame;
+		if (!keyframe)
+		{
+			m_delta.resize(size);
+			XorBytes(frame, m_reference.data(), size, m_delta.data());
+			source = m_delta.data();
+		}
+
+		// anything that does not get smaller is stored as is
+		int dataSize = LZ4_compress_fast((const char*)source, (char*)pData, (int)size,
+			(int)size - 1, m_acceleration);
+		if (dataSize <= 0)
+		{
+			memcpy(pData, source, size);
+			dataSize = (int)size;
+			flags |= kUncompressed;
+		}
+
+		m_reference.assign(frame, frame + size);
+		return (size_t)dataSize;
+	}
+
+	size_t Encoder::EncodeBands(
+		const uint8_t* frame,
+		size_t size,
+		bool keyframe,
+		uint8_t* pData)
+	{
+		const size_t bandCount = BandCount(size);
+		while (m_streams.size() < bandCount)
+		{
+			m_streams.emplace_back(LZ4_createStream());
+		}
+		m_dictionaries.resize(bandCount * kBandSize);
+
+		uint8_t* pOut = pData;
+		for (size_t band = 0; band < bandCount; band++)
+		{
+			LZ4_stream_u* stream = m_streams[band].get();
+			const char* pBand = (const char*)frame + band * kBandSize;
+			const int bandSize = (int)((std::min)(kBandSize, size - band * kBandSize));
+			char* pDictionary = m_dictionaries.data() + band * kBandSize;
+
+			if (keyframe)
+			{
+				// forget the dictionary, the band is coded on its own
+				LZ4_resetStream_fast(stream);
+			}
+
+			uint32_t word;
+			int written = LZ4_compress_fast_continue(stream, pBand, (char*)pOut + sizeof(uint32_t), bandSize,
+				bandSize - 1, m_acceleration);
+			if (written <= 0)
+			{
+				// the stream is undefined after a failure, start over with
+				// this band as the next dictionary
+				memcpy(pOut + sizeof(uint32_t), pBand, bandSize);
+				written = bandSize;
+				word = (uint32_t)bandSize | kStoredBand;
+				LZ4_loadDict(stream, pBand, bandSize);
+			}
+			else
+			{
+				word = (uint32_t)written;
+			}
+
+			// the frame buffer goes away, keep the band (and its hash table)
+			// as the dictionary of the next frame
+			LZ4_saveDict(stream, pDictionary, bandSize);
+
+			StoreUInt32(pOut, word);
+			pOut += sizeof(uint32_t) + written;
+		}
+		return (size_t)(pOut - pData);
+	}
+
+	bool Decoder::Decode(
+		const uint8_t* in,
+		size_t inSize,
+		uint8_t* out,
+		size_t size)
+	{
+		if (inSize < kHeaderSize)
+		{
+			return false;
+		}
+
+		const uint32_t flags = LoadUInt32(in);
+		const uint32_t sequence = LoadUInt32(in + 4);
+		const size_t rawSize = LoadUInt32(in + 8);
+		const uint8_t* pData = in + kHeaderSize;
+		const size_t dataSize = inSize - kHeaderSize;
+		const bool keyframe = (flags & kKeyframe) != 0;
+
+		if (rawSize != size || size > (size_t)LZ4_MAX_INPUT_SIZE ||
+			(!keyframe && (!m_hasReference || sequence != m_sequence + 1 || m_reference.size() != size)))
+		{
+			m_hasReference = false;
+			return false;
+		}
+
+		bool ok;
+		if (flags & kDictionary)
+		{
+			ok = DecodeBands(pData, dataSize, size, keyframe);
+		}
+		else
+		{
+			// keyframes decode straight into the reference
+			std::vector<uint8_t>& target = keyframe ? m_reference : m_delta;
+			target.resize(size);
+			if (flags & kUncompressed)
+			{
+				ok = dataSize >= size;
+				if (ok)
+				{
+					memcpy(target.data(), pData, size);
+				}
+			}
+			else
+			{
+				ok = LZ4_decompress_safe((const char*)pData, (char*)target.data(), (int)dataSize, (int)size) == (int)size;
+			}
+
+			if (ok && !keyframe)
+			{
+				XorBytes(m_reference.data(), m_delta.data(), size, m_reference.data());
+			}
+		}
+
+		m_hasReference = ok;
+		if (!ok)
+		{
+			return false;
+		}
+
+		m_sequence = sequence;
+		memcpy(out, m_reference.data(), size);
+		return true;
+	}
+
+	bool Decoder::DecodeBands(
+		const uint8_t* pData,
+		size_t dataSize,
+		size_t size,
+		bool keyframe)
+	{
+		// the new frame goes into m_delta, the bands of the reference are
+		// the dictionaries
+		m_delta.resize(size);
+		const uint8_t* pIn = pData;
+		const uint8_t* pEnd = pData + dataSize;
+		for (size_t band = 0; band < BandCount(size); band++)
+		{
+			const size_t offset = band * kBandSize;
+			const int bandSize = (int)((std::min)(kBandSize, size - offset));
+			if ((size_t)(pEnd - pIn) < sizeof(uint32_t))
+			{
+				return false;
+			}
+			const uint32_t word = LoadUInt32(pIn);
+			pIn += sizeof(uint32_t);
+
+			const size_t length = word & ~kStoredBand;
+			if (length > (size_t)(pEnd - pIn))
+			{
+				return false;
+			}
+
+			char* pBand = (char*)m_delta.data() + offset;
+			if (word & kStoredBand)
+			{
+				if (length != (size_t)bandSize)
+				{
+					return false;
+				}
+				memcpy(pBand, pIn, bandSize);
+			}
+			else
+			{
+				const char* pDictionary = keyframe ? nullptr : (const char*)m_reference.data() + offset;
+				if (LZ4_decompress_safe_usingDict((const char*)pIn, pBand, (int)length, bandSize,
+					pDictionary, keyframe ? 0 : bandSize) != bandSize)
+				{
+					return false;
+				}
+			}
+			pIn += length;
+		}
+
+		m_reference.swap(m_delta);
+		return true;
+	}
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+union LZ4_stream_u;
+
+// Lossless inter-frame coding of a stream of equally sized frames. Keyframes
+// are LZ4 compressed as they are; the other frames refer to their
+// predecessor in one of two ways:
+//
+//   XorDelta       the XOR of the frame with its predecessor, so every byte
+//                  of a static region becomes zero, LZ4 compressed
+//   Lz4Dictionary  the frame is cut into kBandSize bands and every band is
+//                  LZ4 coded with the same band of the previous frame as
+//                  dictionary (LZ4 streaming API). Matches may come from
+//                  anywhere in that band, so moving content still compresses
+//                  where the XOR delta does not. The bands keep the previous
+//                  frame within LZ4's 64 KB window.
+//
+// A keyframe is sent every keyframeInterval frames, when the frame size
+// changes and whenever the receiver asks for one.
+//
+// Payload (PayloadEncoding::DeltaLz4):
+//
+//   uint32 flags        kKeyframe, kUncompressed, kDictionary
+//   uint32 sequence     frame number, a non-keyframe applies to sequence - 1
+//   uint32 rawSize      size of the reconstructed frame
+//   data                XorDelta: LZ4 block, or rawSize plain bytes if
+//                       kUncompressed
+//                       Lz4Dictionary: per band a uint32 size, with
+//                       kStoredBand set if the band follows uncompressed,
+//                       then the band's LZ4 block
+//
+// The receiver keeps the last reconstructed frame as its reference. If a
+// frame does not follow it (a frame was dropped on the way), the receiver
+// discards it and requests a keyframe. The Python receiver decodes with the
+// lz4 package (hl2_codecs.py).
+namespace TemporalCodec
+{
+	static constexpr uint32_t kKeyframe = 1;
+	// LZ4 did not shrink the frame, the data is stored as is
+	static constexpr uint32_t kUncompressed = 2;
+	// Lz4Dictionary coded bands
+	static constexpr uint32_t kDictionary = 4;
+	static constexpr size_t kHeaderSize = 3 * sizeof(uint32_t);
+
+	// band size of Lz4Dictionary, the previous band plus the current one
+	// stay within LZ4's 64 KB match distance
+	static constexpr size_t kBandSize = 32 * 1024;
+	static constexpr uint32_t kStoredBand = 0x80000000;
+
+	static constexpr uint32_t kDefaultKeyframeInterval = 30;
+
+	enum class Method
+	{
+		XorDelta,
+		Lz4Dictionary,
+	};
+
+	inline size_t BandCount(size_t rawSize)
+	{
+		return (rawSize + kBandSize - 1) / kBandSize;
+	}
+
+	// Upper bound of Encoder::Encode's output for a frame of rawSize bytes.
+	inline size_t MaxEncodedSize(size_t rawSize)
+	{
+		return kHeaderSize + rawSize + sizeof(uint32_t) * BandCount(rawSize);
+	}
+
+	class Encoder
+	{
+	public:
+		// acceleration is LZ4's: 1 compresses best, higher values trade ratio
+		// for speed
+		explicit Encoder(
+			uint32_t keyframeInterval = kDefaultKeyframeInterval,
+			int acceleration = 1,
+			Method method = Method::XorDelta);
+
+		~Encoder();
+
+		Encoder(const Encoder&) = delete;
+		Encoder& operator=(const Encoder&) = delete;
+
+		// Codes size bytes into out. Returns the payload size, or 0 if
+		// capacity is below MaxEncodedSize(size).
+		size_t Encode(
+			const uint8_t* frame,
+			size_t size,
+			uint8_t* out,
+			size_t capacity);
+
+		// Makes the next frame a keyframe. May be called from any thread.
+		void RequestKeyframe()
+		{
+			m_keyframeRequested = true;
+		}
+
+	private:
+		struct StreamDeleter
+		{
+			void operator()(LZ4_stream_u* stream) const;
+		};
+
+		// XorDelta data, returns its size and sets kUncompressed if needed
+		size_t EncodeXor(
+			const uint8_t* frame,
+			size_t size,
+			bool keyframe,
+			uint8_t* pData,
+			uint32_t& flags);
+
+		size_t EncodeBands(
+			const uint8_t* frame,
+			size_t size,
+			bool keyframe,
+			uint8_t* pData);
+
+		uint32_t m_keyframeInterval;
+		int m_acceleration;
+		Method m_method;
+		std::atomic<bool> m_keyframeRequested{ true };
+
+		uint32_t m_sequence = 0;
+		uint32_t m_framesSinceKeyframe = 0;
+		size_t m_frameSize = 0;
+
+		// XorDelta: the previous frame
+		std::vector<uint8_t> m_reference;
+		std::vector<uint8_t> m_delta;
+
+		// Lz4Dictionary: one LZ4 stream per band, each holding the band of
+		// the previous frame as dictionary (saved into m_dictionaries)
+		std::vector<std::unique_ptr<LZ4_stream_u, StreamDeleter>> m_streams;
+		std::vector<char> m_dictionaries;
+	};
+
+	class Decoder
+	{
+	public:
+		// Reconstructs the frame into out (size bytes). Returns false if the
+		// payload is corrupt, has a different size, or does not follow the
+		// reference; only a keyframe helps then.
+		bool Decode(
+			const uint8_t* in,
+			size_t inSize,
+			uint8_t* out,
+			size_t size);
+
+	private:
+		bool DecodeBands(
+			const uint8_t* pData,
+			size_t dataSize,
+			size_t size,
+			bool keyframe);
+
+		bool m_hasReference = false;
+		uint32_t m_sequence = 0;
+		std::vector<uint8_t> m_reference;
+		std::vector<uint8_t> m_delta;
+	};
+}
@@ -0,0 +1,278 @@
+#include "TiledQoi.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	// Region of the caller's buffer the next qoi_encode or qoi_decode on this
+	// thread writes its output to instead of allocating it, so a band is coded
+	// in place. Taken by the first allocation that fits, null for malloc.
+	thread_local void* t_pTarget = nullptr;
+	thread_local size_t t_targetSize = 0;
+
+	void* QoiMalloc(size_t size)
+	{
+		void* pTarget = t_pTarget;
+		t_pTarget = nullptr;
+		return pTarget && size <= t_targetSize ? pTarget : malloc(size);
+	}
+
+	// runs a qoi_encode or qoi_decode call with its output going to target,
+	// frees what it returns if that did not fit there
+	template <typename TCall>
+	bool CodeInto(void* target, size_t targetSize, TCall call)
+	{
+		t_pTarget = target;
+		t_targetSize = targetSize;
+		void* result = call();
+		t_pTarget = nullptr;
+		if (result && result != target)
+		{
+			free(result);
+			return false;
+		}
+		return result != nullptr;
+	}
+}
+
+#define QOI_MALLOC(sz) QoiMalloc(sz)
+#define QOI_FREE(p) free(p)
+#define QOI_IMPLEMENTATION
+#include "qoi.h"
+
+namespace
+{
+	const uint8_t kMagic[4] = { 'q', 'o', 'i', 't' };
+
+	void StoreUInt32(uint8_t* out, uint32_t value)
+	{
+		const uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+		memcpy(out, bytes, 4);
+	}
+
+	uint32_t LoadUInt32(const uint8_t* in)
+	{
+		return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+	}
+
+	uint32_t BandRows(uint32_t height, uint32_t bandCount)
+	{
+		return (height + bandCount - 1) / bandCount;
+	}
+
+	// rows of band b, the last band may be shorter
+	uint32_t RowsOfBand(uint32_t height, uint32_t bandCount, uint32_t band)
+	{
+		const uint32_t bandRows = BandRows(height, bandCount);
+		const uint32_t first = band * bandRows;
+		return first < height ? (std::min)(bandRows, height - first) : 0;
+	}
+
+	void RunBands(WorkerPool* pool, uint32_t bandCount, const std::function<void(size_t)>& task)
+	{
+		if (pool)
+		{
+			pool->Run(bandCount, task);
+		}
+		else
+		{
+			for (size_t band = 0; band < bandCount; band++)
+			{
+				task(band);
+			}
+		}
+	}
+
+	size_t IndexSize(uint32_t bandCount)
+	{
+		return sizeof(uint32_t) * ((size_t)bandCount + 1);
+	}
+
+	// qoi_encode's own bound
+	size_t MaxBandSize(uint32_t width, uint32_t rows, uint32_t channels)
+	{
+		return QOI_HEADER_SIZE + sizeof(qoi_padding) + (size_t)width * rows * (channels + 1);
+	}
+}
+
+namespace TiledQoi
+{
+	size_t MaxEncodedSize(
+		uint32_t width,
+		uint32_t height,
+		uint32_t channels,
+		uint32_t bandCount)
+	{
+		bandCount = (std::max)(1u, (std::min)({ bandCount, height, kMaxBandCount }));
+		// qoi_encode's own bound, per band
+		return kHeaderSize + IndexSize(bandCount) +
+			bandCount * MaxBandSize(width, 0, channels) +
+			(size_t)width * height * (channels + 1);
+	}
+
+	size_t Encode(
+		const uint8_t* pixels,
+		uint32_t width,
+		uint32_t height,
+		uint32_t channels,
+		uint32_t bandCount,
+		WorkerPool* pool,
+		uint8_t* out,
+		size_t capacity)
+	{
+		if (width == 0 || height == 0 || (channels != 3 && channels != 4) ||
+			(size_t)width * height >= QOI_PIXELS_MAX)
+		{
+			return 0;
+		}
+		bandCount = (std::max)(1u, (std::min)({ bandCount, height, kMaxBandCount }));
+		if (capacity < MaxEncodedSize(width, height, channels, bandCount))
+		{
+			return 0;
+		}
+
+		const uint32_t bandRows = BandRows(height, bandCount);
+		const size_t rowSize = (size_t)width * channels;
+
+		// Every band is coded straight into out, at the start of a region
+		// of its own bound, then moved down behind the previous one. The
+		// regions add up to MaxEncodedSize, and only the coded bytes move.
+		uint8_t* pIndex = out + kHeaderSize;
+		uint8_t* pBands = pIndex + IndexSize(bandCount);
+		std::vector<size_t> regions(bandCount, 0);
+		size_t region = 0;
+		for (uint32_t band = 0; band < bandCount; band++)
+		{
+			regions[band] = region;
+			const uint32_t rows = RowsOfBand(height, bandCount, band);
+			region += rows > 0 ? MaxBandSize(width, rows, channels) : 0;
+		}
+
+		std::vector<int> sizes(bandCount, 0);
+		std::vector<char> bandOk(bandCount, 0);
+		RunBands(pool, bandCount, [&](size_t band)
+			{
+				const uint32_t rows = RowsOfBand(height, bandCount, (uint32_t)band);
+				if (rows == 0)
+				{
+					// bandRows rounding can leave trailing bands without
+					// rows, they are empty
+					bandOk[band] = 1;
+					return;
+				}
+				qoi_desc desc = { width, rows, (unsigned char)channels, QOI_SRGB };
+				bandOk[band] = CodeInto(pBands + regions[band], MaxBandSize(width, rows, channels), [&]()
+					{
+						return qoi_encode(pixels + band * bandRows * rowSize, &desc, &sizes[band]);
+					});
+			});
+		if (!std::all_of(bandOk.begin(), bandOk.end(), [](char ok) { return ok != 0; }))
+		{
+			return 0;
+		}
+
+		uint32_t offset = 0;
+		for (uint32_t band = 0; band < bandCount; band++)
+		{
+			StoreUInt32(pIndex + sizeof(uint32_t) * band, offset);
+			if (offset != regions[band])
+			{
+				memmove(pBands + offset, pBands + regions[band], sizes[band]);
+			}
+			offset += (uint32_t)sizes[band];
+		}
+		StoreUInt32(pIndex + sizeof(uint32_t) * bandCount, offset);
+
+		memcpy(out, kMagic, sizeof(kMagic));
+		StoreUInt32(out + 4, width);
+		StoreUInt32(out + 8, height);
+		out[12] = (uint8_t)channels;
+		out[13] = QOI_SRGB;
+		out[14] = (uint8_t)bandCount;
+		out[15] = (uint8_t)(bandCount >> 8);
+		return (size_t)(pBands - out) + offset;
+	}
+
+	bool ReadInfo(
+		const uint8_t* in,
+		size_t size,
+		Info& info)
+	{
+		if (size < kHeaderSize || memcmp(in, kMagic, sizeof(kMagic)) != 0)
+		{
+			return false;
+		}
+
+		info.width = LoadUInt32(in + 4);
+		info.height = LoadUInt32(in + 8);
+		info.channels = in[12];
+		info.bandCount = (uint32_t)in[14] | ((uint32_t)in[15] << 8);
+		if (info.width == 0 || info.height == 0 || (info.channels != 3 && info.channels != 4) ||
+			info.bandCount == 0 || info.bandCount > info.height ||
+			size < kHeaderSize + IndexSize(info.bandCount))
+		{
+			return false;
+		}
+
+		// offsets ascend and stay within the payload
+		const uint8_t* pIndex = in + kHeaderSize;
+		const size_t dataSize = size - kHeaderSize - IndexSize(info.bandCount);
+		uint32_t previous = 0;
+		for (uint32_t i = 0; i <= info.bandCount; i++)
+		{
+			const uint32_t offset = LoadUInt32(pIndex + sizeof(uint32_t) * i);
+			if (offset < previous || offset > dataSize)
+			{
+				return false;
+			}
+			previous = offset;
+		}
+		return true;
+	}
+
+	bool Decode(
+		const uint8_t* in,
+		size_t size,
+		WorkerPool* pool,
+		uint8_t* out,
+		size_t outSize)
+	{
+		Info info;
+		if (!ReadInfo(in, size, info) ||
+			outSize < (size_t)info.width * info.height * info.channels)
+		{
+			return false;
+		}
+
+		const uint8_t* pIndex = in + kHeaderSize;
+		const uint8_t* pBands = pIndex + IndexSize(info.bandCount);
+		const uint32_t bandRows = BandRows(info.height, info.bandCount);
+		const size_t rowSize = (size_t)info.width * info.channels;
+
+		std::vector<char> bandOk(info.bandCount, 0);
+		RunBands(pool, info.bandCount, [&](size_t band)
+			{
+				const uint32_t rows = RowsOfBand(info.height, info.bandCount, (uint32_t)band);
+				const uint32_t begin = LoadUInt32(pIndex + sizeof(uint32_t) * band);
+				const uint32_t end = LoadUInt32(pIndex + sizeof(uint32_t) * (band + 1));
+				if (rows == 0)
+				{
+					bandOk[band] = begin == end;
+					return;
+				}
+
+				// decoded in place, a band of another size does not fit
+				qoi_desc desc;
+				bandOk[band] = CodeInto(out + band * bandRows * rowSize, rows * rowSize, [&]()
+					{
+						return qoi_decode(pBands + begin, (int)(end - begin), &desc, (int)info.channels);
+					}) && desc.width == info.width && desc.height == rows;
+			});
+
+		return std::all_of(bandOk.begin(), bandOk.end(), [](char ok) { return ok != 0; });
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class WorkerPool;
+
+// QOI for several cores. qoi_encode carries its pixel index and previous
+// pixel from one pixel to the next, so a single image is strictly
+// sequential. Here the image is cut into horizontal bands that are QOI
+// images of their own, coded with fresh state in parallel on a WorkerPool.
+// An index of band offsets lets the receiver decode them in parallel too.
+//
+// Payload (PayloadEncoding::QoiTiled), little-endian:
+//
+//   char[4] magic       "qoit"
+//   uint32 width
+//   uint32 height
+//   uint8 channels      3 or 4
+//   uint8 colorspace
+//   uint16 bandCount
+//   uint32 offsets[bandCount + 1]
+//                       start of every band relative to the end of the
+//                       index, the last entry is the total size
+//   bands               complete QOI images (header and end marker),
+//                       band b holds rows [b * bandRows, (b + 1) * bandRows)
+//                       of the image, bandRows = ceil(height / bandCount)
+//
+// qoi.h's implementation lives in TiledQoi.cpp, which PythonReceiver/native
+// builds as well to decode the bands in parallel.
+namespace TiledQoi
+{
+	static constexpr size_t kHeaderSize = 16;
+	static constexpr uint32_t kMaxBandCount = 0xFFFF;
+	static constexpr uint32_t kDefaultBandCount = 8;
+
+	struct Info
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t channels;
+		uint32_t bandCount;
+	};
+
+	// Upper bound of Encode's output.
+	size_t MaxEncodedSize(
+		uint32_t width,
+		uint32_t height,
+		uint32_t channels,
+		uint32_t bandCount);
+
+	// Codes the tightly packed image (channels bytes per pixel) into out.
+	// bandCount is clamped to [1, height]. Without a pool the bands are coded
+	// on the calling thread. Returns the payload size, or 0 if the image is
+	// not supported or out holds less than MaxEncodedSize bytes.
+	size_t Encode(
+		const uint8_t* pixels,
+		uint32_t width,
+		uint32_t height,
+		uint32_t channels,
+		uint32_t bandCount,
+		WorkerPool* pool,
+		uint8_t* out,
+		size_t capacity);
+
+	// Reads the header and checks the index. Returns false if the payload is
+	// truncated or not tiled QOI.
+	bool ReadInfo(
+		const uint8_t* in,
+		size_t size,
+		Info& info);
+
+	// Decodes into out, which must hold width * height * channels bytes.
+	// Returns false on corrupt input.
+	bool Decode(
+		const uint8_t* in,
+		size_t size,
+		WorkerPool* pool,
+		uint8_t* out,
+		size_t outSize);
+}
@@ -137,14 +137,18 @@ IAsyncAction VideoCameraFrameProcessor::StartAsync()
     MediaFrameReaderStartStatus status = co_await m_mediaFrameReader.StartAsync();
     winrt::check_bool(status == MediaFrameReaderStartStatus::Success);
 
-    //m_processThread = std::thread(FrameProcesingThread, this);
+    m_processThread = std::thread(FrameProcesingThread, this);
 
     m_OnFrameArrivedRegistration = m_mediaFrameReader.FrameArrived(
         { this, &VideoCameraFrameProcessor::OnFrameArrived });
 
     isRunning = true;
 
-    StartReqListener();
+    // without a port of its own the requests come in through the multiplexed transport
+    if (!m_reqPortName.empty())
+    {
+        StartReqListener();
+    }
 
 #if DBG_ENABLE_VERBOSE_LOGGING
     OutputDebugStringW(L"VideoCameraFrameProcessor::StartAsync: Done.\n");
@@ -154,6 +158,7 @@ IAsyncAction VideoCameraFrameProcessor::StartAsync()
 void VideoCameraFrameProcessor::Stop()
 {
     m_fExit = true;
+    m_frameMailbox.Wake();
 
     if (m_processThread.joinable())
     {
@@ -163,7 +168,8 @@ void VideoCameraFrameProcessor::Stop()
     // revoke registered delegate
     m_mediaFrameReader.FrameArrived(m_OnFrameArrivedRegistration);
 
-    m_latestFrame = nullptr;
+    // drop the frame that was never sent
+    m_frameMailbox.Take();
 
     isRunning = false;
 }
@@ -174,8 +180,8 @@ void VideoCameraFrameProcessor::OnFrameArrived(
 {
     if (MediaFrameReference frame = sender.TryAcquireLatestFrame())
     {
-        std::lock_guard<std::shared_mutex> lock(m_frameMutex);
-        m_latestFrame = frame;
+        // never blocks, even while the previous frame is being sent
+        m_frameMailbox.Publish(std::make_unique<MediaFrameReference>(frame));
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"VideoCameraFrameProcessor::OnFrameArrived: Updated frame.\n");
 #endif
@@ -189,78 +195,85 @@ void VideoCameraFrameProcessor::FrameProcesingThread(VideoCameraFrameProcessor*
 #endif
     while (!pProcessor->m_fExit)
     {
-        OutputDebugString(L"VideoCameraFrameProcessor::FrameProcesingThread: loop.\n");
-        if (pProcessor->m_sendNextFrame) // TODO: instead of using a bool, use 
+        // sleep until a new frame, a request or Stop() wakes us up
+        pProcessor->m_frameMailbox.Wait();
+
+        if (pProcessor->m_fExit)
         {
-            std::lock_guard<std::shared_mutex> reader_guard(pProcessor->m_frameMutex);
-            if (pProcessor->m_latestFrame)
-            {
-                MediaFrameReference frame = pProcessor->m_latestFrame;
-                long long timestamp = pProcessor->m_converter.RelativeTicksToAbsoluteTicks(
-                    HundredsOfNanoseconds(frame.SystemRelativeTime().Value().count())).count();
-                if (timestamp != pProcessor->m_latestTimestamp)
-                {
-                    long long delta = timestamp - pProcessor->m_latestTimestamp;
-                    if (delta > pProcessor->m_minDelta)
-                    {
-                        pProcessor->m_latestTimestamp = timestamp;
-                        pProcessor->m_pFrameSink->Send(frame, timestamp);
+            break;
+        }
 
-                        std::this_thread::sleep_for(1ms);
+        // a frame is only sent while the receiver has credits left *and* a
+        // new one arrived
+        if (!pProcessor->m_credits.Available())
+        {
+            continue;
+        }
 
-                    }
-                }
-            }
+        std::unique_ptr<MediaFrameReference> pFrame = pProcessor->m_frameMailbox.Take();
+        if (!pFrame)
+        {
+            continue;
+        }
 
-            pProcessor->m_sendNextFrame = false;
+        long long timestamp = pProcessor->m_converter.RelativeTicksToAbsoluteTicks(
+            HundredsOfNanoseconds(pFrame->SystemRelativeTime().Value().count())).count();
+        if (timestamp == pProcessor->m_latestTimestamp ||
+            timestamp - pProcessor->m_latestTimestamp <= pProcessor->m_minDelta)
+        {
+            continue;
+        }
+        if (pProcessor->m_pRateController &&
+            !pProcessor->m_pRateController->Admit((size_t)StreamId::PhotoVideo, (uint64_t)timestamp))
+        {
+            continue;
         }
+        pProcessor->m_latestTimestamp = timestamp;
+
+        // only this thread consumes credits, so the one seen above is still there
+        pProcessor->m_credits.TryConsume();
 
-        std::this_thread::sleep_for(1ms);
+        pProcessor->m_pFrameSink->Send(*pFrame, timestamp);
     }
 }
 
 
-void VideoCameraFrameProcessor::datagramSocket_MessageReceived(winrt::Windows::Networking::Sockets::DatagramSocket const& /* sender */,
-    winrt::Windows::Networking::Sockets::DatagramSocketMessageReceivedEventArgs const& args)
+bool VideoCameraFrameProcessor::HandleRequest(const wchar_t* request)
 {
-    //OutputDebugStringW(L"VideoCameraFrameProcessor::datagramSocket_MessageReceived start\n");
-
-    DataReader dataReader{ args.GetDataReader() };
-    winrt::hstring request{ dataReader.ReadString(dataReader.UnconsumedBufferLength()) };
-
-    if (request == L"1\n")
+    if (*request == L'K')
     {
-        //OutputDebugStringW(L"VideoCameraFrameProcessor::datagramSocket_MessageReceived request == 1 = true\n");
+        if (m_pFrameSink)
+        {
+            m_pFrameSink->RequestKeyframe();
+        }
+        return true;
+    }
 
+    if (!m_credits.HandleRequest(request))
+    {
+        return false;
+    }
 
+    // a receiver that (re)connects has no reference frame yet
+    if (*request == L'R' && m_pFrameSink)
+    {
+        m_pFrameSink->RequestKeyframe();
+    }
 
-        //m_sendNextFrame = true;
+    m_frameMailbox.Wake();
+    return true;
+}
 
-        if (!m_fExit)
-        {
-            std::lock_guard<std::shared_mutex> reader_guard(m_frameMutex);
-            if (m_latestFrame)
-            {
-                MediaFrameReference frame = m_latestFrame;
-                long long timestamp = m_converter.RelativeTicksToAbsoluteTicks(
-                    HundredsOfNanoseconds(frame.SystemRelativeTime().Value().count())).count();
-                if (timestamp != m_latestTimestamp)
-                {
-                    long long delta = timestamp - m_latestTimestamp;
-                    if (delta > m_minDelta)
-                    {
-                        m_latestTimestamp = timestamp;
-                        m_pFrameSink->Send(frame, timestamp);
 
-                        //std::this_thread::sleep_for(50ms);
+void VideoCameraFrameProcessor::datagramSocket_MessageReceived(winrt::Windows::Networking::Sockets::DatagramSocket const& /* sender */,
+    winrt::Windows::Networking::Sockets::DatagramSocketMessageReceivedEventArgs const& args)
+{
+    //OutputDebugStringW(L"VideoCameraFrameProcessor::datagramSocket_MessageReceived start\n");
 
-                    }
-                }
-            }
-        }
+    DataReader dataReader{ args.GetDataReader() };
+    winrt::hstring request{ dataReader.ReadString(dataReader.UnconsumedBufferLength()) };
 
-    }
-    else
+    if (!HandleRequest(request.c_str()))
     {
         OutputDebugStringW(L"VideoCameraFrameProcessor::datagramSocket_MessageReceived unexpected message \n");
     }
@@ -1,7 +1,5 @@
 #pragma once
 
-#include <shared_mutex>
-
 
 class VideoCameraFrameProcessor
 {
@@ -11,6 +9,7 @@ public:
 	virtual ~VideoCameraFrameProcessor()
 	{
 		m_fExit = true;
+		m_frameMailbox.Wake();
 
 		if (m_processThread.joinable())
 		{
@@ -31,7 +30,19 @@ public:
 
 	bool isRunning = false;
 
-	bool m_sendNextFrame = true;
+	// Applies a credit request from the receiver. Called by the request
+	// listener, or by the multiplexed transport when reqPortName is empty.
+	bool HandleRequest(const wchar_t* request);
+
+	// frames the receiver allows to be in flight, refilled by its requests
+	FrameCredits m_credits;
+
+	// Also drops the frames the controller has no room for on the link,
+	// after the minDelta check. Call it before StartAsync().
+	void SetRateController(std::shared_ptr<RateController> rateController)
+	{
+		m_pRateController = rateController;
+	}
 
 
 protected:
@@ -46,18 +57,19 @@ private:
 
 	std::shared_ptr<IVideoFrameSink> m_pFrameSink;
 
-	std::shared_mutex m_frameMutex;
+	// latest frame handed from FrameArrived to the processing thread
+	LatestFrameMailbox<winrt::Windows::Media::Capture::Frames::MediaFrameReference> m_frameMailbox;
 	long long m_latestTimestamp = 0;
-	winrt::Windows::Media::Capture::Frames::MediaFrameReference m_latestFrame = nullptr;
 	winrt::Windows::Media::Capture::Frames::MediaFrameReader m_mediaFrameReader = nullptr;
 	winrt::event_token m_OnFrameArrivedRegistration;
 
-	bool m_fExit = false;
+	std::atomic<bool> m_fExit{ false };
 
 	TimeConverter m_converter;
 	std::thread m_processThread;
 
 	long long m_minDelta;
+	std::shared_ptr<RateController> m_pRateController;
 
 	static const int kImageWidth;
 	static const wchar_t kSensorName[3];
@@ -1,6 +1,4 @@
 #include "pch.h"
-#define QOI_IMPLEMENTATION
-#include "qoi.h"
 
 
 
@@ -23,28 +21,35 @@ using namespace winrt::Windows::Storage::Streams;
 
 VideoCameraStreamer::VideoCameraStreamer(
     const SpatialCoordinateSystem& coordSystem,
-    std::wstring portName)
+    std::wstring portName,
+    int scaleFactor,
+    std::shared_ptr<MultiplexedStreamTransport> transport,
+    std::shared_ptr<FrameBufferPool> bufferPool)
 {
     m_worldCoordSystem = coordSystem;
     m_portName = portName;
+    m_pTransport = transport;
+    // buffers are reserved once the first frame tells the frame size
+    m_pBufferPool = bufferPool ? bufferPool : std::make_shared<FrameBufferPool>();
+    SetScaleFactor(scaleFactor);
 
-    StartServer();
+    if (!m_pTransport)
+    {
+        StartServer();
+    }
     // m_streamingEnabled = true;
+}
 
-
-    m_qoi_desc = (qoi_desc *) malloc(sizeof(qoi_desc));
-    if (m_qoi_desc == NULL)
+void VideoCameraStreamer::SetScaleFactor(int scaleFactor)
+{
+    if (scaleFactor != 1 && scaleFactor != 2 && scaleFactor != 4)
     {
-        throw new std::bad_alloc();
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"VideoCameraStreamer::SetScaleFactor: Only 1, 2 and 4 are supported, using 1.\n");
+#endif
+        scaleFactor = 1;
     }
-
-    m_qoi_desc->width = 0;
-    m_qoi_desc->height = 0;
-    m_qoi_desc->channels = 3;
-    m_qoi_desc->colorspace = 0;
-
-
-    m_bgr_buf = (uint8_t*)malloc(1952 * 1100 * 4); // max expected frame size for Hololens 2 Video Conferencing Profile
+    m_scaleFactor = scaleFactor;
 }
 
 IAsyncAction VideoCameraStreamer::StartServer()
@@ -89,13 +94,12 @@ void VideoCameraStreamer::OnConnectionReceived(
 {
     try
     {
-        m_streamSocket = args.Socket();
-        m_writer = DataWriter(args.Socket().OutputStream());
-        m_writer.UnicodeEncoding(UnicodeEncoding::Utf8);
-        m_writer.ByteOrder(ByteOrder::LittleEndian);
-
-        m_writeInProgress = false;
+        {
+            std::lock_guard<std::mutex> guard(m_socketMutex);
+            m_streamSocket = args.Socket();
+        }
         isConnected = true;
+        RequestKeyframe();
 #if DBG_ENABLE_INFO_LOGGING
         OutputDebugStringW(L"VideoCameraStreamer::OnConnectionReceived: Received connection! \n");
 #endif
@@ -118,26 +122,115 @@ void VideoCameraStreamer::Send(
     MediaFrameReference pFrame,
     long long pTimestamp)
 {
-    if (m_writeInProgress)
+    if (m_pPipeline)
+    {
+        // packing and the socket write happen on the pipeline's threads
+        m_pPipeline->Submit({ pFrame, pTimestamp });
+        return;
+    }
+
+    PackedFrame packed;
+    if (Pack(pFrame, pTimestamp, packed))
+    {
+        Transmit(packed);
+    }
+}
+
+void VideoCameraStreamer::EnablePipeline(std::function<void()> onDrop)
+{
+    if (m_pPipeline)
     {
-    #if DBG_ENABLE_VERBOSE_LOGGING
-            OutputDebugStringW(
-                L"VideoCameraStreamer::SendFrame: Write in progress.\n");
-    #endif
-            return;
+        return;
     }
 
+    m_pPipeline = std::make_unique<FramePipeline<PendingFrame, PackedFrame>>(
+        [this](PendingFrame& pending, PackedFrame& packed)
+        {
+            return Pack(pending.frame, pending.timestamp, packed);
+        },
+        [this](PackedFrame& packed)
+        {
+            Transmit(packed);
+        },
+        kPipelineQueueCapacity,
+        [this, onDrop](bool skipped)
+        {
+            // the receiver's next delta would refer to the dropped frame
+            RequestKeyframe();
+            // a skipped frame (no pose, no connection) says nothing about
+            // the link
+            if (!skipped)
+            {
+                ReportCongestion();
+            }
+            if (onDrop)
+            {
+                onDrop();
+            }
+        });
+}
+
+void VideoCameraStreamer::SetTemporalDelta(
+    uint32_t keyframeInterval,
+    TemporalCodec::Method method,
+    int acceleration)
+{
+    m_pTemporalEncoder = std::make_unique<TemporalCodec::Encoder>(keyframeInterval, acceleration, method);
+}
+
+void VideoCameraStreamer::SetTiledQoi(
+    std::shared_ptr<WorkerPool> pWorkerPool,
+    uint32_t bandCount)
+{
+    m_pQoiWorkerPool = pWorkerPool;
+    m_qoiBandCount = bandCount;
+}
+
+void VideoCameraStreamer::EnableAdaptiveEncoding(double cpuBudget)
+{
+    std::vector<PayloadEncoding> candidates = { PayloadEncoding::Raw, PayloadEncoding::Lz4 };
+    if (m_pQoiWorkerPool)
+    {
+        candidates.push_back(PayloadEncoding::QoiTiled);
+    }
+    if (m_pTemporalEncoder)
+    {
+        candidates.push_back(PayloadEncoding::DeltaLz4);
+    }
+    m_pCodecController = std::make_unique<CodecController>(candidates, cpuBudget);
+}
 
+void VideoCameraStreamer::ReportCongestion()
+{
+    if (m_pCodecController)
+    {
+        m_pCodecController->ReportCongestion();
+    }
+}
+
+void VideoCameraStreamer::RequestKeyframe()
+{
+    if (m_pTemporalEncoder)
+    {
+        m_pTemporalEncoder->RequestKeyframe();
+    }
+}
+
+bool VideoCameraStreamer::Pack(
+    MediaFrameReference pFrame,
+    long long pTimestamp,
+    PackedFrame& packed)
+{
 #if DBG_ENABLE_VERBOSE_LOGGING
     OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Received frame for sending!\n");
 #endif
-    if (!m_streamSocket || !m_writer)
+    if (!IsConnected())
     {
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(
             L"VideoCameraStreamer::SendFrame: No connection.\n");
 #endif
-        return;
+        return false;
     }
 
 
@@ -157,7 +250,7 @@ void VideoCameraStreamer::Send(
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"Streamer::SendFrame: Could not locate frame.\n");
 #endif
-        return;
+        return false;
     }
 
     // grab the frame data
@@ -168,7 +261,7 @@ void VideoCameraStreamer::Send(
     int imageHeight = softwareBitmap.PixelHeight();
 
     int pixelStride = 4;
-    int scaleFactor = 1;
+    int scaleFactor = m_scaleFactor;
 
     int rowStride = imageWidth * pixelStride;
 
@@ -201,181 +294,326 @@ void VideoCameraStreamer::Send(
 
     if ( (imageWidth*imageHeight) > (1952 * 1100) )
     {
-        OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Unexpected_image_size");
-        throw std::bad_alloc();
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Unexpected_image_size\n");
+#endif
+        return false;
     }
 
 
-    m_qoi_desc->width = imageWidth;
-    m_qoi_desc->height = imageHeight;
-    m_qoi_desc->channels = 3;
-
+    const int bgrWidth = imageWidth / scaleFactor;
+    const int bgrHeight = imageHeight / scaleFactor;
+    const size_t bgrSize = (size_t)bgrWidth * bgrHeight * 3;
+    // room for the largest encoding this stream may use
+    size_t payloadCapacity = bgrSize;
+    if (m_pQoiWorkerPool)
+    {
+        payloadCapacity = (std::max)(payloadCapacity, TiledQoi::MaxEncodedSize(bgrWidth, bgrHeight, 3, m_qoiBandCount));
+    }
+    if (m_pTemporalEncoder)
+    {
+        payloadCapacity = (std::max)(payloadCapacity, TemporalCodec::MaxEncodedSize(bgrSize));
+    }
+    ReserveBuffers(payloadCapacity);
+    std::shared_ptr<FrameSendSlot> slot = m_pBufferPool->Acquire(FrameHeaderSize(m_poseFormat), payloadCapacity);
+    if (!slot)
+    {
+        m_stats.framesDropped++;
+#if DBG_ENABLE_VERBOSE_LOGGING
+        OutputDebugStringW(L"VideoCameraStreamer::SendFrame: No send buffer available.\n");
+#endif
+        return false;
+    }
 
+    // QOI takes precedence over temporal coding and that over LZ4, unless
+    // the controller picks the encoding
+    PayloadEncoding encoding = PayloadEncoding::Raw;
+    if (m_pCodecController)
+    {
+        encoding = m_pCodecController->Choose();
+    }
+    else if (m_pQoiWorkerPool)
+    {
+        encoding = PayloadEncoding::QoiTiled;
+    }
+    else if (m_pTemporalEncoder)
+    {
+        encoding = PayloadEncoding::DeltaLz4;
+    }
+    else if (m_useLz4)
+    {
+        encoding = PayloadEncoding::Lz4;
+    }
+    const PayloadEncoding requested = encoding;
+    const CodecController::Clock::time_point encodeStart = CodecController::Clock::now();
 
+    // drop the alpha channel, box-filtering the image down if requested.
+    // Encoded frames use the image as the encoder's input, not the payload.
+    size_t payloadSize = bgrSize;
+    if (encoding == PayloadEncoding::Raw)
+    {
+        FramePacking::DownscaleBgraToBgr(pixelBufferData, imageWidth, imageHeight, rowStride, scaleFactor, slot->Payload());
+    }
+    else
+    {
+        m_bgrImage.resize(bgrSize);
+        FramePacking::DownscaleBgraToBgr(pixelBufferData, imageWidth, imageHeight, rowStride, scaleFactor, m_bgrImage.data());
+    }
 
-    int count = 0;
-    for (int row = 0; row < imageHeight; row += scaleFactor)
+    if (encoding == PayloadEncoding::QoiTiled)
     {
-        for (int col = 0; col < rowStride; col += scaleFactor * pixelStride)
+        payloadSize = TiledQoi::Encode(m_bgrImage.data(), bgrWidth, bgrHeight, 3,
+            m_qoiBandCount, m_pQoiWorkerPool.get(), slot->Payload(), slot->PayloadCapacity());
+        if (payloadSize == 0)
         {
-            for (int j = 0; j < pixelStride - 1; j++)
-            {
-                m_bgr_buf[count] = pixelBufferData[row * rowStride + col + j];
-                ++count;
-            }
+#if DBG_ENABLE_ERROR_LOGGING
+            OutputDebugStringW(L"VideoCameraStreamer::SendFrame: QOI encoding failed.\n");
+#endif
+            return false;
+        }
+    }
+    else if (encoding == PayloadEncoding::DeltaLz4)
+    {
+        payloadSize = m_pTemporalEncoder->Encode(m_bgrImage.data(), bgrSize, slot->Payload(), slot->PayloadCapacity());
+    }
+    else if (encoding == PayloadEncoding::Lz4)
+    {
+        const int size = LZ4_compress_default((const char*)m_bgrImage.data(), (char*)slot->Payload(),
+            (int)bgrSize, (int)bgrSize - 1);
+        if (size > 0)
+        {
+            payloadSize = (size_t)size;
+        }
+        else
+        {
+            memcpy(slot->Payload(), m_bgrImage.data(), bgrSize);
+            packed.bytesCopied = (uint32_t)bgrSize;
+            encoding = PayloadEncoding::Raw;
         }
     }
 
-    int out_len = 0;
-
-    // removing compression
-    //uint8_t* qoi_buf = (uint8_t*)qoi_encode(m_bgr_buf, m_qoi_desc, &out_len);  // m_qoi_desc has the size of the buffer
-    //if (qoi_buf == NULL)
-    //{
-    //    throw std::bad_alloc();
-    //}
-
-                                //std::vector<uint8_t> imageBufferAsVector;
-
-                                //for (int i = 0; i < out_len; i++)
-                                //{
-                                //    imageBufferAsVector.emplace_back(qoi_buf[i]);
-                                //}
-
-
-    /*const int max_dst_size = LZ4_compressBound(out_len);
-    char* compressed_data = (char*)malloc((size_t)max_dst_size)*/;
-
-    //if (compressed_data == NULL)
-    //{
-    //    OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Malloc failed for lz4.\n");
-    //    throw std::bad_alloc();
-    //}
-
-    //const int compressed_data_size = LZ4_compress_default( (char*)qoi_buf, compressed_data, out_len, max_dst_size);
-
-    //free(qoi_buf);
-
-    //if (compressed_data_size <= 0)
-    //{
-    //    // lz4 error
-    //    free(compressed_data);
-    //    return;
-    //}
-
-
-    ////second LZ4 pass
-    //const int max_dst_size2 = LZ4_compressBound(compressed_data_size);
-    //char* compressed_data2 = (char*)malloc((size_t)max_dst_size2);
+    if (m_pCodecController)
+    {
+        const CodecController::Clock::time_point now = CodecController::Clock::now();
+        m_pCodecController->Report(requested, bgrSize, payloadSize, now - encodeStart, now);
+    }
 
-    //if (compressed_data2 == NULL)
-    //{
-    //    OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Malloc failed for lz4.\n");
-    //    throw std::bad_alloc();
-    //}
+    imageWidth /= scaleFactor;
+    imageHeight /= scaleFactor;
+
+    // focal lengths are in pixels and shrink with the image
+    fx /= scaleFactor;
+    fy /= scaleFactor;
+
+    // Write header
+    FrameHeader header = MakeFrameHeader((uint8_t)StreamId::PhotoVideo, m_poseFormat, (uint16_t)encoding, m_sequence++);
+    header.timestamp = (uint64_t)pTimestamp;
+    header.width = imageWidth;
+    header.height = imageHeight;
+    header.pixelStride = pixelStride - 1; // 3
+    header.rowStride = imageWidth * (pixelStride - 1); // adapted row stride
+    header.payloadLength = (uint32_t)payloadSize;
+    header.fx = fx;
+    header.fy = fy;
+    WriteFrameHeader(header, &PVtoWorldtransform.m11, slot->Header());
+
+
+    packed.slot = slot;
+    packed.payloadLength = (uint32_t)payloadSize;
+    return true;
+}
 
-    //const int compressed_data_size2 = LZ4_compress_default(compressed_data, compressed_data2, compressed_data_size, max_dst_size2);
+void VideoCameraStreamer::Transmit(PackedFrame& packed)
+{
+    if (m_pendingWrite)
+    {
+        if (m_pendingWrite.Status() == AsyncStatus::Started)
+        {
+            // the previous frame is still on the wire
+            ReportCongestion();
+        }
+        // Writes do not pile up behind each other: the frames that arrive
+        // meanwhile wait in the transmit queue, which drops the oldest and
+        // hands its credit back.
+        CompletePendingWrite();
+    }
 
-    //if (compressed_data_size2 <= 0)
-    //{
-    //    // lz4 error
-    //    free(compressed_data);
-    //    free(compressed_data2);
-    //    return;
-    //}
+    StreamSocket socket = nullptr;
+    if (!m_pTransport)
+    {
+        std::lock_guard<std::mutex> guard(m_socketMutex);
+        socket = m_streamSocket;
+    }
+    if (m_pTransport ? !m_pTransport->IsConnected() : !socket)
+    {
+#if DBG_ENABLE_VERBOSE_LOGGING
+        OutputDebugStringW(L"VideoCameraStreamer::SendFrame: No connection.\n");
+#endif
+        RequestKeyframe();
+        return;
+    }
 
-                            // old from when I removed qoi_encode
-                            /*const int max_dst_size = LZ4_compressBound(imageWidth * imageHeight*3);
-                            char* compressed_data = (char*)malloc((size_t)max_dst_size);
+    try
+    {
+        SendSlot(packed.slot, packed.payloadLength, packed.bytesCopied, socket);
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+        RequestKeyframe();
+        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+        if (webErrorStatus == SocketErrorStatus::ConnectionResetByPeer)
+        {
+            // the client disconnected!
+            DropSocket(socket);
+        }
+#if DBG_ENABLE_ERROR_LOGGING
+        winrt::hstring message = ex.message();
+        OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Sending failed with ");
+        OutputDebugStringW(message.c_str());
+        OutputDebugStringW(L"\n");
+#endif // DBG_ENABLE_ERROR_LOGGING
+    }
 
-                            if (compressed_data == NULL)
-                            {
-                                OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Malloc failed for lz4.\n");
-                                throw std::bad_alloc();
-                            }
+#if DBG_ENABLE_VERBOSE_LOGGING
+    OutputDebugStringW(
+        L"VideoCameraStreamer::SendFrame: Frame sent!\n");
+#endif
+}
 
-                            const int compressed_data_size = LZ4_compress_default( (char*)m_bgr_buf, compressed_data, imageWidth * imageHeight * 3, max_dst_size);*/
+bool VideoCameraStreamer::IsConnected() const
+{
+    if (m_pTransport)
+    {
+        return m_pTransport->IsConnected();
+    }
+    std::lock_guard<std::mutex> guard(m_socketMutex);
+    return m_streamSocket != nullptr;
+}
 
+void VideoCameraStreamer::SendSlot(
+    std::shared_ptr<FrameSendSlot> const& slot,
+    uint32_t payloadLength,
+    uint32_t bytesCopied,
+    StreamSocket const& socket)
+{
+    // header and payload are contiguous in the slot and go out as one buffer
+    const uint32_t length = (uint32_t)slot->HeaderSize() + payloadLength;
+    IBuffer buffer = winrt::make<FrameSendBuffer>(slot, length);
 
+    if (m_pTransport)
+    {
+        using SubmitResult = MultiplexedStreamTransport::SubmitResult;
+        const SubmitResult result = m_pTransport->Submit(StreamId::PhotoVideo, buffer);
+        if (result == SubmitResult::DroppedOldest)
+        {
+            // the transport handed the dropped frame's credit back
+            m_stats.framesDropped++;
+        }
+        if (result == SubmitResult::Queued || result == SubmitResult::DroppedOldest)
+        {
+            ReportCongestion();
+        }
+    }
+    else
+    {
+        // not awaited, the slot stays in flight until the socket is done with
+        // it and the next Transmit waits for the write
+        m_pendingWrite = socket.OutputStream().WriteAsync(buffer);
+        m_pendingWriteSocket = socket;
+        std::shared_ptr<std::promise<void>> pDone = std::make_shared<std::promise<void>>();
+        m_writeDone = pDone->get_future();
+        // the write completes once the socket took the whole frame, which is
+        // what the rate controller measures the link by
+        std::shared_ptr<RateController> pRateController = m_pRateController;
+        const size_t stream = (size_t)StreamId::PhotoVideo;
+        if (pRateController)
+        {
+            pRateController->ReportQueued(stream, length);
+        }
+        // the completion handler can only be set once, so it also tells
+        // CompletePendingWrite that the write is done
+        m_pendingWrite.Completed([pRateController, stream, length, pDone](
+            winrt::Windows::Foundation::IAsyncOperationWithProgress<uint32_t, uint32_t> const& /* write */,
+            winrt::Windows::Foundation::AsyncStatus status)
+            {
+                if (pRateController)
+                {
+                    if (status == winrt::Windows::Foundation::AsyncStatus::Completed)
+                    {
+                        pRateController->ReportSent(stream, length);
+                    }
+                    else
+                    {
+                        pRateController->ReportDropped(stream, length);
+                    }
+                }
+                pDone->set_value();
+            });
+    }
 
+    m_stats.RecordFrame(length, bytesCopied);
 
-    //std::vector<uint8_t> imageBufferAsVector(compressed_data2, compressed_data2 + compressed_data_size2);
-    int bgr_buf_size = imageWidth * imageHeight * 3;
-    std::vector<uint8_t> imageBufferAsVector(m_bgr_buf, m_bgr_buf + bgr_buf_size);
+#if DBG_ENABLE_INFO_LOGGING
+    if (m_stats.framesSent % kStatsLogInterval == 0)
+    {
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"VideoCameraStreamer: sent %llu frames, %llu bytes copied per frame, %llu dropped.\n",
+            m_stats.framesSent.load(), m_stats.BytesCopiedPerFrame(), m_stats.framesDropped.load());
+        OutputDebugStringW(msgBuffer);
+        if (m_pRateController)
+        {
+            swprintf_s(msgBuffer, L"VideoCameraStreamer: limited to %.1f fps (0 for none), link %.2f MB/s.\n",
+                m_pRateController->Rate((size_t)StreamId::PhotoVideo), m_pRateController->Capacity() / 1e6);
+            OutputDebugStringW(msgBuffer);
+        }
+    }
+#endif
+}
 
-  /*  free(compressed_data);
-    free(compressed_data2);*/
+void VideoCameraStreamer::ReserveBuffers(size_t payloadSize)
+{
+    if (payloadSize == m_reservedPayloadSize)
+    {
+        return;
+    }
 
+    m_pBufferPool->Reserve(FrameHeaderSize(m_poseFormat) + payloadSize, kBuffersPerStream);
+    m_reservedPayloadSize = payloadSize;
+}
 
-    m_writeInProgress = true;
+void VideoCameraStreamer::CompletePendingWrite()
+{
+    m_writeDone.wait();
     try
     {
-
-
-        // Write header
-        m_writer.WriteUInt64(pTimestamp);
-        m_writer.WriteInt32(imageWidth);
-        m_writer.WriteInt32(imageHeight);
-        m_writer.WriteInt32(pixelStride - 1); // 3
-        m_writer.WriteInt32(imageWidth * (pixelStride - 1)); // adapted row stride
-        //m_writer.WriteInt32(/*compressed_data_size2*/);
-        m_writer.WriteInt32(bgr_buf_size);
-        m_writer.WriteSingle(fx);
-        m_writer.WriteSingle(fy);
-
-        WriteMatrix4x4(PVtoWorldtransform);
-
-
-        m_writer.WriteBytes(imageBufferAsVector);
-        m_writer.StoreAsync();
+        // rethrows the error of a failed write
+        m_pendingWrite.GetResults();
     }
     catch (winrt::hresult_error const& ex)
     {
         SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
-        if (webErrorStatus == SocketErrorStatus::ConnectionResetByPeer)
+        if (webErrorStatus == SocketErrorStatus::ConnectionResetByPeer ||
+            webErrorStatus == SocketErrorStatus::ConnectionAborted)
         {
             // the client disconnected!
-            m_writer == nullptr;
-            m_streamSocket == nullptr;
-            m_writeInProgress = false;
+            DropSocket(m_pendingWriteSocket);
         }
 #if DBG_ENABLE_ERROR_LOGGING
         winrt::hstring message = ex.message();
-        OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Sending failed with ");
+        OutputDebugStringW(L"VideoCameraStreamer::CompletePendingWrite: Sending failed with ");
         OutputDebugStringW(message.c_str());
         OutputDebugStringW(L"\n");
 #endif // DBG_ENABLE_ERROR_LOGGING
     }
-
-    m_writeInProgress = false;
-
-#if DBG_ENABLE_VERBOSE_LOGGING
-    OutputDebugStringW(
-        L"VideoCameraStreamer::SendFrame: Frame sent!\n");
-#endif
-
+    m_pendingWrite = nullptr;
+    m_pendingWriteSocket = nullptr;
 }
 
-void VideoCameraStreamer::WriteMatrix4x4(
-    _In_ winrt::Windows::Foundation::Numerics::float4x4 matrix)
+void VideoCameraStreamer::DropSocket(StreamSocket const& socket)
 {
-    m_writer.WriteSingle(matrix.m11);
-    m_writer.WriteSingle(matrix.m12);
-    m_writer.WriteSingle(matrix.m13);
-    m_writer.WriteSingle(matrix.m14);
-
-    m_writer.WriteSingle(matrix.m21);
-    m_writer.WriteSingle(matrix.m22);
-    m_writer.WriteSingle(matrix.m23);
-    m_writer.WriteSingle(matrix.m24);
-
-    m_writer.WriteSingle(matrix.m31);
-    m_writer.WriteSingle(matrix.m32);
-    m_writer.WriteSingle(matrix.m33);
-    m_writer.WriteSingle(matrix.m34);
-
-    m_writer.WriteSingle(matrix.m41);
-    m_writer.WriteSingle(matrix.m42);
-    m_writer.WriteSingle(matrix.m43);
-    m_writer.WriteSingle(matrix.m44);
+    std::lock_guard<std::mutex> guard(m_socketMutex);
+    if (m_streamSocket == socket)
+    {
+        m_streamSocket = nullptr;
+    }
 }
@@ -1,30 +1,137 @@
 #pragma once
-#include "qoi.h"
 
 class VideoCameraStreamer : public IVideoFrameSink
 {
 public:
+    // With a transport the frames go out over the multiplexed connection as
+    // StreamId::PhotoVideo and portName is not used.
     VideoCameraStreamer(
         const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& coordSystem,
-        std::wstring portName);
+        std::wstring portName,
+        int scaleFactor = 1,
+        std::shared_ptr<MultiplexedStreamTransport> transport = nullptr,
+        std::shared_ptr<FrameBufferPool> bufferPool = nullptr);
 
     void Send(
         winrt::Windows::Media::Capture::Frames::MediaFrameReference pFrame,
         long long pTimestamp);
 
+    // Moves packing and the socket write onto their own threads (see
+    // FramePipeline), Send then only queues the frame. onDrop is called for
+    // every frame the pipeline drops.
+    void EnablePipeline(std::function<void()> onDrop = nullptr);
+
+    // Downscale factor applied to every frame before sending (1, 2 or 4).
+    // Can be changed while streaming.
+    void SetScaleFactor(int scaleFactor);
+
+    // Sends every frame relative to the previous one (see TemporalCodec),
+    // with a keyframe every keyframeInterval frames and whenever the size
+    // changes. Set it before the stream starts.
+    void SetTemporalDelta(
+        uint32_t keyframeInterval = TemporalCodec::kDefaultKeyframeInterval,
+        TemporalCodec::Method method = TemporalCodec::Method::Lz4Dictionary,
+        int acceleration = 1);
+
+    void RequestKeyframe() override;
+
+    // Sends every frame as tiled QOI (see TiledQoi), bandCount bands coded
+    // in parallel on the pool's threads. Takes precedence over
+    // SetTemporalDelta. Set it before the stream starts.
+    void SetTiledQoi(
+        std::shared_ptr<WorkerPool> pWorkerPool,
+        uint32_t bandCount = TiledQoi::kDefaultBandCount);
+
+    // Sends every frame as one LZ4 block. SetTiledQoi and SetTemporalDelta
+    // take precedence. Set it before the stream starts.
+    void EnableLz4()
+    {
+        m_useLz4 = true;
+    }
+
+    // Lets a CodecController choose the encoding of every frame from raw,
+    // LZ4 and the tiled QOI and temporal coding if they are set up. Call it
+    // after SetTiledQoi and SetTemporalDelta, before the stream starts.
+    void EnableAdaptiveEncoding(double cpuBudget = CodecController::kDefaultCpuBudget);
+
+    // Format of the PV to world transform in the frame header (see
+    // PoseCodec). Set it before the stream starts.
+    void SetPoseFormat(PoseCodec::Format format)
+    {
+        m_poseFormat = format;
+    }
+
+    // Reports every frame written to the socket to the controller. With a
+    // transport the transport reports them instead. Set it before the stream
+    // starts.
+    void SetRateController(std::shared_ptr<RateController> rateController)
+    {
+        m_pRateController = rateController;
+    }
+
+    const SendStats& GetSendStats() const
+    {
+        return m_stats;
+    }
+
     // void StreamingToggle();
 public:
     bool isConnected = false;
 
 private:
+    // a frame waiting to be packed
+    struct PendingFrame
+    {
+        winrt::Windows::Media::Capture::Frames::MediaFrameReference frame = nullptr;
+        long long timestamp = 0;
+    };
+
+    // header and payload packed into a send buffer, ready for the socket
+    struct PackedFrame
+    {
+        std::shared_ptr<FrameSendSlot> slot;
+        uint32_t payloadLength = 0;
+        uint32_t bytesCopied = 0;
+    };
+
     winrt::Windows::Foundation::IAsyncAction StartServer();
 
+    // pose lookup, alpha removal and downscaling, returns false if the frame
+    // is skipped
+    bool Pack(
+        winrt::Windows::Media::Capture::Frames::MediaFrameReference pFrame,
+        long long pTimestamp,
+        PackedFrame& packed);
+
+    void Transmit(PackedFrame& packed);
+
     void OnConnectionReceived(
         winrt::Windows::Networking::Sockets::StreamSocketListener /* sender */,
         winrt::Windows::Networking::Sockets::StreamSocketListenerConnectionReceivedEventArgs args);
 
-    void WriteMatrix4x4(
-        _In_ winrt::Windows::Foundation::Numerics::float4x4 matrix);
+    bool IsConnected() const;
+
+    // sends the header and the first payloadLength payload bytes of the slot
+    // in a single write, to socket unless there is a transport. bytesCopied is
+    // only used for the statistics.
+    void SendSlot(
+        std::shared_ptr<FrameSendSlot> const& slot,
+        uint32_t payloadLength,
+        uint32_t bytesCopied,
+        winrt::Windows::Networking::Sockets::StreamSocket const& socket);
+
+    // waits for the previous write and picks up its result, dropping the
+    // connection if the client went away
+    void CompletePendingWrite();
+
+    // clears m_streamSocket unless a new client connected in the meantime
+    void DropSocket(winrt::Windows::Networking::Sockets::StreamSocket const& socket);
+
+    // reserves this stream's buffers in the pool when the frame size changes
+    void ReserveBuffers(size_t payloadSize);
+
+    // a frame was dropped or had to wait for the link
+    void ReportCongestion();
 
     //bool m_streamingEnabled = true;
 
@@ -32,14 +139,53 @@ private:
 
     winrt::Windows::Perception::Spatial::SpatialCoordinateSystem m_worldCoordSystem = nullptr;
     winrt::Windows::Networking::Sockets::StreamSocketListener m_streamSocketListener;
+    // guarded by m_socketMutex, the transmit thread writes to a copy
     winrt::Windows::Networking::Sockets::StreamSocket m_streamSocket = nullptr;
-    winrt::Windows::Storage::Streams::DataWriter m_writer = nullptr;
-    bool m_writeInProgress = false;
+    mutable std::mutex m_socketMutex;
+    // transmit thread only: the write still going out, the socket it goes out
+    // on and the future its completion handler fulfils
+    winrt::Windows::Foundation::IAsyncOperationWithProgress<uint32_t, uint32_t> m_pendingWrite = nullptr;
+    winrt::Windows::Networking::Sockets::StreamSocket m_pendingWriteSocket = nullptr;
+    std::future<void> m_writeDone;
+
+    // set when streaming over the multiplexed connection, the send buffers
+    // are then handed to the transport instead of the socket
+    std::shared_ptr<MultiplexedStreamTransport> m_pTransport;
+    std::shared_ptr<RateController> m_pRateController;
 
     std::wstring m_portName;
 
-    qoi_desc* m_qoi_desc;
-    uint8_t* m_bgr_buf;
+    std::atomic<int> m_scaleFactor{ 1 };
+
+    // one buffer can be packed while the other one is still being sent
+    static constexpr int kBuffersPerStream = 2;
+    static constexpr uint64_t kStatsLogInterval = 300;
+
+    std::shared_ptr<FrameBufferPool> m_pBufferPool;
+    size_t m_reservedPayloadSize = 0;
+    SendStats m_stats;
+
+    // set by SetTemporalDelta, only used on the packing thread
+    std::unique_ptr<TemporalCodec::Encoder> m_pTemporalEncoder;
+    // set by SetTiledQoi
+    std::shared_ptr<WorkerPool> m_pQoiWorkerPool;
+    uint32_t m_qoiBandCount = TiledQoi::kDefaultBandCount;
+    // set by EnableLz4
+    bool m_useLz4 = false;
+    // the BGR image, input of the temporal, QOI and LZ4 encoders
+    std::vector<uint8_t> m_bgrImage;
+
+    // set by EnableAdaptiveEncoding, only used on the packing thread (except
+    // ReportCongestion)
+    std::unique_ptr<CodecController> m_pCodecController;
+
+    // FrameHeader::sequence of the next frame, only used on the packing thread
+    uint32_t m_sequence = 0;
+    PoseCodec::Format m_poseFormat = PoseCodec::Format::Matrix;
+
+    static constexpr size_t kPipelineQueueCapacity = 2;
+    // declared last so its threads stop before the members they use go away
+    std::unique_ptr<FramePipeline<PendingFrame, PackedFrame>> m_pPipeline;
 
 
 };
\ No newline at end of file
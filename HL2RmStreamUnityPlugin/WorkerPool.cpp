@@ -0,0 +1,118 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(size_t threadCount)
+{
+	m_threads.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; i++)
+	{
+		m_threads.emplace_back(&WorkerPool::WorkerLoop, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		m_stop = true;
+	}
+	m_batchStarted.notify_all();
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+size_t WorkerPool::DefaultThreadCount()
+{
+	const unsigned int cores = std::thread::hardware_concurrency();
+	return cores > 1 ? cores - 1 : 0;
+}
+
+void WorkerPool::Run(
+	size_t taskCount,
+	const std::function<void(size_t)>& task)
+{
+	if (taskCount == 0)
+	{
+		return;
+	}
+	if (m_threads.empty() || taskCount == 1)
+	{
+		for (size_t i = 0; i < taskCount; i++)
+		{
+			task(i);
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> runGuard(m_runMutex);
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		m_pTask = &task;
+		m_taskCount = taskCount;
+		m_tasksDone = 0;
+		m_nextTask = 0;
+		m_generation++;
+	}
+	m_batchStarted.notify_all();
+
+	Work(task, taskCount);
+
+	// a worker that is still between two claims could otherwise take a task
+	// of the next batch and run this one's function
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_batchDone.wait(lock, [this] { return m_tasksDone == m_taskCount && m_activeWorkers == 0; });
+	m_pTask = nullptr;
+}
+
+void WorkerPool::Work(
+	const std::function<void(size_t)>& task,
+	size_t taskCount)
+{
+	size_t done = 0;
+	for (size_t i = m_nextTask++; i < taskCount; i = m_nextTask++)
+	{
+		task(i);
+		done++;
+	}
+
+	if (done > 0)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		m_tasksDone += done;
+	}
+}
+
+void WorkerPool::WorkerLoop()
+{
+	uint64_t generation = 0;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_batchStarted.wait(lock, [this, generation] { return m_stop || m_generation != generation; });
+		if (m_stop)
+		{
+			return;
+		}
+		generation = m_generation;
+		if (!m_pTask)
+		{
+			// woke up after the batch was over
+			continue;
+		}
+
+		const std::function<void(size_t)>& task = *m_pTask;
+		const size_t taskCount = m_taskCount;
+		m_activeWorkers++;
+		lock.unlock();
+
+		Work(task, taskCount);
+
+		lock.lock();
+		m_activeWorkers--;
+		if (m_tasksDone == m_taskCount && m_activeWorkers == 0)
+		{
+			m_batchDone.notify_one();
+		}
+	}
+}
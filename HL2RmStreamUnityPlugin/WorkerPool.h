@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads that run the tasks of one batch in parallel, e.g. the
+// bands of a tiled QOI image (see TiledQoi). The calling thread works on the
+// batch as well, so a pool of n threads keeps n + 1 cores busy.
+class WorkerPool
+{
+public:
+	// threadCount 0 runs every batch on the calling thread alone.
+	explicit WorkerPool(size_t threadCount);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Calls task(0) ... task(taskCount - 1) and returns when all of them are
+	// done. Tasks must not throw. Batches of concurrent callers run one
+	// after the other.
+	void Run(
+		size_t taskCount,
+		const std::function<void(size_t)>& task);
+
+	size_t ThreadCount() const
+	{
+		return m_threads.size();
+	}
+
+	// hardware threads minus the calling one
+	static size_t DefaultThreadCount();
+
+private:
+	void WorkerLoop();
+
+	// claims and runs tasks of the current batch until none are left
+	void Work(
+		const std::function<void(size_t)>& task,
+		size_t taskCount);
+
+	std::vector<std::thread> m_threads;
+
+	// one batch at a time
+	std::mutex m_runMutex;
+
+	std::mutex m_mutex;
+	std::condition_variable m_batchStarted;
+	std::condition_variable m_batchDone;
+	const std::function<void(size_t)>* m_pTask = nullptr;
+	size_t m_taskCount = 0;
+	uint64_t m_generation = 0;
+	size_t m_tasksDone = 0;
+	// workers that picked up the current batch and may still claim tasks
+	size_t m_activeWorkers = 0;
+	bool m_stop = false;
+
+	std::atomic<size_t> m_nextTask{ 0 };
+};
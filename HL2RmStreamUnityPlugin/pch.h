@@ -11,12 +11,18 @@
 #include <wchar.h>
 #include <comdef.h>
 #include <MemoryBuffer.h>
+#include <robuffer.h>
 
 #include <deque>
 #include <queue>
 #include <codecvt>
 #include <chrono>
 #include <mutex>
+#include <condition_variable>
+#include <future>
+#include <thread>
+#include <functional>
+#include <atomic>
 
 
 #include <winrt\base.h>
@@ -38,11 +44,34 @@
 
 
 #include "TimeConverter.h"
+#include "FramePacking.h"
+#include "PayloadEncoding.h"
+#include "PoseCodec.h"
+#include "FrameHeader.h"
+#include "DepthCodec.h"
+#include "TemporalCodec.h"
+#include "WorkerPool.h"
+#include "TiledQoi.h"
+#include "CodecController.h"
+#include "RateController.h"
+#include "PoseCache.h"
+#include "ImuPacking.h"
 #include "ResearchModeApi.h"
 #include "IResearchModeFrameSink.h"
 #include "IVideoFrameSink.h"
+#include "LatestFrameMailbox.h"
+#include "StereoBundler.h"
+#include "FrameCredits.h"
+#include "FrameSendBuffer.h"
+#include "FrameBufferPool.h"
+#include "FramePipeline.h"
+#include "MultiplexedStreamTransport.h"
+#include "SensorSettings.h"
+#include "RigPoseService.h"
 #include "ResearchModeFrameProcessor.h"
+#include "StereoFrameProcessor.h"
 #include "ResearchModeFrameStreamer.h"
+#include "ImuStreamer.h"
 #include "VideoCameraFrameProcessor.h"
 #include "VideoCameraStreamer.h"
 
@@ -7,9 +7,14 @@ import numpy as np
 import time
 import select
 import _thread
+from collections import deque
 import qoi
 import lz4.block
 
+from DataCollection import hl2_codecs
+from DataCollection.frame_recorder import FrameRecorder
+from DataCollection.native_receiver import NativeReceiver, NATIVE_POLL_TIMEOUT_MS
+
 ###############################################################################
 # USER ADJUSTABLE PARAMETERS
 
@@ -17,15 +22,56 @@ VIDEO_STREAM_PORT = 23940
 DEPTH_STREAM_PORT = 23941
 LEFT_FRONT_STREAM_PORT = 23942
 RIGHT_FRONT_STREAM_PORT = 23943
+IMU_STREAM_PORT = 23944
+LEFT_LEFT_STREAM_PORT = 23945
+RIGHT_RIGHT_STREAM_PORT = 23946
+AHAT_STREAM_PORT = 23947
+STEREO_STREAM_PORT = 23948
 
 VIDEO_UDP_PORT = 21110
 DEPTH_UDP_PORT = 21111
 LEFT_FRONT_UDP_PORT = 21112
 RIGHT_FRONT_UDP_PORT = 21113
+IMU_UDP_PORT = 21114
+LEFT_LEFT_UDP_PORT = 21115
+RIGHT_RIGHT_UDP_PORT = 21116
+AHAT_UDP_PORT = 21117
+STEREO_UDP_PORT = 21118
+
+# Single connection used by all sensors when the HoloLens streams with
+# EnableMultiplexedTransport(true). Every message is prefixed with
+# (stream id, reserved, sequence number, length).
+MUX_STREAM_PORT = 23950
+MUX_UDP_PORT = 21120
+MUX_HEADER_FORMAT = "<B3xII"
+MUX_HEADER_SIZE = struct.calcsize(MUX_HEADER_FORMAT)
+
+VIDEO_STREAM_ID = 0
+DEPTH_STREAM_ID = 1
+LEFT_FRONT_STREAM_ID = 2
+RIGHT_FRONT_STREAM_ID = 3
+IMU_STREAM_ID = 4
+LEFT_LEFT_STREAM_ID = 5
+RIGHT_RIGHT_STREAM_ID = 6
+AHAT_STREAM_ID = 7
+STEREO_STREAM_ID = 8
 
 VIDEO_REQUEST_TIMEOUT = .1
 DEPTH_REQUEST_TIMEOUT = .1
 VLC_REQUEST_TIMEOUT = .1
+IMU_REQUEST_TIMEOUT = .1
+
+# Number of frames each sensor may have in flight (credits). 1 is the old
+# one-request-per-frame behaviour; 2-3 keeps the link busy on higher RTT links.
+# The HoloLens caps the window at 8.
+VIDEO_REQUEST_WINDOW = 3
+DEPTH_REQUEST_WINDOW = 3
+VLC_REQUEST_WINDOW = 3
+IMU_REQUEST_WINDOW = 3
+
+# IMU sample blocks kept per sensor until pop_samples takes them, the oldest
+# go first (a block is one message worth of samples)
+IMU_MAX_BUFFERED_BLOCKS = 1024
 
 FPS_PRINT_INTERVAL = 10
 
@@ -37,33 +83,133 @@ SOCKET_RESTART_TIMEOUT = 3
 np.warnings.filterwarnings('ignore')
 
 # Definitions
-# Protocol Header Format
-# see https://docs.python.org/2/library/struct.html#format-characters
-VIDEO_STREAM_HEADER_FORMAT = "@qIIIII18f"
-
-VIDEO_FRAME_STREAM_HEADER = namedtuple(
+# Protocol Header Format, the same for every sensor (see FrameHeader.h in the
+# plugin). Little-endian without padding, the pose block follows the fixed part.
+# see https://docs.python.org/3/library/struct.html#format-characters
+FRAME_HEADER_FORMAT = "<IHHBBHIQIIIII2f"
+FRAME_HEADER_SIZE = struct.calcsize(FRAME_HEADER_FORMAT)
+FRAME_HEADER_MAGIC = 0x46324C48 # "HL2F"
+FRAME_HEADER_VERSION = 3
+# magic, version, header size
+FRAME_HEADER_PREFIX_FORMAT = "<IHH"
+FRAME_PAYLOAD_LENGTH_OFFSET = 40
+
+# The camera / rig to world transform follows the fixed part of the header in
+# one of these formats (see PoseCodec.h in the plugin)
+POSE_FORMAT_MATRIX = 0
+POSE_FORMAT_QUATERNION = 1
+POSE_FORMAT_QUANTIZED = 2
+POSE_BLOCK_FORMATS = {
+    POSE_FORMAT_MATRIX: "<16f",
+    POSE_FORMAT_QUATERNION: "<7f",
+    POSE_FORMAT_QUANTIZED: "<hhhHiii",
+}
+POSE_QUANTIZED_COMPONENT_SCALE = 32767.0 * np.sqrt(2.0)
+POSE_QUANTIZED_TRANSLATION_SCALE = 65536.0
+
+# the pose comes out as the 16 transform fields, whatever its format
+FRAME_HEADER = namedtuple(
     'SensorFrameStreamHeader',
+    'Magic Version HeaderSize SensorId PoseFormat Codec Sequence '
     'Timestamp ImageWidth ImageHeight PixelStride RowStride BufLen fx fy '
-    'PVtoWorldtransformM11 PVtoWorldtransformM12 PVtoWorldtransformM13 PVtoWorldtransformM14 '
-    'PVtoWorldtransformM21 PVtoWorldtransformM22 PVtoWorldtransformM23 PVtoWorldtransformM24 '
-    'PVtoWorldtransformM31 PVtoWorldtransformM32 PVtoWorldtransformM33 PVtoWorldtransformM34 '
-    'PVtoWorldtransformM41 PVtoWorldtransformM42 PVtoWorldtransformM43 PVtoWorldtransformM44 '
+    'TransformM11 TransformM12 TransformM13 TransformM14 '
+    'TransformM21 TransformM22 TransformM23 TransformM24 '
+    'TransformM31 TransformM32 TransformM33 TransformM34 '
+    'TransformM41 TransformM42 TransformM43 TransformM44 '
 )
+FRAME_HEADER_TRANSFORM_INDEX = FRAME_HEADER._fields.index('TransformM11')
+
+
+def decode_pose(pose_format, data, offset=0):
+    # The 16 transform values, row by row, of the pose block at offset.
+    values = struct.unpack_from(POSE_BLOCK_FORMATS[pose_format], data, offset)
+    if pose_format == POSE_FORMAT_MATRIX:
+        return values
+
+    if pose_format == POSE_FORMAT_QUATERNION:
+        x, y, z, w = values[0:4]
+        translation = values[4:7]
+    else:
+        # smallest three, the left out largest component is positive
+        components = [value / POSE_QUANTIZED_COMPONENT_SCALE for value in values[0:3]]
+        largest = values[3] & 3
+        components.insert(largest, np.sqrt(max(0.0, 1.0 - sum(c * c for c in components))))
+        x, y, z, w = components
+        translation = [value / POSE_QUANTIZED_TRANSLATION_SCALE for value in values[4:7]]
+
+    # the float4x4 of make_float4x4_from_quaternion plus the translation
+    return (1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y + z * w), 2.0 * (x * z - y * w), 0.0,
+            2.0 * (x * y - z * w), 1.0 - 2.0 * (x * x + z * z), 2.0 * (y * z + x * w), 0.0,
+            2.0 * (x * z + y * w), 2.0 * (y * z - x * w), 1.0 - 2.0 * (x * x + y * y), 0.0,
+            translation[0], translation[1], translation[2], 1.0)
+
+
+def check_frame_header(data):
+    # Checks the fixed part of a frame header (FRAME_HEADER_SIZE bytes).
+    # Returns (header_size, skip): header_size is the size of the whole
+    # header, pose block included, or None for a header this receiver does
+    # not know; the frame is then skipped by discarding the next skip bytes
+    # (the rest of its header and its payload). Raises ValueError if data
+    # does not start with a frame header at all.
+    magic, version, header_size = struct.unpack_from(FRAME_HEADER_PREFIX_FORMAT, data)
+    if magic != FRAME_HEADER_MAGIC or header_size < FRAME_HEADER_SIZE:
+        raise ValueError("not a frame header")
+    pose_format = data[9]
+    if (version != FRAME_HEADER_VERSION or pose_format not in POSE_BLOCK_FORMATS or
+            header_size != FRAME_HEADER_SIZE + struct.calcsize(POSE_BLOCK_FORMATS[pose_format])):
+        payload_length, = struct.unpack_from("<I", data, FRAME_PAYLOAD_LENGTH_OFFSET)
+        return None, header_size - FRAME_HEADER_SIZE + payload_length
+    return header_size, 0
+
+
+def read_frame_header(data):
+    # Unpacks a whole header that passed check_frame_header.
+    fields = struct.unpack_from(FRAME_HEADER_FORMAT, data)
+    return FRAME_HEADER._make(fields + tuple(decode_pose(fields[4], data, FRAME_HEADER_SIZE)))
+
+
+def recvall(sock, size, timeout=None):
+    received_any = False # set to True if at least 1 byte received
+    msg = bytearray()    #       
+
+    # Check with select() for data on the socket.
+    # If select times out
+    # before any data is received None is returned. If some data is received
+    # at all, then it is assumed that in total `size` bytes are coming. This
+    # will keep reading until the expected number of bytes come in
+    while len(msg) < size:
+        if (timeout is None) or (received_any):
+            # if there is a timeout or some bytes have been read, select
+            # will wait indefinitely since more bytes should be coming
+            read_sockets, _, _ = select.select([sock], [], [])
 
-RM_STREAM_HEADER_FORMAT = "@qIIIII16f"
+        else:
+            # if there is a timeout, and there is nothing to read from
+            # select(), return none
+            read_sockets, _, _ = select.select([sock], [], [], timeout)
 
-RM_FRAME_STREAM_HEADER = namedtuple(
-    'SensorFrameStreamHeader',
-    'Timestamp ImageWidth ImageHeight PixelStride RowStride BufLen '
-    'rig2worldTransformM11 rig2worldTransformM12 rig2worldTransformM13 rig2worldTransformM14 '
-    'rig2worldTransformM21 rig2worldTransformM22 rig2worldTransformM23 rig2worldTransformM24 '
-    'rig2worldTransformM31 rig2worldTransformM32 rig2worldTransformM33 rig2worldTransformM34 '
-    'rig2worldTransformM41 rig2worldTransformM42 rig2worldTransformM43 rig2worldTransformM44 '
-)
+            if (len(read_sockets) == 0) and (not received_any):
+                
+                return None
+
+        for s in read_sockets:
+            if s == sock:
+                part = sock.recv(size - len(msg)) # blocks until data
+
+                if part != '':
+                    received_any = True
+
+                    msg += part
+                else:
+                    print("ERROR: empty recv part")
+                    # interrupts main thread, and causes the program to exit
+                    _thread.interrupt_main()
+
+    return msg
 
 
 class FrameReceiverThread(threading.Thread):
-    def __init__(self, host, port, udp_port, header_format, header_data, req_resend_timeout, sensor_name="NoSensorName"):
+    def __init__(self, host, port, udp_port, header_format, header_data, req_resend_timeout, req_window=1, sensor_name="NoSensorName", stream_id=None):
         super(FrameReceiverThread, self).__init__()
         self.header_size = struct.calcsize(header_format)
         self.header_format = header_format
@@ -78,8 +224,17 @@ class FrameReceiverThread(threading.Thread):
         self.udp_socket = None
 
         self.req_resend_timeout = req_resend_timeout
+        self.req_window = req_window
         self.sensor_name = sensor_name
 
+        # set when the frames arrive over a MultiplexedReceiver instead of
+        # this receiver's own sockets
+        self.stream_id = stream_id
+        self.mux = None
+        # set when a NativeReceiver receives the frames and returns the
+        # credits; listen_native then only decodes
+        self.native = None
+
         self.lock = threading.Lock()
 
         self.should_stop = False
@@ -88,47 +243,21 @@ class FrameReceiverThread(threading.Thread):
         self.motion_detector = None
         self.no_motion = False
 
-        self.last_frame_req_timestamp = time.time()
+        # reference frame of ENCODING_DELTA_LZ4 frames
+        self.temporal_decoder = hl2_codecs.TemporalDecoder()
+        self.last_keyframe_req_timestamp = 0
 
+        # FrameRecorder writing the decoded frames to a corpus file
+        self.recorder = None
 
-    def recvall(self, size, timeout=None):
-        received_any = False # set to True if at least 1 byte received
-        msg = bytearray()    #       
-
-        # Check with select() for data on the socket.
-        # If select times out
-        # before any data is received None is returned. If some data is received
-        # at all, then it is assumed that in total `size` bytes are coming. This
-        # will keep reading until the expected number of bytes come in
-        while len(msg) < size:
-            if (timeout is None) or (received_any):
-                # if there is a timeout or some bytes have been read, select
-                # will wait indefinitely since more bytes should be coming
-                read_sockets, _, _ = select.select([self.socket], [], [])
-
-            else:
-                # if there is a timeout, and there is nothing to read from
-                # select(), return none
-                read_sockets, _, _ = select.select([self.socket], [], [], timeout)
-
-                if (len(read_sockets) == 0) and (not received_any):
-                    
-                    return None
-
-            for s in read_sockets:
-                if s == self.socket:
-                    part = self.socket.recv(size - len(msg)) # blocks until data
+        self.last_frame_req_timestamp = time.time()
 
-                    if part != '':
-                        received_any = True
+        self.fps_count = 0
+        self.fps_start = time.time()
 
-                        msg += part
-                    else:
-                        print("ERROR: empty recv part")
-                        # interrupts main thread, and causes the program to exit
-                        _thread.interrupt_main()
 
-        return msg
+    def recvall(self, size, timeout=None):
+        return recvall(self.socket, size, timeout)
 
     def start_socket(self):
         self.socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
@@ -140,9 +269,13 @@ class FrameReceiverThread(threading.Thread):
         self.udp_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM) # UDP
         print('INFO: UDP Socket created')
 
+        # the reset makes the HoloLens start over with a keyframe
+        self.temporal_decoder.reset()
+        self.reset_credits()
+
     def start_listen(self):
         self.should_stop = False
-        t = threading.Thread(target=self.listen)
+        t = threading.Thread(target=self.listen if self.native is None else self.listen_native)
         t.daemon = True
         t.start()
 
@@ -154,94 +287,213 @@ class FrameReceiverThread(threading.Thread):
         self.socket.shutdown(socket.SHUT_RDWR)
         self.socket.close()
 
-    def req_next_frame(self):
-        # UDP message includes a newline at the end so that netcat can also be used
-        # easily for debugging
-        # 
-        # send two packets for redundancy     
- 
-        timestamp = time.time()
-        if (timestamp - self.last_frame_req_timestamp) > self.req_resend_timeout:     
-            self.udp_socket.sendto(bytes("1\n", "utf-8"), (self.host, self.udp_port))
-            self.last_frame_req_timestamp = timestamp
+    # Flow control: the HoloLens only sends while it holds credits. Every
+    # received frame hands one credit back, so req_window frames stay in
+    # flight. UDP messages include a newline at the end so that netcat can
+    # also be used easily for debugging.
 
-    @abc.abstractmethod
-    def listen(self):
-        return
+    def send_request(self, request):
+        if self.native is not None:
+            self.native.send_request(self.stream_id, request)
+        elif self.mux is not None:
+            self.mux.send_request(self.stream_id, request)
+        else:
+            self.udp_socket.sendto(bytes(request + "\n", "utf-8"), (self.host, self.udp_port))
 
-    @abc.abstractmethod
-    def get_mat_from_header(self, header):
-        return
+    def return_credit(self):
+        # the native receiver returns the credit as soon as a frame is in
+        if self.native is None:
+            self.send_request("1")
 
+    def reset_credits(self):
+        self.send_request("R" + str(self.req_window))
+        self.last_frame_req_timestamp = time.time()
 
-class VideoReceiverThread(FrameReceiverThread):
-    def __init__(self, host):
-        super().__init__(host, VIDEO_STREAM_PORT, VIDEO_UDP_PORT, VIDEO_STREAM_HEADER_FORMAT,
-                         VIDEO_FRAME_STREAM_HEADER, VIDEO_REQUEST_TIMEOUT, sensor_name="VIDEO")
+    def req_keyframe(self):
+        # frames sent before the keyframe can not be decoded either, ask once
+        # per req_resend_timeout
+        timestamp = time.time()
+        if (timestamp - self.last_keyframe_req_timestamp) > self.req_resend_timeout:
+            self.send_request("K")
+            self.last_keyframe_req_timestamp = timestamp
+
+    def decode_temporal(self, image_data, raw_size):
+        # returns the raw payload of a delta frame, or None if it does not
+        # follow the last frame (one got dropped on the way). The frame still
+        # counts against the window, so its credit is handed back here.
+        image_data = self.temporal_decoder.decode(image_data, raw_size)
+        if image_data is None:
+            self.return_credit()
+            self.req_keyframe()
+        return image_data
+
+    def req_next_frame(self):
+        # Called when no frame arrived within req_resend_timeout. Credit
+        # datagrams may have been lost, so the whole window is granted again.
+        # The native receiver does this on its own.
+        if self.native is not None:
+            return
+        timestamp = time.time()
+        if (timestamp - self.last_frame_req_timestamp) > self.req_resend_timeout:
+            self.reset_credits()
 
     def listen(self):
-        count = 0
-        start = time.time()
-        
         while True:
-            # self.req_next_frame()
-            
             ret = self.get_data_from_socket()
 
             if ret is not None:
-                # Mutex used so that the header and latest frame always match
-                # when read by the other thread
-                with self.lock:
-                    self.latest_header, image_data = ret
-                    self.latest_frame = np.frombuffer(image_data, dtype=np.uint8).reshape((self.latest_header.ImageHeight,
-                                                                                        self.latest_header.ImageWidth,
-                                                                                        self.latest_header.PixelStride))                                                          
-
-                end = time.time()
-                count += 1
-                if (end-start) > FPS_PRINT_INTERVAL:
-                    print(self.sensor_name, "receive FPS: ", count / (end-start))
-                    count = 0
-                    start = time.time()
-
+                self.return_credit()
+                self.record_frame(ret)
+                self.store_frame(ret)
+                self.count_frame()
             else:
                 self.req_next_frame()
 
-
             if self.should_stop:
                 return
 
-    def get_mat_from_header(self, header):
-        pv_to_world_transform = np.array(header[7:24]).reshape((4, 4)).T
-        return pv_to_world_transform
+    def listen_native(self):
+        while not self.should_stop:
+            try:
+                frame = self.native.next_frame(self.stream_id)
+            except ConnectionError:
+                if not self.should_stop:
+                    print(self.sensor_name, ": Connection closed")
 
+                    global should_restart_sockets
+                    should_restart_sockets = True
+                return
+
+            if frame is None:
+                continue
+
+            # the payload is a view of the native frame slot, which stays
+            # held for as long as it or a frame decoded without a copy is
+            # referenced
+            # the native receiver only passes on headers it validated
+            header_bytes, image_data = frame
+            header = read_frame_header(header_bytes)
+            ret = self.decode_payload(header, image_data[:header.BufLen])
+            if ret is not None:
+                self.record_frame(ret)
+                self.store_frame(ret)
+                self.count_frame()
+
+    def count_frame(self):
+        end = time.time()
+        self.fps_count += 1
+        if (end - self.fps_start) > FPS_PRINT_INTERVAL:
+            print(self.sensor_name, "receive FPS: ", self.fps_count / (end - self.fps_start))
+            self.fps_count = 0
+            self.fps_start = time.time()
 
     def get_data_from_socket(self, debug=False):
         # read image header
         reply = self.recvall(self.header_size, timeout=self.req_resend_timeout)
 
-
         if reply is None:
             # reply is None if self.recvall timed out
             # print(self.sensor_name, ": Header Timeout")
             return None
 
-        data = struct.unpack(self.header_format, reply)
-        header = self.header_data(*data)
-        image_size_bytes = header.ImageHeight * header.RowStride
+        global should_restart_sockets
+        try:
+            header_size, skip = check_frame_header(reply)
+        except ValueError:
+            print(self.sensor_name, ": Lost frame sync")
+            should_restart_sockets = True
+            return None
+
+        if header_size is None:
+            # a later header version, skipped but still a frame in flight
+            self.recvall(skip, timeout=SOCKET_RESTART_TIMEOUT)
+            self.return_credit()
+            return None
+
+        # read the pose block
+        if header_size > self.header_size:
+            pose_data = self.recvall(header_size - self.header_size, timeout=SOCKET_RESTART_TIMEOUT)
+            if pose_data is None:
+                print(self.sensor_name, ": Header Timeout")
+                should_restart_sockets = True
+                return None
+            reply += pose_data
+        header = read_frame_header(reply)
 
         # read the image
         image_data = self.recvall(header.BufLen, timeout=SOCKET_RESTART_TIMEOUT)
 
-        
         if image_data is None:
             print(self.sensor_name, ": Image Timeout")
 
-            global should_restart_sockets
             should_restart_sockets = True
             return None
 
+        return self.decode_payload(header, image_data)
+
+    def handle_message(self, message):
+        # one frame (header + payload) delivered by a MultiplexedReceiver
+        try:
+            header_size, _ = check_frame_header(message)
+            if header_size is not None:
+                header = read_frame_header(message)
+        except (ValueError, struct.error):
+            header_size = None
+        if header_size is None:
+            # skipped, the mux header already delimits the message
+            self.return_credit()
+            return
+        image_data = message[header_size:header_size + header.BufLen]
+
+        ret = self.decode_payload(header, image_data)
+        if ret is None:
+            return
+
+        self.return_credit()
+        self.record_frame(ret)
+        self.store_frame(ret)
+        self.count_frame()
+
+    def record_frame(self, ret):
+        # ret is (header, image parts...) as returned by decode_payload, the
+        # parts together are the raw payload
+        if self.recorder is not None:
+            self.recorder.record(ret[0], b"".join(bytes(part) for part in ret[1:]))
+
+    @abc.abstractmethod
+    def decode_payload(self, header, image_data):
+        return
+
+    @abc.abstractmethod
+    def store_frame(self, ret):
+        return
+
+    @abc.abstractmethod
+    def get_mat_from_header(self, header):
+        return
+
 
+class VideoReceiverThread(FrameReceiverThread):
+    def __init__(self, host):
+        super().__init__(host, VIDEO_STREAM_PORT, VIDEO_UDP_PORT, FRAME_HEADER_FORMAT,
+                         FRAME_HEADER, VIDEO_REQUEST_TIMEOUT, VIDEO_REQUEST_WINDOW, sensor_name="VIDEO",
+                         stream_id=VIDEO_STREAM_ID)
+
+    def store_frame(self, ret):
+        # Mutex used so that the header and latest frame always match
+        # when read by the other thread
+        with self.lock:
+            self.latest_header, image_data = ret
+            self.latest_frame = np.frombuffer(image_data, dtype=np.uint8).reshape((self.latest_header.ImageHeight,
+                                                                                self.latest_header.ImageWidth,
+                                                                                self.latest_header.PixelStride))
+
+    def get_mat_from_header(self, header):
+        pv_to_world_transform = np.array(header[FRAME_HEADER_TRANSFORM_INDEX:FRAME_HEADER_TRANSFORM_INDEX + 16]).reshape((4, 4)).T
+        return pv_to_world_transform
+
+
+    def decode_payload(self, header, image_data):
         # max_uncompressed_size = 1952*1100 * 2
 
         # pass_1 = lz4.block.decompress(image_data, uncompressed_size=max_uncompressed_size)
@@ -251,6 +503,16 @@ class VideoReceiverThread(FrameReceiverThread):
         # bgr_decoded = qoi.decode(qoi_image)
 
 
+        encoding = header.Codec
+        if encoding == hl2_codecs.ENCODING_DELTA_LZ4:
+            image_data = self.decode_temporal(image_data, header.ImageHeight * header.RowStride)
+            if image_data is None:
+                return None
+        elif encoding == hl2_codecs.ENCODING_QOI_TILED:
+            image_data = hl2_codecs.decode_qoi_tiled(image_data, header.ImageHeight * header.RowStride)
+        elif encoding == hl2_codecs.ENCODING_LZ4:
+            image_data = hl2_codecs.decode_lz4(image_data, header.ImageHeight * header.RowStride)
+
         #temp
         bgr_decoded = image_data
 
@@ -263,80 +525,53 @@ class VideoReceiverThread(FrameReceiverThread):
 
 
 class DepthReceiverThread(FrameReceiverThread):
-    def __init__(self, host):
-        super().__init__(host,
-                         DEPTH_STREAM_PORT, DEPTH_UDP_PORT, RM_STREAM_HEADER_FORMAT, RM_FRAME_STREAM_HEADER,
-                         DEPTH_REQUEST_TIMEOUT, sensor_name="DEPTH")
+    def __init__(self, host, camera="LT"):
+        # "LT" receives the Long Throw depth stream, "AHAT" the AHAT one. Both
+        # can run at the same time.
+        if camera == "AHAT":
+            super().__init__(host,
+                             AHAT_STREAM_PORT, AHAT_UDP_PORT, FRAME_HEADER_FORMAT, FRAME_HEADER,
+                             DEPTH_REQUEST_TIMEOUT, DEPTH_REQUEST_WINDOW, sensor_name="DEPTH_AHAT",
+                             stream_id=AHAT_STREAM_ID)
+        else:
+            super().__init__(host,
+                             DEPTH_STREAM_PORT, DEPTH_UDP_PORT, FRAME_HEADER_FORMAT, FRAME_HEADER,
+                             DEPTH_REQUEST_TIMEOUT, DEPTH_REQUEST_WINDOW, sensor_name="DEPTH",
+                             stream_id=DEPTH_STREAM_ID)
 
         self.latest_depth_frame = None
         self.latest_ab_frame = None
 
 
-    def listen(self):
-        count = 0
-        start = time.time()
-
-
-        while True:
-            # self.req_next_frame()
-
-            ret = self.get_data_from_socket()
-
-            if ret is not None:
-                # Mutex used so that the header and latest frame always match
-                # when read by the other thread
-                with self.lock:
-                    self.latest_header, depth_data, ab_data = ret
-                    self.latest_depth_frame = np.frombuffer(depth_data, dtype=np.uint16).reshape((self.latest_header.ImageHeight,
-                                                                                    self.latest_header.ImageWidth))
-                    self.latest_ab_frame = np.frombuffer(ab_data, dtype=np.uint16).reshape((self.latest_header.ImageHeight,
-                                                                                    self.latest_header.ImageWidth))
-
-                end = time.time()
-                count += 1
-                if (end-start) > FPS_PRINT_INTERVAL:
-                    print(self.sensor_name, "receive FPS: ", count / (end-start))
-                    count = 0
-                    start = time.time()
-                                                                                        
-            else:
-                self.req_next_frame()
-
-
-            if self.should_stop:
-                return
+    def store_frame(self, ret):
+        # Mutex used so that the header and latest frame always match
+        # when read by the other thread
+        with self.lock:
+            self.latest_header, depth_data, ab_data = ret
+            self.latest_depth_frame = np.frombuffer(depth_data, dtype=np.uint16).reshape((self.latest_header.ImageHeight,
+                                                                            self.latest_header.ImageWidth))
+            self.latest_ab_frame = np.frombuffer(ab_data, dtype=np.uint16).reshape((self.latest_header.ImageHeight,
+                                                                            self.latest_header.ImageWidth))
 
     def get_mat_from_header(self, header):
-        rig_to_world_transform = np.array(header[5:22]).reshape((4, 4)).T
+        rig_to_world_transform = np.array(header[FRAME_HEADER_TRANSFORM_INDEX:FRAME_HEADER_TRANSFORM_INDEX + 16]).reshape((4, 4)).T
         return rig_to_world_transform
 
 
-    def get_data_from_socket(self, debug=False):
-        # THIS METHOD IS OVERRIDING THE FrameReceiverThread method
-
-        # read image header
-        reply = self.recvall(self.header_size, timeout=self.req_resend_timeout)
-        
-        if reply is None:
-            # reply is None if self.recvall timed out
-            # print(self.sensor_name, ": Header Timeout")
-
-            return None
-
-        data = struct.unpack(self.header_format, reply)
-        header = self.header_data(*data)
+    def decode_payload(self, header, image_data):
         image_size_bytes = header.ImageHeight * header.RowStride
 
-        # read the image
-        image_data = self.recvall(header.BufLen, timeout=SOCKET_RESTART_TIMEOUT)
-        
-        
-        if image_data is None:
-            print(self.sensor_name, ": Image Timeout")
-
-            global should_restart_sockets
-            should_restart_sockets = True
-            return None
+        encoding = header.Codec
+        if encoding == hl2_codecs.ENCODING_RVL:
+            image_data = hl2_codecs.decode_depth_ab_rvl(image_data, header.ImageHeight * header.ImageWidth)
+        elif encoding == hl2_codecs.ENCODING_PACKED12:
+            image_data = hl2_codecs.decode_depth_ab_packed12(image_data, header.ImageHeight * header.ImageWidth)
+        elif encoding == hl2_codecs.ENCODING_DELTA_LZ4:
+            image_data = self.decode_temporal(image_data, 2 * image_size_bytes)
+            if image_data is None:
+                return None
+        elif encoding == hl2_codecs.ENCODING_LZ4:
+            image_data = hl2_codecs.decode_lz4(image_data, 2 * image_size_bytes)
 
         # print("BufLen", self.sensor_name, header.BufLen)
 
@@ -363,102 +598,219 @@ class VLC_ReceiverThread(FrameReceiverThread):
 
         if camera == "LF":
             super().__init__(host,
-                         LEFT_FRONT_STREAM_PORT, LEFT_FRONT_UDP_PORT, RM_STREAM_HEADER_FORMAT,
-                         RM_FRAME_STREAM_HEADER, VLC_REQUEST_TIMEOUT, sensor_name="VLC_LF")
+                         LEFT_FRONT_STREAM_PORT, LEFT_FRONT_UDP_PORT, FRAME_HEADER_FORMAT,
+                         FRAME_HEADER, VLC_REQUEST_TIMEOUT, VLC_REQUEST_WINDOW, sensor_name="VLC_LF",
+                         stream_id=LEFT_FRONT_STREAM_ID)
                          
         elif camera == "RF":
             super().__init__(host,
-                         RIGHT_FRONT_STREAM_PORT, RIGHT_FRONT_UDP_PORT, RM_STREAM_HEADER_FORMAT,
-                         RM_FRAME_STREAM_HEADER, VLC_REQUEST_TIMEOUT, sensor_name="VLC_RF")
+                         RIGHT_FRONT_STREAM_PORT, RIGHT_FRONT_UDP_PORT, FRAME_HEADER_FORMAT,
+                         FRAME_HEADER, VLC_REQUEST_TIMEOUT, VLC_REQUEST_WINDOW, sensor_name="VLC_RF",
+                         stream_id=RIGHT_FRONT_STREAM_ID)
+
+        elif camera == "LL":
+            super().__init__(host,
+                         LEFT_LEFT_STREAM_PORT, LEFT_LEFT_UDP_PORT, FRAME_HEADER_FORMAT,
+                         FRAME_HEADER, VLC_REQUEST_TIMEOUT, VLC_REQUEST_WINDOW, sensor_name="VLC_LL",
+                         stream_id=LEFT_LEFT_STREAM_ID)
+
+        elif camera == "RR":
+            super().__init__(host,
+                         RIGHT_RIGHT_STREAM_PORT, RIGHT_RIGHT_UDP_PORT, FRAME_HEADER_FORMAT,
+                         FRAME_HEADER, VLC_REQUEST_TIMEOUT, VLC_REQUEST_WINDOW, sensor_name="VLC_RR",
+                         stream_id=RIGHT_RIGHT_STREAM_ID)
 
         else:
-            print("Only LF and RF cameras implemented")
+            print("Only LF, RF, LL and RR cameras implemented")
 
 
-    def listen(self):
-        count = 0
-        start = time.time()
+    def store_frame(self, ret):
+        # Mutex used so that the header and latest frame always match
+        # when read by the other thread
+        with self.lock:
+            self.latest_header, image_data = ret
+            self.latest_frame = np.frombuffer(image_data, dtype=np.uint8).reshape((self.latest_header.ImageHeight,
+                                                                                    self.latest_header.ImageWidth))
 
+    def get_mat_from_header(self, header):
+        rig_to_world_transform = np.array(header[FRAME_HEADER_TRANSFORM_INDEX:FRAME_HEADER_TRANSFORM_INDEX + 16]).reshape((4, 4)).T
+        return rig_to_world_transform
 
-        while True:
-            # self.req_next_frame()
-            ret = self.get_data_from_socket()
 
-            if ret is not None:
-                # Mutex used so that the header and latest frame always match
-                # when read by the other thread
-                with self.lock:
-                    self.latest_header, image_data = ret
-                    self.latest_frame = np.frombuffer(image_data, dtype=np.uint8).reshape((self.latest_header.ImageHeight,
-                                                                                            self.latest_header.ImageWidth))
-
-                end = time.time()
-                count += 1
-                if (end-start) > FPS_PRINT_INTERVAL:
-                    print(self.sensor_name, "receive FPS: ", count / (end-start))
-                    count = 0
-                    start = time.time()
-            
-            else:
-                self.req_next_frame()
+    def decode_payload(self, header, image_data):
+        # max_uncompressed_size = 640*480 * 2
+        # pass_1 = lz4.block.decompress(image_data, uncompressed_size=max_uncompressed_size)
+        # qoi_image = lz4.block.decompress(pass_1, uncompressed_size=max_uncompressed_size)
+        # vlc_decoded = qoi.decode(qoi_image)
 
+        encoding = header.Codec
+        if encoding == hl2_codecs.ENCODING_DELTA_LZ4:
+            image_data = self.decode_temporal(image_data, header.ImageHeight * header.RowStride)
+            if image_data is None:
+                return None
+        elif encoding == hl2_codecs.ENCODING_LZ4:
+            image_data = hl2_codecs.decode_lz4(image_data, header.ImageHeight * header.RowStride)
+
+        vlc_decoded = image_data
+
+
+        # print("BufLen", self.sensor_name, header.BufLen)
+        # print("vlc_decoded shape", vlc_decoded.shape, vlc_decoded.shape[1] * vlc_decoded.shape[2] * vlc_decoded.shape[0])
+
+        return header, vlc_decoded
+
+
+
+class StereoReceiverThread(VLC_ReceiverThread):
+    # LF and RF frames paired on the HoloLens, one frame with the right image
+    # below the left one, the left timestamp and one rig pose
+    def __init__(self, host):
+        FrameReceiverThread.__init__(self, host,
+                                     STEREO_STREAM_PORT, STEREO_UDP_PORT, FRAME_HEADER_FORMAT,
+                                     FRAME_HEADER, VLC_REQUEST_TIMEOUT, VLC_REQUEST_WINDOW, sensor_name="VLC_STEREO",
+                                     stream_id=STEREO_STREAM_ID)
+        self.latest_left_frame = None
+        self.latest_right_frame = None
+
+    def store_frame(self, ret):
+        with self.lock:
+            self.latest_header, image_data = ret
+            self.latest_frame = np.frombuffer(image_data, dtype=np.uint8).reshape((self.latest_header.ImageHeight,
+                                                                                    self.latest_header.ImageWidth))
+            self.latest_left_frame, self.latest_right_frame = np.split(self.latest_frame, 2)
 
-            if self.should_stop:
-                return
+
+class ImuReceiverThread(FrameReceiverThread):
+    # Receives the accelerometer, gyroscope and magnetometer samples. Unlike
+    # the cameras, every sample counts: the decoded blocks queue up until
+    # pop_samples takes them.
+
+    def __init__(self, host):
+        super().__init__(host, IMU_STREAM_PORT, IMU_UDP_PORT, FRAME_HEADER_FORMAT,
+                         FRAME_HEADER, IMU_REQUEST_TIMEOUT, IMU_REQUEST_WINDOW, sensor_name="IMU",
+                         stream_id=IMU_STREAM_ID)
+
+        self.blocks = {kind: deque(maxlen=IMU_MAX_BUFFERED_BLOCKS)
+                       for kind in (hl2_codecs.IMU_ACCEL, hl2_codecs.IMU_GYRO, hl2_codecs.IMU_MAG)}
+        self.latest_temperature = {}
+
+    def store_frame(self, ret):
+        with self.lock:
+            self.latest_header, blocks = ret
+            for kind, timestamps, values, temperature in blocks:
+                self.blocks[kind].append((timestamps, values))
+                self.latest_temperature[kind] = temperature
+
+    def pop_samples(self, kind):
+        # All samples of one sensor (hl2_codecs.IMU_ACCEL, IMU_GYRO or
+        # IMU_MAG) received since the last call: int64 timestamps on the clock
+        # of the camera frame timestamps and float32 values of shape (n, 3).
+        with self.lock:
+            blocks = list(self.blocks[kind])
+            self.blocks[kind].clear()
+        if not blocks:
+            return np.empty(0, dtype=np.int64), np.empty((0, 3), dtype=np.float32)
+        return np.concatenate([block[0] for block in blocks]), np.concatenate([block[1] for block in blocks])
 
     def get_mat_from_header(self, header):
-        rig_to_world_transform = np.array(header[5:22]).reshape((4, 4)).T
+        rig_to_world_transform = np.array(header[FRAME_HEADER_TRANSFORM_INDEX:FRAME_HEADER_TRANSFORM_INDEX + 16]).reshape((4, 4)).T
         return rig_to_world_transform
 
+    def decode_payload(self, header, image_data):
+        if header.Codec != hl2_codecs.ENCODING_IMU_BATCH:
+            # still a message in flight
+            self.return_credit()
+            return None
+        return header, hl2_codecs.decode_imu_batch(image_data, header.Timestamp)
 
-    def get_data_from_socket(self, debug=False):
-        # read image header
-        reply = self.recvall(self.header_size, timeout=self.req_resend_timeout)
 
-        if reply is None:
-            # reply is None if self.recvall timed out
-            # print(self.sensor_name, ": Header Timeout")
+class MultiplexedReceiver:
+    # Receives the frames of all sensors over the single connection of the
+    # HoloLens' MultiplexedStreamTransport and hands each one to the receiver
+    # registered for its stream id. Offers the same start_socket /
+    # start_listen / stop interface as a FrameReceiverThread.
 
-            return None
+    def __init__(self, host, receivers):
+        self.host = host
+        self.port = MUX_STREAM_PORT
+        self.udp_port = MUX_UDP_PORT
+        self.socket = None
+        self.udp_socket = None
+        self.should_stop = False
 
-        data = struct.unpack(self.header_format, reply)
-        header = self.header_data(*data)
-        image_size_bytes = header.ImageHeight * header.RowStride
+        self.receivers = {}
+        for receiver in receivers:
+            receiver.mux = self
+            self.receivers[receiver.stream_id] = receiver
 
-        # read the image
-        image_data = self.recvall(header.BufLen, timeout=SOCKET_RESTART_TIMEOUT)
+    def send_request(self, stream_id, request):
+        self.udp_socket.sendto(bytes(str(stream_id) + ":" + request + "\n", "utf-8"), (self.host, self.udp_port))
 
-        if image_data is None:
-            print(self.sensor_name, ": Image Timeout")
+    def start_socket(self):
+        self.socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.socket.setsockopt(socket.SOL_TCP, socket.TCP_QUICKACK, 1)
+        self.socket.connect((self.host, self.port))
 
-            global should_restart_sockets
-            should_restart_sockets = True
-            return None
-        
+        print('INFO: Multiplexed socket connected to ' + self.host + ' on port ' + str(self.port))
 
-        # max_uncompressed_size = 640*480 * 2
-        # pass_1 = lz4.block.decompress(image_data, uncompressed_size=max_uncompressed_size)
-        # qoi_image = lz4.block.decompress(pass_1, uncompressed_size=max_uncompressed_size)
-        # vlc_decoded = qoi.decode(qoi_image)
+        self.udp_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM) # UDP
 
-        vlc_decoded = image_data
+        for receiver in self.receivers.values():
+            receiver.reset_credits()
 
+    def start_listen(self):
+        self.should_stop = False
+        t = threading.Thread(target=self.listen)
+        t.daemon = True
+        t.start()
 
-        # print("BufLen", self.sensor_name, header.BufLen)
-        # print("vlc_decoded shape", vlc_decoded.shape, vlc_decoded.shape[1] * vlc_decoded.shape[2] * vlc_decoded.shape[0])
+        self.listen_thread = t
 
-        return header, vlc_decoded
+    def stop(self):
+        self.should_stop = True
+        self.listen_thread.join()
+        self.socket.shutdown(socket.SHUT_RDWR)
+        self.socket.close()
 
+    def listen(self):
+        timeout = min(receiver.req_resend_timeout for receiver in self.receivers.values())
+
+        while True:
+            reply = recvall(self.socket, MUX_HEADER_SIZE, timeout=timeout)
+
+            if reply is not None:
+                stream_id, sequence, length = struct.unpack(MUX_HEADER_FORMAT, reply)
+                message = recvall(self.socket, length, timeout=SOCKET_RESTART_TIMEOUT)
 
+                if message is None:
+                    print("MULTIPLEXED : Message Timeout")
 
+                    global should_restart_sockets
+                    should_restart_sockets = True
+
+                elif stream_id in self.receivers:
+                    self.receivers[stream_id].handle_message(message)
+
+            # streams that went quiet get their window granted again
+            for receiver in self.receivers.values():
+                receiver.req_next_frame()
+
+            if self.should_stop:
+                return
 
 
 
 class HololensReceiver:
 
-    def __init__(self, ip_address, cameras_to_stream):
+    def __init__(self, ip_address, cameras_to_stream, multiplexed=False, record_dir=None, record_frames=None,
+                 native=False, stream_imu=False, bundle_window_ms=None):
         
-        STREAM_VIDEO, STREAM_DEPTH, STREAM_FRONT_LEFT, STREAM_FRONT_RIGHT = cameras_to_stream
+        # (video, depth, front left, front right), optionally followed by
+        # (left left, right right, AHAT depth, front stereo pairs). depth is
+        # Long Throw.
+        cameras_to_stream = tuple(cameras_to_stream) + (False,) * (8 - len(cameras_to_stream))
+        (STREAM_VIDEO, STREAM_DEPTH, STREAM_FRONT_LEFT, STREAM_FRONT_RIGHT, STREAM_LEFT_LEFT, STREAM_RIGHT_RIGHT,
+         STREAM_AHAT, STREAM_STEREO) = cameras_to_stream
         
         self.receiver_list = []
 
@@ -471,6 +823,10 @@ class HololensReceiver:
             self.depth_receiver = DepthReceiverThread(ip_address)
             self.receiver_list.append(self.depth_receiver)
 
+        if STREAM_AHAT:
+            self.ahat_receiver = DepthReceiverThread(ip_address, camera="AHAT")
+            self.receiver_list.append(self.ahat_receiver)
+
         if STREAM_FRONT_LEFT:
             self.front_left_receiver = VLC_ReceiverThread(ip_address, camera="LF")
             self.receiver_list.append(self.front_left_receiver)
@@ -479,8 +835,56 @@ class HololensReceiver:
             self.front_right_receiver = VLC_ReceiverThread(ip_address, camera="RF")
             self.receiver_list.append(self.front_right_receiver)
 
+        if STREAM_LEFT_LEFT:
+            self.left_left_receiver = VLC_ReceiverThread(ip_address, camera="LL")
+            self.receiver_list.append(self.left_left_receiver)
+
+        if STREAM_RIGHT_RIGHT:
+            self.right_right_receiver = VLC_ReceiverThread(ip_address, camera="RR")
+            self.receiver_list.append(self.right_right_receiver)
+
+        if STREAM_STEREO:
+            self.stereo_receiver = StereoReceiverThread(ip_address)
+            self.receiver_list.append(self.stereo_receiver)
+
+        if stream_imu:
+            self.imu_receiver = ImuReceiverThread(ip_address)
+            self.receiver_list.append(self.imu_receiver)
+
         # self.receiver_list = [self.video_receiver, self.depth_receiver, self.front_left_receiver, self.front_right_receiver]
 
+        # the first record_frames frames of every stream (all if None) go to
+        # record_dir as a corpus for Benchmarks/CodecBench
+        self.recorders = []
+        if record_dir is not None:
+            for receiver in self.receiver_list:
+                # the corpus is for the image codecs
+                if receiver.stream_id == IMU_STREAM_ID:
+                    continue
+                receiver.recorder = FrameRecorder(record_dir, receiver.sensor_name, receiver.stream_id, record_frames)
+                self.recorders.append(receiver.recorder)
+
+        # With bundle_window_ms the camera frames are taken with next_bundle,
+        # one of every camera at a time with timestamps at most that far
+        # apart; the IMU samples still come with pop_samples.
+        self.bundled = []
+        self.bundle_window_ticks = 0
+        if bundle_window_ms is not None:
+            if not native:
+                raise ValueError("Frame bundles need the native receiver (native=True)")
+            self.bundled = [receiver for receiver in self.receiver_list if receiver.stream_id != IMU_STREAM_ID]
+            # header timestamps are in 100 ns ticks
+            self.bundle_window_ticks = int(bundle_window_ms * 10000)
+
+        if native:
+            # frames are received by the native library, the sensor
+            # receivers only decode
+            self.receiver_list = [NativeReceiver(ip_address, self.receiver_list, multiplexed,
+                                                 MUX_STREAM_PORT, MUX_UDP_PORT, self.bundled)]
+        elif multiplexed:
+            # the sensor receivers only decode, one connection carries them all
+            self.receiver_list = [MultiplexedReceiver(ip_address, self.receiver_list)]
+
 
         self.is_connected = False
 
@@ -516,6 +920,48 @@ class HololensReceiver:
                 self.is_connected = False
                 return
 
+    def next_bundle(self, timeout=None):
+        # Blocks until the next bundle, up to timeout seconds. Returns
+        # {sensor_name: (header, image parts...)} as decode_payload returns
+        # them, with the latest frames updated as well, or None on timeout or
+        # once the connection is lost (restart_sockets reconnects). Frames
+        # without partners are skipped; a skipped TemporalDelta frame breaks
+        # the delta chain of its stream until the next keyframe.
+        global should_restart_sockets
+        if not self.bundled:
+            raise ValueError("Frame bundles are off, pass bundle_window_ms")
+
+        deadline = None if timeout is None else time.time() + timeout
+        while True:
+            remaining = NATIVE_POLL_TIMEOUT_MS if deadline is None else \
+                int(max(0.0, min(NATIVE_POLL_TIMEOUT_MS / 1000.0, deadline - time.time())) * 1000)
+            native = self.receiver_list[0]
+            try:
+                frames = native.next_bundle(self.bundle_window_ticks, remaining)
+            except ConnectionError:
+                if native.native is None:
+                    # still connecting
+                    time.sleep(remaining / 1000.0)
+                    frames = None
+                else:
+                    should_restart_sockets = True
+                    return None
+
+            if frames is not None:
+                decoded = []
+                for receiver, (header_bytes, image_data) in zip(self.bundled, frames):
+                    header = read_frame_header(header_bytes)
+                    decoded.append(receiver.decode_payload(header, image_data[:header.BufLen]))
+                if all(ret is not None for ret in decoded):
+                    for receiver, ret in zip(self.bundled, decoded):
+                        receiver.record_frame(ret)
+                        receiver.store_frame(ret)
+                        receiver.count_frame()
+                    return {receiver.sensor_name: ret for receiver, ret in zip(self.bundled, decoded)}
+
+            if deadline is not None and time.time() >= deadline:
+                return None
+
     def _restart_sockets(self):
         print("Attempting to restart sockets...")
         for receiver in self.receiver_list:
@@ -545,4 +991,7 @@ class HololensReceiver:
     
     def close_all_sockets(self):
         for receiver in self.receiver_list:
-            receiver.stop() 
\ No newline at end of file
+            receiver.stop()
+
+        for recorder in self.recorders:
+            recorder.close() 
\ No newline at end of file
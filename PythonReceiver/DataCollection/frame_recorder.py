@@ -0,0 +1,63 @@
+# Records the decoded frames of one stream into a corpus file for
+# Benchmarks/CodecBench, which runs every packing and codec path of the plugin
+# on them off-device.
+#
+# A corpus file holds the raw payloads (what an unencoded frame would carry),
+# whatever encoding they arrived in:
+#
+#   "HL2R"   magic
+#   uint32   version (1)
+#   uint32   stream id (0 PV, 1 Long Throw, 2 left front, 3 right front,
+#            5 left left, 6 right right, 7 AHAT, 8 front stereo)
+#   frames:
+#     int64  timestamp
+#     uint32 width, height, pixel stride, row stride
+#     uint32 payload size
+#     payload
+#
+# Everything is little-endian. Long Throw frames lose their sigma image on the
+# way (invalid depth pixels are already zero), so do PV frames their alpha
+# channel and any downscaling.
+
+import os
+import struct
+import threading
+
+CORPUS_MAGIC = b"HL2R"
+CORPUS_VERSION = 1
+CORPUS_FILE_HEADER_FORMAT = "<4sII"
+CORPUS_FRAME_HEADER_FORMAT = "<qIIIII"
+CORPUS_FILE_EXTENSION = ".hl2rec"
+
+
+class FrameRecorder:
+    def __init__(self, directory, sensor_name, stream_id, max_frames=None):
+        if not os.path.isdir(directory):
+            os.makedirs(directory)
+
+        self.path = os.path.join(directory, sensor_name.lower() + CORPUS_FILE_EXTENSION)
+        self.max_frames = max_frames
+        self.frame_count = 0
+        self.lock = threading.Lock()
+
+        self.file = open(self.path, "wb")
+        self.file.write(struct.pack(CORPUS_FILE_HEADER_FORMAT, CORPUS_MAGIC, CORPUS_VERSION, stream_id))
+
+    def record(self, header, payload):
+        # header is the frame's header as received, its Codec field (offset 10)
+        # is the encoding the payload arrived in; payload is the decoded raw
+        # bytes, so the recorded frame does not depend on it
+        with self.lock:
+            if self.file is None or (self.max_frames is not None and self.frame_count >= self.max_frames):
+                return
+
+            self.file.write(struct.pack(CORPUS_FRAME_HEADER_FORMAT, header.Timestamp, header.ImageWidth,
+                                        header.ImageHeight, header.PixelStride, header.RowStride, len(payload)))
+            self.file.write(payload)
+            self.frame_count += 1
+
+    def close(self):
+        with self.lock:
+            if self.file is not None:
+                self.file.close()
+                self.file = None
@@ -0,0 +1,268 @@
+# Decoders for the compressed payloads of the HoloLens streamer.
+#
+# The payload encoding travels in the Codec field of the frame header (see
+# PayloadEncoding.h and FrameHeader.h in the plugin). The decoders are
+# the plugin's own C++ sources, built as a small shared library:
+#
+#   cmake -S PythonReceiver/native -B PythonReceiver/native/build
+#   cmake --build PythonReceiver/native/build --config Release
+#
+# HL2_CODECS_LIB can point to the library if it lives somewhere else.
+# LZ4 and temporal delta frames only need the lz4 package, tiled QOI frames fall
+# back to the qoi package (one band after the other) without the library.
+
+import ctypes
+import os
+import struct
+import sys
+
+import lz4.block
+import numpy as np
+
+ENCODING_RAW = 0
+ENCODING_RVL = 1
+ENCODING_PACKED12 = 2
+ENCODING_DELTA_LZ4 = 3
+ENCODING_QOI_TILED = 4
+ENCODING_LZ4 = 5
+ENCODING_IMU_BATCH = 6
+
+PACKED12_BIG_ENDIAN_PLANES = 1
+
+DELTA_KEYFRAME = 1
+DELTA_UNCOMPRESSED = 2
+DELTA_DICTIONARY = 4
+DELTA_BAND_SIZE = 32 * 1024
+DELTA_STORED_BAND = 0x80000000
+DELTA_HEADER_FORMAT = "<III"
+DELTA_HEADER_SIZE = struct.calcsize(DELTA_HEADER_FORMAT)
+
+QOI_TILED_MAGIC = b"qoit"
+QOI_TILED_HEADER_FORMAT = "<4sIIBBH"
+QOI_TILED_HEADER_SIZE = struct.calcsize(QOI_TILED_HEADER_FORMAT)
+
+# IMU sample blocks (see ImuPacking.h in the plugin)
+IMU_ACCEL = 0
+IMU_GYRO = 1
+IMU_MAG = 2
+IMU_BLOCK_HEADER_FORMAT = "<BxHff"
+IMU_BLOCK_HEADER_SIZE = struct.calcsize(IMU_BLOCK_HEADER_FORMAT)
+IMU_SAMPLE_DTYPE = np.dtype([("offset", "<u4"), ("value", "<i2", (3,))])
+
+_NATIVE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "native", "build")
+
+_lib = None
+_lib_missing = False
+
+
+def _load(required=True):
+    global _lib, _lib_missing
+    if _lib is not None:
+        return _lib
+    if _lib_missing and not required:
+        return None
+
+    if sys.platform == "win32":
+        names = ["hl2codecs.dll"]
+    elif sys.platform == "darwin":
+        names = ["libhl2codecs.dylib"]
+    else:
+        names = ["libhl2codecs.so"]
+
+    candidates = []
+    if os.environ.get("HL2_CODECS_LIB"):
+        candidates.append(os.environ["HL2_CODECS_LIB"])
+    candidates += [os.path.join(_NATIVE_DIR, name) for name in names]
+
+    for path in candidates:
+        if os.path.exists(path):
+            lib = ctypes.CDLL(path)
+            lib.hl2_decode_depth_ab_rvl.argtypes = [ctypes.c_char_p, ctypes.c_size_t, ctypes.c_size_t, ctypes.c_void_p]
+            lib.hl2_decode_depth_ab_rvl.restype = ctypes.c_int
+            lib.hl2_decode_depth_ab_packed12.argtypes = [ctypes.c_char_p, ctypes.c_size_t, ctypes.c_size_t, ctypes.c_void_p]
+            lib.hl2_decode_depth_ab_packed12.restype = ctypes.c_int
+            lib.hl2_decode_qoi_tiled.argtypes = [ctypes.c_char_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_size_t]
+            lib.hl2_decode_qoi_tiled.restype = ctypes.c_int
+            _lib = lib
+            return _lib
+
+    _lib_missing = True
+    if not required:
+        return None
+    raise RuntimeError("Compressed frames need the native decoders, build PythonReceiver/native "
+                       "(looked for " + ", ".join(candidates) + ")")
+
+
+def decode_depth_ab_rvl(payload, pixel_count):
+    # returns depth + AB in the same byte layout as a raw payload
+    out = ctypes.create_string_buffer(4 * pixel_count)
+    if _load().hl2_decode_depth_ab_rvl(bytes(payload), len(payload), pixel_count, out) != 0:
+        raise ValueError("corrupt RVL depth payload")
+    return bytearray(out.raw)
+
+
+def _unpack12_numpy(data, pixel_count, big_endian):
+    # a | b << 12 in 3 little-endian bytes per pixel pair
+    pairs = np.frombuffer(data, dtype=np.uint8, count=pixel_count // 2 * 3).reshape(-1, 3).astype(np.uint16)
+    values = np.empty(pixel_count, dtype=np.uint16)
+    values[0:pixel_count - 1:2] = pairs[:, 0] | ((pairs[:, 1] & 0x0F) << 8)
+    values[1::2] = (pairs[:, 1] >> 4) | (pairs[:, 2] << 4)
+    if pixel_count % 2:
+        tail = data[pixel_count // 2 * 3:]
+        values[-1] = tail[0] | ((tail[1] & 0x0F) << 8)
+    return values.astype(">u2" if big_endian else "<u2").tobytes()
+
+
+def decode_depth_ab_packed12(payload, pixel_count):
+    # returns depth + AB in the same byte layout as a raw payload. Uses the
+    # native SIMD kernels when they are built, numpy otherwise.
+    lib = _load(required=False)
+    if lib is not None:
+        out = ctypes.create_string_buffer(4 * pixel_count)
+        if lib.hl2_decode_depth_ab_packed12(bytes(payload), len(payload), pixel_count, out) != 0:
+            raise ValueError("truncated 12-bit depth payload")
+        return bytearray(out.raw)
+
+    payload = bytes(payload)
+    flags, = struct.unpack_from("<I", payload)
+    big_endian = (flags & PACKED12_BIG_ENDIAN_PLANES) != 0
+    image_size = pixel_count // 2 * 3 + (pixel_count % 2) * 2
+    if len(payload) < 4 + 2 * image_size:
+        raise ValueError("truncated 12-bit depth payload")
+
+    depth = _unpack12_numpy(payload[4:4 + image_size], pixel_count, big_endian)
+    ab = _unpack12_numpy(payload[4 + image_size:4 + 2 * image_size], pixel_count, big_endian)
+    return bytearray(depth + ab)
+
+
+def decode_lz4(payload, raw_size):
+    # returns the raw payload of an LZ4 frame
+    try:
+        out = lz4.block.decompress(bytes(payload), uncompressed_size=raw_size)
+    except lz4.block.LZ4BlockError:
+        raise ValueError("corrupt LZ4 payload")
+    if len(out) != raw_size:
+        raise ValueError("corrupt LZ4 payload")
+    return bytearray(out)
+
+
+def decode_qoi_tiled(payload, raw_size):
+    # returns the image in the raw payload layout (raw_size bytes). The native
+    # library decodes the bands in parallel, the qoi package one by one.
+    payload = bytes(payload)
+    lib = _load(required=False)
+    if lib is not None:
+        out = ctypes.create_string_buffer(raw_size)
+        if lib.hl2_decode_qoi_tiled(payload, len(payload), out, raw_size) != 0:
+            raise ValueError("corrupt tiled QOI payload")
+        return bytearray(out.raw)
+
+    import qoi
+
+    if len(payload) < QOI_TILED_HEADER_SIZE:
+        raise ValueError("truncated tiled QOI payload")
+    magic, width, height, channels, _, band_count = struct.unpack_from(QOI_TILED_HEADER_FORMAT, payload)
+    if magic != QOI_TILED_MAGIC or width * height * channels != raw_size or band_count == 0:
+        raise ValueError("corrupt tiled QOI payload")
+    offsets = struct.unpack_from("<%dI" % (band_count + 1), payload, QOI_TILED_HEADER_SIZE)
+    data = payload[QOI_TILED_HEADER_SIZE + 4 * (band_count + 1):]
+
+    out = bytearray()
+    for band in range(band_count):
+        if offsets[band + 1] > offsets[band]:
+            out += qoi.decode(data[offsets[band]:offsets[band + 1]]).tobytes()
+    if len(out) != raw_size:
+        raise ValueError("corrupt tiled QOI payload")
+    return out
+
+
+def decode_imu_batch(payload, timestamp):
+    # returns a list of (kind, timestamps, values, temperature) blocks:
+    # int64 sample times on the clock of the header timestamp, float32
+    # values of shape (count, 3) and the mean temperature (NaN for the
+    # magnetometer)
+    blocks = []
+    pos = 0
+    while pos < len(payload):
+        if len(payload) - pos < IMU_BLOCK_HEADER_SIZE:
+            raise ValueError("truncated IMU payload")
+        kind, count, scale, temperature = struct.unpack_from(IMU_BLOCK_HEADER_FORMAT, payload, pos)
+        pos += IMU_BLOCK_HEADER_SIZE
+        if kind > IMU_MAG or len(payload) - pos < count * IMU_SAMPLE_DTYPE.itemsize:
+            raise ValueError("corrupt IMU payload")
+
+        samples = np.frombuffer(payload, dtype=IMU_SAMPLE_DTYPE, count=count, offset=pos)
+        pos += count * IMU_SAMPLE_DTYPE.itemsize
+        timestamps = samples["offset"].astype(np.int64) + timestamp
+        values = samples["value"].astype(np.float32) * np.float32(scale)
+        blocks.append((kind, timestamps, values, temperature))
+    return blocks
+
+
+class TemporalDecoder:
+    # Reconstructs ENCODING_DELTA_LZ4 frames (see TemporalCodec.h in the
+    # plugin). A delta frame is either the XOR of the frame with its
+    # predecessor, or LZ4 bands with the bands of the predecessor as
+    # dictionaries (DELTA_DICTIONARY).
+
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        self.reference = None
+        self.sequence = 0
+
+    def decode(self, payload, raw_size):
+        # returns the raw payload, or None if the frame does not follow the
+        # reference; the sender has to send a keyframe then
+        payload = bytes(payload)
+        if len(payload) < DELTA_HEADER_SIZE:
+            raise ValueError("truncated delta payload")
+        flags, sequence, size = struct.unpack_from(DELTA_HEADER_FORMAT, payload)
+        keyframe = (flags & DELTA_KEYFRAME) != 0
+
+        if size != raw_size or (not keyframe and (self.reference is None or
+                                                   sequence != (self.sequence + 1) & 0xFFFFFFFF)):
+            self.reference = None
+            return None
+
+        data = payload[DELTA_HEADER_SIZE:]
+        if flags & DELTA_DICTIONARY:
+            frame = self._decode_bands(data, size, keyframe)
+            self.reference = frame
+            self.sequence = sequence
+            return bytearray(frame)
+
+        if flags & DELTA_UNCOMPRESSED:
+            data = data[:size]
+        else:
+            data = lz4.block.decompress(data, uncompressed_size=size)
+        if len(data) != size:
+            raise ValueError("truncated delta payload")
+
+        frame = np.frombuffer(data, dtype=np.uint8)
+        if not keyframe:
+            frame = np.bitwise_xor(frame, self.reference)
+        self.reference = frame
+        self.sequence = sequence
+        return bytearray(frame.tobytes())
+
+    def _decode_bands(self, data, size, keyframe):
+        bands = []
+        pos = 0
+        for offset in range(0, size, DELTA_BAND_SIZE):
+            band_size = min(DELTA_BAND_SIZE, size - offset)
+            word, = struct.unpack_from("<I", data, pos)
+            pos += 4
+            length = word & ~DELTA_STORED_BAND
+            block = data[pos:pos + length]
+            pos += length
+            if word & DELTA_STORED_BAND:
+                band = block
+            else:
+                dictionary = b"" if keyframe else self.reference[offset:offset + band_size]
+                band = lz4.block.decompress(block, uncompressed_size=band_size, dict=dictionary)
+            if len(band) != band_size:
+                raise ValueError("truncated delta payload")
+            bands.append(band)
+        return b"".join(bands)
@@ -0,0 +1,276 @@
+# Receives the frames of the HoloLens streams in the native library
+# (FrameReceiver in PythonReceiver/native, built together with the codecs).
+#
+# An I/O thread outside the GIL reads every frame straight into a ring of
+# preallocated slots and returns its credit. Python gets the payload as a
+# numpy array over the slot memory, without a copy; the slot goes back to the
+# ring once the last array referring to it is gone.
+#
+# The slots are also indexed by frame timestamp: next_bundle takes one frame
+# of each of several streams, captured at about the same time, in one call.
+
+import ctypes
+import threading
+import weakref
+
+import numpy as np
+
+from DataCollection import hl2_codecs
+
+# frames each stream can have queued or held by Python at once; the decoded
+# latest frame of every sensor keeps one of them
+NATIVE_SLOT_COUNT = 8
+
+# for streams read with next_bundle; a fast stream queues its frames while
+# waiting for a slow one (30 Hz PV for 5 Hz Long Throw: 6 frames and more)
+NATIVE_BUNDLE_SLOT_COUNT = 16
+
+# how long next_frame blocks before the listen loop checks should_stop
+NATIVE_POLL_TIMEOUT_MS = 100
+
+# header and payload; a frame announcing more closes the connection, the byte
+# stream is corrupt (a raw PV frame is 8 MB, its tiled QOI bound 10 MB)
+NATIVE_MAX_FRAME_SIZE = 64 * 1024 * 1024
+
+
+class hl2_frame(ctypes.Structure):
+    _fields_ = [
+        ("header", ctypes.c_void_p),
+        ("header_size", ctypes.c_size_t),
+        ("payload", ctypes.c_void_p),
+        ("payload_size", ctypes.c_size_t),
+        ("slot", ctypes.c_uint32),
+    ]
+
+
+_lib = None
+
+
+def _load():
+    global _lib
+    if _lib is not None:
+        return _lib
+
+    lib = hl2_codecs._load()
+    if not hasattr(lib, "hl2_receiver_create"):
+        raise RuntimeError("The native library was built without the frame receiver, rebuild PythonReceiver/native")
+
+    lib.hl2_receiver_create.argtypes = []
+    lib.hl2_receiver_create.restype = ctypes.c_void_p
+    lib.hl2_receiver_destroy.argtypes = [ctypes.c_void_p]
+    lib.hl2_receiver_destroy.restype = None
+    lib.hl2_receiver_add_stream.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_size_t, ctypes.c_uint32,
+                                            ctypes.c_uint32, ctypes.c_size_t]
+    lib.hl2_receiver_add_stream.restype = ctypes.c_int
+    lib.hl2_receiver_connect_stream.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_char_p, ctypes.c_uint16,
+                                                ctypes.c_uint16]
+    lib.hl2_receiver_connect_stream.restype = ctypes.c_int
+    lib.hl2_receiver_connect_multiplexed.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint16,
+                                                     ctypes.c_uint16]
+    lib.hl2_receiver_connect_multiplexed.restype = ctypes.c_int
+    lib.hl2_receiver_start.argtypes = [ctypes.c_void_p]
+    lib.hl2_receiver_start.restype = ctypes.c_int
+    lib.hl2_receiver_stop.argtypes = [ctypes.c_void_p]
+    lib.hl2_receiver_stop.restype = None
+    lib.hl2_receiver_send_request.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_char_p]
+    lib.hl2_receiver_send_request.restype = ctypes.c_int
+    lib.hl2_receiver_next.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint32, ctypes.POINTER(hl2_frame)]
+    lib.hl2_receiver_next.restype = ctypes.c_int
+    lib.hl2_receiver_next_bundle.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint32), ctypes.c_uint32,
+                                             ctypes.c_uint64, ctypes.c_uint32, ctypes.POINTER(hl2_frame)]
+    lib.hl2_receiver_next_bundle.restype = ctypes.c_int
+    lib.hl2_receiver_release.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint32]
+    lib.hl2_receiver_release.restype = None
+    lib.hl2_receiver_stats.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.POINTER(ctypes.c_uint64),
+                                       ctypes.POINTER(ctypes.c_uint64), ctypes.POINTER(ctypes.c_uint64)]
+    lib.hl2_receiver_stats.restype = ctypes.c_int
+    _lib = lib
+    return _lib
+
+
+class ReceiverHandle:
+    # One native receiver. Destroyed once it is closed and every frame taken
+    # from it has been released, whichever comes last.
+
+    def __init__(self):
+        self.lib = _load()
+        self.handle = self.lib.hl2_receiver_create()
+        if self.handle is None:
+            raise MemoryError("Could not create the native receiver")
+        self.lock = threading.Lock()
+        self.held = 0
+        self.closed = False
+
+    def take(self):
+        with self.lock:
+            self.held += 1
+
+    def enter(self):
+        # keeps the receiver alive during a call from a thread stop does not
+        # join, False if it is already destroyed
+        with self.lock:
+            if self.handle is None:
+                return False
+            self.held += 1
+            return True
+
+    def leave(self):
+        with self.lock:
+            self.held -= 1
+            self._destroy_if_done()
+
+    def release(self, stream_id, slot):
+        with self.lock:
+            self.lib.hl2_receiver_release(self.handle, stream_id, slot)
+            self.held -= 1
+            self._destroy_if_done()
+
+    def stop(self):
+        # ends the connections, a blocked next_frame returns
+        self.lib.hl2_receiver_stop(self.handle)
+
+    def close(self):
+        # after stop, once no thread waits in next_frame any more
+        with self.lock:
+            self.closed = True
+            self._destroy_if_done()
+
+    def _destroy_if_done(self):
+        if self.closed and self.held == 0 and self.handle is not None:
+            self.lib.hl2_receiver_destroy(self.handle)
+            self.handle = None
+
+
+class NativeReceiver:
+    # Receives the frames of the given FrameReceiverThreads, on their own
+    # ports or over the multiplexed transport, and hands them to each
+    # receiver's listen_native loop. Offers the same start_socket /
+    # start_listen / stop interface as a FrameReceiverThread. The frames of
+    # the bundled receivers are not listened for, they are taken with
+    # next_bundle.
+
+    def __init__(self, host, receivers, multiplexed=False, mux_port=None, mux_udp_port=None, bundled=()):
+        self.host = host
+        self.multiplexed = multiplexed
+        self.mux_port = mux_port
+        self.mux_udp_port = mux_udp_port
+        self.receivers = list(receivers)
+        self.bundled = [receiver for receiver in self.receivers if receiver in bundled]
+        self.listened = [receiver for receiver in self.receivers if receiver not in bundled]
+        self.native = None
+
+        for receiver in self.receivers:
+            receiver.native = self
+
+    def start_socket(self):
+        # a restart gets a fresh receiver, frames still held keep the old
+        # one alive until they are released
+        native = ReceiverHandle()
+        try:
+            self._start(native)
+        except Exception:
+            native.stop()
+            native.close()
+            raise
+        self.native = native
+
+    def _start(self, native):
+        host = self.host.encode("utf-8")
+        for receiver in self.receivers:
+            slot_count = NATIVE_BUNDLE_SLOT_COUNT if receiver in self.bundled else NATIVE_SLOT_COUNT
+            if native.lib.hl2_receiver_add_stream(native.handle, receiver.stream_id, slot_count,
+                                                  receiver.req_window, int(receiver.req_resend_timeout * 1000),
+                                                  NATIVE_MAX_FRAME_SIZE) != 0:
+                raise RuntimeError("Could not add stream " + receiver.sensor_name)
+
+        if self.multiplexed:
+            if native.lib.hl2_receiver_connect_multiplexed(native.handle, host, self.mux_port, self.mux_udp_port) != 0:
+                raise ConnectionError("Could not connect to " + self.host + " on port " + str(self.mux_port))
+            print('INFO: Native multiplexed socket connected to ' + self.host + ' on port ' + str(self.mux_port))
+        else:
+            for receiver in self.receivers:
+                if native.lib.hl2_receiver_connect_stream(native.handle, receiver.stream_id, host, receiver.port,
+                                                          receiver.udp_port) != 0:
+                    raise ConnectionError("Could not connect to " + self.host + " on port " + str(receiver.port))
+                print('INFO: Native socket connected to ' + self.host + ' on port ' + str(receiver.port))
+
+        for receiver in self.receivers:
+            # the window reset at start makes the HoloLens begin with a keyframe
+            receiver.temporal_decoder.reset()
+
+        if native.lib.hl2_receiver_start(native.handle) != 0:
+            raise RuntimeError("Could not start the native receiver")
+
+    def start_listen(self):
+        for receiver in self.listened:
+            receiver.start_listen()
+
+    def stop(self):
+        for receiver in self.receivers:
+            receiver.should_stop = True
+        self.native.stop()
+        for receiver in self.listened:
+            receiver.listen_thread.join()
+        self.native.close()
+
+    def send_request(self, stream_id, request):
+        self.native.lib.hl2_receiver_send_request(self.native.handle, stream_id, request.encode("utf-8"))
+
+    def next_frame(self, stream_id, timeout_ms=NATIVE_POLL_TIMEOUT_MS):
+        # returns (header bytes, payload array) for the oldest frame of the
+        # stream, None on timeout. Raises ConnectionError once the
+        # connection is gone.
+        native = self.native
+        frame = hl2_frame()
+        result = native.lib.hl2_receiver_next(native.handle, stream_id, timeout_ms, ctypes.byref(frame))
+        if result == 1:
+            return None
+        if result != 0:
+            raise ConnectionError("native receiver closed")
+
+        return self._wrap(native, stream_id, frame)
+
+    def next_bundle(self, window_ticks, timeout_ms=NATIVE_POLL_TIMEOUT_MS):
+        # returns [(header bytes, payload array)], one frame of every bundled
+        # receiver in their order, with timestamps at most window_ticks
+        # (100 ns) apart, None on timeout. Raises ConnectionError once a
+        # connection is gone.
+        native = self.native
+        if native is None or not native.enter():
+            raise ConnectionError("native receiver closed")
+        count = len(self.bundled)
+        stream_ids = (ctypes.c_uint32 * count)(*[receiver.stream_id for receiver in self.bundled])
+        frames = (hl2_frame * count)()
+        try:
+            result = native.lib.hl2_receiver_next_bundle(native.handle, stream_ids, count, window_ticks, timeout_ms,
+                                                         frames)
+            if result == 0:
+                bundle = [self._wrap(native, receiver.stream_id, frame)
+                          for receiver, frame in zip(self.bundled, frames)]
+        finally:
+            native.leave()
+        if result == 1:
+            return None
+        if result != 0:
+            raise ConnectionError("native receiver closed")
+        return bundle
+
+    @staticmethod
+    def _wrap(native, stream_id, frame):
+        native.take()
+        header = ctypes.string_at(frame.header, frame.header_size)
+        memory = (ctypes.c_uint8 * frame.payload_size).from_address(frame.payload)
+        weakref.finalize(memory, native.release, stream_id, frame.slot)
+        # arrays and slices made from payload keep memory alive
+        payload = np.frombuffer(memory, dtype=np.uint8)
+        return header, payload
+
+    def stats(self, stream_id):
+        # (frames received, frames dropped because Python fell behind, frames
+        # next_bundle found no partners for)
+        received = ctypes.c_uint64()
+        dropped = ctypes.c_uint64()
+        unmatched = ctypes.c_uint64()
+        self.native.lib.hl2_receiver_stats(self.native.handle, stream_id, ctypes.byref(received),
+                                           ctypes.byref(dropped), ctypes.byref(unmatched))
+        return received.value, dropped.value, unmatched.value
@@ -3,6 +3,7 @@ import numpy as np
 
 from DataCollection.utils import *
 from DataCollection.HololensReceiver import HololensReceiver, VLC_ReceiverThread, VideoReceiverThread, DepthReceiverThread
+from DataCollection import hl2_codecs
 
 #########################################################
 # Set the streams that you need to True 
@@ -10,16 +11,52 @@ from DataCollection.HololensReceiver import HololensReceiver, VLC_ReceiverThread
 # which is the depth image (hard to see the raw image)
 STREAM_VIDEO = True
 STREAM_DEPTH = True
+# The AHAT depth stream (near range, high rate), off unless enabled as "Ahat
+# Depth" on the StartStreamer component in Unity. STREAM_DEPTH is Long Throw.
+STREAM_AHAT = False
 STREAM_FRONT_LEFT = True
 STREAM_FRONT_RIGHT = True
+# The side facing grayscale cameras, off unless enabled on the StartStreamer
+# component in Unity ("Left Left", "Right Right").
+STREAM_LEFT_LEFT = False
+STREAM_RIGHT_RIGHT = False
+# The front cameras as stereo pairs matched on the HoloLens, off unless
+# "Front Stereo" is enabled on the StartStreamer component in Unity. The
+# front cameras then do not stream on their own, set STREAM_FRONT_LEFT and
+# STREAM_FRONT_RIGHT to False.
+STREAM_STEREO = False
+
+# Must match "Stream Imu" on the StartStreamer component in Unity.
+STREAM_IMU = False
 
 # Set Hololens IP address
 HOLOLENS_IP = "10.162.35.31"
+
+# Must match "Use Multiplexed Transport" on the StartStreamer component in Unity.
+# All streams then share a single TCP connection and UDP request port.
+USE_MULTIPLEXED_TRANSPORT = False
+
+# Receive the frames in the native library (build PythonReceiver/native first).
+USE_NATIVE_RECEIVER = False
+
+# Set to a window in milliseconds to take the camera frames as time-synchronized
+# bundles, one frame of every enabled camera with timestamps at most this far
+# apart (needs USE_NATIVE_RECEIVER). The windows then show matching frames.
+BUNDLE_WINDOW_MS = None
+
+# Set to a directory to record the received frames as a corpus for
+# Benchmarks/CodecBench (one .hl2rec file per stream, RECORD_FRAMES frames each).
+RECORD_CORPUS_DIR = None
+RECORD_FRAMES = 300
 #########################################################
 
 
 if __name__ == '__main__':
-    hl2_receiver = HololensReceiver(HOLOLENS_IP, (STREAM_VIDEO, STREAM_DEPTH, STREAM_FRONT_LEFT, STREAM_FRONT_RIGHT))
+    hl2_receiver = HololensReceiver(HOLOLENS_IP, (STREAM_VIDEO, STREAM_DEPTH, STREAM_FRONT_LEFT, STREAM_FRONT_RIGHT,
+                                                 STREAM_LEFT_LEFT, STREAM_RIGHT_RIGHT, STREAM_AHAT, STREAM_STEREO),
+                                    multiplexed=USE_MULTIPLEXED_TRANSPORT, native=USE_NATIVE_RECEIVER,
+                                    record_dir=RECORD_CORPUS_DIR, record_frames=RECORD_FRAMES,
+                                    stream_imu=STREAM_IMU, bundle_window_ms=BUNDLE_WINDOW_MS)
 
     if STREAM_VIDEO:
         cv2.namedWindow('Photo Video Camera Stream', cv2.WINDOW_NORMAL | cv2.WINDOW_GUI_NORMAL)
@@ -28,18 +65,35 @@ if __name__ == '__main__':
         cv2.namedWindow('Depth Camera Depth Stream', cv2.WINDOW_NORMAL | cv2.WINDOW_GUI_NORMAL)
         cv2.namedWindow('Depth Camera Ab Stream', cv2.WINDOW_NORMAL | cv2.WINDOW_GUI_NORMAL)
 
+    if STREAM_AHAT:
+        cv2.namedWindow('AHAT Depth Stream', cv2.WINDOW_NORMAL | cv2.WINDOW_GUI_NORMAL)
+        cv2.namedWindow('AHAT Ab Stream', cv2.WINDOW_NORMAL | cv2.WINDOW_GUI_NORMAL)
+
     if STREAM_FRONT_LEFT:
         cv2.namedWindow('Front Left Camera Stream', cv2.WINDOW_NORMAL | cv2.WINDOW_GUI_NORMAL)
 
     if STREAM_FRONT_RIGHT:
         cv2.namedWindow('Front Right Camera Stream', cv2.WINDOW_NORMAL | cv2.WINDOW_GUI_NORMAL)
 
+    if STREAM_LEFT_LEFT:
+        cv2.namedWindow('Left Left Camera Stream', cv2.WINDOW_NORMAL | cv2.WINDOW_GUI_NORMAL)
+
+    if STREAM_RIGHT_RIGHT:
+        cv2.namedWindow('Right Right Camera Stream', cv2.WINDOW_NORMAL | cv2.WINDOW_GUI_NORMAL)
+
+    if STREAM_STEREO:
+        cv2.namedWindow('Front Stereo Stream', cv2.WINDOW_NORMAL | cv2.WINDOW_GUI_NORMAL)
+
     have_video_frame = have_depth_frame = have_front_left_frame = have_front_right_frame = False    
     should_restart_sockets = False
 
     if hl2_receiver:
         try:
             while True:
+                if BUNDLE_WINDOW_MS is not None:
+                    # the latest frames below are those of the bundle
+                    bundle = hl2_receiver.next_bundle(timeout=0.05)
+
                 if STREAM_VIDEO:
                     have_video_frame = np.any(hl2_receiver.video_receiver.latest_frame)
                     if have_video_frame:
@@ -51,6 +105,11 @@ if __name__ == '__main__':
                         cv2.imshow('Depth Camera Depth Stream', hl2_receiver.depth_receiver.latest_depth_frame)
                         cv2.imshow('Depth Camera Ab Stream', hl2_receiver.depth_receiver.latest_ab_frame*2)
 
+                if STREAM_AHAT:
+                    if np.any(hl2_receiver.ahat_receiver.latest_depth_frame) and np.any(hl2_receiver.ahat_receiver.latest_ab_frame):
+                        cv2.imshow('AHAT Depth Stream', hl2_receiver.ahat_receiver.latest_depth_frame)
+                        cv2.imshow('AHAT Ab Stream', hl2_receiver.ahat_receiver.latest_ab_frame*2)
+
                 if STREAM_FRONT_LEFT:
                     have_front_left_frame = np.any(hl2_receiver.front_left_receiver.latest_frame)
                     if have_front_left_frame:
@@ -63,6 +122,30 @@ if __name__ == '__main__':
                         rotated_image = cv2.rotate(hl2_receiver.front_right_receiver.latest_frame, cv2.ROTATE_90_COUNTERCLOCKWISE)  
                         cv2.imshow('Front Right Camera Stream', rotated_image)
 
+                if STREAM_LEFT_LEFT:
+                    if np.any(hl2_receiver.left_left_receiver.latest_frame):
+                        rotated_image = cv2.rotate(hl2_receiver.left_left_receiver.latest_frame, cv2.ROTATE_90_COUNTERCLOCKWISE)
+                        cv2.imshow('Left Left Camera Stream', rotated_image)
+
+                if STREAM_RIGHT_RIGHT:
+                    if np.any(hl2_receiver.right_right_receiver.latest_frame):
+                        rotated_image = cv2.rotate(hl2_receiver.right_right_receiver.latest_frame, cv2.ROTATE_90_CLOCKWISE)
+                        cv2.imshow('Right Right Camera Stream', rotated_image)
+
+                if STREAM_STEREO:
+                    with hl2_receiver.stereo_receiver.lock:
+                        left = hl2_receiver.stereo_receiver.latest_left_frame
+                        right = hl2_receiver.stereo_receiver.latest_right_frame
+                    if left is not None:
+                        # side by side, upright as in the single camera windows
+                        cv2.imshow('Front Stereo Stream', np.hstack((cv2.rotate(left, cv2.ROTATE_90_CLOCKWISE),
+                                                                     cv2.rotate(right, cv2.ROTATE_90_COUNTERCLOCKWISE))))
+
+                if STREAM_IMU:
+                    # every sample since the last call, e.g. for a VIO pipeline
+                    gyro_timestamps, gyro_values = hl2_receiver.imu_receiver.pop_samples(hl2_codecs.IMU_GYRO)
+                    accel_timestamps, accel_values = hl2_receiver.imu_receiver.pop_samples(hl2_codecs.IMU_ACCEL)
+
                 key = cv2.waitKey(1) & 0xFF
 
                 if key == ord('q'):
@@ -0,0 +1,902 @@
+#include "FrameReceiver.h"
+
+#include <algorithm>
+#include <exception>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <ws2tcpip.h>
+#define poll WSAPoll
+typedef int ssize_t;
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // how long the I/O thread sleeps in poll() at most, bounds Stop()
+    constexpr int kPollMilliseconds = 20;
+    // the link can have a few frames in flight per stream
+    constexpr int kReceiveBufferSize = 8 * 1024 * 1024;
+    constexpr size_t kDiscardChunk = 64 * 1024;
+
+#if defined(_WIN32)
+    constexpr SocketHandle kInvalidSocket = INVALID_SOCKET;
+
+    void CloseSocket(SocketHandle socket)
+    {
+        closesocket(socket);
+    }
+
+    bool WouldBlock()
+    {
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+    }
+
+    bool SetNonBlocking(SocketHandle socket)
+    {
+        u_long enable = 1;
+        return ioctlsocket(socket, FIONBIO, &enable) == 0;
+    }
+
+    bool InitSockets()
+    {
+        static const bool initialized = []
+            {
+                WSADATA data;
+                return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+            }();
+        return initialized;
+    }
+#else
+    constexpr SocketHandle kInvalidSocket = -1;
+
+    void CloseSocket(SocketHandle socket)
+    {
+        close(socket);
+    }
+
+    bool WouldBlock()
+    {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+
+    bool SetNonBlocking(SocketHandle socket)
+    {
+        const int flags = fcntl(socket, F_GETFL, 0);
+        return flags >= 0 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+
+    bool InitSockets()
+    {
+        return true;
+    }
+#endif
+
+    uint32_t LoadUInt32(const uint8_t* in)
+    {
+        return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+    }
+
+    // the fixed part of the header, the pose block follows
+    constexpr size_t kHeaderSize = sizeof(FrameHeader);
+}
+
+FrameReceiver::~FrameReceiver()
+{
+    Stop();
+    for (const std::unique_ptr<Connection>& connection : m_connections)
+    {
+        if (connection->open)
+        {
+            CloseSocket(connection->socket);
+        }
+    }
+    if (m_hasRequestSocket)
+    {
+        CloseSocket(m_requestSocket);
+    }
+}
+
+bool FrameReceiver::AddStream(
+    uint32_t streamId,
+    size_t slotCount,
+    uint32_t window,
+    std::chrono::milliseconds resendTimeout,
+    size_t maxFrameSize)
+{
+    if (m_started || FindStream(streamId) || slotCount == 0 || maxFrameSize < kHeaderSize)
+    {
+        return false;
+    }
+
+    auto stream = std::make_unique<Stream>();
+    stream->id = streamId;
+    stream->window = (std::max)(1u, window);
+    stream->resendTimeout = resendTimeout;
+    stream->maxFrameSize = maxFrameSize;
+    stream->slots.resize(slotCount);
+    m_streams.push_back(std::move(stream));
+    return true;
+}
+
+FrameReceiver::Stream* FrameReceiver::FindStream(uint32_t streamId) const
+{
+    for (const std::unique_ptr<Stream>& stream : m_streams)
+    {
+        if (stream->id == streamId)
+        {
+            return stream.get();
+        }
+    }
+    return nullptr;
+}
+
+bool FrameReceiver::Connect(
+    const std::string& host,
+    uint16_t tcpPort,
+    uint16_t udpPort,
+    Connection& connection)
+{
+    if (!InitSockets())
+    {
+        return false;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* address = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(tcpPort).c_str(), &hints, &address) != 0 || !address)
+    {
+        return false;
+    }
+
+    connection.socket = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    bool connected = connection.socket != kInvalidSocket;
+    if (connected)
+    {
+        const int bufferSize = kReceiveBufferSize;
+        setsockopt(connection.socket, SOL_SOCKET, SO_RCVBUF, (const char*)&bufferSize, sizeof(bufferSize));
+#if defined(TCP_QUICKACK)
+        const int enable = 1;
+        setsockopt(connection.socket, IPPROTO_TCP, TCP_QUICKACK, &enable, sizeof(enable));
+#endif
+        connected = connect(connection.socket, address->ai_addr, (int)address->ai_addrlen) == 0 &&
+            SetNonBlocking(connection.socket);
+        if (!connected)
+        {
+            CloseSocket(connection.socket);
+        }
+    }
+
+    if (connected)
+    {
+        // requests go to the same host
+        sockaddr_in requestAddress;
+        memcpy(&requestAddress, address->ai_addr, sizeof(requestAddress));
+        requestAddress.sin_port = htons(udpPort);
+        memcpy(&connection.requestAddress, &requestAddress, sizeof(requestAddress));
+        connection.requestAddressSize = sizeof(requestAddress);
+    }
+    freeaddrinfo(address);
+
+    if (connected && !m_hasRequestSocket)
+    {
+        m_requestSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        m_hasRequestSocket = m_requestSocket != kInvalidSocket;
+    }
+    return connected && m_hasRequestSocket;
+}
+
+bool FrameReceiver::ConnectStream(
+    uint32_t streamId,
+    const std::string& host,
+    uint16_t tcpPort,
+    uint16_t udpPort)
+{
+    Stream* stream = FindStream(streamId);
+    if (m_started || !stream || stream->connection)
+    {
+        return false;
+    }
+
+    auto connection = std::make_unique<Connection>();
+    if (!Connect(host, tcpPort, udpPort, *connection))
+    {
+        return false;
+    }
+    connection->stream = stream;
+    stream->connection = connection.get();
+    BeginFrame(*connection);
+    m_connections.push_back(std::move(connection));
+    return true;
+}
+
+bool FrameReceiver::ConnectMultiplexed(
+    const std::string& host,
+    uint16_t tcpPort,
+    uint16_t udpPort)
+{
+    if (m_started || !m_connections.empty())
+    {
+        return false;
+    }
+
+    auto connection = std::make_unique<Connection>();
+    if (!Connect(host, tcpPort, udpPort, *connection))
+    {
+        return false;
+    }
+    connection->multiplexed = true;
+    for (const std::unique_ptr<Stream>& stream : m_streams)
+    {
+        stream->connection = connection.get();
+    }
+    BeginFrame(*connection);
+    m_connections.push_back(std::move(connection));
+    return true;
+}
+
+bool FrameReceiver::Start()
+{
+    if (m_started || m_connections.empty())
+    {
+        return false;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    for (const std::unique_ptr<Stream>& stream : m_streams)
+    {
+        if (stream->connection)
+        {
+            SendRequest(*stream->connection, stream->id, "R" + std::to_string(stream->window));
+        }
+        stream->lastFrame = now;
+    }
+
+    m_started = true;
+    m_thread = std::thread(&FrameReceiver::Run, this);
+    return true;
+}
+
+void FrameReceiver::Stop()
+{
+    if (!m_started)
+    {
+        return;
+    }
+    m_stop = true;
+    m_thread.join();
+    m_started = false;
+
+    for (const std::unique_ptr<Connection>& connection : m_connections)
+    {
+        if (connection->open)
+        {
+            CloseStreams(*connection);
+            CloseSocket(connection->socket);
+            connection->open = false;
+        }
+    }
+}
+
+bool FrameReceiver::SendRequest(
+    uint32_t streamId,
+    const char* request)
+{
+    Stream* stream = FindStream(streamId);
+    if (!stream || !stream->connection || !request)
+    {
+        return false;
+    }
+    SendRequest(*stream->connection, streamId, request);
+    return true;
+}
+
+void FrameReceiver::SendRequest(
+    Connection& connection,
+    uint32_t streamId,
+    const std::string& request)
+{
+    // newline terminated so netcat works for debugging, like the Python
+    // receiver's requests
+    const std::string message = connection.multiplexed ?
+        std::to_string(streamId) + ":" + request + "\n" :
+        request + "\n";
+    sendto(m_requestSocket, message.data(), (int)message.size(), 0,
+        (const sockaddr*)&connection.requestAddress, connection.requestAddressSize);
+}
+
+FrameReceiver::NextResult FrameReceiver::Next(
+    uint32_t streamId,
+    std::chrono::milliseconds timeout,
+    Frame& frame)
+{
+    Stream* stream = FindStream(streamId);
+    if (!stream)
+    {
+        return NextResult::Closed;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    Slot* pOldest = nullptr;
+    auto findOldest = [&]
+        {
+            pOldest = nullptr;
+            for (Slot& slot : stream->slots)
+            {
+                if (slot.state == SlotState::Ready && (!pOldest || slot.order < pOldest->order))
+                {
+                    pOldest = &slot;
+                }
+            }
+            return pOldest != nullptr || stream->closed;
+        };
+    if (!stream->ready.wait_for(lock, timeout, findOldest))
+    {
+        return NextResult::Timeout;
+    }
+    if (!pOldest)
+    {
+        return NextResult::Closed;
+    }
+
+    Hold(*stream, *pOldest, frame);
+    return NextResult::Frame;
+}
+
+FrameReceiver::NextResult FrameReceiver::NextBundle(
+    const uint32_t* streamIds,
+    size_t count,
+    uint64_t window,
+    std::chrono::milliseconds timeout,
+    Frame* frames)
+{
+    std::vector<Stream*> streams;
+    for (size_t i = 0; i < count; i++)
+    {
+        Stream* stream = FindStream(streamIds[i]);
+        if (!stream || std::find(streams.begin(), streams.end(), stream) != streams.end())
+        {
+            return NextResult::Closed;
+        }
+        streams.push_back(stream);
+    }
+    if (streams.empty())
+    {
+        return NextResult::Closed;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::vector<Slot*> bundle;
+    bool closed = false;
+    auto findBundle = [&]
+        {
+            for (Stream* stream : streams)
+            {
+                // a bundle can not be complete without the stream
+                if (stream->closed)
+                {
+                    closed = true;
+                    return true;
+                }
+            }
+            return FindBundle(streams, window, bundle);
+        };
+    if (!m_anyReady.wait_for(lock, timeout, findBundle))
+    {
+        return NextResult::Timeout;
+    }
+    if (closed)
+    {
+        return NextResult::Closed;
+    }
+
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        Hold(*streams[i], *bundle[i], frames[i]);
+    }
+    return NextResult::Frame;
+}
+
+bool FrameReceiver::FindBundle(
+    const std::vector<Stream*>& streams,
+    uint64_t window,
+    std::vector<Slot*>& bundle)
+{
+    bundle.assign(streams.size(), nullptr);
+    while (true)
+    {
+        // The oldest frames of the streams; the latest of them, the pivot,
+        // is in the next bundle or never matched, so every later bundle
+        // starts at pivot - window or after it.
+        uint64_t pivot = 0;
+        for (Stream* stream : streams)
+        {
+            const Slot* pOldest = nullptr;
+            for (const Slot& slot : stream->slots)
+            {
+                if (slot.state == SlotState::Ready && (!pOldest || slot.timestamp < pOldest->timestamp))
+                {
+                    pOldest = &slot;
+                }
+            }
+            if (!pOldest)
+            {
+                return false;
+            }
+            pivot = (std::max)(pivot, pOldest->timestamp);
+        }
+        const uint64_t earliest = pivot > window ? pivot - window : 0;
+
+        // every stream's latest frame up to the pivot, after dropping what
+        // is too old for it
+        bool complete = true;
+        uint64_t low = UINT64_MAX;
+        for (size_t i = 0; i < streams.size(); i++)
+        {
+            Stream& stream = *streams[i];
+            bundle[i] = nullptr;
+            for (Slot& slot : stream.slots)
+            {
+                if (slot.state != SlotState::Ready)
+                {
+                    continue;
+                }
+                if (slot.timestamp < earliest)
+                {
+                    slot.state = SlotState::Free;
+                    stream.unmatched++;
+                }
+                else if (slot.timestamp <= pivot && (!bundle[i] || slot.timestamp > bundle[i]->timestamp))
+                {
+                    bundle[i] = &slot;
+                }
+            }
+            if (!bundle[i])
+            {
+                // all its frames up to the pivot were too old; its oldest
+                // frame is the next pivot
+                complete = false;
+                continue;
+            }
+            low = (std::min)(low, bundle[i]->timestamp);
+        }
+        if (!complete)
+        {
+            continue;
+        }
+
+        // The frames up to the pivot are at most window apart. A frame just
+        // after the pivot is taken instead if it is closer to the pivot and
+        // still within window of the rest; the bundle only gets tighter.
+        for (size_t i = 0; i < streams.size(); i++)
+        {
+            const uint64_t before = pivot - bundle[i]->timestamp;
+            for (Slot& slot : streams[i]->slots)
+            {
+                if (slot.state == SlotState::Ready && slot.timestamp > pivot &&
+                    slot.timestamp - pivot < before && slot.timestamp - low <= window &&
+                    (bundle[i]->timestamp <= pivot || slot.timestamp < bundle[i]->timestamp))
+                {
+                    bundle[i] = &slot;
+                }
+            }
+        }
+
+        // bundles come in timestamp order, older frames are never matched
+        for (size_t i = 0; i < streams.size(); i++)
+        {
+            for (Slot& slot : streams[i]->slots)
+            {
+                if (slot.state == SlotState::Ready && slot.timestamp < bundle[i]->timestamp)
+                {
+                    slot.state = SlotState::Free;
+                    streams[i]->unmatched++;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+void FrameReceiver::Hold(
+    Stream& stream,
+    Slot& slot,
+    Frame& frame)
+{
+    slot.state = SlotState::Held;
+    frame.header = slot.data.data();
+    frame.headerSize = slot.headerSize;
+    frame.payload = slot.data.data() + slot.headerSize;
+    frame.payloadSize = slot.payloadSize;
+    frame.slot = (uint32_t)(&slot - stream.slots.data());
+}
+
+void FrameReceiver::Release(
+    uint32_t streamId,
+    uint32_t slot)
+{
+    Stream* stream = FindStream(streamId);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (stream && slot < stream->slots.size() && stream->slots[slot].state == SlotState::Held)
+    {
+        stream->slots[slot].state = SlotState::Free;
+    }
+}
+
+bool FrameReceiver::Stats(
+    uint32_t streamId,
+    uint64_t& received,
+    uint64_t& dropped,
+    uint64_t& unmatched) const
+{
+    Stream* stream = FindStream(streamId);
+    if (!stream)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    received = stream->received;
+    dropped = stream->dropped;
+    unmatched = stream->unmatched;
+    return true;
+}
+
+void FrameReceiver::Run()
+{
+    std::vector<pollfd> fds;
+    std::vector<Connection*> polled;
+    while (!m_stop)
+    {
+        fds.clear();
+        polled.clear();
+        for (const std::unique_ptr<Connection>& connection : m_connections)
+        {
+            if (connection->open)
+            {
+                pollfd fd{};
+                fd.fd = connection->socket;
+                fd.events = POLLIN;
+                fds.push_back(fd);
+                polled.push_back(connection.get());
+            }
+        }
+        if (fds.empty())
+        {
+            return;
+        }
+
+        if (poll(fds.data(), (unsigned long)fds.size(), kPollMilliseconds) > 0)
+        {
+            for (size_t i = 0; i < fds.size(); i++)
+            {
+                if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                {
+                    continue;
+                }
+                bool received = false;
+                try
+                {
+                    received = Receive(*polled[i]);
+                }
+                catch (const std::exception&)
+                {
+                    // out of memory for a slot, the frame is lost and the
+                    // byte stream with it
+                }
+                if (!received)
+                {
+                    CloseStreams(*polled[i]);
+                    CloseSocket(polled[i]->socket);
+                    polled[i]->open = false;
+                }
+            }
+        }
+
+        // credit datagrams may get lost; a quiet stream gets its whole
+        // window again
+        const auto now = std::chrono::steady_clock::now();
+        for (const std::unique_ptr<Stream>& stream : m_streams)
+        {
+            if (stream->connection && stream->connection->open && now - stream->lastFrame > stream->resendTimeout)
+            {
+                SendRequest(*stream->connection, stream->id, "R" + std::to_string(stream->window));
+                stream->lastFrame = now;
+            }
+        }
+    }
+}
+
+bool FrameReceiver::Receive(Connection& connection)
+{
+    while (true)
+    {
+        const ssize_t count = recv(connection.socket, (char*)connection.target + connection.received,
+            (int)(connection.targetSize - connection.received), 0);
+        if (count == 0)
+        {
+            return false;
+        }
+        if (count < 0)
+        {
+            return WouldBlock();
+        }
+
+        connection.received += (size_t)count;
+        if (connection.received == connection.targetSize)
+        {
+            Advance(connection);
+            if (connection.lostSync)
+            {
+                return false;
+            }
+        }
+    }
+}
+
+void FrameReceiver::Advance(Connection& connection)
+{
+    switch (connection.phase)
+    {
+    case Connection::Phase::MuxHeader:
+    {
+        // the whole message, frame header and payload, goes into one slot
+        const uint32_t length = LoadUInt32(connection.muxHeader + 8);
+        connection.stream = FindStream(connection.muxHeader[0]);
+        if (!connection.stream || length < kHeaderSize)
+        {
+            connection.stream = nullptr;
+            BeginDiscard(connection, length);
+            return;
+        }
+        if (length > connection.stream->maxFrameSize)
+        {
+            // a corrupt length, the byte stream can not be trusted
+            connection.lostSync = true;
+            return;
+        }
+
+        connection.slot = AcquireSlot(*connection.stream, length);
+        if (connection.slot < 0)
+        {
+            BeginDiscard(connection, length);
+            return;
+        }
+        connection.phase = Connection::Phase::Payload;
+        connection.target = connection.stream->slots[connection.slot].data.data();
+        connection.targetSize = length;
+        connection.received = 0;
+        return;
+    }
+
+    case Connection::Phase::FrameHeader:
+    {
+        FrameHeader header;
+        const bool known = ReadFrameHeader(connection.target, header);
+        if (header.magic != kFrameHeaderMagic || header.headerSize < kHeaderSize)
+        {
+            // not at the start of a frame, the byte stream can not be trusted
+            connection.lostSync = true;
+            return;
+        }
+        if (header.headerSize + (size_t)header.payloadLength > connection.stream->maxFrameSize)
+        {
+            connection.lostSync = true;
+            return;
+        }
+        if (!known || connection.slot < 0)
+        {
+            // later versions only append header fields, so the frame can
+            // be skipped
+            if (connection.slot >= 0)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                connection.stream->slots[connection.slot].state = SlotState::Free;
+                connection.slot = -1;
+            }
+            BeginDiscard(connection, header.headerSize - kHeaderSize + (size_t)header.payloadLength);
+            return;
+        }
+
+        // pose block and payload
+        Slot& slot = connection.stream->slots[connection.slot];
+        const size_t remaining = header.headerSize - kHeaderSize + (size_t)header.payloadLength;
+        if (slot.data.size() < kHeaderSize + remaining)
+        {
+            // the slot is only written by this thread while Writing
+            slot.data.resize(kHeaderSize + remaining);
+        }
+        connection.phase = Connection::Phase::Payload;
+        connection.target = slot.data.data() + kHeaderSize;
+        connection.targetSize = remaining;
+        connection.received = 0;
+        if (remaining == 0)
+        {
+            EndFrame(connection);
+        }
+        return;
+    }
+
+    case Connection::Phase::Payload:
+        EndFrame(connection);
+        return;
+
+    case Connection::Phase::Discard:
+        ContinueDiscard(connection);
+        return;
+    }
+}
+
+void FrameReceiver::BeginFrame(Connection& connection)
+{
+    connection.received = 0;
+    if (connection.multiplexed)
+    {
+        connection.phase = Connection::Phase::MuxHeader;
+        connection.target = connection.muxHeader;
+        connection.targetSize = kMuxHeaderSize;
+        return;
+    }
+
+    // the header goes into the slot already, the payload follows it
+    Stream& stream = *connection.stream;
+    connection.phase = Connection::Phase::FrameHeader;
+    connection.slot = AcquireSlot(stream, kHeaderSize);
+    if (connection.slot >= 0)
+    {
+        connection.target = stream.slots[connection.slot].data.data();
+    }
+    else
+    {
+        connection.scratch.resize((std::max)(connection.scratch.size(), kHeaderSize));
+        connection.target = connection.scratch.data();
+    }
+    connection.targetSize = kHeaderSize;
+}
+
+void FrameReceiver::BeginDiscard(Connection& connection, size_t size)
+{
+    connection.phase = Connection::Phase::Discard;
+    connection.discardRemaining = size;
+    connection.scratch.resize((std::max)(connection.scratch.size(), kDiscardChunk));
+    connection.target = connection.scratch.data();
+    connection.targetSize = 0;
+    connection.received = 0;
+    ContinueDiscard(connection);
+}
+
+void FrameReceiver::ContinueDiscard(Connection& connection)
+{
+    connection.discardRemaining -= connection.received;
+    connection.received = 0;
+    connection.targetSize = (std::min)(connection.discardRemaining, kDiscardChunk);
+    if (connection.discardRemaining > 0)
+    {
+        return;
+    }
+
+    // a frame of a known stream still counts, as dropped
+    if (connection.stream)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            connection.stream->dropped++;
+        }
+        SendRequest(connection, connection.stream->id, "1");
+        connection.stream->lastFrame = std::chrono::steady_clock::now();
+    }
+    BeginFrame(connection);
+}
+
+void FrameReceiver::EndFrame(Connection& connection)
+{
+    Stream& stream = *connection.stream;
+    bool ready = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Slot& slot = stream.slots[connection.slot];
+        FrameHeader header;
+        // bytes in the slot, header included
+        const size_t received = connection.multiplexed ? connection.targetSize : kHeaderSize + connection.targetSize;
+        if (ReadFrameHeader(slot.data.data(), header) && received >= header.headerSize)
+        {
+            slot.headerSize = header.headerSize;
+            slot.payloadSize = (std::min)((size_t)header.payloadLength, received - header.headerSize);
+            slot.order = stream.nextOrder++;
+            slot.timestamp = header.timestamp;
+            slot.state = SlotState::Ready;
+            stream.received++;
+            ready = true;
+        }
+        else
+        {
+            // a multiplexed message with a header this build does not know
+            slot.state = SlotState::Free;
+            stream.dropped++;
+        }
+    }
+    if (ready)
+    {
+        stream.ready.notify_all();
+        m_anyReady.notify_all();
+    }
+
+    // the frame is in, hand its credit back
+    SendRequest(connection, stream.id, "1");
+    stream.lastFrame = std::chrono::steady_clock::now();
+    connection.slot = -1;
+    BeginFrame(connection);
+}
+
+int FrameReceiver::AcquireSlot(Stream& stream, size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Slot* pSlot = nullptr;
+    for (Slot& slot : stream.slots)
+    {
+        if (slot.state == SlotState::Free)
+        {
+            pSlot = &slot;
+            break;
+        }
+    }
+    if (!pSlot)
+    {
+        // Python fell behind, the oldest queued frame makes room
+        for (Slot& slot : stream.slots)
+        {
+            if (slot.state == SlotState::Ready && (!pSlot || slot.order < pSlot->order))
+            {
+                pSlot = &slot;
+            }
+        }
+        if (!pSlot)
+        {
+            return -1;
+        }
+        stream.dropped++;
+    }
+
+    pSlot->state = SlotState::Writing;
+    if (pSlot->data.size() < size)
+    {
+        pSlot->data.resize(size);
+    }
+    return (int)(pSlot - stream.slots.data());
+}
+
+void FrameReceiver::CloseStreams(Connection& connection)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const std::unique_ptr<Stream>& stream : m_streams)
+        {
+            if (stream->connection == &connection)
+            {
+                stream->closed = true;
+                // a frame that was being written is incomplete
+                for (Slot& slot : stream->slots)
+                {
+                    if (slot.state == SlotState::Writing)
+                    {
+                        slot.state = SlotState::Free;
+                    }
+                }
+            }
+        }
+    }
+    for (const std::unique_ptr<Stream>& stream : m_streams)
+    {
+        stream->ready.notify_all();
+    }
+    m_anyReady.notify_all();
+}
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FrameHeader.h"
+
+#if defined(_WIN32)
+#include <winsock2.h>
+typedef SOCKET SocketHandle;
+#else
+#include <sys/socket.h>
+typedef int SocketHandle;
+#endif
+
+// Receives the frames of the HoloLens streams off the GIL, for
+// DataCollection/native_receiver.py.
+//
+// One I/O thread polls all connections, either one TCP connection per sensor
+// or the single connection of the multiplexed transport. Every stream owns a
+// ring of frame slots; the thread recv()s header and payload straight into a
+// free slot, so a frame is never copied on the receiving side. Python takes
+// complete frames in order (Next) and hands the slot back once nothing refers
+// to it any more (Release).
+//
+// If Python falls behind, the oldest frame that is not held is overwritten.
+// If every slot is held, incoming frames are read into a scratch buffer and
+// dropped. Either way the frame's credit goes back to the HoloLens right away,
+// so the link keeps its window of frames in flight. Like
+// FrameReceiverThread.req_next_frame, a stream that stays quiet for
+// resendTimeout is granted its whole window again.
+//
+// The slots also index the frames by FrameHeader::timestamp, so NextBundle
+// can take one frame of each of several streams that were captured at about
+// the same time (see FindBundle).
+class FrameReceiver
+{
+public:
+    // stream id, 3 reserved bytes, sequence number, length
+    static constexpr size_t kMuxHeaderSize = 12;
+    // header and payload; a raw PV frame is 8 MB, its tiled QOI bound 10 MB
+    static constexpr size_t kDefaultMaxFrameSize = 64 * 1024 * 1024;
+
+    struct Frame
+    {
+        const uint8_t* header;
+        size_t headerSize;
+        const uint8_t* payload;
+        size_t payloadSize;
+        uint32_t slot;
+    };
+
+    enum class NextResult
+    {
+        Frame,
+        Timeout,
+        // the connection of the stream was lost, or the receiver stopped
+        Closed,
+    };
+
+    FrameReceiver() = default;
+    ~FrameReceiver();
+
+    FrameReceiver(const FrameReceiver&) = delete;
+    FrameReceiver& operator=(const FrameReceiver&) = delete;
+
+    // Before Start. slotCount is the number of frames that can be queued or
+    // held at once, window the number of frames in flight (credits). A frame
+    // header announcing more than maxFrameSize bytes means the byte stream
+    // can not be trusted, the connection is closed.
+    bool AddStream(
+        uint32_t streamId,
+        size_t slotCount,
+        uint32_t window,
+        std::chrono::milliseconds resendTimeout,
+        size_t maxFrameSize = kDefaultMaxFrameSize);
+
+    // Connects one stream on its own TCP port; requests go to udpPort as
+    // "<request>\n". Before Start.
+    bool ConnectStream(
+        uint32_t streamId,
+        const std::string& host,
+        uint16_t tcpPort,
+        uint16_t udpPort);
+
+    // Connects all streams over the multiplexed transport; requests go to
+    // udpPort as "<stream id>:<request>\n". Before Start.
+    bool ConnectMultiplexed(
+        const std::string& host,
+        uint16_t tcpPort,
+        uint16_t udpPort);
+
+    // Grants every stream its window and starts the I/O thread.
+    bool Start();
+
+    // Stops the I/O thread and closes the connections. Frames Python still
+    // holds stay valid until the receiver is destroyed.
+    void Stop();
+
+    // Sends a request ("K", "R3", ...) to the stream's sender.
+    bool SendRequest(
+        uint32_t streamId,
+        const char* request);
+
+    // Oldest complete frame of the stream, waiting up to timeout. The frame
+    // stays valid until Release.
+    NextResult Next(
+        uint32_t streamId,
+        std::chrono::milliseconds timeout,
+        Frame& frame);
+
+    // One frame of each of the count streams, at most window timestamp
+    // ticks apart, waiting up to timeout. Bundles come in timestamp order;
+    // queued frames of these streams that are older than the bundle can not
+    // be matched any more and are dropped as unmatched. The frames stay valid
+    // until Release. A stream is read either with Next or with NextBundle.
+    NextResult NextBundle(
+        const uint32_t* streamIds,
+        size_t count,
+        uint64_t window,
+        std::chrono::milliseconds timeout,
+        Frame* frames);
+
+    void Release(
+        uint32_t streamId,
+        uint32_t slot);
+
+    // frames received, frames dropped because Python fell behind and frames
+    // NextBundle found no partners for
+    bool Stats(
+        uint32_t streamId,
+        uint64_t& received,
+        uint64_t& dropped,
+        uint64_t& unmatched) const;
+
+private:
+    enum class SlotState
+    {
+        Free,
+        Writing,
+        Ready,
+        Held,
+    };
+
+    struct Slot
+    {
+        std::vector<uint8_t> data;
+        // FrameHeader::headerSize, the pose block included
+        size_t headerSize = 0;
+        size_t payloadSize = 0;
+        uint64_t order = 0;
+        // FrameHeader::timestamp
+        uint64_t timestamp = 0;
+        SlotState state = SlotState::Free;
+    };
+
+    struct Connection;
+
+    struct Stream
+    {
+        uint32_t id = 0;
+        uint32_t window = 1;
+        std::chrono::milliseconds resendTimeout{ 100 };
+        size_t maxFrameSize = kDefaultMaxFrameSize;
+        std::vector<Slot> slots;
+        uint64_t nextOrder = 0;
+        bool closed = false;
+        uint64_t received = 0;
+        uint64_t dropped = 0;
+        uint64_t unmatched = 0;
+        std::condition_variable ready;
+
+        // I/O thread only
+        Connection* connection = nullptr;
+        std::chrono::steady_clock::time_point lastFrame;
+    };
+
+    // reads one connection's byte stream into the slots of its streams
+    struct Connection
+    {
+        SocketHandle socket;
+        bool multiplexed = false;
+        bool open = true;
+        // set on a frame header without the magic or with a length above the
+        // stream's maxFrameSize, the connection is closed
+        bool lostSync = false;
+        sockaddr_storage requestAddress{};
+        int requestAddressSize = 0;
+
+        // the stream of a per-sensor connection, or of the current message
+        Stream* stream = nullptr;
+
+        enum class Phase
+        {
+            MuxHeader,
+            FrameHeader,
+            Payload,
+            // a frame without a free slot, or a message of an unknown stream
+            Discard,
+        } phase = Phase::FrameHeader;
+        uint8_t muxHeader[kMuxHeaderSize];
+        // bytes still to discard
+        size_t discardRemaining = 0;
+
+        // where the current phase reads to and how far it got
+        uint8_t* target = nullptr;
+        size_t targetSize = 0;
+        size_t received = 0;
+
+        // slot being written, -1 while reading into scratch
+        int slot = -1;
+        std::vector<uint8_t> scratch;
+    };
+
+    Stream* FindStream(uint32_t streamId) const;
+
+    // Picks the next bundle of the streams into bundle, with m_mutex held.
+    // False while a stream has no frame that could be part of it.
+    bool FindBundle(
+        const std::vector<Stream*>& streams,
+        uint64_t window,
+        std::vector<Slot*>& bundle);
+
+    void Hold(
+        Stream& stream,
+        Slot& slot,
+        Frame& frame);
+
+    bool Connect(
+        const std::string& host,
+        uint16_t tcpPort,
+        uint16_t udpPort,
+        Connection& connection);
+
+    void Run();
+
+    // reads what the socket has, false once the connection is gone
+    bool Receive(Connection& connection);
+
+    // called whenever the current phase has all its bytes
+    void Advance(Connection& connection);
+
+    void BeginFrame(Connection& connection);
+    void BeginDiscard(Connection& connection, size_t size);
+    void ContinueDiscard(Connection& connection);
+    void EndFrame(Connection& connection);
+
+    // a slot of at least size bytes to write the next frame to, -1 if all
+    // of them are held
+    int AcquireSlot(Stream& stream, size_t size);
+
+    void SendRequest(
+        Connection& connection,
+        uint32_t streamId,
+        const std::string& request);
+
+    void CloseStreams(Connection& connection);
+
+    std::vector<std::unique_ptr<Stream>> m_streams;
+    std::vector<std::unique_ptr<Connection>> m_connections;
+    SocketHandle m_requestSocket;
+    bool m_hasRequestSocket = false;
+
+    // guards the slots and stream state shared with Python
+    mutable std::mutex m_mutex;
+    // notified with the ready of every stream, for NextBundle
+    std::condition_variable m_anyReady;
+
+    std::atomic<bool> m_stop{ false };
+    std::thread m_thread;
+    bool m_started = false;
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+// Exports of the hl2codecs library, called through ctypes.
+#if defined(_WIN32)
+#define HL2CODECS_API extern "C" __declspec(dllexport)
+#else
+#define HL2CODECS_API extern "C" __attribute__((visibility("default")))
+#endif
@@ -0,0 +1,67 @@
+// C interface of the payload decoders for ctypes (see DataCollection/hl2_codecs.py).
+
+#include "DepthCodec.h"
+#include "FramePacking.h"
+#include "PayloadEncoding.h"
+#include "TiledQoi.h"
+#include "WorkerPool.h"
+#include "hl2_api.h"
+
+#include <cstring>
+
+// PayloadEncoding::Rvl depth + AB payload into the raw payload layout
+// (4 * count bytes). Returns 0 on success, -1 on corrupt input.
+HL2CODECS_API int hl2_decode_depth_ab_rvl(
+    const uint8_t* in,
+    size_t size,
+    size_t count,
+    uint8_t* out)
+{
+    return DepthCodec::DecodeDepthAb(in, size, count, out) ? 0 : -1;
+}
+
+// PayloadEncoding::Packed12 depth + AB payload into the raw payload layout
+// (4 * count bytes), using the SIMD unpack kernels. Returns 0 on success, -1
+// if the payload is too short.
+HL2CODECS_API int hl2_decode_depth_ab_packed12(
+    const uint8_t* in,
+    size_t size,
+    size_t count,
+    uint8_t* out)
+{
+    const size_t imageSize = FramePacking::Packed12Size(count);
+    if (size < kPacked12HeaderSize + 2 * imageSize)
+    {
+        return -1;
+    }
+
+    uint32_t flags;
+    memcpy(&flags, in, sizeof(flags));
+    const bool bigEndian = (flags & kPacked12BigEndianPlanes) != 0;
+
+    const uint8_t* pImages = in + kPacked12HeaderSize;
+    FramePacking::Unpack12(pImages, count, bigEndian, out);
+    FramePacking::Unpack12(pImages + imageSize, count, bigEndian, out + 2 * count);
+    return 0;
+}
+
+// PayloadEncoding::QoiTiled payload into the raw payload layout (out holds
+// size bytes), the bands are decoded on all cores. Returns 0 on success, -1
+// on corrupt input or a different image size.
+HL2CODECS_API int hl2_decode_qoi_tiled(
+    const uint8_t* in,
+    size_t size,
+    uint8_t* out,
+    size_t outSize)
+{
+    // shared by all receiver threads, WorkerPool::Run serializes them
+    static WorkerPool pool(WorkerPool::DefaultThreadCount());
+
+    TiledQoi::Info info;
+    if (!TiledQoi::ReadInfo(in, size, info) ||
+        (size_t)info.width * info.height * info.channels != outSize)
+    {
+        return -1;
+    }
+    return TiledQoi::Decode(in, size, &pool, out, outSize) ? 0 : -1;
+}
@@ -0,0 +1,228 @@
+// C interface of FrameReceiver for ctypes (see DataCollection/native_receiver.py).
+// ctypes releases the GIL for every call, so a blocking hl2_receiver_next
+// only blocks the calling Python thread. No exception may cross into Python,
+// the entry points report them as failures.
+
+#include "FrameReceiver.h"
+#include "hl2_api.h"
+
+#include <exception>
+
+struct hl2_frame
+{
+    const uint8_t* header;
+    size_t header_size;
+    const uint8_t* payload;
+    size_t payload_size;
+    uint32_t slot;
+};
+
+// Returns null if out of memory.
+HL2CODECS_API FrameReceiver* hl2_receiver_create()
+{
+    try
+    {
+        return new FrameReceiver();
+    }
+    catch (const std::exception&)
+    {
+        return nullptr;
+    }
+}
+
+// Stops the receiver if it is running. Every frame must have been released.
+HL2CODECS_API void hl2_receiver_destroy(FrameReceiver* receiver)
+{
+    delete receiver;
+}
+
+// Returns 0 on success, -1 for a duplicate stream id or after start. Frames
+// above max_frame_size bytes close the connection.
+HL2CODECS_API int hl2_receiver_add_stream(
+    FrameReceiver* receiver,
+    uint32_t stream_id,
+    size_t slot_count,
+    uint32_t window,
+    uint32_t resend_timeout_ms,
+    size_t max_frame_size)
+{
+    try
+    {
+        return receiver->AddStream(stream_id, slot_count, window,
+            std::chrono::milliseconds(resend_timeout_ms), max_frame_size) ? 0 : -1;
+    }
+    catch (const std::exception&)
+    {
+        return -1;
+    }
+}
+
+// Returns 0 once connected, -1 if the connection failed.
+HL2CODECS_API int hl2_receiver_connect_stream(
+    FrameReceiver* receiver,
+    uint32_t stream_id,
+    const char* host,
+    uint16_t tcp_port,
+    uint16_t udp_port)
+{
+    try
+    {
+        return receiver->ConnectStream(stream_id, host, tcp_port, udp_port) ? 0 : -1;
+    }
+    catch (const std::exception&)
+    {
+        return -1;
+    }
+}
+
+HL2CODECS_API int hl2_receiver_connect_multiplexed(
+    FrameReceiver* receiver,
+    const char* host,
+    uint16_t tcp_port,
+    uint16_t udp_port)
+{
+    try
+    {
+        return receiver->ConnectMultiplexed(host, tcp_port, udp_port) ? 0 : -1;
+    }
+    catch (const std::exception&)
+    {
+        return -1;
+    }
+}
+
+HL2CODECS_API int hl2_receiver_start(FrameReceiver* receiver)
+{
+    try
+    {
+        return receiver->Start() ? 0 : -1;
+    }
+    catch (const std::exception&)
+    {
+        return -1;
+    }
+}
+
+HL2CODECS_API void hl2_receiver_stop(FrameReceiver* receiver)
+{
+    try
+    {
+        receiver->Stop();
+    }
+    catch (const std::exception&)
+    {
+    }
+}
+
+HL2CODECS_API int hl2_receiver_send_request(
+    FrameReceiver* receiver,
+    uint32_t stream_id,
+    const char* request)
+{
+    try
+    {
+        return receiver->SendRequest(stream_id, request) ? 0 : -1;
+    }
+    catch (const std::exception&)
+    {
+        return -1;
+    }
+}
+
+// Returns 0 with the oldest frame of the stream in frame, 1 on timeout, -1
+// once the stream's connection is closed.
+HL2CODECS_API int hl2_receiver_next(
+    FrameReceiver* receiver,
+    uint32_t stream_id,
+    uint32_t timeout_ms,
+    hl2_frame* frame)
+{
+    FrameReceiver::Frame next;
+    FrameReceiver::NextResult result;
+    try
+    {
+        result = receiver->Next(stream_id, std::chrono::milliseconds(timeout_ms), next);
+    }
+    catch (const std::exception&)
+    {
+        return -1;
+    }
+    switch (result)
+    {
+    case FrameReceiver::NextResult::Frame:
+        frame->header = next.header;
+        frame->header_size = next.headerSize;
+        frame->payload = next.payload;
+        frame->payload_size = next.payloadSize;
+        frame->slot = next.slot;
+        return 0;
+    case FrameReceiver::NextResult::Timeout:
+        return 1;
+    default:
+        return -1;
+    }
+}
+
+// frames gets one hl2_frame per stream id, in the same order; release each.
+HL2CODECS_API int hl2_receiver_next_bundle(
+    FrameReceiver* receiver,
+    const uint32_t* stream_ids,
+    uint32_t count,
+    uint64_t window,
+    uint32_t timeout_ms,
+    hl2_frame* frames)
+{
+    std::vector<FrameReceiver::Frame> bundle;
+    FrameReceiver::NextResult result;
+    try
+    {
+        bundle.resize(count);
+        result = receiver->NextBundle(stream_ids, count, window, std::chrono::milliseconds(timeout_ms), bundle.data());
+    }
+    catch (const std::exception&)
+    {
+        return -1;
+    }
+    switch (result)
+    {
+    case FrameReceiver::NextResult::Frame:
+        for (uint32_t i = 0; i < count; i++)
+        {
+            frames[i].header = bundle[i].header;
+            frames[i].header_size = bundle[i].headerSize;
+            frames[i].payload = bundle[i].payload;
+            frames[i].payload_size = bundle[i].payloadSize;
+            frames[i].slot = bundle[i].slot;
+        }
+        return 0;
+    case FrameReceiver::NextResult::Timeout:
+        return 1;
+    default:
+        return -1;
+    }
+}
+
+HL2CODECS_API void hl2_receiver_release(
+    FrameReceiver* receiver,
+    uint32_t stream_id,
+    uint32_t slot)
+{
+    receiver->Release(stream_id, slot);
+}
+
+HL2CODECS_API int hl2_receiver_stats(
+    FrameReceiver* receiver,
+    uint32_t stream_id,
+    uint64_t* received,
+    uint64_t* dropped,
+    uint64_t* unmatched)
+{
+    try
+    {
+        return receiver->Stats(stream_id, *received, *dropped, *unmatched) ? 0 : -1;
+    }
+    catch (const std::exception&)
+    {
+        return -1;
+    }
+}
@@ -7,12 +7,175 @@ public class StartStreamer : MonoBehaviour
 #if ENABLE_WINMD_SUPPORT
     [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "Initialize", CallingConvention = CallingConvention.StdCall)]
     public static extern void InitializeDll();
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "EnableMultiplexedTransport")]
+    public static extern void EnableMultiplexedTransport([MarshalAs(UnmanagedType.I1)] bool enable);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "EnableDepthCompression")]
+    public static extern void EnableDepthCompression([MarshalAs(UnmanagedType.I1)] bool enable);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "EnableDepthBitPacking")]
+    public static extern void EnableDepthBitPacking([MarshalAs(UnmanagedType.I1)] bool enable);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "EnableTemporalDelta")]
+    public static extern void EnableTemporalDelta([MarshalAs(UnmanagedType.I1)] bool enable, int keyframeInterval);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "SetTemporalCompression")]
+    public static extern void SetTemporalCompression([MarshalAs(UnmanagedType.I1)] bool previousFrameDictionary, int acceleration);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "EnableTiledQoi")]
+    public static extern void EnableTiledQoi([MarshalAs(UnmanagedType.I1)] bool enable, int bandCount);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "SetPvScaleFactor")]
+    public static extern void SetPvScaleFactor(int scaleFactor);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "EnableAdaptiveEncoding")]
+    public static extern void EnableAdaptiveEncoding([MarshalAs(UnmanagedType.I1)] bool enable, float cpuBudget);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "EnableAdaptiveFrameRate")]
+    public static extern void EnableAdaptiveFrameRate([MarshalAs(UnmanagedType.I1)] bool enable, float latencyBoundMs);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "EnableCompactPose")]
+    public static extern void EnableCompactPose([MarshalAs(UnmanagedType.I1)] bool enable, [MarshalAs(UnmanagedType.I1)] bool quantized);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "EnableImuStreaming")]
+    public static extern void EnableImuStreaming([MarshalAs(UnmanagedType.I1)] bool enable);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "ConfigureSensor")]
+    public static extern void ConfigureSensor(int sensor, [MarshalAs(UnmanagedType.I1)] bool enable, int port,
+        int requestPort, float targetRate, int codec);
+
+    static void ConfigureSensor(int sensor, SensorStream stream)
+    {
+        ConfigureSensor(sensor, stream.enabled, stream.port, stream.requestPort, stream.targetRate, (int)stream.codec);
+    }
 #endif
 
+    // Payload encoding of one stream. StreamDefault follows the options
+    // below, the others fix it: Rvl and Packed12 only for depth, TiledQoi
+    // only for PV.
+    public enum Codec
+    {
+        StreamDefault = -1,
+        Raw = 0,
+        Rvl = 1,
+        Packed12 = 2,
+        TemporalDelta = 3,
+        TiledQoi = 4,
+        Lz4 = 5,
+    }
+
+    [Serializable]
+    public class SensorStream
+    {
+        // a disabled sensor costs no thread or socket on the device
+        public bool enabled = true;
+        // 0 keeps the default ports (23940 + stream id for TCP, 21110 +
+        // stream id for UDP)
+        public int port = 0;
+        public int requestPort = 0;
+        // frames per second at most, 0 for every frame of the sensor
+        public float targetRate = 0.0f;
+        public Codec codec = Codec.StreamDefault;
+    }
+
+    // The sensor set. The receiver has to enable the same streams.
+    public SensorStream photoVideo = new SensorStream();
+    // Long Throw depth (5 Hz, far range, for mapping) and AHAT depth (45 Hz,
+    // near range, for hands), each with its own rate and codec
+    public SensorStream depth = new SensorStream();
+    public SensorStream ahatDepth = new SensorStream { enabled = false };
+    public SensorStream leftFront = new SensorStream();
+    public SensorStream rightFront = new SensorStream();
+    public SensorStream leftLeft = new SensorStream { enabled = false };
+    public SensorStream rightRight = new SensorStream { enabled = false };
+    // left and right front as stereo pairs, matched by timestamp on the
+    // device and sent as one frame. Takes over both front cameras,
+    // leftFront and rightFront then do not stream.
+    public SensorStream frontStereo = new SensorStream { enabled = false };
+
+    // Send all sensors over one connection (TCP 23950, UDP 21120) instead of
+    // one port pair per sensor. The receiver has to use the same setting.
+    public bool useMultiplexedTransport = false;
+
+    // Losslessly compress the depth + AB frames (RVL, roughly 2.5-4x smaller).
+    // The Python receiver needs the native decoder in PythonReceiver/native.
+    public bool compressDepth = false;
+
+    // Send depth + AB with 12 instead of 16 bits per pixel (25% less data,
+    // almost free on the CPU). Ignored when compressDepth is set.
+    public bool packDepth12Bit = false;
+
+    // Send the VLC frames (and depth + AB if neither option above is set) as
+    // lossless deltas to the previous frame. Static scenes shrink several
+    // times; a keyframe goes out every keyframeInterval frames.
+    public bool temporalDelta = false;
+    public int keyframeInterval = 30;
+
+    // With temporalDelta: use the previous frame as LZ4 dictionary instead of
+    // XORing the frames, which copes much better with camera motion.
+    // lz4Acceleration above 1 trades ratio for speed.
+    public bool lz4Dictionary = false;
+    public int lz4Acceleration = 1;
+
+    // Losslessly compress the PV frames with QOI, split into qoiBands bands
+    // that are coded on all cores in parallel.
+    public bool tiledQoi = false;
+    public int qoiBands = 8;
+
+    // Downscale the PV frames by this factor (1, 2 or 4) on the device,
+    // averaging each block of pixels: 2 sends a quarter of the data.
+    public int pvScaleFactor = 1;
+
+    // Choose the encoding of every frame at run time: raw while the network
+    // keeps up, compressed once it falls behind, within cpuBudget (share of
+    // one core per stream) so the device does not overheat. Overrides
+    // compressDepth, packDepth12Bit and tiledQoi.
+    public bool adaptiveEncoding = false;
+    public float cpuBudget = 0.25f;
+
+    // Lower the frame rates once the link cannot carry all streams, so that
+    // frames wait at most maxLatencyMs before they go out: every camera
+    // stream gets its fair share of the measured link capacity (a heavy PV
+    // stream on weak Wi-Fi no longer holds back depth and VLC). The IMU is
+    // not limited.
+    public bool adaptiveFrameRate = false;
+    public float maxLatencyMs = 200.0f;
+
+    // Send the camera pose of every frame as quaternion and translation
+    // (28 instead of 64 bytes). quantizePose shrinks it to 20 bytes, within
+    // 0.006 degrees and 8 micrometers of the original.
+    public bool compactPose = false;
+    public bool quantizePose = false;
+
+    // Stream the accelerometer, gyroscope and magnetometer samples in
+    // batches (TCP 23944, UDP 21114, or over the multiplexed connection),
+    // timestamped on the same clock as the camera frames.
+    public bool streamImu = false;
+
     // Start is called before the first frame update
     void Start()
     {
 #if ENABLE_WINMD_SUPPORT
+        EnableMultiplexedTransport(useMultiplexedTransport);
+        EnableDepthCompression(compressDepth);
+        EnableDepthBitPacking(packDepth12Bit);
+        EnableTemporalDelta(temporalDelta, keyframeInterval);
+        SetTemporalCompression(lz4Dictionary, lz4Acceleration);
+        EnableTiledQoi(tiledQoi, qoiBands);
+        SetPvScaleFactor(pvScaleFactor);
+        EnableAdaptiveEncoding(adaptiveEncoding, cpuBudget);
+        EnableAdaptiveFrameRate(adaptiveFrameRate, maxLatencyMs);
+        EnableCompactPose(compactPose, quantizePose);
+        EnableImuStreaming(streamImu);
+        ConfigureSensor(0, photoVideo);
+        ConfigureSensor(1, depth);
+        ConfigureSensor(2, leftFront);
+        ConfigureSensor(3, rightFront);
+        ConfigureSensor(5, leftLeft);
+        ConfigureSensor(6, rightRight);
+        ConfigureSensor(7, ahatDepth);
+        ConfigureSensor(8, frontStereo);
         InitializeDll();
 #endif
     }